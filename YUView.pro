@@ -16,10 +16,13 @@ SOURCES += \
     source/fileSourceAVCAnnexBFile.cpp \
     source/fileSourceHEVCAnnexBFile.cpp \
     source/fileSourceJEMAnnexBFile.cpp \
+    source/frameBufferPool.cpp \
     source/frameHandler.cpp \
+    source/frameLookAhead.cpp \
     source/hevcDecoderLibde265.cpp \
     source/hevcDecoderHM.cpp \
     source/hevcNextGenDecoderJEM.cpp \
+    source/indexRangeSet.cpp \
     source/mainwindow.cpp \
     source/playbackController.cpp \
     source/playlistItem.cpp \
@@ -51,10 +54,13 @@ SOURCES += \
     source/typedef.cpp \
     source/updateHandler.cpp \
     source/videoCache.cpp \
+    source/videoCacheEvictionPolicy.cpp \
+    source/videoCacheSpillFile.cpp \
     source/videoHandler.cpp \
     source/videoHandlerDifference.cpp \
     source/videoHandlerRGB.cpp \
     source/videoHandlerYUV.cpp \
+    source/videoHandlerYUVSIMD.cpp \
     source/viewStateHandler.cpp \
     source/yuviewapp.cpp
 
@@ -69,10 +75,13 @@ HEADERS += \
     source/fileSourceAVCAnnexBFile.h \
     source/fileSourceHEVCAnnexBFile.h \
     source/fileSourceJEMAnnexBFile.h \
+    source/frameBufferPool.h \
     source/frameHandler.h \
+    source/frameLookAhead.h \
     source/hevcDecoderHM.h \
     source/hevcDecoderLibde265.h \
     source/hevcNextGenDecoderJEM.h \
+    source/indexRangeSet.h \
     source/labelElided.h \
     source/mainwindow.h \
     source/mainwindow_performanceTestDialog.h \
@@ -106,10 +115,13 @@ HEADERS += \
     source/typedef.h \
     source/updateHandler.h \
     source/videoCache.h \
+    source/videoCacheEvictionPolicy.h \
+    source/videoCacheSpillFile.h \
     source/videoHandler.h \
     source/videoHandlerDifference.h \
     source/videoHandlerRGB.h \
     source/videoHandlerYUV.h \
+    source/videoHandlerYUVSIMD.h \
     source/viewStateHandler.h \
     source/yuviewapp.h
 
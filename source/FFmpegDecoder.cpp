@@ -36,9 +36,8 @@
 #include <QCoreApplication>
 #include <QDateTime>
 #include <QDir>
-#include <QProgressDialog>
 #include <QSettings>
-#include "mainwindow.h"
+#include <QtConcurrent>
 #include "typedef.h"
 
 using namespace FFmpeg;
@@ -51,6 +50,11 @@ using namespace FFmpeg;
 #define DEBUG_FFMPEG(fmt,...) ((void)0)
 #endif
 
+// When opening a file, this many packets are indexed right away. The rest of the file is indexed in the background.
+#define SCAN_INITIAL_NR_PACKETS 256
+// The background scan publishes what it found so far in this interval
+#define BACKGROUND_SCAN_PUBLISH_INTERVAL_MS 500
+
 FFmpegDecoder::FFmpegDecoder()
 {
   // No error (yet)
@@ -74,11 +78,17 @@ FFmpegDecoder::FFmpegDecoder()
   // When using the zoom box the getOneFrame function is called frequently so we
   // keep this buffer to not decode the same frame over and over again.
   currentOutputBufferFrameIndex = -1;
+  currentOutputFrameValid = false;
+  currentOutputBufferFilled = false;
+  bufferPool = nullptr;
   statsCacheCurFrameIdx = -1;
+  sharedIndexRevision = -1;
 }
 
 FFmpegDecoder::~FFmpegDecoder()
 {
+  stopBackgroundScan();
+
   // Free all the allocated data structures
   if (pkt)
     pkt.free_packet();
@@ -166,9 +176,16 @@ bool FFmpegDecoder::openFile(QString fileName, FFmpegDecoder *otherDec)
 
     if (otherDec)
     {
-      // Copy the key picture list and nrFrames from the other decoder
-      keyFrameList = otherDec->keyFrameList;
-      nrFrames = otherDec->nrFrames;
+      // Copy the key picture list and nrFrames from the other decoder. If the other decoder scans the file in
+      // the background, get them from the index of the scan and follow it.
+      sharedIndex = otherDec->sharedIndex;
+      if (sharedIndex)
+        updateIndexFromBackgroundScan();
+      else
+      {
+        keyFrameList = otherDec->keyFrameList;
+        nrFrames = otherDec->nrFrames;
+      }
     }
     else
       if (!scanBitstream())
@@ -435,94 +452,183 @@ bool FFmpegDecoder::scanBitstream()
     // Seeking failed. Maybe the stream is not opened correctly?
     return false;
 
-  // Show a modal QProgressDialog while this operation is running.
-  // If the user presses cancel, we will cancel and return false (opening the file failed).
-  // First, get a pointer to the main window to use as a parent for the modal parsing progress dialog.
-  QWidgetList l = QApplication::topLevelWidgets();
-  QWidget *mainWindow = nullptr;
-  for (QWidget *w : l)
+  // Index the beginning of the stream so that the first frames can be decoded right away
+  const int streamIdx = video_stream.get_index();
+  qint64 lastPTS;
+  bool endOfStream;
+  if (!scanPackets(fmt_ctx, streamIdx, SCAN_INITIAL_NR_PACKETS, keyFrameList, nrFrames, lastPTS, endOfStream) || keyFrameList.isEmpty())
   {
-    MainWindow *mw = dynamic_cast<MainWindow*>(w);
-    if (mw)
-      mainWindow = mw;
+    keyFrameList.clear();
+    nrFrames = -1;
+    return false;
   }
-  // Create the dialog
-  int64_t duration = fmt_ctx.get_duration();
-  AVRational timeBase = video_stream.get_time_base();
-
-  qint64 maxPTS = duration * timeBase.den / timeBase.num / 1000;
-  // Updating the dialog (setValue) is quite slow. Only do this if the percent value changes.
-  int curPercentValue = 0;
-  QProgressDialog progress("Parsing (indexing) bitstream...", "Cancel", 0, 100, mainWindow);
-  progress.setMinimumDuration(1000);  // Show after 1s
-  progress.setAutoClose(false);
-  progress.setAutoReset(false);
-  progress.setWindowModality(Qt::WindowModal);
 
+  // Seek back to the beginning of the stream.
+  ret = ff.seek_frame(fmt_ctx, streamIdx, 0);
+  if (ret != 0)
+    // Seeking failed.
+    return false;
+
+  if (endOfStream)
+    // The stream is short. We are done.
+    return true;
+
+  // Scan the whole stream in a background thread using a format context of its own
+  sharedIndex.reset(new backgroundScanIndex);
+  sharedIndex->keyFrameList = keyFrameList;
+  sharedIndex->nrFrames = nrFrames;
+  sharedIndexRevision = sharedIndex->revision;
+  backgroundScanFuture = QtConcurrent::run(this, &FFmpegDecoder::runBackgroundScan, streamIdx);
+  DEBUG_FFMPEG("FFmpegDecoder::scanBitstream Started background scan after %d frames", nrFrames);
+  return true;
+}
+
+bool FFmpegDecoder::scanPackets(AVFormatContextWrapper &ctx, int streamIdx, int maxNrPackets, QList<pictureIdx> &keyFrames, int &nrFramesFound, qint64 &lastPTS, bool &endOfStream)
+{
   // Initialize an empty packet (data and size set to 0).
   AVPacketWrapper p(ff);
 
-  qint64 lastKeyFramePTS = 0;
-  const int stream_idx = video_stream.get_index();
-  do
+  qint64 lastKeyFramePTS = keyFrames.isEmpty() ? 0 : keyFrames.last().pts;
+  lastPTS = lastKeyFramePTS;
+  endOfStream = false;
+  int nrPackets = 0;
+  while (maxNrPackets < 0 || nrPackets < maxNrPackets)
   {
     // Get one packet
-    ret = fmt_ctx.read_frame(ff, p);
+    if (ctx.read_frame(ff, p) != 0)
+    {
+      endOfStream = true;
+      break;
+    }
 
-    if (ret == 0 && p.get_stream_index() == stream_idx)
+    if (p.get_stream_index() == streamIdx)
     {
       int64_t pts = p.get_pts();
 
       // Next video frame found
       if (p.get_flags() & AV_PKT_FLAG_KEY)
       {
-        if (nrFrames == -1)
-          nrFrames = 0;
-        keyFrameList.append(pictureIdx(nrFrames, pts));
+        if (nrFramesFound == -1)
+          nrFramesFound = 0;
+        keyFrames.append(pictureIdx(nrFramesFound, pts));
         lastKeyFramePTS = pts;
       }
       if (pts < lastKeyFramePTS)
       {
         // What now? Can this happen? If this happens, the frame count/PTS combination of the last key frame
         // is wrong.
-        keyFrameList.clear();
-        nrFrames = -1;
-        // Free the packet (this will automatically unref the packet as weel)
         p.unref_packet(ff);
         return false;
       }
-      nrFrames++;
-
-      // Update the progress dialog
-      if (progress.wasCanceled())
-      {
-        keyFrameList.clear();
-        nrFrames = -1;
-        // Free the packet (this will automatically unref the packet as weel)
-        p.unref_packet(ff);
-        return false;
-      }
-      int newPercentValue = pts * 100 / maxPTS;
-      if (newPercentValue != curPercentValue)
-      {
-        progress.setValue(newPercentValue);
-        curPercentValue = newPercentValue;
-      }
+      nrFramesFound++;
+      nrPackets++;
+      lastPTS = pts;
     }
 
     // Unref the packet
     p.unref_packet(ff);
-  } while (ret == 0);
+  }
+  return true;
+}
+
+void FFmpegDecoder::runBackgroundScan(int streamIdx)
+{
+  AVFormatContextWrapper ctx;
+  if (ff.open_input(ctx, fullFilePath) < 0)
+  {
+    DEBUG_FFMPEG("FFmpegDecoder::runBackgroundScan Opening the file failed");
+    QMutexLocker lock(&sharedIndex->mutex);
+    sharedIndex->scanComplete = true;
+    return;
+  }
 
-  progress.close();
+  AVRational timeBase = ctx.get_stream(streamIdx).get_time_base();
+  const qint64 maxPTS = ctx.get_duration() * timeBase.den / timeBase.num / 1000;
 
-  // Seek back to the beginning of the stream.
-  ret = ff.seek_frame(fmt_ctx, video_stream.get_index(), 0);
-  if (ret != 0)
-    // Seeking failed.
+  QList<pictureIdx> keyFrames;
+  int nrFramesFound = -1;
+  bool endOfStream = false;
+  bool indexValid = true;
+  QElapsedTimer publishTimer;
+  publishTimer.start();
+  while (!endOfStream && sharedIndex->cancel.load() == 0)
+  {
+    qint64 lastPTS;
+    if (!scanPackets(ctx, streamIdx, SCAN_INITIAL_NR_PACKETS, keyFrames, nrFramesFound, lastPTS, endOfStream))
+    {
+      // The frames after the last published frame can not be indexed. Keep what was published so far.
+      DEBUG_FFMPEG("FFmpegDecoder::runBackgroundScan Indexing failed after %d frames", nrFramesFound);
+      indexValid = false;
+      break;
+    }
+    if (!endOfStream && publishTimer.elapsed() < BACKGROUND_SCAN_PUBLISH_INTERVAL_MS)
+      continue;
+
+    // The scan starts at the beginning of the file again. Only publish once it found more than what is known already.
+    QMutexLocker lock(&sharedIndex->mutex);
+    if (maxPTS > 0)
+      sharedIndex->progress = clip(int(lastPTS * 100 / maxPTS), 0, 100);
+    if (nrFramesFound > sharedIndex->nrFrames)
+    {
+      sharedIndex->keyFrameList = keyFrames;
+      sharedIndex->nrFrames = nrFramesFound;
+      sharedIndex->revision++;
+    }
+    publishTimer.restart();
+  }
+
+  QMutexLocker lock(&sharedIndex->mutex);
+  sharedIndex->scanComplete = true;
+  sharedIndex->progress = 100;
+  lock.unlock();
+  ctx.avformat_close_input(ff);
+  DEBUG_FFMPEG("FFmpegDecoder::runBackgroundScan Done. %d frames %s", nrFramesFound, indexValid ? "" : "(index incomplete)");
+  Q_UNUSED(indexValid);
+}
+
+void FFmpegDecoder::stopBackgroundScan()
+{
+  if (sharedIndex && backgroundScanFuture.isRunning())
+  {
+    sharedIndex->cancel.store(1);
+    backgroundScanFuture.waitForFinished();
+  }
+}
+
+void FFmpegDecoder::updateIndexFromBackgroundScan()
+{
+  if (!sharedIndex)
+    return;
+  QMutexLocker lock(&sharedIndex->mutex);
+  if (sharedIndex->revision == sharedIndexRevision)
+    return;
+  keyFrameList = sharedIndex->keyFrameList;
+  nrFrames = sharedIndex->nrFrames;
+  sharedIndexRevision = sharedIndex->revision;
+}
+
+int FFmpegDecoder::getNumberPOCs() const
+{
+  if (!sharedIndex)
+    return nrFrames;
+  QMutexLocker lock(&sharedIndex->mutex);
+  return sharedIndex->nrFrames;
+}
+
+bool FFmpegDecoder::isBackgroundScanRunning() const
+{
+  if (!sharedIndex)
     return false;
+  QMutexLocker lock(&sharedIndex->mutex);
+  return !sharedIndex->scanComplete && sharedIndex->cancel.load() == 0;
+}
 
-  return true;
+int FFmpegDecoder::getBackgroundScanProgress() const
+{
+  if (!sharedIndex)
+    return 100;
+  QMutexLocker lock(&sharedIndex->mutex);
+  return sharedIndex->progress;
 }
 
 QList<infoItem> FFmpegDecoder::getFileInfoList() const
@@ -572,16 +678,52 @@ QList<infoItem> FFmpegDecoder::getDecoderInfo() const
 
 QByteArray FFmpegDecoder::loadYUVFrameData(int frameIdx)
 {
-  // At first check if the request is for the frame that has been requested in the
-  // last call to this function.
-  if (frameIdx == currentOutputBufferFrameIndex)
+  if (!decodeFrame(frameIdx))
+    return QByteArray();
+
+  // Copy the frame into the output buffer (only once per frame)
+  if (!currentOutputBufferFilled)
+  {
+    copyFrameToOutputBuffer();
+    currentOutputBufferFilled = true;
+  }
+  return currentOutputBuffer;
+}
+
+bool FFmpegDecoder::loadYUVFramePlanes(int frameIdx, yuvPlanes &planes)
+{
+  if (!decodeFrame(frameIdx))
+    return false;
+
+  // The planes can only be used directly if the frame has three planes with the size of the output frame
+  yuvPixelFormat pixFmt = getYUVPixelFormat();
+  if (!pixFmt.isValid() || !pixFmt.planar || pixFmt.subsampling == YUV_400)
+    return false;
+  if (frame.get_width() != frameSize.width() || frame.get_height() != frameSize.height())
+    return false;
+  for (int c = 0; c < 3; c++)
   {
-    assert(!currentOutputBuffer.isEmpty()); // Must not be empty or something is wrong
-    return currentOutputBuffer;
+    planes.plane[c] = frame.get_data(c);
+    planes.stride[c] = frame.get_line_size(c);
+    if (planes.plane[c] == nullptr)
+      return false;
   }
+  return true;
+}
+
+bool FFmpegDecoder::decodeFrame(int frameIdx)
+{
+  // At first check if the request is for the frame that has been requested in the
+  // last call to this function. The frame is still in the decoder.
+  if (frameIdx == currentOutputBufferFrameIndex && currentOutputFrameValid)
+    return true;
+
+  // The last frame is not valid anymore once we continue decoding
+  currentOutputFrameValid = false;
+  currentOutputBufferFilled = false;
 
   // We have to decode the requested frame.
-  if ((int)frameIdx < currentOutputBufferFrameIndex || currentOutputBufferFrameIndex == -1)
+  if ((int)frameIdx <= currentOutputBufferFrameIndex || currentOutputBufferFrameIndex == -1)
   {
     // The requested frame lies before the current one. We will have to rewind and start decoding from there.
     pictureIdx seekFrameIdxAndPTS = getClosestSeekableFrameNumberBefore(frameIdx);
@@ -613,21 +755,26 @@ QByteArray FFmpegDecoder::loadYUVFrameData(int frameIdx)
     // We have decoded one frame. Get the pixel format.
     if (currentOutputBufferFrameIndex == frameIdx)
     {
-      // This is the frame that we want to decode
-
-      // Put image data into buffer
-      copyFrameToOutputBuffer();
+      // This is the frame that we want to decode. It is copied from the frame when it is requested.
+      currentOutputFrameValid = true;
 
       // Get the motion vectors from the image as well...
       // TODO: Only perform this if the statistics are shown. 
       copyFrameMotionInformation();
       statsCacheCurFrameIdx = currentOutputBufferFrameIndex;
 
-      return currentOutputBuffer;
+      return true;
+    }
+    else if (wantIntermediateFrame && wantIntermediateFrame(currentOutputBufferFrameIndex))
+    {
+      // Hand the frame that we decoded on the way to the requested one to the intermediate frame handler.
+      // The output buffer is shared with the handler. The next frame is copied into another buffer.
+      copyFrameToOutputBuffer();
+      intermediateFrameDecoded(currentOutputBufferFrameIndex, currentOutputBuffer);
     }
   }
 
-  return QByteArray();
+  return false;
 }
 
 void FFmpegDecoder::copyFrameToOutputBuffer()
@@ -641,9 +788,10 @@ void FFmpegDecoder::copyFrameToOutputBuffer()
   int nrBytesC = frameSize.width() / pixFmt.getSubsamplingHor() * frameSize.height() / pixFmt.getSubsamplingVer() * nrBytesPerSample;
   int nrBytes = nrBytesY + 2 * nrBytesC;
 
-  // Is the output big enough?
-  if (currentOutputBuffer.capacity() < nrBytes)
-    currentOutputBuffer.resize(nrBytes);
+  // Get an output buffer of the right size. Writing into a buffer that is still referenced elsewhere (e.g. by
+  // the cache) would copy it first, so in this case another buffer is taken from the pool.
+  if (currentOutputBuffer.size() != nrBytes || !currentOutputBuffer.isDetached())
+    currentOutputBuffer = bufferPool ? bufferPool->getBuffer(nrBytes) : QByteArray(nrBytes, Qt::Uninitialized);
 
   // Copy line by line. The linesize of the source may be larger than the width of the frame.
   // This may be because the frame buffer is (8) byte aligned. Also the internal decoded
@@ -679,6 +827,9 @@ void FFmpegDecoder::copyFrameToOutputBuffer()
       src += linesize;
     }
   }
+
+  if (bufferPool)
+    bufferPool->putBuffer(currentOutputBuffer);
 }
 
 void FFmpegDecoder::copyFrameMotionInformation()
@@ -732,8 +883,24 @@ bool FFmpegDecoder::reloadItemSource()
   return false;
 }
 
+QList<int> FFmpegDecoder::getKeyFrameNumbers() const
+{
+  QList<int> keyFrames;
+  if (sharedIndex)
+  {
+    QMutexLocker lock(&sharedIndex->mutex);
+    for (auto f : sharedIndex->keyFrameList)
+      keyFrames.append(int(f.frame));
+    return keyFrames;
+  }
+  for (auto f : keyFrameList)
+    keyFrames.append(int(f.frame));
+  return keyFrames;
+}
+
 FFmpegDecoder::pictureIdx FFmpegDecoder::getClosestSeekableFrameNumberBefore(int frameIdx)
 {
+  updateIndexFromBackgroundScan();
   pictureIdx ret = keyFrameList.first();
   for (auto f : keyFrameList)
   {
@@ -782,7 +949,7 @@ statisticsData FFmpegDecoder::getStatisticsData(int frameIdx, int typeIdx)
       // This can be done like this:
       currentOutputBufferFrameIndex ++;
 
-    loadYUVFrameData(frameIdx);
+    decodeFrame(frameIdx);
   }
 
   return curFrameStats[typeIdx];
@@ -38,8 +38,15 @@
 #include "videoHandlerYUV.h"
 #include "FFMpegDecoderLibHandling.h"
 #include "fileSourceAVCAnnexBFile.h"
+#include "frameBufferPool.h"
+#include <functional>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QFuture>
 #include <QLibrary>
 #include <QFileSystemWatcher>
+#include <QMutex>
+#include <QSharedPointer>
 
 using namespace YUV_Internals;
 
@@ -55,7 +62,8 @@ public:
   // Open the given file. Parse the NAL units list and get the size and YUV pixel format from the file.
   // Return false if an error occured (opening the decoder or parsing the bitstream)
   // If a second decoder is provided, the bistream will not be scanned again (scanBitstream), but
-  // the values will be copied from the given decoder.
+  // the values will be copied from the given decoder. If the other decoder is still scanning the file in the
+  // background, this decoder also picks up the frames that the scan finds.
   bool openFile(QString fileName, FFmpegDecoder *otherDec=nullptr);
 
   // Get the pixel format and frame size. This is valid after openFile was called.
@@ -65,8 +73,13 @@ public:
   // Get some infos on the file (like date changed, file size, etc...)
   QList<infoItem> getFileInfoList() const;
 
-  // How many frames are in the file?
-  int getNumberPOCs() const { return nrFrames; }
+  // How many frames are in the file? While the file is scanned in the background, this grows.
+  int getNumberPOCs() const;
+  // Get the frame numbers of the key frames that we can seek to
+  QList<int> getKeyFrameNumbers() const;
+  // Only the beginning of the file is scanned in openFile. The rest of it is scanned in a background thread.
+  bool isBackgroundScanRunning() const;
+  int getBackgroundScanProgress() const;
   double getFrameRate() const { return frameRate; }
   ColorConversion getColorConversionType() const { return colorConversionType; }
 
@@ -81,6 +94,14 @@ public:
 
   // Load the raw YUV data for the given frame
   QByteArray loadYUVFrameData(int frameIdx);
+  // Get the planes of the given frame directly from the decoder (without copying them). They are valid until the
+  // decoder is used again. Returns false if the frame can not be provided like this.
+  bool loadYUVFramePlanes(int frameIdx, yuvPlanes &planes);
+  // Take the buffers for the decoded frames from the given pool (owned by the playlist item)
+  void setFrameBufferPool(frameBufferPool *pool) { bufferPool = pool; }
+  // Frames that are decoded on the way to the requested frame are dropped unless a handler is set that wants them.
+  // Both functions are called from the thread that uses the decoder.
+  void setIntermediateFrameHandler(std::function<bool(int)> wantFrame, std::function<void(int, const QByteArray&)> frameDecoded) { wantIntermediateFrame = wantFrame; intermediateFrameDecoded = frameDecoded; }
 
   // Was the file changed by some other application?
   bool isFileChanged() { bool b = fileChanged; fileChanged = false; return b; }
@@ -111,8 +132,8 @@ private:
   // If this fails, decoderError will be set.
   void bindFunctionsFromLibraries();
 
-  // Scan the entire stream. Get the number of frames that we can decode and the key frames
-  // that we can seek to.
+  // Scan the stream. Get the number of frames that we can decode and the key frames that we can seek to.
+  // Only the beginning of the stream is scanned here. If there is more, the scan continues in a background thread.
   bool scanBitstream();
 
   // The decoderLibraries can be accessed through this class independent of the FFmpeg version.
@@ -165,6 +186,32 @@ private:
   int nrFrames;                               //< How many frames are in the sequence?
   QList<pictureIdx> keyFrameList;  //< A list of pairs (frameNr, PTS) that we can seek to.
   pictureIdx getClosestSeekableFrameNumberBefore(int frameIdx);
+  // Read up to maxNrPackets packets (-1: until the end of the stream) of the video stream from the given context and
+  // add them to the frame count and the key frame list. Return false if the packets can not be indexed.
+  bool scanPackets(AVFormatContextWrapper &ctx, int streamIdx, int maxNrPackets, QList<pictureIdx> &keyFrames, int &nrFramesFound, qint64 &lastPTS, bool &endOfStream);
+
+  // ---- Scanning in the background
+  // The index of a file that is scanned in the background. The scan publishes what it found so far in regular
+  // intervals. The decoder that started the scan and all decoders that copied its index pick up the changes from here.
+  struct backgroundScanIndex
+  {
+    backgroundScanIndex() : nrFrames(-1), revision(0), progress(0), scanComplete(false) {}
+    QMutex mutex;
+    QList<pictureIdx> keyFrameList;
+    int nrFrames;
+    int revision;
+    int progress;
+    bool scanComplete;
+    QAtomicInt cancel;
+  };
+  QSharedPointer<backgroundScanIndex> sharedIndex;
+  int sharedIndexRevision;
+  // Only the decoder that started the scan runs it (with its own format context)
+  QFuture<void> backgroundScanFuture;
+  void runBackgroundScan(int streamIdx);
+  void stopBackgroundScan();
+  // Get the latest index from the background scan (if it changed)
+  void updateIndexFromBackgroundScan();
 
   // Seek the stream to the given pts value, flush the decoder and load the first packet so
   // that we are ready to start decoding from this pts.
@@ -176,6 +223,10 @@ private:
 
   // The buffer and the index that was requested in the last call to getOneFrame
   int currentOutputBufferFrameIndex;
+  // Decode the given frame into frame (if it is not there yet)
+  bool decodeFrame(int frameIdx);
+  bool currentOutputFrameValid;    //< Does frame hold the picture of currentOutputBufferFrameIndex?
+  bool currentOutputBufferFilled;  //< Was frame copied to currentOutputBuffer?
 #if SSE_CONVERSION
   byteArrayAligned currentOutputBuffer;
   void copyImgToByteArray(const de265_image *src, byteArrayAligned &dst);
@@ -183,6 +234,9 @@ private:
   QByteArray currentOutputBuffer;
   void copyFrameToOutputBuffer(); // Copy the raw data from the frame to the currentOutputBuffer
 #endif
+  frameBufferPool *bufferPool;
+  std::function<bool(int)> wantIntermediateFrame;
+  std::function<void(int, const QByteArray&)> intermediateFrameDecoded;
 
   fileSourceAVCAnnexBFile annexBFile;
   bool canShowNALUnits;
@@ -68,6 +68,18 @@ decoderBase::decoderBase(bool cachingDecoder) :
   // When using the zoom box the getOneFrame function is called frequently so we
   // keep this buffer to not decode the same frame over and over again.
   currentOutputBufferFrameIndex = -1;
+  bufferPool = nullptr;
+}
+
+void decoderBase::prepareOutputBuffer(QByteArray &buffer, int size)
+{
+  if (buffer.size() == size && buffer.isDetached())
+    return;
+
+  if (bufferPool)
+    buffer = bufferPool->getBuffer(size);
+  else
+    buffer = QByteArray(size, Qt::Uninitialized);
 }
 
 void decoderBase::setDecodeSignal(int signalID)
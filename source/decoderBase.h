@@ -33,14 +33,19 @@
 #ifndef DECODERBASE_H
 #define DECODERBASE_H
 
+#include <functional>
 #include <QLibrary>
 #include "fileSourceAnnexBFile.h"
+#include "frameBufferPool.h"
 #include "statisticHandler.h"
 #include "statisticsExtensions.h"
 #include "videoHandlerYUV.h"
 
 using namespace YUV_Internals;
 
+// Every caching decoder needs memory for its own picture buffers. Do not allocate more than this per item.
+#define MAX_NR_CACHING_DECODERS 8
+
 /* This class is the abstract base class for all non FFMpeg decoders that read from a raw source file.
 */
 class decoderBase
@@ -62,12 +67,27 @@ public:
   int getNumberPOCs() const { return annexBFile->getNumberPOCs(); }
   bool isFileChanged() { return annexBFile->isFileChanged(); }
   void updateFileWatchSetting() { annexBFile->updateFileWatchSetting(); }
+  // Data was appended to the file. A decoder that already flushed at the old end of the file (or whose frame indices
+  // changed) has to seek. Call this from the thread that uses the decoder.
+  void continueAfterFileGrew(bool frameIndicesChanged) { if (frameIndicesChanged || annexBFile->atEnd()) currentOutputBufferFrameIndex = -1; }
+
+  // Frames that are decoded on the way to the requested frame (e.g. after seeking to a random access point) are dropped.
+  // If a handler is set, it is asked for each of these frames if it wants it and the wanted frames are passed to it.
+  // Both functions are called from the thread that uses the decoder.
+  void setIntermediateFrameHandler(std::function<bool(int)> wantFrame, std::function<void(int, const QByteArray&)> frameDecoded) { wantIntermediateFrame = wantFrame; intermediateFrameDecoded = frameDecoded; }
+
+  // Take the buffers for the decoded frames from the given pool (owned by the playlist item)
+  void setFrameBufferPool(frameBufferPool *pool) { bufferPool = pool; }
 
   // Which signal should we read from the decoder? Reconstruction(0, default), Prediction(1) or Residual(2)
   void setDecodeSignal(int signalID);
 
   // Load the raw YUV data for the given frame
   virtual QByteArray loadYUVFrameData(int frameIdx) = 0;
+  // Decode the given frame and get pointers to its planes in the picture buffer of the decoder instead of copying
+  // the frame. The planes are valid until the decoder is used again. Return false if the decoder can not provide
+  // the planes of the frame in the YUV format of the decoder (getYUVPixelFormat()). Use loadYUVFrameData then.
+  virtual bool loadYUVFramePlanes(int frameIdx, yuvPlanes &planes) { Q_UNUSED(frameIdx); Q_UNUSED(planes); return false; }
 
   // Get the statistics values for the given frame (decode if necessary)
   virtual statisticsData getStatisticsData(int frameIdx, int typeIdx) = 0;
@@ -112,6 +132,22 @@ protected:
 
   void setError(const QString &reason);
 
+  // Get a buffer of the given size to copy a decoded frame into. Writing into a buffer that is still referenced
+  // elsewhere (e.g. by the cache) would copy it first, so in this case another buffer is taken from the pool.
+  // When the frame was written, put the buffer back into the pool.
+  void prepareOutputBuffer(QByteArray &buffer, int size);
+  void putOutputBuffer(const QByteArray &buffer) { if (bufferPool) bufferPool->putBuffer(buffer); }
+#if SSE_CONVERSION
+  void prepareOutputBuffer(byteArrayAligned &buffer, int size) { if (buffer.capacity() < size) buffer.resize(size); }
+  void putOutputBuffer(byteArrayAligned &buffer) { Q_UNUSED(buffer); }
+#endif
+  frameBufferPool *bufferPool;
+
+  // Does the intermediate frame handler want the given frame? Only then the picture has to be copied out of the decoder.
+  bool isIntermediateFrameWanted(int frameIdx) const { return wantIntermediateFrame && wantIntermediateFrame(frameIdx); }
+  std::function<bool(int)> wantIntermediateFrame;
+  std::function<void(int, const QByteArray&)> intermediateFrameDecoded;
+
   // if set to true the decoder will also get statistics from each decoded frame and put them into the local cache
   bool retrieveStatistics;
 
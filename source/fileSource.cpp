@@ -32,16 +32,24 @@
 
 #include "fileSource.h"
 
+#include <cerrno>
 #include <QDateTime>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QRegExp>
 #include <QSettings>
 #include "typedef.h"
 
 #ifdef Q_OS_WIN
 #include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
 #endif
  
+// How many bytes at the end of the file are compared to check if data was only appended to the file
+#define FILESOURCE_TAIL_CHECK_SIZE 4096
+
 #define FILESOURCE_DEBUG_SIMULATESLOWLOADING 0
 #if FILESOURCE_DEBUG_SIMULATESLOWLOADING && !NDEBUG
 #include <QThread>
@@ -51,10 +59,24 @@ fileSource::fileSource()
 {
   fileChanged = false;
   isFileOpened = false;
+  mappedData = nullptr;
+  mappedSize = 0;
+  mappedAccessSequential = -1;
+#ifdef Q_OS_WIN
+  positionalReadHandle = INVALID_HANDLE_VALUE;
+#endif
 
   connect(&fileWatcher, &QFileSystemWatcher::fileChanged, this, &fileSource::fileSystemWatcherFileChanged);
 }
 
+fileSource::~fileSource()
+{
+#ifdef Q_OS_WIN
+  if (positionalReadHandle != INVALID_HANDLE_VALUE)
+    CloseHandle(positionalReadHandle);
+#endif
+}
+
 bool fileSource::openFile(const QString &filePath)
 {
   // Check if the file exists
@@ -62,26 +84,84 @@ bool fileSource::openFile(const QString &filePath)
   if (!fileInfo.exists() || !fileInfo.isFile())
     return false;
 
+  QWriteLocker handleLock(&fileHandleLock);
   if (isFileOpened && srcFile.isOpen())
     srcFile.close();
 
   // open file for reading
   srcFile.setFileName(filePath);
   isFileOpened = srcFile.open(QIODevice::ReadOnly);
+#ifdef Q_OS_WIN
+  if (positionalReadHandle != INVALID_HANDLE_VALUE)
+    CloseHandle(positionalReadHandle);
+  positionalReadHandle = INVALID_HANDLE_VALUE;
+  if (isFileOpened)
+  {
+    LPCWSTR file = (const wchar_t*) filePath.utf16();
+    positionalReadHandle = CreateFile(file, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    isFileOpened = (positionalReadHandle != INVALID_HANDLE_VALUE);
+  }
+#endif
   if (!isFileOpened)
     return false;
 
   // Save the full file path
   fullFilePath = filePath;
 
+  // If the file was mapped, map the new file
+  if (mappedData != nullptr)
+  {
+    handleLock.unlock();
+    setMemoryMapping(false);
+    setMemoryMapping(true);
+  }
+
   // Install a watcher for the file (if file watching is active)
   updateFileWatchSetting();
 
   fileChanged = false;
+  updateKnownFileTail();
 
   return true;
 }
 
+qint64 fileSource::updateAppendedData()
+{
+  if (!isFileOpened)
+    return -1;
+
+  const qint64 knownSize = fileInfo.size();
+  QFileInfo newFileInfo(fullFilePath);
+  if (!newFileInfo.exists() || newFileInfo.size() < knownSize)
+    return -1;
+
+  // The data that we already know must not have changed
+  QByteArray tail;
+  const qint64 tailStart = knownSize - knownFileTail.size();
+  if (readBytes(tail, tailStart, knownFileTail.size()) != knownFileTail.size() || tail != knownFileTail)
+    return -1;
+
+  // The change (if any) was that data was appended
+  fileChanged = false;
+  const qint64 nrBytesAppended = newFileInfo.size() - knownSize;
+  if (nrBytesAppended == 0)
+    return 0;
+
+  // The mapping (if any) is not extended. The appended data is read from the file.
+  fileInfo = newFileInfo;
+  updateKnownFileTail();
+  return nrBytesAppended;
+}
+
+void fileSource::updateKnownFileTail()
+{
+  const qint64 fileSize = fileInfo.size();
+  const qint64 tailSize = qMin(fileSize, qint64(FILESOURCE_TAIL_CHECK_SIZE));
+  knownFileTail.clear();
+  if (readBytes(knownFileTail, fileSize - tailSize, tailSize) != tailSize)
+    knownFileTail.clear();
+}
+
 #if SSE_CONVERSION
 // Resize the target array if necessary and read the given number of bytes to the data array
 void fileSource::readBytes(byteArrayAligned &targetBuffer, qint64 startPos, qint64 nrBytes)
@@ -92,8 +172,7 @@ void fileSource::readBytes(byteArrayAligned &targetBuffer, qint64 startPos, qint
   if (targetBuffer.size() < nrBytes)
     targetBuffer.resize(nrBytes);
 
-  srcFile.seek(startPos);
-  srcFile.read(targetBuffer.data(), nrBytes);
+  readBytesPositional(targetBuffer.data(), startPos, nrBytes);
 }
 #endif
 
@@ -110,10 +189,141 @@ qint64 fileSource::readBytes(QByteArray &targetBuffer, qint64 startPos, qint64 n
   QThread::msleep(50);
 #endif
 
-  // lock the seek and read function
-  QMutexLocker locker(&readMutex);
-  srcFile.seek(startPos);
-  return srcFile.read(targetBuffer.data(), nrBytes);
+  return readBytesPositional(targetBuffer.data(), startPos, nrBytes);
+}
+
+qint64 fileSource::readBytesPositional(char *targetBuffer, qint64 startPos, qint64 nrBytes)
+{
+  // Only wait if the file is being closed/reopened. Reads never wait for each other.
+  QReadLocker handleLock(&fileHandleLock);
+  if (!isFileOpened)
+    return 0;
+
+  // Update the maximum number of concurrent reads
+  const int concurrentReads = activeReads.fetchAndAddRelaxed(1) + 1;
+  int maxReads = maxConcurrentReads.load();
+  while (concurrentReads > maxReads && !maxConcurrentReads.testAndSetRelaxed(maxReads, concurrentReads))
+    maxReads = maxConcurrentReads.load();
+
+  QElapsedTimer readTimer;
+  readTimer.start();
+
+  // The functions may return less bytes than requested. Continue until all bytes are read or the file ends.
+  qint64 bytesRead = 0;
+  while (bytesRead < nrBytes)
+  {
+    const qint64 offset = startPos + bytesRead;
+#ifdef Q_OS_WIN
+    OVERLAPPED overlapped = {};
+    overlapped.Offset = DWORD(offset & 0xFFFFFFFF);
+    overlapped.OffsetHigh = DWORD(offset >> 32);
+    DWORD nrBytesChunk = DWORD(qMin(nrBytes - bytesRead, qint64(1) << 30));
+    DWORD n = 0;
+    if (!ReadFile(positionalReadHandle, targetBuffer + bytesRead, nrBytesChunk, &n, &overlapped) || n == 0)
+      break;
+#else
+    ssize_t n = pread(srcFile.handle(), targetBuffer + bytesRead, size_t(nrBytes - bytesRead), off_t(offset));
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      break;
+#endif
+    bytesRead += n;
+  }
+
+  readTimeUs.fetchAndAddRelaxed(quint64(readTimer.nsecsElapsed() / 1000));
+  nrBytesRead.fetchAndAddRelaxed(quint64(bytesRead));
+  nrReads.fetchAndAddRelaxed(1);
+  activeReads.fetchAndSubRelaxed(1);
+
+  return bytesRead;
+}
+
+bool fileSource::setMemoryMapping(bool enable)
+{
+  QWriteLocker handleLock(&fileHandleLock);
+  if (!enable)
+  {
+    // The mapping is released when the last reader drops its reference
+    mappedFile.clear();
+    mappedData = nullptr;
+    mappedSize = 0;
+    return true;
+  }
+
+  if (mappedData != nullptr)
+    return true;
+  if (!isFileOpened)
+    return false;
+
+  // Use a separate QFile for the mapping. A QFile releases all its mappings when it is closed.
+  QSharedPointer<QFile> file(new QFile(fullFilePath));
+  if (!file->open(QIODevice::ReadOnly) || file->size() <= 0)
+    return false;
+  uchar *data = file->map(0, file->size());
+  if (data == nullptr)
+    return false;
+
+  mappedFile = file;
+  mappedData = data;
+  mappedSize = file->size();
+  mappedAccessSequential = -1;
+  return true;
+}
+
+bool fileSource::isMemoryMapped() const
+{
+  QReadLocker handleLock(&fileHandleLock);
+  return mappedData != nullptr;
+}
+
+QByteArray fileSource::getMappedBytes(qint64 startPos, qint64 nrBytes, QSharedPointer<QFile> &mappingRef) const
+{
+  QReadLocker handleLock(&fileHandleLock);
+  if (mappedData == nullptr || startPos < 0 || nrBytes <= 0 || startPos + nrBytes > mappedSize)
+    return QByteArray();
+  mappingRef = mappedFile;
+  return QByteArray::fromRawData((const char*)(mappedData + startPos), int(nrBytes));
+}
+
+void fileSource::adviseSequentialAccess(bool sequential)
+{
+#ifndef Q_OS_WIN
+  QReadLocker handleLock(&fileHandleLock);
+  if (mappedData == nullptr || mappedAccessSequential == int(sequential))
+    return;
+  madvise(mappedData, size_t(mappedSize), sequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+  mappedAccessSequential = int(sequential);
+#else
+  Q_UNUSED(sequential);
+#endif
+}
+
+void fileSource::prefetchMappedBytes(qint64 startPos, qint64 nrBytes)
+{
+#ifndef Q_OS_WIN
+  QReadLocker handleLock(&fileHandleLock);
+  if (mappedData == nullptr || startPos < 0 || nrBytes <= 0 || startPos >= mappedSize)
+    return;
+  // The address must be aligned to a page
+  const qint64 pageSize = sysconf(_SC_PAGESIZE);
+  const qint64 alignedStart = startPos - (startPos % pageSize);
+  const qint64 end = qMin(startPos + nrBytes, mappedSize);
+  madvise(mappedData + alignedStart, size_t(end - alignedStart), MADV_WILLNEED);
+#else
+  Q_UNUSED(startPos);
+  Q_UNUSED(nrBytes);
+#endif
+}
+
+fileSource::readStatistics fileSource::getReadStatistics() const
+{
+  readStatistics stats;
+  stats.nrReads = nrReads.load();
+  stats.nrBytes = nrBytesRead.load();
+  stats.readTimeUs = readTimeUs.load();
+  stats.maxConcurrentReads = maxConcurrentReads.load();
+  return stats;
 }
 
 QList<infoItem> fileSource::getFileInfoList() const
@@ -138,6 +348,14 @@ QList<infoItem> fileSource::getFileInfoList() const
   QString fileSize = QString("%1").arg(fileInfo.size());
   infoList.append(infoItem("Nr Bytes", fileSize));
 
+  // How fast were the reads from the file?
+  readStatistics stats = getReadStatistics();
+  if (stats.nrReads > 0 && stats.readTimeUs > 0)
+  {
+    QString readRate = QString("%1 MB/s (%2 reads, max %3 in parallel)").arg(double(stats.nrBytes) / stats.readTimeUs, 0, 'f', 1).arg(stats.nrReads).arg(stats.maxConcurrentReads);
+    infoList.append(infoItem("Read Rate", readRate, "The number of bytes read from the file divided by the time spent in the read calls. Reads of multiple threads can run in parallel."));
+  }
+
   return infoList;
 }
 
@@ -315,7 +533,7 @@ void fileSource::clearFileCache()
 #ifdef Q_OS_WIN
   // We will close the QFile, open it using the FILE_FLAG_NO_BUFFERING flags, close it and reopen the QFile.
   // Suggested: http://stackoverflow.com/questions/478340/clear-file-cache-to-repeat-performance-testing
-  QMutexLocker locker(&readMutex);
+  QWriteLocker handleLock(&fileHandleLock);
   srcFile.close();
 
   LPCWSTR file = (const wchar_t*) fullFilePath.utf16();
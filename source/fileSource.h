@@ -33,11 +33,14 @@
 #ifndef FILESOURCE_H
 #define FILESOURCE_H
 
+#include <QAtomicInteger>
 #include <QFile>
 #include <QFileInfo>
 #include <QFileSystemWatcher>
 #include <QMutex>
 #include <QMutexLocker>
+#include <QReadWriteLock>
+#include <QSharedPointer>
 #include <QString>
 #include "fileInfoWidget.h"
 
@@ -51,6 +54,7 @@ class fileSource : public QObject
 
 public:
   fileSource();
+  ~fileSource();
 
   // Try to open the given file and install a watcher for the file.
   virtual bool openFile(const QString &filePath);
@@ -81,11 +85,37 @@ public:
 
   // Read the given number of bytes starting at startPos into the QByteArray out
   // Resize the QByteArray if necessary. Return how many bytes were read.
+  // This uses positional reads which do not change the position of the file. So multiple threads can read
+  // from the file at the same time and the sequential functions (readLine, seek, pos) are not affected.
   qint64 readBytes(QByteArray &targetBuffer, qint64 startPos, qint64 nrBytes);
 #if SSE_CONVERSION
   void readBytes(byteArrayAligned &data, qint64 startPos, qint64 nrBytes);
 #endif
 
+  // Statistics on the reads performed by readBytes. This can be called from any thread.
+  struct readStatistics
+  {
+    quint64 nrReads;
+    quint64 nrBytes;
+    quint64 readTimeUs;      // The summed up time spent in all reads
+    int maxConcurrentReads;  // The maximum number of reads that were running at the same time
+  };
+  readStatistics getReadStatistics() const;
+
+  // --- Memory mapping: The whole file can be mapped into memory. getMappedBytes then returns a QByteArray which
+  // references the mapping directly (no data is copied). The OS page cache holds the data. The returned array is only
+  // valid as long as the caller holds the returned mapping reference. If the mapping is disabled or the file is
+  // reopened, the old mapping is released when the last reference to it is dropped.
+  // Do not map files that may be truncated while they are open (accessing a truncated mapping raises SIGBUS).
+  // Return false if the file could not be mapped (e.g. not enough address space).
+  bool setMemoryMapping(bool enable);
+  bool isMemoryMapped() const;
+  // Get the given bytes from the mapping. Returns an empty array if the file is not mapped or the range is invalid.
+  QByteArray getMappedBytes(qint64 startPos, qint64 nrBytes, QSharedPointer<QFile> &mappingRef) const;
+  // Give the OS a hint on how the mapped file is accessed (sequential or random) and which bytes will be needed next.
+  void adviseSequentialAccess(bool sequential);
+  void prefetchMappedBytes(qint64 startPos, qint64 nrBytes);
+
   QString getAbsoluteFilePath() const { return fileInfo.absoluteFilePath(); }
 
   // Get the absolute path to the file (from absolute or relative path)
@@ -93,6 +123,11 @@ public:
 
   // Was the file changed by some other application?
   bool isFileChanged() { bool b = fileChanged; fileChanged = false; return b; }
+  // Follow mode: A file that is still being written (e.g. by an encoder) only grows at the end. Check if data was appended
+  // to the file since it was opened (or since the last call). If so, the file info (size) is updated. Return the number
+  // of bytes that were appended or -1 if the file was modified in another way (e.g. truncated or rewritten). If the file
+  // only grew, the change is not reported by isFileChanged() anymore.
+  qint64 updateAppendedData();
   // Check if we are supposed to watch the file for changes. If no, remove the file watcher. If yes, install one.
   void updateFileWatchSetting();
 
@@ -115,9 +150,33 @@ private:
   // Watch the opened file for modifications
   QFileSystemWatcher fileWatcher;
   bool fileChanged;
-
-  // protect the read function with a mutex
-  QMutex readMutex;
+  // The last bytes of the file (at the known size). If these are unchanged, data was only appended to the file.
+  QByteArray knownFileTail;
+  void updateKnownFileTail();
+
+  // Read from the given position without using (or changing) the position of the file. Return how many bytes were read.
+  qint64 readBytesPositional(char *targetBuffer, qint64 startPos, qint64 nrBytes);
+#ifdef Q_OS_WIN
+  // On windows, a separate handle is used for the positional reads (ReadFile with an offset moves the file pointer)
+  void *positionalReadHandle;
+#endif
+  // The positional reads can run in parallel. Only closing/reopening the file or changing the mapping requires
+  // exclusive access.
+  mutable QReadWriteLock fileHandleLock;
+
+  // The file that is mapped into memory (if enabled). The QFile unmaps the file when it is destroyed. Readers of the
+  // mapped data hold a reference to it so that it stays mapped until the last reader is done.
+  QSharedPointer<QFile> mappedFile;
+  uchar *mappedData;
+  qint64 mappedSize;
+  int mappedAccessSequential;   // The current access hint (-1 none, 0 random, 1 sequential)
+
+  // Read statistics
+  QAtomicInteger<quint64> nrReads;
+  QAtomicInteger<quint64> nrBytesRead;
+  QAtomicInteger<quint64> readTimeUs;
+  QAtomicInt activeReads;
+  QAtomicInt maxConcurrentReads;
 };
 
 #endif
@@ -36,21 +36,21 @@
 #include <QDebug>
 
 // Read "numBits" bits into the variable "into". 
-#define READBITS(into,numBits) {QString code; into=reader.readBits(numBits, &code); if (itemTree) new TreeItem(#into,into,QString("u(v) -> u(%1)").arg(numBits),code, itemTree);}
-#define READBITS_M(into,numBits,meanings) {QString code; into=reader.readBits(numBits, &code); if (itemTree) new TreeItem(#into,into,QString("u(v) -> u(%1)").arg(numBits),code, meanings,itemTree);}
-#define READBITS_A(into,numBits,i) {QString code; int v=reader.readBits(numBits,&code); into.append(v); if (itemTree) new TreeItem(QString(#into)+QString("[%1]").arg(i),v,QString("u(v) -> u(%1)").arg(numBits),code, itemTree);}
+#define READBITS(into,numBits) {QString code; into=reader.readBits(numBits, itemTree ? &code : nullptr); if (itemTree) new TreeItem(#into,into,QString("u(v) -> u(%1)").arg(numBits),code, itemTree);}
+#define READBITS_M(into,numBits,meanings) {QString code; into=reader.readBits(numBits, itemTree ? &code : nullptr); if (itemTree) new TreeItem(#into,into,QString("u(v) -> u(%1)").arg(numBits),code, meanings,itemTree);}
+#define READBITS_A(into,numBits,i) {QString code; int v=reader.readBits(numBits, itemTree ? &code : nullptr); into.append(v); if (itemTree) new TreeItem(QString(#into)+QString("[%1]").arg(i),v,QString("u(v) -> u(%1)").arg(numBits),code, itemTree);}
 // Read a flag (1 bit) into the variable "into".
 #define READFLAG(into) {into=(reader.readBits(1)!=0); if (itemTree) new TreeItem(#into,into,QString("u(1)"),(into!=0)?"1":"0",itemTree);}
 #define READFLAG_M(into,meanings) {into=(reader.readBits(1)!=0); if (itemTree) new TreeItem(#into,into,QString("u(1)"),(into!=0)?"1":"0",meanings,itemTree);}
 #define READFLAG_A(into,i) {bool b=(reader.readBits(1)!=0); into.append(b); if (itemTree) new TreeItem(QString(#into)+QString("[%1]").arg(i),b,QString("u(1)"),b?"1":"0",itemTree);}
 // Read a unsigned ue(v) code from the bitstream into the variable "into"
-#define READUEV(into) {QString code; into=reader.readUE_V(&code); if (itemTree) new TreeItem(#into,into,QString("ue(v)"),code,itemTree);}
-#define READUEV_M(into,meanings) {QString code; into=reader.readUE_V(&code); if (itemTree) new TreeItem(#into,into,QString("ue(v)"),code,meanings,itemTree);}
-#define READUEV_A(arr,i) {QString code; int v=reader.readUE_V(&code); arr.append(v); if (itemTree) new TreeItem(QString(#arr)+QString("[%1]").arg(i),v,QString("ue(v)"),code,itemTree);}
-#define READUEV_APP(arr) {QString code; int v=reader.readUE_V(&code); arr.append(v); if (itemTree) new TreeItem(QString(#arr),v,QString("ue(v)"),code,itemTree);}
+#define READUEV(into) {QString code; into=reader.readUE_V(itemTree ? &code : nullptr); if (itemTree) new TreeItem(#into,into,QString("ue(v)"),code,itemTree);}
+#define READUEV_M(into,meanings) {QString code; into=reader.readUE_V(itemTree ? &code : nullptr); if (itemTree) new TreeItem(#into,into,QString("ue(v)"),code,meanings,itemTree);}
+#define READUEV_A(arr,i) {QString code; int v=reader.readUE_V(itemTree ? &code : nullptr); arr.append(v); if (itemTree) new TreeItem(QString(#arr)+QString("[%1]").arg(i),v,QString("ue(v)"),code,itemTree);}
+#define READUEV_APP(arr) {QString code; int v=reader.readUE_V(itemTree ? &code : nullptr); arr.append(v); if (itemTree) new TreeItem(QString(#arr),v,QString("ue(v)"),code,itemTree);}
 // Read a signed se(v) code from the bitstream into the variable "into"
-#define READSEV(into) {QString code; into=reader.readSE_V(&code); if (itemTree) new TreeItem(#into,into,QString("se(v)"),code,itemTree);}
-#define READSEV_A(into,i) {QString code; int v=reader.readSE_V(&code); into.append(v); if (itemTree) new TreeItem(QString(#into)+QString("[%1]").arg(i),v,QString("se(v)"),code,itemTree);}
+#define READSEV(into) {QString code; into=reader.readSE_V(itemTree ? &code : nullptr); if (itemTree) new TreeItem(#into,into,QString("se(v)"),code,itemTree);}
+#define READSEV_A(into,i) {QString code; int v=reader.readSE_V(itemTree ? &code : nullptr); into.append(v); if (itemTree) new TreeItem(QString(#into)+QString("[%1]").arg(i),v,QString("se(v)"),code,itemTree);}
 // Do not actually read anything but also put the value into the tree as a calculated value
 #define LOGVAL(val) {if (itemTree) new TreeItem(#val,val,QString("calc"),QString(),itemTree);}
 #define LOGVAL_M(val,meaning) {if (itemTree) new TreeItem(#val,val,QString("calc"),QString(),meaning,itemTree);}
@@ -62,6 +62,16 @@ double fileSourceAVCAnnexBFile::getFramerate() const
   return 0.0;
 }
 
+void fileSourceAVCAnnexBFile::resetParsingState()
+{
+  // Parsing starts again with the first NAL unit. Forget everything that was derived from the NAL units parsed so far.
+  firstPOCRandomAccess = INT_MAX;
+  active_SPS_list.clear();
+  active_PPS_list.clear();
+  last_picture_first_slice.clear();
+  CpbDpbDelaysPresentFlag = false;
+}
+
 void fileSourceAVCAnnexBFile::parseAndAddNALUnit(int nalID)
 {
   // Save the position of the first byte of the start code
@@ -1230,7 +1240,7 @@ int fileSourceAVCAnnexBFile::sei::parse_sei_message(QByteArray &sliceHeaderData,
   // Read byte by byte
   int byte;
   QString code;
-  byte = reader.readBits(8, &code);
+  byte = reader.readBits(8, itemTree ? &code : nullptr);
   while (byte == 255) // 0xFF
   {
     payloadType += 255;
@@ -1240,7 +1250,7 @@ int fileSourceAVCAnnexBFile::sei::parse_sei_message(QByteArray &sliceHeaderData,
 
     // Read the next byte
     code.clear();
-    byte = reader.readBits(8, &code);
+    byte = reader.readBits(8, itemTree ? &code : nullptr);
   }
 
   // The next byte is not 255 (0xFF)
@@ -1369,7 +1379,7 @@ int fileSourceAVCAnnexBFile::sei::parse_sei_message(QByteArray &sliceHeaderData,
 
   // Read the next byte
   code.clear();
-  byte = reader.readBits(8, &code);
+  byte = reader.readBits(8, itemTree ? &code : nullptr);
   while (byte == 255) // 0xFF
   {
     payloadSize += 255;
@@ -1379,7 +1389,7 @@ int fileSourceAVCAnnexBFile::sei::parse_sei_message(QByteArray &sliceHeaderData,
 
     // Read the next byte
     code.clear();
-    byte = reader.readBits(8, &code);
+    byte = reader.readBits(8, itemTree ? &code : nullptr);
   }
 
   // The next byte is not 255
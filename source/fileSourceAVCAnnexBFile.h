@@ -488,6 +488,10 @@ protected:
   static void read_scaling_list(sub_byte_reader &reader, int *scalingList, int sizeOfScalingList, bool *useDefaultScalingMatrixFlag, TreeItem *itemTree);
 
   void parseAndAddNALUnit(int nalID) Q_DECL_OVERRIDE;
+  void resetParsingState() Q_DECL_OVERRIDE;
+  // Of a slice, only the header is parsed. The parameter sets and SEIs are much smaller than this.
+  int maxNALBytesForParsing() const Q_DECL_OVERRIDE { return 64 * 1024; }
+  fileSourceAnnexBFile *createBackgroundScanner() const Q_DECL_OVERRIDE { return new fileSourceAVCAnnexBFile; }
 
   // When we start to parse the bitstream we will remember the first RAP POC
   // so that we can disregard any possible RASL pictures.
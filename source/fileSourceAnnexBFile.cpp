@@ -31,8 +31,30 @@
 */
 
 #include "fileSourceAnnexBFile.h"
+
+#include <cstring>
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDir>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QThread>
+#include <QtConcurrent>
+
 #include "mainwindow.h"
 
+// SSE2 is part of the x86-64 base instruction set so the start code scanner can use it without a runtime check.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANNEXB_SSE2 1
+#include <emmintrin.h>
+#else
+#define ANNEXB_SSE2 0
+#endif
+#if defined(_MSC_VER) && defined(_WIN64)
+#include <intrin.h>
+#endif
+
 #define ANNEXBFILE_DEBUG_OUTPUT 0
 #if ANNEXBFILE_DEBUG_OUTPUT && !NDEBUG
 #include <QDebug>
@@ -41,99 +63,139 @@
 #define DEBUG_ANNEXB(fmt,...) ((void)0)
 #endif
 
+// The NAL index cache files start with this magic number and version. Increase the version if the format changes.
+#define INDEX_CACHE_MAGIC   0x59564958
+#define INDEX_CACHE_VERSION 1
+
+// Files of at least this size are scanned for start codes by multiple threads. Each thread scans at least
+// PARALLEL_SCAN_MIN_CHUNK_SIZE bytes and reads PARALLEL_SCAN_BLOCK_SIZE bytes at a time.
+#define PARALLEL_SCAN_MIN_FILE_SIZE  (qint64(64) * 1024 * 1024)
+#define PARALLEL_SCAN_MIN_CHUNK_SIZE (qint64(16) * 1024 * 1024)
+#define PARALLEL_SCAN_BLOCK_SIZE     (qint64(4) * 1024 * 1024)
+
+// A picture can precede at most this many pictures in decoding order and follow them in output order (the maximum
+// DPB size). While the file is scanned in the background, the frame indices of all but the last pictures are final.
+#define BACKGROUND_SCAN_MAX_REORDER_PICS 16
+// How often does the background scan publish its progress?
+#define BACKGROUND_SCAN_PUBLISH_INTERVAL_MS 500
+
 #define READFLAG(into) {into=(reader.readBits(1)!=0); if (itemTree) new TreeItem(#into,into,QString("u(1)"),(into!=0)?"1":"0",itemTree);}
-#define READBITS(into,numBits) {QString code; into=reader.readBits(numBits, &code); if (itemTree) new TreeItem(#into,into,QString("u(v) -> u(%1)").arg(numBits),code, itemTree);}
+#define READBITS(into,numBits) {QString code; into=reader.readBits(numBits, itemTree ? &code : nullptr); if (itemTree) new TreeItem(#into,into,QString("u(v) -> u(%1)").arg(numBits),code, itemTree);}
 
-unsigned int fileSourceAnnexBFile::sub_byte_reader::readBits(int nrBits, QString *bitsRead)
+// Count the leading zero bits of a 64 bit value (64 if the value is zero)
+static inline int countLeadingZeroBits(quint64 v)
 {
-  int out = 0;
-  int nrBitsRead = nrBits;
+  if (v == 0)
+    return 64;
+#if defined(__GNUC__)
+  return __builtin_clzll(v);
+#elif defined(_MSC_VER) && defined(_WIN64)
+  unsigned long idx;
+  _BitScanReverse64(&idx, v);
+  return 63 - int(idx);
+#else
+  int n = 0;
+  while (!(v & (quint64(1) << 63)))
+  {
+    v <<= 1;
+    n++;
+  }
+  return n;
+#endif
+}
 
-  // The return unsigned int is of depth 32 bits
-  if (nrBits > 32)
-    throw std::logic_error("Trying to read more than 32 bits at once from the bitstream.");
+// Append the given number of bits of val (LSB aligned) as a string of '0' and '1' characters
+static void appendBitString(QString *bitsRead, quint64 val, int nrBits)
+{
+  for (int i = nrBits-1; i >= 0; i--)
+    bitsRead->append((val & (quint64(1) << i)) ? QLatin1Char('1') : QLatin1Char('0'));
+}
 
-  while (nrBits > 0)
+fileSourceAnnexBFile::sub_byte_reader::sub_byte_reader(const QByteArray &inArr) : p_bitCache(0), p_nrBitsInCache(0), posInBuffer_bytes(0)
+{
+  // Remove the emulation prevention 3 bytes (a 3 byte after two zero bytes). Most NAL units contain none so the
+  // input array is only copied if one is found.
+  const char *data = inArr.constData();
+  const int size = inArr.size();
+  int nrZeroBytes = 0;
+  int copyStart = 0;
+  for (int i = 0; i < size; i++)
   {
-    if (posInBuffer_bits == 8 && nrBits != 0) 
+    if (data[i] == (char)3 && nrZeroBytes >= 2)
     {
-      // We read all bits we could from the current byte but we need more. Go to the next byte.
-      if (!p_gotoNextByte())
-        // We are at the end of the buffer but we need to read more. Error.
-        throw std::logic_error("Error while reading annexB file. Trying to read over buffer boundary.");
+      if (p_emuPrevBytePositions.isEmpty())
+        p_byteArray.reserve(size);
+      p_byteArray.append(data + copyStart, i - copyStart);
+      p_emuPrevBytePositions.append(p_byteArray.size());
+      copyStart = i + 1;
+      nrZeroBytes = 0;
+      continue;
     }
+    nrZeroBytes = (data[i] == (char)0) ? nrZeroBytes + 1 : 0;
+  }
 
-    // How many bits can be gotton from the current byte?
-    int curBitsLeft = 8 - posInBuffer_bits;
+  if (p_emuPrevBytePositions.isEmpty())
+    p_byteArray = inArr;
+  else
+    p_byteArray.append(data + copyStart, size - copyStart);
+}
 
-    int readBits; // Nr of bits to read
-    int offset;   // Offset for reading from the right
-    if (nrBits >= curBitsLeft)
-    {
-      // Read "curBitsLeft" bits
-      readBits = curBitsLeft;
-      offset = 0;
-    }
-    else 
-    {
-      // Read "nrBits" bits
-      assert(nrBits < 8 && nrBits < curBitsLeft);
-      readBits = nrBits;
-      offset = curBitsLeft - nrBits;
-    }
+void fileSourceAnnexBFile::sub_byte_reader::p_refillCache()
+{
+  const unsigned char *data = (const unsigned char*)p_byteArray.constData();
+  const int size = p_byteArray.size();
+  while (p_nrBitsInCache <= 56 && posInBuffer_bytes < size)
+  {
+    p_bitCache |= quint64(data[posInBuffer_bytes++]) << (56 - p_nrBitsInCache);
+    p_nrBitsInCache += 8;
+  }
+}
 
-    // Shift output value so that the new bits fit
-    out = out << readBits;
+unsigned int fileSourceAnnexBFile::sub_byte_reader::readBits(int nrBits, QString *bitsRead)
+{
+  // The return unsigned int is of depth 32 bits
+  if (nrBits > 32)
+    throw std::logic_error("Trying to read more than 32 bits at once from the bitstream.");
+  if (nrBits <= 0)
+    return 0;
 
-    char c = p_byteArray[posInBuffer_bytes];
-    c = c >> offset;
-    int mask = ((1<<readBits) - 1);
+  if (p_nrBitsInCache < nrBits)
+  {
+    p_refillCache();
+    if (p_nrBitsInCache < nrBits)
+      // We are at the end of the buffer but we need to read more. Error.
+      throw std::logic_error("Error while reading annexB file. Trying to read over buffer boundary.");
+  }
 
-    // Write bits to output
-    out += (c & mask);
+  const unsigned int out = (unsigned int)(p_bitCache >> (64 - nrBits));
+  p_skipBits(nrBits);
 
-    // Update counters
-    nrBits -= readBits;
-    posInBuffer_bits += readBits;
-  }
-  
   if (bitsRead)
-    for (int i = nrBitsRead-1; i >= 0; i--)
-    {
-      if (out & (1 << i))
-        bitsRead->append("1");
-      else
-        bitsRead->append("0");
-    }
+    appendBitString(bitsRead, out, nrBits);
 
   return out;
 }
 
 int fileSourceAnnexBFile::sub_byte_reader::readUE_V(QString *bitsRead, int *bit_count)
 {
-  int readBit = readBits(1, bitsRead);
-  if (bit_count)
-    bit_count++;
-  if (readBit == 1)
-    return 0;
-  
-  // Get the length of the golomb
-  int golLength = 0;
-  while (readBit == 0) 
-  {
-    readBit = readBits(1, bitsRead);
-    golLength++;
-  }
-  
-  // Read "golLength" bits
-  int val = readBits(golLength, bitsRead);
-  // Add the exponentional part
-  val += (1 << golLength)-1;
+  // Get the length of the golomb code (the number of leading zero bits)
+  p_refillCache();
+  const int golLength = countLeadingZeroBits(p_bitCache);
+  if (golLength >= p_nrBitsInCache && posInBuffer_bytes >= p_byteArray.size())
+    // The data ended before the 1 bit was found. Error.
+    throw std::logic_error("Error while reading annexB file. Trying to read over buffer boundary.");
+  if (golLength > 31)
+    throw std::logic_error("Error while reading annexB file. The ue(v) code is too long.");
+  p_skipBits(golLength);
+  if (bitsRead)
+    appendBitString(bitsRead, 0, golLength);
 
+  // Read the 1 bit and "golLength" bits. Together with the exponentional part, this is the value + 1.
+  const quint64 val = readBits(golLength + 1, bitsRead);
   if (bit_count)
-    bit_count += 2 * golLength;
-  
-  return val;
+    *bit_count += 2 * golLength + 1;
+
+  return int(val - 1);
 }
 
 int fileSourceAnnexBFile::sub_byte_reader::readSE_V(QString *bitsRead)
@@ -149,81 +211,32 @@ int fileSourceAnnexBFile::sub_byte_reader::readSE_V(QString *bitsRead)
  * following bits are 0. */
 bool fileSourceAnnexBFile::sub_byte_reader::more_rbsp_data()
 {
-  int posBytes = posInBuffer_bytes;
-  int posBits  = posInBuffer_bits;
-  bool terminatingBitFound = false;
-  if (posBits == 8)
-  {
-    posBytes++;
-    posBits = 0;
-  }
-  else
+  // The bits that are left in the cache and the bytes that were not loaded yet
+  p_refillCache();
+  if (p_nrBitsInCache == 0)
+    return false;
+  if (posInBuffer_bytes < p_byteArray.size())
   {
-    // Check the remainder of the current byte
-    unsigned char c = p_byteArray[posBytes];
-    if (c & (1 << (7-posBits)))
-      terminatingBitFound = true;
-    else
-      return true;
-    posBits++;
-    while (posBits != 8)
-    {
-      if (c & (1 << (7-posBits)))
-        // Only zeroes should follow
+    // There is more data after the cache. If any of it is not zero, the terminating bit is not in the cache.
+    for (int i = posInBuffer_bytes; i < p_byteArray.size(); i++)
+      if (p_byteArray.at(i) != (char)0)
         return true;
-      posBits++;
-    }
-    posBytes++;
   }
-  while(posBytes < p_byteArray.size())
-  {
-    unsigned char c = p_byteArray[posBytes];
-    if (terminatingBitFound && c != 0)
-      return true;
-    else if (!terminatingBitFound && (c & 128))
-      terminatingBitFound = true;
-    else
-      return true;
-    posBytes++;
-  }
-  if (!terminatingBitFound)
-    return true;
-  return false;
+  // The terminating bit must be the first bit and all following bits must be 0.
+  return p_bitCache != (quint64(1) << 63);
 }
 
-bool fileSourceAnnexBFile::sub_byte_reader::p_gotoNextByte()
+int fileSourceAnnexBFile::sub_byte_reader::nrBytesRead() const
 {
-  // Before we go to the neyt byte, check if the last (current) byte is a zero byte.
-  if (p_byteArray[posInBuffer_bytes] == (char)0)
-    p_numEmuPrevZeroBytes++;
-
-  // Skip the remaining sub-byte-bits
-  posInBuffer_bits = 0;
-  // Advance pointer
-  posInBuffer_bytes++;
-  
-  if (posInBuffer_bytes >= p_byteArray.size()) 
-    // The next byte is outside of the current buffer. Error.
-    return false;    
-
-  if (p_numEmuPrevZeroBytes == 2 && p_byteArray[posInBuffer_bytes] == (char)3) 
-  {
-    // The current byte is an emulation prevention 3 byte. Skip it.
-    posInBuffer_bytes++; // Skip byte
-
-    if (posInBuffer_bytes >= p_byteArray.size()) {
-      // The next byte is outside of the current buffer. Error
-      return false;
-    }
-
-    // Reset counter
-    p_numEmuPrevZeroBytes = 0;
-  }
-  else if (p_byteArray[posInBuffer_bytes] != (char)0)
-    // No zero byte. No emulation prevention 3 byte
-    p_numEmuPrevZeroBytes = 0;
-
-  return true;
+  // The number of bytes (of p_byteArray) that bits were read from
+  const int nrBitsRead = posInBuffer_bytes * 8 - p_nrBitsInCache;
+  const int nrBytes = (nrBitsRead + 7) / 8;
+
+  // Add the emulation prevention bytes that were before the last byte that was read
+  int nrEmuPrevBytes = 0;
+  while (nrEmuPrevBytes < p_emuPrevBytePositions.count() && p_emuPrevBytePositions[nrEmuPrevBytes] < nrBytes)
+    nrEmuPrevBytes++;
+  return nrBytes + nrEmuPrevBytes;
 }
 
 fileSourceAnnexBFile::fileSourceAnnexBFile()
@@ -232,15 +245,15 @@ fileSourceAnnexBFile::fileSourceAnnexBFile()
   posInBuffer = 0;
   bufferStartPosInFile = 0;
   numZeroBytes = 0;
-  
-  // Set the start code to look for (0x00 0x00 0x01)
-  startCode.append((char)0);
-  startCode.append((char)0);
-  startCode.append((char)1);
+  sharedIndexRevision = -1;
+  scanEndPos = -1;
+  scanEndNalID = 0;
+  followPicsHeldBack = false;
 }
 
 fileSourceAnnexBFile::~fileSourceAnnexBFile()
 {
+  stopBackgroundScan();
   clearData();
 }
 
@@ -252,6 +265,8 @@ bool fileSourceAnnexBFile::openFile(const QString &fileName, bool saveAllUnits,
 {
   DEBUG_ANNEXB("fileSourceAnnexBFile::openFile fileName %s %s", fileName, saveAllUnits ? "saveAllUnits" : "");
 
+  stopBackgroundScan();
+
   if (srcFile.isOpen())
     // A file was already open. We are re-opening the file.
     clearData();
@@ -269,13 +284,156 @@ bool fileSourceAnnexBFile::openFile(const QString &fileName, bool saveAllUnits,
   nalUnitListCopied = (otherFile != nullptr);
   if (otherFile)
   {
-    // Copy the nalUnitList and POC_List from the other file
-    nalUnitList = otherFile->nalUnitList;
-    POC_List = otherFile->POC_List;
+    // Copy the nalUnitList and POC_List from the other file. If the other file is still scanned
+    // in the background, follow the background scan.
+    if (otherFile->sharedIndex)
+    {
+      sharedIndex = otherFile->sharedIndex;
+      updateIndexFromBackgroundScan();
+    }
+    else
+    {
+      nalUnitList = otherFile->nalUnitList;
+      POC_List = otherFile->POC_List;
+    }
     return true;
   }
-  else
-    return scanFileForNalUnits(saveAllUnits);
+
+  // A file that is followed while it grows is always scanned by the background scanner, which can continue the scan later.
+  QSettings settings;
+  const bool followFile = settings.value("FollowGrowingFiles", false).toBool();
+
+  // Try to restore the index from a previous scan of the same file. If the NAL unit tree is requested we have to
+  // parse all NAL units anyways.
+  if (!saveAllUnits && !followFile && loadIndexFromCache())
+    return true;
+
+  // Only scan the beginning of the file and continue in the background
+  bool scanCompleted = false;
+  if (!saveAllUnits && startBackgroundScan(followFile, scanCompleted))
+  {
+    if (scanCompleted)
+      saveIndexToCache();
+    return true;
+  }
+
+  if (!scanFileForNalUnits(saveAllUnits))
+    return false;
+
+  saveIndexToCache();
+  return true;
+}
+
+QString fileSourceAnnexBFile::getIndexCacheFilePath() const
+{
+  QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  if (cacheDir.isEmpty())
+    return QString();
+
+  // The name of the index file is derived from the absolute path of the bitstream and the parser that created it
+  QByteArray key = fileInfo.absoluteFilePath().toUtf8() + '|' + metaObject()->className();
+  QString hash = QString::fromLatin1(QCryptographicHash::hash(key, QCryptographicHash::Md5).toHex());
+  return cacheDir + "/bitstreamIndex/" + hash + ".idx";
+}
+
+bool fileSourceAnnexBFile::loadIndexFromCache()
+{
+  QFile indexFile(getIndexCacheFilePath());
+  if (indexFile.fileName().isEmpty() || !indexFile.open(QIODevice::ReadOnly))
+    return false;
+
+  QDataStream in(&indexFile);
+  quint32 magic, version;
+  QString filePath, parserName;
+  qint64 fileSize, lastModified;
+  in >> magic >> version;
+  if (magic != INDEX_CACHE_MAGIC || version != INDEX_CACHE_VERSION)
+    return false;
+  in >> filePath >> parserName >> fileSize >> lastModified;
+  if (filePath != fileInfo.absoluteFilePath() || parserName != metaObject()->className() || 
+      fileSize != fileInfo.size() || lastModified != fileInfo.lastModified().toMSecsSinceEpoch())
+  {
+    DEBUG_ANNEXB("fileSourceAnnexBFile::loadIndexFromCache The file changed since the index was saved");
+    return false;
+  }
+
+  QList<int> cachedPOCList;
+  quint32 nrUnits;
+  in >> cachedPOCList >> nrUnits;
+  QList<quint64> unitFilePos;
+  QList<qint32> unitNalIdx, unitPOC;
+  for (quint32 i = 0; i < nrUnits && in.status() == QDataStream::Ok; i++)
+  {
+    quint64 filePos;
+    qint32 nalIdx, poc;
+    in >> filePos >> nalIdx >> poc;
+    unitFilePos.append(filePos);
+    unitNalIdx.append(nalIdx);
+    unitPOC.append(poc);
+  }
+  if (in.status() != QDataStream::Ok || cachedPOCList.isEmpty())
+    return false;
+
+  // Only the parameter sets and random access points are in the index. Parse just these NAL units again in
+  // their original order. This is fast and restores all the information we need for seeking and decoding.
+  bool indexValid = true;
+  for (int i = 0; i < unitFilePos.count() && indexValid; i++)
+  {
+    if (!seekToFilePos(unitFilePos[i]) || !seekToNextNALUnit())
+    {
+      indexValid = false;
+      break;
+    }
+    try
+    {
+      parseAndAddNALUnit(unitNalIdx[i]);
+    }
+    catch (...)
+    {
+      indexValid = false;
+      break;
+    }
+
+    // The unit must have been added to the list again with the same POC. The POC of some random access points
+    // depends on pictures that we skipped. If we could not restore it, we have to do a full scan.
+    if (nalUnitList.count() != i + 1 || nalUnitList[i]->getPOC() != unitPOC[i])
+      indexValid = false;
+  }
+
+  if (!indexValid)
+  {
+    DEBUG_ANNEXB("fileSourceAnnexBFile::loadIndexFromCache Restoring the index failed. Rescanning the file.");
+    clearData();
+    seekToFilePos(0);
+    return false;
+  }
+
+  POC_List = cachedPOCList;
+  DEBUG_ANNEXB("fileSourceAnnexBFile::loadIndexFromCache Restored %d NAL units and %d POCs", nalUnitList.count(), POC_List.count());
+  return true;
+}
+
+void fileSourceAnnexBFile::saveIndexToCache() const
+{
+  QString indexFilePath = getIndexCacheFilePath();
+  if (indexFilePath.isEmpty() || !QDir().mkpath(QFileInfo(indexFilePath).absolutePath()))
+    return;
+
+  QSaveFile indexFile(indexFilePath);
+  if (!indexFile.open(QIODevice::WriteOnly))
+    return;
+
+  QDataStream out(&indexFile);
+  out << quint32(INDEX_CACHE_MAGIC) << quint32(INDEX_CACHE_VERSION);
+  out << fileInfo.absoluteFilePath() << QString(metaObject()->className());
+  out << qint64(fileInfo.size()) << qint64(fileInfo.lastModified().toMSecsSinceEpoch());
+  out << POC_List << quint32(nalUnitList.count());
+  for (auto nal : nalUnitList)
+    out << quint64(nal->filePos) << qint32(nal->nal_idx) << qint32(nal->getPOC());
+
+  if (out.status() == QDataStream::Ok)
+    indexFile.commit();
+  DEBUG_ANNEXB("fileSourceAnnexBFile::saveIndexToCache Saved index to %s", indexFilePath.toLatin1().data());
 }
 
 bool fileSourceAnnexBFile::updateBuffer()
@@ -303,7 +461,7 @@ bool fileSourceAnnexBFile::seekToNextNALUnit()
   numZeroBytes = 0;
   
   // Check if there is another start code in the buffer
-  int idx = fileBuffer.indexOf(startCode, posInBuffer);
+  int idx = findStartCode(fileBuffer.constData(), posInBuffer, fileBufferSize);
   while (idx < 0) 
   {
     // Start code not found in this buffer. Load next chuck of data from file.
@@ -344,7 +502,7 @@ bool fileSourceAnnexBFile::seekToNextNALUnit()
     }
 
     // New buffer loaded but no start code found yet. Search for it again.
-    idx = fileBuffer.indexOf(startCode, posInBuffer);
+    idx = findStartCode(fileBuffer.constData(), posInBuffer, fileBufferSize);
   }
 
   assert(idx >= 0);
@@ -386,6 +544,58 @@ bool fileSourceAnnexBFile::gotoNextByte()
   return true;
 }
 
+int fileSourceAnnexBFile::findStartCode(const char *data, int start, int end)
+{
+  const unsigned char *d = reinterpret_cast<const unsigned char*>(data);
+  int i = start;
+
+#if ANNEXB_SSE2
+  // Test 16 possible start code positions at once. Three overlapping loads give us the bytes at
+  // offset 0, 1 and 2 of each position so that no shifting across lanes is needed.
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one = _mm_set1_epi8(1);
+  while (i + 18 <= end)
+  {
+    __m128i b0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + i));
+    __m128i b1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + i + 1));
+    __m128i b2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(d + i + 2));
+    __m128i match = _mm_and_si128(_mm_and_si128(_mm_cmpeq_epi8(b0, zero), _mm_cmpeq_epi8(b1, zero)), _mm_cmpeq_epi8(b2, one));
+    int mask = _mm_movemask_epi8(match);
+    if (mask != 0)
+    {
+      while ((mask & 1) == 0)
+      {
+        mask >>= 1;
+        i++;
+      }
+      return i;
+    }
+    i += 16;
+  }
+#else
+  // A start code can only begin at a zero byte. Skip 8 bytes at a time as long as they contain no zero byte.
+  while (i + 8 <= end)
+  {
+    quint64 word;
+    memcpy(&word, d + i, 8);
+    if (((word - Q_UINT64_C(0x0101010101010101)) & ~word & Q_UINT64_C(0x8080808080808080)) != 0)
+      break;
+    i += 8;
+  }
+#endif
+
+  // Check the remaining bytes one by one
+  for (; i + 3 <= end; i++)
+  {
+    if (d[i+2] > 1)
+      // Neither this nor the next position can be the start of a start code
+      i += 2;
+    else if (d[i] == 0 && d[i+1] == 0 && d[i+2] == 1)
+      return i;
+  }
+  return -1;
+}
+
 QByteArray fileSourceAnnexBFile::getRemainingNALBytes(int maxBytes)
 {
   QByteArray retArray;
@@ -393,14 +603,46 @@ QByteArray fileSourceAnnexBFile::getRemainingNALBytes(int maxBytes)
 
   while (!curPosAtStartCode() && (maxBytes == -1 || nrBytesRead < maxBytes)) 
   {
-    // Save byte and goto the next one
-    retArray.append(getCurByte());
+    if (numZeroBytes > 0 || getCurByte() == (char)0)
+    {
+      // We are at or directly after a zero byte which might belong to a start code that spans the buffer
+      // boundary. Go byte by byte until we are past the zero bytes.
+      retArray.append(getCurByte());
+
+      if (!gotoNextByte())
+        // No more bytes. Return all we got.
+        return retArray;
 
-    if (!gotoNextByte())
+      nrBytesRead++;
+      continue;
+    }
+
+    // Search the rest of the buffer for the next start code and copy everything before it in one go.
+    int searchEnd = int(fileBufferSize);
+    if (maxBytes != -1)
+      searchEnd = qMin(searchEnd, int(posInBuffer) + maxBytes - nrBytesRead);
+    int idx = findStartCode(fileBuffer.constData(), posInBuffer, searchEnd);
+    if (idx >= 0)
+    {
+      // Copy the payload up to the start code and move to the one byte of the start code
+      retArray.append(fileBuffer.constData() + posInBuffer, idx - posInBuffer);
+      nrBytesRead += idx + 2 - posInBuffer;
+      posInBuffer = idx + 2;
+      numZeroBytes = 2;
+      break;
+    }
+
+    // No start code in the searched range. Copy all bytes except for trailing zero bytes which could be
+    // the beginning of a start code. These are handled byte by byte. The current byte is not a zero byte.
+    int copyEnd = searchEnd;
+    while (fileBuffer.at(copyEnd - 1) == (char)0)
+      copyEnd--;
+    retArray.append(fileBuffer.constData() + posInBuffer, copyEnd - posInBuffer);
+    nrBytesRead += copyEnd - posInBuffer;
+    posInBuffer = copyEnd;
+    if (posInBuffer >= fileBufferSize && !updateBuffer())
       // No more bytes. Return all we got.
       return retArray;
-
-    nrBytesRead++;
   }
 
   // We should now be at a header byte. Remove the zeroes from the start code that we put into retArray
@@ -479,11 +721,26 @@ bool fileSourceAnnexBFile::scanFileForNalUnits(bool saveAllUnits)
 
   // Count the NALs
   int nalID = 0;
+  resetParsingState();
 
   if (saveAllUnits && nalUnitModel.rootItem.isNull())
     // Create a new root for the nal unit tree of the QAbstractItemModel
     nalUnitModel.rootItem.reset(new TreeItem(QStringList() << "Name" << "Value" << "Coding" << "Code" << "Meaning", nullptr));
 
+  if (maxPos >= PARALLEL_SCAN_MIN_FILE_SIZE && getOptimalThreadCount() > 1)
+  {
+    // Large file. Find the NAL units using multiple threads and only parse them sequentially.
+    bool scanCompleted = scanFileForNalUnitsParallel(saveAllUnits, &progress);
+    progress.close();
+    if (!scanCompleted)
+    {
+      clearData();
+      return false;
+    }
+    std::sort(POC_List.begin(), POC_List.end());
+    return true;
+  }
+
   while (seekToNextNALUnit()) 
   {
     try
@@ -525,10 +782,421 @@ bool fileSourceAnnexBFile::scanFileForNalUnits(bool saveAllUnits)
   return true;
 }
 
+bool fileSourceAnnexBFile::scanFileForNalUnitsParallel(bool saveAllUnits, QProgressDialog *progress)
+{
+  const qint64 fileSize = getFileSize();
+  const int nrChunks = clip(int(fileSize / PARALLEL_SCAN_MIN_CHUNK_SIZE), 1, int(getOptimalThreadCount()));
+  const qint64 chunkSize = (fileSize + nrChunks - 1) / nrChunks;
+  DEBUG_ANNEXB("fileSourceAnnexBFile::scanFileForNalUnitsParallel Scanning %d chunks", nrChunks);
+
+  // First pass: Find the positions of all start codes. Every thread scans one chunk of the file.
+  QAtomicInteger<quint64> bytesScanned(0);
+  QAtomicInt cancel(0);
+  QList<QFuture<QVector<quint64>>> chunkFutures;
+  for (int i = 0; i < nrChunks; i++)
+  {
+    const qint64 chunkStart = i * chunkSize;
+    const qint64 chunkEnd = qMin(fileSize, chunkStart + chunkSize);
+    chunkFutures.append(QtConcurrent::run([this, chunkStart, chunkEnd, &bytesScanned, &cancel]() { return findStartCodesInRange(chunkStart, chunkEnd, bytesScanned, cancel); }));
+  }
+
+  bool scanRunning = true;
+  while (scanRunning)
+  {
+    scanRunning = false;
+    for (auto &future : chunkFutures)
+      if (!future.isFinished())
+        scanRunning = true;
+
+    // The first half of the progress is the start code scan
+    if (progress)
+    {
+      progress->setValue(int(bytesScanned.load() * 50 / fileSize));
+      QApplication::processEvents();
+      if (progress->wasCanceled())
+        cancel.store(1);
+    }
+    else if (isBackgroundScanCanceled())
+      cancel.store(1);
+    if (scanRunning)
+      QThread::msleep(20);
+  }
+  if (cancel.load() != 0)
+    return false;
+
+  QVector<quint64> startCodePositions;
+  for (auto &future : chunkFutures)
+    startCodePositions += future.result();
+
+  // Second pass: Parse the NAL units in order. Parameter sets and POCs depend on what was parsed before.
+  // We know where every NAL unit ends so we only read as much of each unit as the parser needs.
+  const int maxNALBytes = saveAllUnits ? -1 : maxNALBytesForParsing();
+  int curPercentValue = 50;
+  for (int nalID = 0; nalID < startCodePositions.count(); nalID++)
+  {
+    const quint64 nalStart = startCodePositions[nalID];
+    const quint64 nalEnd = (nalID + 1 < startCodePositions.count()) ? startCodePositions[nalID + 1] : quint64(fileSize);
+    const qint64 nalSize = qint64(nalEnd - nalStart);
+    const bool truncated = (maxNALBytes >= 0 && nalSize > maxNALBytes + 3);
+
+    if (loadNALUnitToBuffer(nalStart, truncated ? maxNALBytes + 3 : nalSize))
+    {
+      try
+      {
+        parseAndAddNALUnit(nalID);
+      }
+      catch (...)
+      {
+        // If we did not give the parser the whole NAL unit, try again with all of it.
+        if (truncated && loadNALUnitToBuffer(nalStart, nalSize))
+        {
+          try
+          {
+            parseAndAddNALUnit(nalID);
+          }
+          catch (...)
+          {
+            DEBUG_ANNEXB("fileSourceAnnexBFile::scanFileForNalUnitsParallel Exception thrown parsing NAL %d", nalID);
+          }
+        }
+      }
+    }
+
+    if ((progress && progress->wasCanceled()) || isBackgroundScanCanceled())
+      return false;
+    int newPercentValue = 50 + int(qint64(nalID) * 50 / startCodePositions.count());
+    if (!progress)
+      publishScanProgress(newPercentValue);
+    else if (newPercentValue != curPercentValue)
+    {
+      progress->setValue(newPercentValue);
+      curPercentValue = newPercentValue;
+    }
+  }
+
+  // Leave the file at the end like the sequential scan does
+  scanEndNalID = startCodePositions.count();
+  seekToFilePos(fileSize);
+  return true;
+}
+
+QVector<quint64> fileSourceAnnexBFile::findStartCodesInRange(qint64 start, qint64 end, QAtomicInteger<quint64> &bytesScanned, const QAtomicInt &cancel)
+{
+  QVector<quint64> startCodePositions;
+  QByteArray block;
+  for (qint64 blockStart = start; blockStart < end && cancel.load() == 0; blockStart += PARALLEL_SCAN_BLOCK_SIZE)
+  {
+    // Read two more bytes so that we also find start codes that begin in this block but end in the next one
+    const qint64 blockEnd = qMin(end, blockStart + PARALLEL_SCAN_BLOCK_SIZE);
+    const int nrBytes = int(readBytes(block, blockStart, blockEnd - blockStart + 2));
+
+    int idx = findStartCode(block.constData(), 0, nrBytes);
+    while (idx >= 0 && blockStart + idx < blockEnd)
+    {
+      startCodePositions.append(blockStart + idx);
+      idx = findStartCode(block.constData(), idx + 3, nrBytes);
+    }
+    bytesScanned.fetchAndAddRelaxed(blockEnd - blockStart);
+  }
+  return startCodePositions;
+}
+
+bool fileSourceAnnexBFile::loadNALUnitToBuffer(quint64 startCodePos, qint64 nrBytes)
+{
+  if (readBytes(fileBuffer, startCodePos, nrBytes) != nrBytes)
+    return false;
+
+  // Terminate the data with a start code. Reading the NAL unit stops there and does not load the next buffer.
+  if (fileBuffer.size() < nrBytes + 3)
+    fileBuffer.resize(nrBytes + 3);
+  fileBuffer[int(nrBytes)] = (char)0;
+  fileBuffer[int(nrBytes) + 1] = (char)0;
+  fileBuffer[int(nrBytes) + 2] = (char)1;
+
+  // Go to the first byte after the start code
+  bufferStartPosInFile = startCodePos;
+  fileBufferSize = nrBytes + 3;
+  posInBuffer = 3;
+  numZeroBytes = 0;
+  return true;
+}
+
+bool fileSourceAnnexBFile::startBackgroundScan(bool followFile, bool &scanCompleted)
+{
+  QScopedPointer<fileSourceAnnexBFile> scanner(createBackgroundScanner());
+  if (!scanner)
+    return false;
+
+  // Parse the beginning of the file until we know the order of the first frames
+  resetParsingState();
+  int nalID = 0;
+  scanCompleted = true;
+  while (seekToNextNALUnit())
+  {
+    try
+    {
+      parseAndAddNALUnit(nalID);
+    }
+    catch (...)
+    {
+      DEBUG_ANNEXB("fileSourceAnnexBFile::startBackgroundScan Exception thrown parsing NAL %d", nalID);
+    }
+    nalID++;
+
+    if (POC_List.count() > BACKGROUND_SCAN_MAX_REORDER_PICS)
+    {
+      scanCompleted = false;
+      break;
+    }
+  }
+
+  if (scanCompleted && !followFile)
+  {
+    // The file is short. We are done.
+    std::sort(POC_List.begin(), POC_List.end());
+    return true;
+  }
+
+  // The scanner opens the file again and scans all of it in a background thread
+  if (!scanner->fileSource::openFile(fileInfo.absoluteFilePath()) || !scanner->seekToFilePos(0))
+  {
+    clearData();
+    seekToFilePos(0);
+    return false;
+  }
+
+  // If this file was scanned completely, nothing has to be held back. The scanner scans it again so that it can
+  // continue the scan when data is appended.
+  sharedIndex.reset(new backgroundScanIndex);
+  publishIndex(false, 0, !scanCompleted);
+  updateIndexFromBackgroundScan();
+  scanCompleted = false;
+
+  scanner->sharedIndex = sharedIndex;
+  backgroundScanner.reset(scanner.take());
+  backgroundScanFuture = QtConcurrent::run(backgroundScanner.data(), &fileSourceAnnexBFile::runBackgroundScan);
+  DEBUG_ANNEXB("fileSourceAnnexBFile::startBackgroundScan Started background scan after %d NAL units", nalID);
+  return true;
+}
+
+void fileSourceAnnexBFile::stopBackgroundScan()
+{
+  if (backgroundScanner)
+  {
+    sharedIndex->cancel.store(1);
+    backgroundScanFuture.waitForFinished();
+    backgroundScanner.reset();
+  }
+  sharedIndex.clear();
+  sharedIndexRevision = -1;
+  followPicsHeldBack = false;
+}
+
+void fileSourceAnnexBFile::runBackgroundScan()
+{
+  const qint64 fileSize = getFileSize();
+  resetParsingState();
+  publishTimer.start();
+
+  bool scanCompleted;
+  if (fileSize >= PARALLEL_SCAN_MIN_FILE_SIZE && getOptimalThreadCount() > 1)
+    scanCompleted = scanFileForNalUnitsParallel(false, nullptr);
+  else
+  {
+    int nalID = 0;
+    while (!isBackgroundScanCanceled() && seekToNextNALUnit())
+    {
+      try
+      {
+        parseAndAddNALUnit(nalID);
+      }
+      catch (...)
+      {
+        DEBUG_ANNEXB("fileSourceAnnexBFile::runBackgroundScan Exception thrown parsing NAL %d", nalID);
+      }
+      nalID++;
+      publishScanProgress(int(tell() * 100 / fileSize));
+    }
+    scanEndNalID = nalID;
+    scanCompleted = !isBackgroundScanCanceled();
+  }
+
+  if (!scanCompleted)
+    return;
+
+  std::sort(POC_List.begin(), POC_List.end());
+  scanEndPos = tell();
+  publishIndex(true, 100, false);
+  saveIndexToCache();
+  DEBUG_ANNEXB("fileSourceAnnexBFile::runBackgroundScan Done. %d POCs", POC_List.count());
+}
+
+void fileSourceAnnexBFile::continueBackgroundScan()
+{
+  // Start a few bytes before the end of the last scan. A start code may not have been written completely.
+  // The rest of the last NAL unit is skipped. Its header was parsed already.
+  // If the file was modified in another way, it can not be followed anymore.
+  if (updateAppendedData() < 0 || !seekToFilePos(quint64(qMax(scanEndPos - 3, qint64(0)))))
+  {
+    scanEndPos = -1;
+    return;
+  }
+
+  int nalID = scanEndNalID;
+  while (!isBackgroundScanCanceled() && seekToNextNALUnit())
+  {
+    try
+    {
+      parseAndAddNALUnit(nalID);
+    }
+    catch (...)
+    {
+      DEBUG_ANNEXB("fileSourceAnnexBFile::continueBackgroundScan Exception thrown parsing NAL %d", nalID);
+    }
+    nalID++;
+  }
+  if (isBackgroundScanCanceled())
+  {
+    scanEndPos = -1;
+    return;
+  }
+
+  DEBUG_ANNEXB("fileSourceAnnexBFile::continueBackgroundScan Parsed %d NAL units from %lld", nalID - scanEndNalID, scanEndPos);
+  scanEndPos = qMax(qint64(tell()), scanEndPos);
+  scanEndNalID = nalID;
+  publishIndex(true, 100, true);
+}
+
+void fileSourceAnnexBFile::publishIndex(bool scanComplete, int progress, bool holdBackReorderedPics)
+{
+  // The frame index of a picture is its position in the sorted POC list. A picture that was not found yet can only precede
+  // a limited number of the pictures that were found so far in output order. The frame indices of all others are final.
+  QList<int> sortedPOCs = POC_List;
+  std::sort(sortedPOCs.begin(), sortedPOCs.end());
+
+  QMutexLocker lock(&sharedIndex->mutex);
+  sharedIndex->progress = progress;
+  sharedIndex->scanComplete = scanComplete;
+  const QList<int> &publishedPOCs = sharedIndex->POC_List;
+  if (holdBackReorderedPics)
+  {
+    const int nrPics = qMax(sortedPOCs.count() - BACKGROUND_SCAN_MAX_REORDER_PICS, publishedPOCs.count());
+    if (nrPics > sortedPOCs.count())
+    {
+      // The scanner did not get as far as the published index yet
+      sharedIndex->revision++;
+      return;
+    }
+    sortedPOCs.erase(sortedPOCs.begin() + nrPics, sortedPOCs.end());
+  }
+
+  // If a picture is output before pictures that were already published, the following frame indices change
+  for (int i = 0; i < qMin(sortedPOCs.count(), publishedPOCs.count()); i++)
+  {
+    if (sortedPOCs[i] != publishedPOCs[i])
+    {
+      if (sharedIndex->firstChangedFrameIdx == -1 || i < sharedIndex->firstChangedFrameIdx)
+        sharedIndex->firstChangedFrameIdx = i;
+      break;
+    }
+  }
+
+  sharedIndex->nalUnitList = nalUnitList;
+  sharedIndex->POC_List = sortedPOCs;
+  sharedIndex->revision++;
+}
+
+void fileSourceAnnexBFile::publishScanProgress(int progress)
+{
+  if (publishTimer.elapsed() < BACKGROUND_SCAN_PUBLISH_INTERVAL_MS)
+    return;
+  publishIndex(false, progress, true);
+  publishTimer.restart();
+}
+
+bool fileSourceAnnexBFile::scanAppendedData()
+{
+  // Only the background scanner can continue the scan. Wait until it is done with the data that it already found.
+  if (!backgroundScanner)
+    return false;
+  if (backgroundScanFuture.isRunning())
+    return true;
+  if (backgroundScanner->scanEndPos < 0)
+    return false;
+
+  const qint64 nrBytesAppended = updateAppendedData();
+  if (nrBytesAppended < 0)
+    return false;
+
+  if (nrBytesAppended > 0)
+  {
+    followPicsHeldBack = true;
+    backgroundScanFuture = QtConcurrent::run(backgroundScanner.data(), &fileSourceAnnexBFile::continueBackgroundScan);
+  }
+  else if (followPicsHeldBack)
+  {
+    // The file does not grow at the moment (or the encoder is done). Show the last pictures as well.
+    backgroundScanner->publishIndex(true, 100, false);
+    followPicsHeldBack = false;
+  }
+  return true;
+}
+
+int fileSourceAnnexBFile::takeFirstChangedFrameIdx()
+{
+  if (!sharedIndex)
+    return -1;
+  QMutexLocker lock(&sharedIndex->mutex);
+  const int frameIdx = sharedIndex->firstChangedFrameIdx;
+  sharedIndex->firstChangedFrameIdx = -1;
+  return frameIdx;
+}
+
+void fileSourceAnnexBFile::updateIndexFromBackgroundScan()
+{
+  if (!sharedIndex)
+    return;
+
+  QMutexLocker lock(&sharedIndex->mutex);
+  if (sharedIndex->revision == sharedIndexRevision)
+    return;
+  nalUnitList = sharedIndex->nalUnitList;
+  POC_List = sharedIndex->POC_List;
+  sharedIndexRevision = sharedIndex->revision;
+}
+
+int fileSourceAnnexBFile::getNumberPOCs() const
+{
+  if (sharedIndex)
+  {
+    QMutexLocker lock(&sharedIndex->mutex);
+    return sharedIndex->POC_List.count();
+  }
+  return POC_List.count();
+}
+
+bool fileSourceAnnexBFile::isBackgroundScanRunning() const
+{
+  if (!sharedIndex)
+    return false;
+  QMutexLocker lock(&sharedIndex->mutex);
+  return !sharedIndex->scanComplete && sharedIndex->cancel.load() == 0;
+}
+
+int fileSourceAnnexBFile::getBackgroundScanProgress() const
+{
+  if (!sharedIndex)
+    return 100;
+  QMutexLocker lock(&sharedIndex->mutex);
+  return sharedIndex->progress;
+}
+
 // Look through the random access points and find the closest one before (or equal)
 // the given frameIdx where we can start decoding
-int fileSourceAnnexBFile::getClosestSeekableFrameNumber(int frameIdx) const
+int fileSourceAnnexBFile::getClosestSeekableFrameNumber(int frameIdx)
 {
+  updateIndexFromBackgroundScan();
+
   // Get the POC for the frame number
   int iPOC = POC_List[frameIdx];
 
@@ -551,8 +1219,43 @@ int fileSourceAnnexBFile::getClosestSeekableFrameNumber(int frameIdx) const
   return POC_List.indexOf(bestSeekPOC);
 }
 
+QList<int> fileSourceAnnexBFile::getRandomAccessPoints() const
+{
+  // If the file is scanned in the background, use the latest published state
+  QList<QSharedPointer<nal_unit>> nalUnits;
+  QList<int> sortedPOCs;
+  if (sharedIndex)
+  {
+    QMutexLocker lock(&sharedIndex->mutex);
+    nalUnits = sharedIndex->nalUnitList;
+    sortedPOCs = sharedIndex->POC_List;
+  }
+  else
+  {
+    nalUnits = nalUnitList;
+    sortedPOCs = POC_List;
+  }
+
+  QList<int> randomAccessPoints;
+  for (auto nal : nalUnits)
+  {
+    if (!nal->isParameterSet() && nal->getPOC() >= 0)
+    {
+      // The POC list is sorted
+      auto it = std::lower_bound(sortedPOCs.constBegin(), sortedPOCs.constEnd(), nal->getPOC());
+      if (it != sortedPOCs.constEnd() && *it == nal->getPOC())
+        randomAccessPoints.append(int(it - sortedPOCs.constBegin()));
+    }
+  }
+  std::sort(randomAccessPoints.begin(), randomAccessPoints.end());
+  randomAccessPoints.erase(std::unique(randomAccessPoints.begin(), randomAccessPoints.end()), randomAccessPoints.end());
+  return randomAccessPoints;
+}
+
 QList<QByteArray> fileSourceAnnexBFile::seekToFrameNumber(int iFrameNr)
 {
+  updateIndexFromBackgroundScan();
+
   // Get the POC for the frame number
   int iPOC = POC_List[iFrameNr];
 
@@ -34,6 +34,11 @@
 #define FILESOURCEANNEXBFILE_H
 
 #include <QAbstractItemModel>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QMutex>
+#include <QVector>
 #include "fileSource.h"
 #include "videoHandlerYUV.h"
 
@@ -41,6 +46,8 @@ using namespace YUV_Internals;
 
 #define BUFFER_SIZE 40960
 
+class QProgressDialog;
+
 /* This class can perform basic NAL unit reading from a bitstream.
 */
 class fileSourceAnnexBFile : public fileSource
@@ -55,8 +62,23 @@ public:
   virtual bool openFile(const QString &filePath) Q_DECL_OVERRIDE { return openFile(filePath, false); }
   virtual bool openFile(const QString &filePath, bool saveAllUnits, fileSourceAnnexBFile *otherFile=nullptr);
 
-  // How many POC's have been found in the file
-  int getNumberPOCs() const { return POC_List.size(); }
+  // How many POC's have been found in the file (so far if the file is still scanned in the background)
+  int getNumberPOCs() const;
+
+  // Large files are scanned in the background. openFile only scans the beginning of the file and returns. While the scan
+  // is running, the number of POCs and the random access points grow. The file can already be decoded.
+  bool isBackgroundScanRunning() const;
+  // The progress of the background scan in percent
+  int getBackgroundScanProgress() const;
+  // The first frame whose index changed since the last call (because the scan found pictures that are output before it)
+  // or -1 if only frames were added.
+  int takeFirstChangedFrameIdx();
+
+  // Follow mode: If enabled in the settings when the file is opened, the scanner is kept after the background scan
+  // finished. When data is appended to the file (e.g. by an encoder that is still running), the scan continues where
+  // it ended. While the file grows, the last pictures (whose frame index may still change) are held back. Return false
+  // if the file was modified in another way or if it can not be followed. Then it has to be opened again.
+  bool scanAppendedData();
 
   // Is the file at the end?
   virtual bool atEnd() const Q_DECL_OVERRIDE { return fileBufferSize == 0; }
@@ -70,9 +92,15 @@ public:
   // Or: do getCurByte(), gotoNextByte until we find a new start code.
   QByteArray getRemainingNALBytes(int maxBytes=-1);
 
+  // Find the first start code (0x00 0x00 0x01) that lies completely within data[start, end). Return the
+  // index of the first zero byte of the start code or -1 if there is none. Vectorized where possible.
+  static int findStartCode(const char *data, int start, int end);
+
   // Calculate the closest random access point (RAP) before the given frame number.
   // Return the frame number of that random access point.
-  int getClosestSeekableFrameNumber(int frameIdx) const;
+  int getClosestSeekableFrameNumber(int frameIdx);
+  // Get the frame numbers of all random access points in the file (sorted in ascending order).
+  QList<int> getRandomAccessPoints() const;
 
   // Seek the file to the given frame number. The given frame number has to be a random 
   // access point. We can start decoding the file from here. Use getClosestSeekableFrameNumber to find a random access point.
@@ -146,32 +174,39 @@ protected:
   NALUnitModel nalUnitModel;
 
   /* This class provides the ability to read a byte array bit wise. Reading of ue(v) symbols is also supported.
+   * The emulation prevention bytes are removed once when the reader is created. The bits are read from a 64 bit cache
+   * which is refilled byte wise.
   */
   class sub_byte_reader
   {
   public:
-    sub_byte_reader(const QByteArray &inArr) : p_byteArray(inArr), posInBuffer_bytes(0), posInBuffer_bits(0), p_numEmuPrevZeroBytes(0) {}
-    // Read the given number of bits and return as integer. If bitsRead is true, the bits that were read are returned as a QString.
+    sub_byte_reader(const QByteArray &inArr);
+    // Read the given number of bits and return as integer. If bitsRead is given, the bits that were read are appended as a QString.
+    // Only request the bits if they are shown (in the NAL unit tree). Creating the string is much slower than reading.
     unsigned int readBits(int nrBits, QString *bitsRead=nullptr);
-    // Read an UE(v) code from the array. If given, increase bit_count with every bit read.
+    // Read an UE(v) code from the array. If given, increase bit_count by the number of bits read.
     int readUE_V(QString *bitsRead=nullptr, int *bit_count=nullptr);
     // Read an SE(v) code from the array
     int readSE_V(QString *bitsRead=nullptr);
     // Is there more RBSP data or are we at the end?
     bool more_rbsp_data();
-    // How many full bytes were read from the reader?
-    int nrBytesRead() { return (posInBuffer_bits == 0) ? posInBuffer_bytes : posInBuffer_bytes + 1; }
+    // How many full bytes were read from the input array (including the emulation prevention bytes)?
+    int nrBytesRead() const;
     
   protected:
+    // The input data without the emulation prevention bytes
     QByteArray p_byteArray;
+    // For every emulation prevention byte that was removed, the position in p_byteArray of the byte that followed it
+    QList<int> p_emuPrevBytePositions;
 
-    // Move to the next byte and look for an emulation prevention 3 byte. Remove it (skip it) if found.
-    // This function is just used by the internal reading functions.
-    bool p_gotoNextByte();
+    // Load bytes into the cache until it holds more than 56 bits (or the end of the data is reached)
+    void p_refillCache();
+    // Remove the given number of bits from the cache
+    void p_skipBits(int nrBits) { p_bitCache <<= nrBits; p_nrBitsInCache -= nrBits; }
 
-    int posInBuffer_bytes;   // The byte position in the buffer
-    int posInBuffer_bits;    // The sub byte (bit) position in the buffer (0...7)
-    int p_numEmuPrevZeroBytes; // The number of emulation prevention three bytes that were found
+    quint64 p_bitCache;      // The next bits to read. The next bit is the MSB.
+    int p_nrBitsInCache;     // The number of valid bits in the cache
+    int posInBuffer_bytes;   // The next byte in p_byteArray that is loaded into the cache
   };
 
   /* The basic NAL unit. Contains the NAL header and the file position of the unit.
@@ -218,9 +253,6 @@ protected:
   // Returns false if the POC was already present int the list
   bool addPOCToList(int poc);
 
-  // The start code pattern
-  QByteArray startCode;
-
   // A list of nal units sorted by position in the file.
   // Only parameter sets and random access positions go in here.
   // So basically all information we need to seek in the stream and start the decoder at a certain position.
@@ -231,14 +263,80 @@ protected:
   // nalUnitList. Also collect a list of all POCs in coding order in POC_List.
   // If saving is activated, all NAL data is saved to be used by the QAbstractItemModel.
   bool scanFileForNalUnits(bool saveAllUnits);
+  // For large files, the start codes are searched by multiple threads in chunks of the file. Then the NAL units
+  // are parsed in order. Return false if the user canceled the scan.
+  // If no progress dialog is given, the scan runs in the background and publishes what it found so far.
+  bool scanFileForNalUnitsParallel(bool saveAllUnits, QProgressDialog *progress);
+  QVector<quint64> findStartCodesInRange(qint64 start, qint64 end, QAtomicInteger<quint64> &bytesScanned, const QAtomicInt &cancel);
+  // Read the NAL unit with the start code at the given position into the buffer and go to the first byte after the start code.
+  bool loadNALUnitToBuffer(quint64 startCodePos, qint64 nrBytes);
+  // How many bytes of a NAL unit (after the start code) does parseAndAddNALUnit need at most? Slice data does not
+  // have to be read if only the slice header is parsed. -1 means that the complete NAL unit is needed.
+  virtual int maxNALBytesForParsing() const { return -1; }
+
+  // The index (nalUnitList and POC_List) of a scanned file is saved to a cache file in the user's cache directory.
+  // When the same unchanged file (size and modification time) is opened again, only the NAL units in the index are
+  // parsed again instead of scanning the whole file. Return false if there is no valid index for the file.
+  bool loadIndexFromCache();
+  void saveIndexToCache() const;
+  QString getIndexCacheFilePath() const;
 
   // The bitstream is at the start of a nal unit. This function should be overloaded and parse the NAL unit header
   // and whatever the NAL unit may contain. Finally it should add the unit to the nalUnitList (if it is a parameter set or an RA point).
   virtual void parseAndAddNALUnit(int nalID) = 0;
+  // Reset the state that the parser carries from one NAL unit to the next before a scan of the file starts
+  virtual void resetParsingState() {}
 
   // Clear all knowledge about the bitstream.
   void clearData();
 
+  // ---- Scanning in the background
+  // The index of a file that is scanned in the background. The scanner publishes what it found so far in regular
+  // intervals. The file that started the scan and all files that copied its index pick up the changes from here.
+  struct backgroundScanIndex
+  {
+    backgroundScanIndex() : revision(0), progress(0), scanComplete(false), firstChangedFrameIdx(-1) {}
+    QMutex mutex;
+    QList<QSharedPointer<nal_unit>> nalUnitList;
+    QList<int> POC_List;  //< Sorted. Only POCs whose frame index can not change anymore (unless the file grows).
+    int revision;
+    int progress;
+    bool scanComplete;
+    int firstChangedFrameIdx;
+    QAtomicInt cancel;
+  };
+  QSharedPointer<backgroundScanIndex> sharedIndex;
+  int sharedIndexRevision;
+  // The file that started the background scan owns the scanner (a second instance of the same class)
+  QScopedPointer<fileSourceAnnexBFile> backgroundScanner;
+  QFuture<void> backgroundScanFuture;
+  QElapsedTimer publishTimer;
+
+  // Get a new instance of the derived class that can scan the file in a background thread. Return nullptr
+  // if the file can not be parsed in the background. Then it is always scanned completely in openFile.
+  virtual fileSourceAnnexBFile *createBackgroundScanner() const { return nullptr; }
+  // Scan the beginning of the file and start the background scan. Return false if this is not possible.
+  // If the file is followed, the scanner is always started (also if the file is short).
+  bool startBackgroundScan(bool followFile, bool &scanCompleted);
+  void stopBackgroundScan();
+  // This is executed by the scanner in a background thread
+  void runBackgroundScan();
+  // Continue the scan after data was appended to the file (follow mode). This is executed by the scanner in a background thread.
+  void continueBackgroundScan();
+  bool isBackgroundScanCanceled() const { return sharedIndex && sharedIndex->cancel.load() != 0; }
+  // Publish the current index to the sharedIndex (the scanner does this every few hundred ms). If the scan is not complete
+  // or the file still grows, the last pictures are held back. Pictures that were published already are never held back.
+  void publishIndex(bool scanComplete, int progress, bool holdBackReorderedPics);
+  void publishScanProgress(int progress);
+  // Get the latest index from the background scan (if it changed)
+  void updateIndexFromBackgroundScan();
+  // The position in the file and the NAL unit number where the scan ended. The scan continues from here if data
+  // is appended to the file. -1 if the scan did not finish.
+  qint64 scanEndPos;
+  int scanEndNalID;
+  // Are the last pictures held back because the file is still growing?
+  bool followPicsHeldBack;
+
   // load the next buffer
   bool updateBuffer();
 
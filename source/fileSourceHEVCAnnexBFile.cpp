@@ -45,24 +45,28 @@
 #define DEBUG_ANNEXB(fmt,...) ((void)0)
 #endif
 
+// If the NAL unit tree is not requested, only the beginning of the slice header is parsed (up to slice_pic_order_cnt_lsb).
+// These syntax elements take less than 12 bytes (including emulation prevention bytes).
+#define SLICE_HEADER_POC_MAX_BYTES 32
+
 /* Some macros that we use to read syntax elements from the bitstream.
  * The advantage of these macros is, that they can directly also create the tree structure for the QAbstractItemModel that is 
  * used to show the NAL units and their content. The tree will only be added if the pointer to the given tree itemTree is valid.
 */
 // Read "numBits" bits into the variable "into". 
-#define READBITS(into,numBits) {QString code; into=reader.readBits(numBits, &code); if (itemTree) new TreeItem(#into,into,QString("u(v) -> u(%1)").arg(numBits),code, itemTree);}
-#define READBITS_M(into,numBits,meanings) {QString code; into=reader.readBits(numBits, &code); if (itemTree) new TreeItem(#into,into,QString("u(v) -> u(%1)").arg(numBits),code, meanings,itemTree);}
-#define READBITS_A(into,numBits,i) {QString code; int v=reader.readBits(numBits,&code); into.append(v); if (itemTree) new TreeItem(QString(#into)+QString("[%1]").arg(i),v,QString("u(v) -> u(%1)").arg(numBits),code, itemTree);}
+#define READBITS(into,numBits) {QString code; into=reader.readBits(numBits, itemTree ? &code : nullptr); if (itemTree) new TreeItem(#into,into,QString("u(v) -> u(%1)").arg(numBits),code, itemTree);}
+#define READBITS_M(into,numBits,meanings) {QString code; into=reader.readBits(numBits, itemTree ? &code : nullptr); if (itemTree) new TreeItem(#into,into,QString("u(v) -> u(%1)").arg(numBits),code, meanings,itemTree);}
+#define READBITS_A(into,numBits,i) {QString code; int v=reader.readBits(numBits, itemTree ? &code : nullptr); into.append(v); if (itemTree) new TreeItem(QString(#into)+QString("[%1]").arg(i),v,QString("u(v) -> u(%1)").arg(numBits),code, itemTree);}
 // Read a flag (1 bit) into the variable "into".
 #define READFLAG(into) {into=(reader.readBits(1)!=0); if (itemTree) new TreeItem(#into,into,QString("u(1)"),(into!=0)?"1":"0",itemTree);}
 #define READFLAG_A(into,i) {bool b=(reader.readBits(1)!=0); into.append(b); if (itemTree) new TreeItem(QString(#into)+QString("[%1]").arg(i),b,QString("u(1)"),b?"1":"0",itemTree);}
 // Read a unsigned ue(v) code from the bitstream into the variable "into"
-#define READUEV(into) {QString code; into=reader.readUE_V(&code); if (itemTree) new TreeItem(#into,into,QString("ue(v)"),code,itemTree);}
-#define READUEV_M(into,meanings) {QString code; into=reader.readUE_V(&code); if (itemTree) new TreeItem(#into,into,QString("ue(v)"),code,meanings,itemTree);}
-#define READUEV_A(arr,i) {QString code; int v=reader.readUE_V(&code); arr.append(v); if (itemTree) new TreeItem(QString(#arr)+QString("[%1]").arg(i),v,QString("ue(v)"),code,itemTree);}
+#define READUEV(into) {QString code; into=reader.readUE_V(itemTree ? &code : nullptr); if (itemTree) new TreeItem(#into,into,QString("ue(v)"),code,itemTree);}
+#define READUEV_M(into,meanings) {QString code; into=reader.readUE_V(itemTree ? &code : nullptr); if (itemTree) new TreeItem(#into,into,QString("ue(v)"),code,meanings,itemTree);}
+#define READUEV_A(arr,i) {QString code; int v=reader.readUE_V(itemTree ? &code : nullptr); arr.append(v); if (itemTree) new TreeItem(QString(#arr)+QString("[%1]").arg(i),v,QString("ue(v)"),code,itemTree);}
 // Read a signed se(v) code from the bitstream into the variable "into"
-#define READSEV(into) {QString code; into=reader.readSE_V(&code); if (itemTree) new TreeItem(#into,into,QString("se(v)"),code,itemTree);}
-#define READSEV_A(into,i) {QString code; int v=reader.readSE_V(&code); into.append(v); if (itemTree) new TreeItem(QString(#into)+QString("[%1]").arg(i),v,QString("se(v)"),code,itemTree);}
+#define READSEV(into) {QString code; into=reader.readSE_V(itemTree ? &code : nullptr); if (itemTree) new TreeItem(#into,into,QString("se(v)"),code,itemTree);}
+#define READSEV_A(into,i) {QString code; int v=reader.readSE_V(itemTree ? &code : nullptr); into.append(v); if (itemTree) new TreeItem(QString(#into)+QString("[%1]").arg(i),v,QString("se(v)"),code,itemTree);}
 // Do not actually read anything but also put the value into the tree as a calculated value
 #define LOGVAL(val) {if (itemTree) new TreeItem(#val,val,QString("calc"),QString(),itemTree);}
 #define LOGVAL_M(val,meaning) {if (itemTree) new TreeItem(#val,val,QString("calc"),QString(),meaning,itemTree);}
@@ -122,8 +126,8 @@ void fileSourceHEVCAnnexBFile::profile_tier_level::parse_profile_tier_level(sub_
     // Read the zero nrGeneralReservedZeroBits bits. 
     // The readbits function can only read 32 bits at once so read the bits in multiple steps.
     QString code;
-    int zero = reader.readBits(32, &code);
-    int zero2 = reader.readBits(nrGeneralReservedZeroBits-32, &code);
+    int zero = reader.readBits(32, itemTree ? &code : nullptr);
+    int zero2 = reader.readBits(nrGeneralReservedZeroBits-32, itemTree ? &code : nullptr);
     if (zero != 0 || zero2 != 0)
       throw std::logic_error("general_reserved_zero_bits were not zero.");
     if (itemTree)
@@ -193,8 +197,8 @@ void fileSourceHEVCAnnexBFile::profile_tier_level::parse_profile_tier_level(sub_
       // Read the zero nrSubLayerReservedZeroBits bits. 
       // The readbits function can only read 32 bits at once so read the bits in multiple steps.
       QString code;
-      int zero = reader.readBits(32, &code);
-      int zero2 = reader.readBits(nrSubLayerReservedZeroBits-32, &code);
+      int zero = reader.readBits(32, itemTree ? &code : nullptr);
+      int zero2 = reader.readBits(nrSubLayerReservedZeroBits-32, itemTree ? &code : nullptr);
       if (zero != 0 || zero2 != 0)
         throw std::logic_error("general_reserved_zero_bits were not zero.");
       if (itemTree)
@@ -363,14 +367,6 @@ void fileSourceHEVCAnnexBFile::pred_weight_table::parse_pred_weight_table(sub_by
   }
 }
 
-int fileSourceHEVCAnnexBFile::st_ref_pic_set::NumNegativePics[65];
-int fileSourceHEVCAnnexBFile::st_ref_pic_set::NumPositivePics[65];
-int fileSourceHEVCAnnexBFile::st_ref_pic_set::DeltaPocS0[65][16];
-int fileSourceHEVCAnnexBFile::st_ref_pic_set::DeltaPocS1[65][16];
-bool fileSourceHEVCAnnexBFile::st_ref_pic_set::UsedByCurrPicS0[65][16];
-bool fileSourceHEVCAnnexBFile::st_ref_pic_set::UsedByCurrPicS1[65][16];
-int fileSourceHEVCAnnexBFile::st_ref_pic_set::NumDeltaPocs[65];
-
 void fileSourceHEVCAnnexBFile::st_ref_pic_set::parse_st_ref_pic_set(sub_byte_reader &reader, int stRpsIdx, sps *actSPS, TreeItem *root)
 {
   // Create a new TreeItem root for the item
@@ -397,7 +393,7 @@ void fileSourceHEVCAnnexBFile::st_ref_pic_set::parse_st_ref_pic_set(sub_byte_rea
     LOGVAL(RefRpsIdx);
     LOGVAL(deltaRps);
 
-    for(int j=0; j<=NumDeltaPocs[RefRpsIdx]; j++)
+    for(int j=0; j<=actSPS->NumDeltaPocs[RefRpsIdx]; j++)
     {
       READFLAG_A(used_by_curr_pic_flag, j);
       use_delta_flag.append(true); // Infer to 1
@@ -407,64 +403,64 @@ void fileSourceHEVCAnnexBFile::st_ref_pic_set::parse_st_ref_pic_set(sub_byte_rea
 
     // Derive NumNegativePics Rec. ITU-T H.265 v3 (04/2015) (7-59)
     int i = 0;
-    for(int j=NumPositivePics[RefRpsIdx] - 1; j >= 0; j--)
+    for(int j=actSPS->NumPositivePics[RefRpsIdx] - 1; j >= 0; j--)
     {
-      int dPoc = DeltaPocS1[RefRpsIdx][j] + deltaRps;
-      if(dPoc < 0 && use_delta_flag[NumNegativePics[RefRpsIdx] + j]) 
+      int dPoc = actSPS->DeltaPocS1[RefRpsIdx][j] + deltaRps;
+      if(dPoc < 0 && use_delta_flag[actSPS->NumNegativePics[RefRpsIdx] + j]) 
       { 
-        DeltaPocS0[stRpsIdx][i] = dPoc;
+        actSPS->DeltaPocS0[stRpsIdx][i] = dPoc;
         LOGSTRVAL(QString("DeltaPocS0[%1][%2]").arg(stRpsIdx).arg(i), dPoc);
-        UsedByCurrPicS0[stRpsIdx][i++] = used_by_curr_pic_flag[NumNegativePics[RefRpsIdx] + j];
+        actSPS->UsedByCurrPicS0[stRpsIdx][i++] = used_by_curr_pic_flag[actSPS->NumNegativePics[RefRpsIdx] + j];
       }
     }
-    if(deltaRps < 0 && use_delta_flag[NumDeltaPocs[RefRpsIdx]])
+    if(deltaRps < 0 && use_delta_flag[actSPS->NumDeltaPocs[RefRpsIdx]])
     { 
-      DeltaPocS0[stRpsIdx][i] = deltaRps;
+      actSPS->DeltaPocS0[stRpsIdx][i] = deltaRps;
       LOGSTRVAL(QString("DeltaPocS0[%1][%2]").arg(stRpsIdx).arg(i), deltaRps);
-      UsedByCurrPicS0[stRpsIdx][i++] = used_by_curr_pic_flag[NumDeltaPocs[RefRpsIdx]];
+      actSPS->UsedByCurrPicS0[stRpsIdx][i++] = used_by_curr_pic_flag[actSPS->NumDeltaPocs[RefRpsIdx]];
     }
-    for(int j=0; j<NumNegativePics[RefRpsIdx]; j++)
+    for(int j=0; j<actSPS->NumNegativePics[RefRpsIdx]; j++)
     { 
-      int dPoc = DeltaPocS0[RefRpsIdx][j] + deltaRps;
+      int dPoc = actSPS->DeltaPocS0[RefRpsIdx][j] + deltaRps;
       if(dPoc < 0 && use_delta_flag[j])
       { 
-        DeltaPocS0[stRpsIdx][i] = dPoc;
+        actSPS->DeltaPocS0[stRpsIdx][i] = dPoc;
         LOGSTRVAL(QString("DeltaPocS0[%1][%2]").arg(stRpsIdx).arg(i), dPoc);
-        UsedByCurrPicS0[stRpsIdx][i++] = used_by_curr_pic_flag[j];
+        actSPS->UsedByCurrPicS0[stRpsIdx][i++] = used_by_curr_pic_flag[j];
       } 
     } 
-    NumNegativePics[stRpsIdx] = i;
+    actSPS->NumNegativePics[stRpsIdx] = i;
     LOGSTRVAL(QString("NumNegativePics[%1]").arg(stRpsIdx), i);
 
     // Derive NumPositivePics Rec. ITU-T H.265 v3 (04/2015) (7-60)
     i = 0;
-    for(int j=NumNegativePics[RefRpsIdx] - 1; j>=0; j--)
+    for(int j=actSPS->NumNegativePics[RefRpsIdx] - 1; j>=0; j--)
     { 
-      int dPoc = DeltaPocS0[RefRpsIdx][j] + deltaRps;
+      int dPoc = actSPS->DeltaPocS0[RefRpsIdx][j] + deltaRps;
       if(dPoc > 0 && use_delta_flag[j])
       { 
-        DeltaPocS1[stRpsIdx][i] = dPoc;
+        actSPS->DeltaPocS1[stRpsIdx][i] = dPoc;
         LOGSTRVAL(QString("DeltaPocS1[%1][%2]").arg(stRpsIdx).arg(i), dPoc);
-        UsedByCurrPicS1[stRpsIdx][i++] = used_by_curr_pic_flag[j];
+        actSPS->UsedByCurrPicS1[stRpsIdx][i++] = used_by_curr_pic_flag[j];
       }
     }
-    if(deltaRps > 0 && use_delta_flag[NumDeltaPocs[RefRpsIdx]])
+    if(deltaRps > 0 && use_delta_flag[actSPS->NumDeltaPocs[RefRpsIdx]])
     {
-      DeltaPocS1[stRpsIdx][i] = deltaRps;
+      actSPS->DeltaPocS1[stRpsIdx][i] = deltaRps;
       LOGSTRVAL(QString("DeltaPocS1[%1][%2]").arg(stRpsIdx).arg(i), deltaRps);
-      UsedByCurrPicS1[stRpsIdx][i++] = used_by_curr_pic_flag[NumDeltaPocs[RefRpsIdx]];
+      actSPS->UsedByCurrPicS1[stRpsIdx][i++] = used_by_curr_pic_flag[actSPS->NumDeltaPocs[RefRpsIdx]];
     }
-    for(int j=0; j<NumPositivePics[RefRpsIdx]; j++)
+    for(int j=0; j<actSPS->NumPositivePics[RefRpsIdx]; j++)
     { 
-      int dPoc = DeltaPocS1[RefRpsIdx][j] + deltaRps;
-      if(dPoc > 0 && use_delta_flag[NumNegativePics[RefRpsIdx] + j])
+      int dPoc = actSPS->DeltaPocS1[RefRpsIdx][j] + deltaRps;
+      if(dPoc > 0 && use_delta_flag[actSPS->NumNegativePics[RefRpsIdx] + j])
       { 
-        DeltaPocS1[stRpsIdx][i] = dPoc;
+        actSPS->DeltaPocS1[stRpsIdx][i] = dPoc;
         LOGSTRVAL(QString("DeltaPocS1[%1][%2]").arg(stRpsIdx).arg(i), dPoc);
-        UsedByCurrPicS1[stRpsIdx][i++] = used_by_curr_pic_flag[NumNegativePics[RefRpsIdx] + j] ;
+        actSPS->UsedByCurrPicS1[stRpsIdx][i++] = used_by_curr_pic_flag[actSPS->NumNegativePics[RefRpsIdx] + j] ;
       }
     }
-    NumPositivePics[stRpsIdx] = i;
+    actSPS->NumPositivePics[stRpsIdx] = i;
     LOGSTRVAL(QString("NumPositivePics[%1]").arg(stRpsIdx), i);
   }
   else
@@ -477,12 +473,12 @@ void fileSourceHEVCAnnexBFile::st_ref_pic_set::parse_st_ref_pic_set(sub_byte_rea
       READFLAG_A(used_by_curr_pic_s0_flag, i);
       
       if (i==0)
-        DeltaPocS0[stRpsIdx][i] = -(delta_poc_s0_minus1.last() + 1); // (7-65)
+        actSPS->DeltaPocS0[stRpsIdx][i] = -(delta_poc_s0_minus1.last() + 1); // (7-65)
       else
-        DeltaPocS0[stRpsIdx][i] = DeltaPocS0[stRpsIdx][i-1] - (delta_poc_s0_minus1.last() + 1); // (7-67)
-      LOGSTRVAL(QString("DeltaPocS0[%1][%2]").arg(stRpsIdx).arg(i), DeltaPocS0[stRpsIdx][i]);
-      UsedByCurrPicS0[stRpsIdx][i] = used_by_curr_pic_s0_flag[i];
-      LOGSTRVAL(QString("UsedByCurrPicS0[%1][%2]").arg(stRpsIdx).arg(i), UsedByCurrPicS0[stRpsIdx][i]);
+        actSPS->DeltaPocS0[stRpsIdx][i] = actSPS->DeltaPocS0[stRpsIdx][i-1] - (delta_poc_s0_minus1.last() + 1); // (7-67)
+      LOGSTRVAL(QString("DeltaPocS0[%1][%2]").arg(stRpsIdx).arg(i), actSPS->DeltaPocS0[stRpsIdx][i]);
+      actSPS->UsedByCurrPicS0[stRpsIdx][i] = used_by_curr_pic_s0_flag[i];
+      LOGSTRVAL(QString("UsedByCurrPicS0[%1][%2]").arg(stRpsIdx).arg(i), actSPS->UsedByCurrPicS0[stRpsIdx][i]);
     }
     for(int i = 0; i < num_positive_pics; i++)
     {
@@ -490,32 +486,32 @@ void fileSourceHEVCAnnexBFile::st_ref_pic_set::parse_st_ref_pic_set(sub_byte_rea
       READFLAG_A(used_by_curr_pic_s1_flag, i);
 
       if (i==0)
-        DeltaPocS1[stRpsIdx][i] = delta_poc_s1_minus1.last() + 1; // (7-66)
+        actSPS->DeltaPocS1[stRpsIdx][i] = delta_poc_s1_minus1.last() + 1; // (7-66)
       else
-        DeltaPocS1[stRpsIdx][i] = DeltaPocS1[stRpsIdx][i-1] + (delta_poc_s1_minus1.last() + 1); // (7-68)
-      LOGSTRVAL(QString("DeltaPocS1[%1][%2]").arg(stRpsIdx).arg(i), DeltaPocS1[stRpsIdx][i]);
-      UsedByCurrPicS1[stRpsIdx][i] = used_by_curr_pic_s1_flag[i];
-      LOGSTRVAL(QString("UsedByCurrPicS1[%1][%2]").arg(stRpsIdx).arg(i), UsedByCurrPicS1[stRpsIdx][i]);
+        actSPS->DeltaPocS1[stRpsIdx][i] = actSPS->DeltaPocS1[stRpsIdx][i-1] + (delta_poc_s1_minus1.last() + 1); // (7-68)
+      LOGSTRVAL(QString("DeltaPocS1[%1][%2]").arg(stRpsIdx).arg(i), actSPS->DeltaPocS1[stRpsIdx][i]);
+      actSPS->UsedByCurrPicS1[stRpsIdx][i] = used_by_curr_pic_s1_flag[i];
+      LOGSTRVAL(QString("UsedByCurrPicS1[%1][%2]").arg(stRpsIdx).arg(i), actSPS->UsedByCurrPicS1[stRpsIdx][i]);
     }
 
-    NumNegativePics[stRpsIdx] = num_negative_pics;
-    NumPositivePics[stRpsIdx] = num_positive_pics;
+    actSPS->NumNegativePics[stRpsIdx] = num_negative_pics;
+    actSPS->NumPositivePics[stRpsIdx] = num_positive_pics;
     LOGSTRVAL(QString("NumNegativePics[%1]").arg(stRpsIdx), num_negative_pics);
     LOGSTRVAL(QString("NumPositivePics[%1]").arg(stRpsIdx), num_positive_pics);
   }
 
-  NumDeltaPocs[stRpsIdx] = NumNegativePics[stRpsIdx] + NumPositivePics[stRpsIdx]; // (7-69)
+  actSPS->NumDeltaPocs[stRpsIdx] = actSPS->NumNegativePics[stRpsIdx] + actSPS->NumPositivePics[stRpsIdx]; // (7-69)
 }
 
 // (7-55)
-int fileSourceHEVCAnnexBFile::st_ref_pic_set::NumPicTotalCurr(int CurrRpsIdx, slice *actSlice)
+int fileSourceHEVCAnnexBFile::st_ref_pic_set::NumPicTotalCurr(int CurrRpsIdx, const sps *actSPS, const slice *actSlice)
 {
   int NumPicTotalCurr = 0;
-  for(int i = 0; i < NumNegativePics[CurrRpsIdx]; i++)
-    if(UsedByCurrPicS0[CurrRpsIdx][i])
+  for(int i = 0; i < actSPS->NumNegativePics[CurrRpsIdx]; i++)
+    if(actSPS->UsedByCurrPicS0[CurrRpsIdx][i])
       NumPicTotalCurr++ ;
-  for(int i = 0; i < NumPositivePics[CurrRpsIdx]; i++)  
-    if(UsedByCurrPicS1[CurrRpsIdx][i]) 
+  for(int i = 0; i < actSPS->NumPositivePics[CurrRpsIdx]; i++)  
+    if(actSPS->UsedByCurrPicS1[CurrRpsIdx][i]) 
       NumPicTotalCurr++;
   for(int i = 0; i < actSlice->num_long_term_sps + actSlice->num_long_term_pics; i++) 
     if(actSlice->UsedByCurrPicLt[i])
@@ -735,6 +731,11 @@ void fileSourceHEVCAnnexBFile::vps::parse_vps(const QByteArray &parameterSetData
 
 fileSourceHEVCAnnexBFile::sps::sps(const nal_unit_hevc &nal) : nal_unit_hevc(nal)
 {
+  // No reference picture sets were parsed yet
+  std::fill(NumNegativePics, NumNegativePics + 65, 0);
+  std::fill(NumPositivePics, NumPositivePics + 65, 0);
+  std::fill(NumDeltaPocs, NumDeltaPocs + 65, 0);
+
   // Infer some default values (if not present)
   separate_colour_plane_flag = false;
   conf_win_left_offset = 0;
@@ -1055,11 +1056,6 @@ void fileSourceHEVCAnnexBFile::ref_pic_lists_modification::parse_ref_pic_lists_m
   }
 }
 
-// Initialize static member. Only true for the first slice instance
-bool fileSourceHEVCAnnexBFile::slice::bFirstAUInDecodingOrder = true;
-int fileSourceHEVCAnnexBFile::slice::prevTid0Pic_slice_pic_order_cnt_lsb = 0;
-int fileSourceHEVCAnnexBFile::slice::prevTid0Pic_PicOrderCntMsb = 0;
-
 fileSourceHEVCAnnexBFile::slice::slice(const nal_unit_hevc &nal) : nal_unit_hevc(nal)
 {
   PicOrderCntVal = -1;
@@ -1084,57 +1080,12 @@ fileSourceHEVCAnnexBFile::slice::slice(const nal_unit_hevc &nal) : nal_unit_hevc
 }
 
 // T-REC-H.265-201410 - 7.3.6.1 slice_segment_header()
-void fileSourceHEVCAnnexBFile::slice::parse_slice(const QByteArray &sliceHeaderData, const sps_map &p_active_SPS_list, const pps_map &p_active_PPS_list, QSharedPointer<slice> firstSliceInSegment, TreeItem *root)
+void fileSourceHEVCAnnexBFile::slice::parse_slice_header_remainder(sub_byte_reader &reader, TreeItem *itemTree)
 {
-  sub_byte_reader reader(sliceHeaderData);
-
-  // Create a new TreeItem root for the item
-  // The macros will use this variable to add all the parsed variables
-  TreeItem *const itemTree = root ? new TreeItem("slice_segment_header()", root) : nullptr;
-
-  READFLAG(first_slice_segment_in_pic_flag);
-  
-  if (isIRAP())
-    READFLAG(no_output_of_prior_pics_flag);
-
-  READUEV(slice_pic_parameter_set_id);
-  // The value of slice_pic_parameter_set_id shall be in the range of 0 to 63, inclusive. (Max 11 bits read)
-  if (slice_pic_parameter_set_id >= 63) 
-    throw std::out_of_range("The variable slice_pic_parameter_set_id is out of range.");
-
-  // Get the active PPS
-  if (!p_active_PPS_list.contains(slice_pic_parameter_set_id))
-    throw std::logic_error("The signaled PPS was not found in the bitstream.");
-  actPPS = p_active_PPS_list.value(slice_pic_parameter_set_id);
-
-  // Get the active SPS
-  if (!p_active_SPS_list.contains(actPPS->pps_seq_parameter_set_id))
-    throw std::logic_error("The signaled SPS was not found in the bitstream.");
-  actSPS = p_active_SPS_list.value(actPPS->pps_seq_parameter_set_id);
-
-  if (!first_slice_segment_in_pic_flag)
-  {
-    if (actPPS->dependent_slice_segments_enabled_flag)
-      READFLAG(dependent_slice_segment_flag);
-    int nrBits = ceil(log2(actSPS->PicSizeInCtbsY));  // 7.4.7.1
-    READBITS(slice_segment_address, nrBits);
-  }
-
   if (!dependent_slice_segment_flag)
   {
-    for (int i=0; i < actPPS->num_extra_slice_header_bits; i++)
-      READFLAG_A(slice_reserved_flag, i);
-
-    READUEV(slice_type); // Max 3 bits read. 0-B 1-P 2-I
-    if (actPPS->output_flag_present_flag) 
-      READFLAG(pic_output_flag);
-
-    if (actSPS->separate_colour_plane_flag) 
-      READFLAG(colour_plane_id);
-
     if(nal_type != IDR_W_RADL && nal_type != IDR_N_LP)
     {
-      READBITS(slice_pic_order_cnt_lsb, actSPS->log2_max_pic_order_cnt_lsb_minus4 + 4); // Max 16 bits read
       READFLAG(short_term_ref_pic_set_sps_flag);
 
       //Decoding of the reference picture sets works differently. 
@@ -1210,7 +1161,7 @@ void fileSourceHEVCAnnexBFile::slice::parse_slice(const QByteArray &sliceHeaderD
       }
 
       int CurrRpsIdx = (short_term_ref_pic_set_sps_flag) ? short_term_ref_pic_set_idx : actSPS->num_short_term_ref_pic_sets;
-      int NumPicTotalCurr = st_rps.NumPicTotalCurr(CurrRpsIdx, this);
+      int NumPicTotalCurr = st_rps.NumPicTotalCurr(CurrRpsIdx, actSPS.data(), this);
       if(actPPS->lists_modification_present_flag && NumPicTotalCurr > 1)
         slice_rpl_mod.parse_ref_pic_lists_modification(reader, this, NumPicTotalCurr, itemTree);
 
@@ -1254,15 +1205,8 @@ void fileSourceHEVCAnnexBFile::slice::parse_slice(const QByteArray &sliceHeaderD
 
     if(actPPS->pps_loop_filter_across_slices_enabled_flag && (slice_sao_luma_flag || slice_sao_chroma_flag || !slice_deblocking_filter_disabled_flag))
       READFLAG(slice_loop_filter_across_slices_enabled_flag);
-  } 
-  else // dependent_slice_segment_flag is true -- inferr values from firstSliceInSegment
-  {
-    if (firstSliceInSegment == nullptr)
-      throw std::logic_error("Dependent slice without a first slice in the segment.");
-
-    slice_pic_order_cnt_lsb = firstSliceInSegment->slice_pic_order_cnt_lsb;
   }
-  
+
   if(actPPS->tiles_enabled_flag || actPPS->entropy_coding_sync_enabled_flag)
   {
     READUEV(num_entry_point_offsets);
@@ -1286,6 +1230,70 @@ void fileSourceHEVCAnnexBFile::slice::parse_slice(const QByteArray &sliceHeaderD
     for(int i = 0; i < slice_segment_header_extension_length; i++)
       READBITS_A(slice_segment_header_extension_data_byte, 8, i);
   }
+}
+
+void fileSourceHEVCAnnexBFile::slice::parse_slice(const QByteArray &sliceHeaderData, const sps_map &p_active_SPS_list, const pps_map &p_active_PPS_list, QSharedPointer<slice> firstSliceInSegment, pocDerivationState &pocState, TreeItem *root)
+{
+  sub_byte_reader reader(sliceHeaderData);
+
+  // Create a new TreeItem root for the item
+  // The macros will use this variable to add all the parsed variables
+  TreeItem *const itemTree = root ? new TreeItem("slice_segment_header()", root) : nullptr;
+
+  READFLAG(first_slice_segment_in_pic_flag);
+  
+  if (isIRAP())
+    READFLAG(no_output_of_prior_pics_flag);
+
+  READUEV(slice_pic_parameter_set_id);
+  // The value of slice_pic_parameter_set_id shall be in the range of 0 to 63, inclusive. (Max 11 bits read)
+  if (slice_pic_parameter_set_id >= 63) 
+    throw std::out_of_range("The variable slice_pic_parameter_set_id is out of range.");
+
+  // Get the active PPS
+  if (!p_active_PPS_list.contains(slice_pic_parameter_set_id))
+    throw std::logic_error("The signaled PPS was not found in the bitstream.");
+  actPPS = p_active_PPS_list.value(slice_pic_parameter_set_id);
+
+  // Get the active SPS
+  if (!p_active_SPS_list.contains(actPPS->pps_seq_parameter_set_id))
+    throw std::logic_error("The signaled SPS was not found in the bitstream.");
+  actSPS = p_active_SPS_list.value(actPPS->pps_seq_parameter_set_id);
+
+  if (!first_slice_segment_in_pic_flag)
+  {
+    if (actPPS->dependent_slice_segments_enabled_flag)
+      READFLAG(dependent_slice_segment_flag);
+    int nrBits = ceil(log2(actSPS->PicSizeInCtbsY));  // 7.4.7.1
+    READBITS(slice_segment_address, nrBits);
+  }
+
+  if (!dependent_slice_segment_flag)
+  {
+    for (int i=0; i < actPPS->num_extra_slice_header_bits; i++)
+      READFLAG_A(slice_reserved_flag, i);
+
+    READUEV(slice_type); // Max 3 bits read. 0-B 1-P 2-I
+    if (actPPS->output_flag_present_flag) 
+      READFLAG(pic_output_flag);
+
+    if (actSPS->separate_colour_plane_flag) 
+      READFLAG(colour_plane_id);
+
+    if(nal_type != IDR_W_RADL && nal_type != IDR_N_LP)
+      READBITS(slice_pic_order_cnt_lsb, actSPS->log2_max_pic_order_cnt_lsb_minus4 + 4); // Max 16 bits read
+  }
+  else // dependent_slice_segment_flag is true -- inferr values from firstSliceInSegment
+  {
+    if (firstSliceInSegment == nullptr)
+      throw std::logic_error("Dependent slice without a first slice in the segment.");
+
+    slice_pic_order_cnt_lsb = firstSliceInSegment->slice_pic_order_cnt_lsb;
+  }
+
+  // The rest of the slice header is not needed to calculate the POC. It is only parsed if the values are shown in the tree.
+  if (itemTree)
+    parse_slice_header_remainder(reader, itemTree);
 
   // End of the slice header - byte_alignment()
 
@@ -1297,10 +1305,10 @@ void fileSourceHEVCAnnexBFile::slice::parse_slice(const QByteArray &sliceHeaderD
   NoRaslOutputFlag = false;
   if (nal_type == IDR_W_RADL || nal_type == BLA_W_LP)
     NoRaslOutputFlag = true;
-  else if (bFirstAUInDecodingOrder) 
+  else if (pocState.bFirstAUInDecodingOrder) 
   {
     NoRaslOutputFlag = true;
-    bFirstAUInDecodingOrder = false;
+    pocState.bFirstAUInDecodingOrder = false;
   }
 
   // T-REC-H.265-201410 - 8.3.1 Decoding process for picture order count
@@ -1312,8 +1320,8 @@ void fileSourceHEVCAnnexBFile::slice::parse_slice(const QByteArray &sliceHeaderD
   {
     // the variables prevPicOrderCntLsb and prevPicOrderCntMsb are derived as follows:
      
-    prevPicOrderCntLsb = prevTid0Pic_slice_pic_order_cnt_lsb;
-    prevPicOrderCntMsb = prevTid0Pic_PicOrderCntMsb;
+    prevPicOrderCntLsb = pocState.prevTid0Pic_slice_pic_order_cnt_lsb;
+    prevPicOrderCntMsb = pocState.prevTid0Pic_PicOrderCntMsb;
   }
   LOGVAL(prevPicOrderCntLsb);
   LOGVAL(prevPicOrderCntMsb);
@@ -1346,8 +1354,8 @@ void fileSourceHEVCAnnexBFile::slice::parse_slice(const QByteArray &sliceHeaderD
     // equal to 0 and that is not a RASL picture, a RADL picture or an SLNR picture.
 
     // Set these for the next slice
-    prevTid0Pic_slice_pic_order_cnt_lsb = slice_pic_order_cnt_lsb;
-    prevTid0Pic_PicOrderCntMsb = PicOrderCntMsb;
+    pocState.prevTid0Pic_slice_pic_order_cnt_lsb = slice_pic_order_cnt_lsb;
+    pocState.prevTid0Pic_PicOrderCntMsb = PicOrderCntMsb;
   }
 }
 
@@ -1449,8 +1457,10 @@ void fileSourceHEVCAnnexBFile::parseAndAddNALUnit(int nalID)
   else if (nal_hevc.isSlice())
   {
     // Create a new slice unit
+    // Without the tree, only the values that are needed for the POC are parsed. The rest of the slice is skipped.
     auto new_slice = QSharedPointer<slice>(new slice(nal_hevc));
-    new_slice->parse_slice(getRemainingNALBytes(), active_SPS_list, active_PPS_list, lastFirstSliceSegmentInPic, nalRoot);
+    const QByteArray sliceHeaderData = getRemainingNALBytes(nalRoot ? -1 : SLICE_HEADER_POC_MAX_BYTES);
+    new_slice->parse_slice(sliceHeaderData, active_SPS_list, active_PPS_list, lastFirstSliceSegmentInPic, pocState, nalRoot);
 
     // Add the POC of the slice
     if (new_slice->isIRAP() && new_slice->NoRaslOutputFlag && maxPOCCount > 0)
@@ -1567,8 +1577,24 @@ void fileSourceHEVCAnnexBFile::parseAndAddNALUnit(int nalID)
     nalRoot->itemData.append(QString("NAL %1: %2").arg(nal_hevc.nal_idx).arg(nal_unit_type_toString.value(nal_hevc.nal_type)) + specificDescription);
 }
 
+void fileSourceHEVCAnnexBFile::resetParsingState()
+{
+  // Parsing starts again with the first NAL unit. Forget everything that was derived from the NAL units parsed so far.
+  pocState = pocDerivationState();
+  firstPOCRandomAccess = INT_MAX;
+  pocCounterOffset = 0;
+  maxPOCCount = -1;
+  active_VPS_list.clear();
+  active_SPS_list.clear();
+  active_PPS_list.clear();
+  lastFirstSliceSegmentInPic.clear();
+  reparse_sei.clear();
+}
+
 QList<QByteArray> fileSourceHEVCAnnexBFile::seekToFrameNumber(int iFrameNr)
 {
+  updateIndexFromBackgroundScan();
+
   // Get the POC for the frame number
   int iPOC = POC_List[iFrameNr];
 
@@ -1865,7 +1891,7 @@ int fileSourceHEVCAnnexBFile::sei::parse_sei_message(const QByteArray &sliceHead
   // Read byte by byte
   int byte;
   QString code;
-  byte = reader.readBits(8, &code);
+  byte = reader.readBits(8, itemTree ? &code : nullptr);
   
   while (byte == 255) // 0xFF
   {
@@ -1876,7 +1902,7 @@ int fileSourceHEVCAnnexBFile::sei::parse_sei_message(const QByteArray &sliceHead
 
     // Read the next byte
     code.clear();
-    byte = reader.readBits(8, &code);
+    byte = reader.readBits(8, itemTree ? &code : nullptr);
   }
 
   // The next byte is not 255 (0xFF)
@@ -2020,7 +2046,7 @@ int fileSourceHEVCAnnexBFile::sei::parse_sei_message(const QByteArray &sliceHead
 
   // Read the next byte
   code.clear();
-  byte = reader.readBits(8, &code);
+  byte = reader.readBits(8, itemTree ? &code : nullptr);
   while (byte == 255) // 0xFF
   {
     payloadSize += 255;
@@ -2030,7 +2056,7 @@ int fileSourceHEVCAnnexBFile::sei::parse_sei_message(const QByteArray &sliceHead
 
     // Read the next byte
     code.clear();
-    byte = reader.readBits(8, &code);
+    byte = reader.readBits(8, itemTree ? &code : nullptr);
   }
 
   // The next byte is not 255
@@ -242,7 +242,7 @@ protected:
   struct st_ref_pic_set
   {
     void parse_st_ref_pic_set(sub_byte_reader &reader, int stRpsIdx, sps *actSPS, TreeItem *root);
-    int NumPicTotalCurr(int CurrRpsIdx, slice *actSlice);
+    int NumPicTotalCurr(int CurrRpsIdx, const sps *actSPS, const slice *actSlice);
 
     bool inter_ref_pic_set_prediction_flag;
     int delta_idx_minus1;
@@ -257,15 +257,6 @@ protected:
     QList<bool> used_by_curr_pic_s0_flag;
     QList<int> delta_poc_s1_minus1;
     QList<bool> used_by_curr_pic_s1_flag;
-
-    // Calculated values. These are static. They are used for reference picture set prediction.
-    static int NumNegativePics[65];
-    static int NumPositivePics[65];
-    static int DeltaPocS0[65][16];
-    static int DeltaPocS1[65][16];
-    static bool UsedByCurrPicS0[65][16];
-    static bool UsedByCurrPicS1[65][16];
-    static int NumDeltaPocs[65];
   };
 
   struct vui_parameters
@@ -422,6 +413,16 @@ protected:
     bool pcm_loop_filter_disabled_flag;
     int num_short_term_ref_pic_sets;
     QList<st_ref_pic_set> sps_st_ref_pic_sets;
+
+    // Calculated values of the short term reference picture sets. They are used for reference picture set prediction.
+    // The set at index num_short_term_ref_pic_sets is the one that was last sent in a slice header.
+    int NumNegativePics[65];
+    int NumPositivePics[65];
+    int DeltaPocS0[65][16];
+    int DeltaPocS1[65][16];
+    bool UsedByCurrPicS0[65][16];
+    bool UsedByCurrPicS1[65][16];
+    int NumDeltaPocs[65];
     bool long_term_ref_pics_present_flag;
     int num_long_term_ref_pics_sps;
     QList<int> lt_ref_pic_poc_lsb_sps;
@@ -524,11 +525,21 @@ protected:
     pps_range_extension range_extension;
   };
 
+  // The variables of the picture order count derivation (8.3.1) that are kept from one slice to the next in decoding order
+  struct pocDerivationState
+  {
+    pocDerivationState() : bFirstAUInDecodingOrder(true), prevTid0Pic_slice_pic_order_cnt_lsb(0), prevTid0Pic_PicOrderCntMsb(0) {}
+    bool bFirstAUInDecodingOrder;
+    int prevTid0Pic_slice_pic_order_cnt_lsb;
+    int prevTid0Pic_PicOrderCntMsb;
+  };
+
   // A slice NAL unit.
   struct slice : nal_unit_hevc
   {
     slice(const nal_unit_hevc &nal);
-    void parse_slice(const QByteArray &sliceHeaderData, const sps_map &p_active_SPS_list, const pps_map &p_active_PPS_list, QSharedPointer<slice> firstSliceInSegment, TreeItem *root);
+    // Parse the slice header and calculate the POC. If no tree is given, only the values needed for the POC are read.
+    void parse_slice(const QByteArray &sliceHeaderData, const sps_map &p_active_SPS_list, const pps_map &p_active_PPS_list, QSharedPointer<slice> firstSliceInSegment, pocDerivationState &pocState, TreeItem *root);
     virtual int getPOC() const override { return PicOrderCntVal; }
     
     bool first_slice_segment_in_pic_flag;
@@ -591,12 +602,10 @@ protected:
 
     int globalPOC;
 
-    // Static variables for keeping track of the decoding order
-    static bool bFirstAUInDecodingOrder;
-    static int prevTid0Pic_slice_pic_order_cnt_lsb;
-    static int prevTid0Pic_PicOrderCntMsb;
-
   private:
+    // Parse the part of the slice header after slice_pic_order_cnt_lsb (only needed to show the values in the tree)
+    void parse_slice_header_remainder(sub_byte_reader &reader, TreeItem *itemTree);
+
     // We will keep a pointer to the active SPS and PPS
     QSharedPointer<pps> actPPS;
     QSharedPointer<sps> actSPS;
@@ -605,6 +614,7 @@ protected:
   // The PicOrderCntMsb may be reset to zero for IDR frames. In order to count the global POC, we store the maximum POC.
   int maxPOCCount;
   int pocCounterOffset;
+  pocDerivationState pocState;
 
   struct sei : nal_unit_hevc
   {
@@ -701,6 +711,10 @@ protected:
   static QStringList get_matrix_coefficients_meaning();
 
   void parseAndAddNALUnit(int nalID) Q_DECL_OVERRIDE;
+  void resetParsingState() Q_DECL_OVERRIDE;
+  fileSourceAnnexBFile *createBackgroundScanner() const Q_DECL_OVERRIDE { return new fileSourceHEVCAnnexBFile; }
+  // Of a slice, only the header is parsed. The parameter sets and SEIs are much smaller than this.
+  int maxNALBytesForParsing() const Q_DECL_OVERRIDE { return 64 * 1024; }
 
   // When we start to parse the bitstream we will remember the first RAP POC
   // so that we can disregard any possible RASL pictures.
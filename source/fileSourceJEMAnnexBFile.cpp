@@ -33,7 +33,7 @@
 #include "fileSourceJEMAnnexBFile.h"
 
 #define READFLAG(into) {into=(reader.readBits(1)!=0); if (itemTree) new TreeItem(#into,into,QString("u(1)"),(into!=0)?"1":"0",itemTree);}
-#define READBITS(into,numBits) {QString code; into=reader.readBits(numBits, &code); if (itemTree) new TreeItem(#into,into,QString("u(v) -> u(%1)").arg(numBits),code, itemTree);}
+#define READBITS(into,numBits) {QString code; into=reader.readBits(numBits, itemTree ? &code : nullptr); if (itemTree) new TreeItem(#into,into,QString("u(v) -> u(%1)").arg(numBits),code, itemTree);}
 
 void fileSourceJEMAnnexBFile::parseAndAddNALUnit(int nalID)
 {
@@ -0,0 +1,63 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FRAMEBUFFERPOOL_H
+#define FRAMEBUFFERPOOL_H
+
+#include <QByteArray>
+#include <QList>
+#include <QMutex>
+
+/* A pool of output buffers for the decoders of one playlist item. All buffers have the size of one decoded frame.
+ * A decoder gets a buffer from the pool, writes the frame into it and puts it back into the pool. The pool keeps a
+ * reference to the buffer while it is passed on (to the video handler and the cache). Once all other references
+ * are gone, the buffer is reused for another frame. This way, scrubbing through a sequence does not allocate a new
+ * buffer for every decoded frame and a buffer that is still shared is never copied before it is overwritten.
+ * All functions are thread safe.
+ */
+class frameBufferPool
+{
+public:
+  frameBufferPool(int maxNrBuffers = 16) : maxNrBuffers(maxNrBuffers) {}
+
+  // Get a buffer with the given size that is not referenced anywhere else.
+  QByteArray getBuffer(int size);
+  // Put the buffer back into the pool. It is reused as soon as it is not referenced anywhere else.
+  void putBuffer(const QByteArray &buffer);
+
+private:
+  QMutex mutex;
+  QList<QByteArray> buffers;
+  int maxNrBuffers;
+};
+
+#endif // FRAMEBUFFERPOOL_H
@@ -0,0 +1,171 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "frameLookAhead.h"
+
+#include "typedef.h"
+
+#define FRAMELOOKAHEAD_DEBUG_OUTPUT 0
+#if FRAMELOOKAHEAD_DEBUG_OUTPUT && !NDEBUG
+#include <QDebug>
+#define DEBUG_LOOKAHEAD qDebug
+#else
+#define DEBUG_LOOKAHEAD(fmt,...) ((void)0)
+#endif
+
+// The number of frames that are decoded ahead of the playhead and the maximum memory used for them
+#define LOOK_AHEAD_NR_FRAMES 8
+#define LOOK_AHEAD_MAX_BYTES qint64(256*1024*1024)
+
+frameLookAhead::frameLookAhead()
+{
+  playheadIdx = -1;
+  nextFrameIdx = 0;
+  decodingFrameIdx = -1;
+  lastFrameIdx = -1;
+  maxNrFrames = LOOK_AHEAD_NR_FRAMES;
+  abort = false;
+  generation = 0;
+}
+
+frameLookAhead::~frameLookAhead()
+{
+  stop();
+}
+
+void frameLookAhead::setPlayhead(int frameIdx, int lastIdx, qint64 bytesPerImage)
+{
+  QMutexLocker lock(&mutex);
+
+  // Drop the frames that are not needed anymore
+  while (!queue.isEmpty() && queue.firstKey() <= frameIdx)
+    queue.erase(queue.begin());
+
+  if (frameIdx < playheadIdx || frameIdx >= nextFrameIdx)
+  {
+    // Playback jumped or the thread fell behind. Start decoding after the new playhead.
+    DEBUG_LOOKAHEAD("frameLookAhead::setPlayhead %d restart", frameIdx);
+    queue.clear();
+    generation++;
+    nextFrameIdx = frameIdx + 1;
+  }
+  playheadIdx = frameIdx;
+  lastFrameIdx = lastIdx;
+  if (bytesPerImage > 0)
+    maxNrFrames = int(clip(LOOK_AHEAD_MAX_BYTES / bytesPerImage, qint64(1), qint64(LOOK_AHEAD_NR_FRAMES)));
+
+  // The thread might still be finishing the frame that it decoded when it was stopped. It then just continues.
+  abort = false;
+  if (!isRunning())
+    start();
+  wakeUp.wakeOne();
+}
+
+bool frameLookAhead::takeFrame(int frameIdx, QImage &image)
+{
+  QMutexLocker lock(&mutex);
+
+  // Decoding the frame again would take longer than waiting for it
+  while (decodingFrameIdx == frameIdx)
+    frameDecoded.wait(&mutex);
+
+  if (!queue.contains(frameIdx))
+    return false;
+
+  DEBUG_LOOKAHEAD("frameLookAhead::takeFrame %d", frameIdx);
+  image = queue.take(frameIdx);
+  wakeUp.wakeOne();
+  return true;
+}
+
+void frameLookAhead::clear()
+{
+  QMutexLocker lock(&mutex);
+  queue.clear();
+  generation++;
+  nextFrameIdx = playheadIdx + 1;
+  wakeUp.wakeOne();
+}
+
+void frameLookAhead::stop(bool waitForThread)
+{
+  QMutexLocker lock(&mutex);
+  abort = true;
+  queue.clear();
+  generation++;
+  playheadIdx = -1;
+  nextFrameIdx = 0;
+  wakeUp.wakeOne();
+  lock.unlock();
+
+  if (waitForThread)
+    wait();
+}
+
+void frameLookAhead::run()
+{
+  QMutexLocker lock(&mutex);
+  while (!abort)
+  {
+    if (queue.count() >= maxNrFrames || nextFrameIdx > lastFrameIdx || !decodeFrame)
+    {
+      // Wait until a frame was taken or the playhead moved
+      wakeUp.wait(&mutex);
+      continue;
+    }
+
+    const int frameIdx = nextFrameIdx++;
+    const int frameGeneration = generation;
+    decodingFrameIdx = frameIdx;
+    lock.unlock();
+
+    DEBUG_LOOKAHEAD("frameLookAhead::run decoding %d", frameIdx);
+    QImage image;
+    const bool decoded = decodeFrame(frameIdx, image);
+
+    lock.relock();
+    decodingFrameIdx = -1;
+    frameDecoded.wakeAll();
+    if (frameGeneration != generation)
+      // The frame is not valid anymore
+      continue;
+    if (!decoded)
+    {
+      // Don't try to decode the following frames. They are loaded when they are needed.
+      DEBUG_LOOKAHEAD("frameLookAhead::run decoding %d failed", frameIdx);
+      nextFrameIdx = lastFrameIdx + 1;
+      continue;
+    }
+    if (frameIdx > playheadIdx)
+      queue.insert(frameIdx, image);
+  }
+}
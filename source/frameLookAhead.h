@@ -0,0 +1,92 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef FRAMELOOKAHEAD_H
+#define FRAMELOOKAHEAD_H
+
+#include <functional>
+#include <QImage>
+#include <QMap>
+#include <QMutex>
+#include <QThread>
+#include <QWaitCondition>
+
+/* Decode and convert the next frames of a playlist item in a background thread during playback.
+ * While playing, the item calls setPlayhead() for every frame that it loads. The thread then decodes the frames
+ * after the playhead (using the function that the item set) and keeps the converted frames in a small queue.
+ * Frames that fall behind the playhead are dropped. The item takes the frames from the queue when they are due, so
+ * that loading a frame during playback takes the average decoding time and not the time of the slowest frame.
+ * The thread is started by setPlayhead() and runs until stop() is called (e.g. if the user jumps to another frame).
+ */
+class frameLookAhead : public QThread
+{
+public:
+  frameLookAhead();
+  ~frameLookAhead();
+
+  // Decode and convert the given frame. This is called from the look ahead thread. Return false if it failed.
+  void setDecodeFunction(std::function<bool(int, QImage&)> decodeFunction) { decodeFrame = decodeFunction; }
+
+  // Playback is at the given frame. The frames after it (up to lastFrameIdx) are decoded ahead. The number of frames
+  // in the queue is limited by the memory that the images of bytesPerImage each need.
+  void setPlayhead(int frameIdx, int lastFrameIdx, qint64 bytesPerImage);
+  // Take the given frame from the queue. If the frame is being decoded right now, wait for it. Return false if it
+  // was not decoded.
+  bool takeFrame(int frameIdx, QImage &image);
+  // Drop all frames in the queue (and the one that is being decoded). Decoding continues after the playhead.
+  // Call this if the frames are not valid anymore (e.g. the conversion settings changed).
+  void clear();
+  // Stop the thread and drop all frames. If waitForThread is set, this waits until the frame that is being decoded is
+  // done. This is needed before the function that decodes the frames can not be used anymore.
+  void stop(bool waitForThread=true);
+
+protected:
+  virtual void run() Q_DECL_OVERRIDE;
+
+private:
+  std::function<bool(int, QImage&)> decodeFrame;
+
+  QMutex mutex;
+  QWaitCondition wakeUp;
+  QWaitCondition frameDecoded;
+  QMap<int, QImage> queue;
+  int playheadIdx;
+  int nextFrameIdx;   //< The next frame that the thread decodes
+  int decodingFrameIdx;  //< The frame that the thread is decoding right now (-1 if none)
+  int lastFrameIdx;
+  int maxNrFrames;
+  bool abort;
+  // Counted up by clear() and stop(). A frame that was being decoded while the counter changed is dropped.
+  int generation;
+};
+
+#endif // FRAMELOOKAHEAD_H
@@ -377,6 +377,12 @@ QByteArray hevcDecoderHM::loadYUVFrameData(int frameIdx)
         else
         {
           DEBUG_DECHM("hevcDecoderHM::loadYUVFrameData decoded the unrequested frame %d - POC %d", currentOutputBufferFrameIndex, libHMDEC_get_POC(pic));
+          if (isIntermediateFrameWanted(currentOutputBufferFrameIndex))
+          {
+            QByteArray intermediateFrame;
+            copyImgToByteArray(pic, intermediateFrame);
+            intermediateFrameDecoded(currentOutputBufferFrameIndex, intermediateFrame);
+          }
         }
 
         // Try to get another picture
@@ -419,9 +425,8 @@ void hevcDecoderHM::copyImgToByteArray(libHMDec_picture *src, QByteArray &dst)
   int nrBytesOutput = (outSizeY + outSizeCb + outSizeCr) * (outputTwoByte ? 2 : 1);
   DEBUG_DECHM("hevcDecoderHM::copyImgToByteArray nrBytesOutput %d", nrBytesOutput);
 
-  // Is the output big enough?
-  if (dst.capacity() < nrBytesOutput)
-    dst.resize(nrBytesOutput);
+  // Get an output buffer of the right size
+  prepareOutputBuffer(dst, nrBytesOutput);
 
   // The source (from HM) is always short (16bit). The destination is a QByteArray so
   // we have to cast it right.
@@ -475,6 +480,8 @@ void hevcDecoderHM::copyImgToByteArray(libHMDec_picture *src, QByteArray &dst)
       }
     }
   }
+
+  putOutputBuffer(dst);
 }
 
 void hevcDecoderHM::cacheStatistics(libHMDec_picture *img)
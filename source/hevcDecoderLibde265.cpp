@@ -35,6 +35,7 @@
 #include <cstring>
 #include <QCoreApplication>
 #include <QDir>
+#include <QMutex>
 #include <QSettings>
 #include "typedef.h"
 
@@ -53,6 +54,15 @@
 #define DEBUG_LIBDE265(fmt,...) ((void)0)
 #endif
 
+// libde265 does not start more worker threads than this
+#define LIBDE265_MAX_WORKER_THREADS 32
+// Seeking is faster the more worker threads the interactive decoder has. Give it at least this many (if the budget allows).
+#define LIBDE265_MIN_INTERACTIVE_WORKER_THREADS 8
+
+// The worker threads that are currently reserved by all libde265 decoders
+static QMutex workerThreadBudgetMutex;
+static int workerThreadsInUse = 0;
+
 hevcDecoderLibde265_Functions::hevcDecoderLibde265_Functions() { memset(this, 0, sizeof(*this)); }
 
 hevcDecoderLibde265::hevcDecoderLibde265(int signalID, bool cachingDecoder) :
@@ -66,6 +76,9 @@ hevcDecoderLibde265::hevcDecoderLibde265(int signalID, bool cachingDecoder) :
 
   decError = DE265_OK;
   decoder = nullptr;
+  nrWorkerThreads = 0;
+  currentOutputImage = nullptr;
+  currentOutputBufferFilled = false;
 
   // Set the signal to decode (if supported)
   if (signalID >= 0 && signalID <= 3)
@@ -86,13 +99,14 @@ hevcDecoderLibde265::hevcDecoderLibde265() :
 {
   decError = DE265_OK;
   decoder = nullptr;
+  nrWorkerThreads = 0;
+  currentOutputImage = nullptr;
+  currentOutputBufferFilled = false;
 }
 
 hevcDecoderLibde265::~hevcDecoderLibde265()
 {
-  if (decoder != nullptr)
-    // Free the decoder
-    de265_free_decoder(decoder);
+  freeDecoder();
 }
 
 bool hevcDecoderLibde265::openFile(QString fileName, decoderBase *otherDecoder)
@@ -148,8 +162,11 @@ void hevcDecoderLibde265::resolveLibraryFunctionPointers()
   if (!resolve(de265_decode, "de265_decode")) return;
   if (!resolve(de265_push_data, "de265_push_data")) return;
   if (!resolve(de265_flush_data, "de265_flush_data")) return;
-  if (!resolve(de265_get_next_picture, "de265_get_next_picture")) return;
+  if (!resolve(de265_peek_next_picture, "de265_peek_next_picture")) return;
+  if (!resolve(de265_release_next_picture, "de265_release_next_picture")) return;
   if (!resolve(de265_free_decoder, "de265_free_decoder")) return;
+  // Resetting the decoder is optional. Without it, the decoder is reallocated when seeking.
+  resolveInternals(de265_reset, "de265_reset");
   DEBUG_LIBDE265("hevcDecoderLibde265::loadDecoderLibrary - decoding functions found");
 
   // Get pointers to the internals/statistics functions (if present)
@@ -212,15 +229,7 @@ void hevcDecoderLibde265::allocateNewDecoder()
   de265_set_parameter_bool(decoder, DE265_DECODER_PARAM_DISABLE_SAO, false);
 
   // Set retrieval of the right component
-  if (nrSignalsSupported > 0)
-  {
-    if (decodeSignal == 1)
-      de265_internals_set_parameter_bool(decoder, DE265_INTERNALS_DECODER_PARAM_SAVE_PREDICTION, true);
-    else if (decodeSignal == 2)
-      de265_internals_set_parameter_bool(decoder, DE265_INTERNALS_DECODER_PARAM_SAVE_RESIDUAL, true);
-    else if (decodeSignal == 3)
-      de265_internals_set_parameter_bool(decoder, DE265_INTERNALS_DECODER_PARAM_SAVE_TR_COEFF, true);
-  }
+  setDecodeSignalParameters();
 
   // You could disable SSE acceleration ... not really recommended
   //de265_set_parameter_int(decoder, DE265_DECODER_PARAM_ACCELERATION_CODE, de265_acceleration_SCALAR);
@@ -230,34 +239,139 @@ void hevcDecoderLibde265::allocateNewDecoder()
   // Verbosity level (0...3(highest))
   de265_set_verbosity(0);
 
-  // Set the number of decoder threads. Libde265 can use wavefronts to utilize these.
-  decError = de265_start_worker_threads(decoder, 8);
+  // Set the number of decoder threads. Libde265 can use wavefronts to utilize these. Without worker threads,
+  // libde265 decodes in the calling thread.
+  nrWorkerThreads = reserveWorkerThreads();
+  if (nrWorkerThreads > 0)
+    decError = de265_start_worker_threads(decoder, nrWorkerThreads);
 
   // The highest temporal ID to decode. Set this to very high (all) by default.
   de265_set_limit_TID(decoder, 100);
 }
 
+void hevcDecoderLibde265::setDecodeSignalParameters()
+{
+  if (nrSignalsSupported <= 1)
+    return;
+
+  de265_internals_set_parameter_bool(decoder, DE265_INTERNALS_DECODER_PARAM_SAVE_PREDICTION, decodeSignal == 1);
+  de265_internals_set_parameter_bool(decoder, DE265_INTERNALS_DECODER_PARAM_SAVE_RESIDUAL, decodeSignal == 2);
+  de265_internals_set_parameter_bool(decoder, DE265_INTERNALS_DECODER_PARAM_SAVE_TR_COEFF, decodeSignal == 3);
+}
+
+bool hevcDecoderLibde265::freeDecoder()
+{
+  if (decoder == nullptr)
+    return true;
+
+  de265_error err = de265_free_decoder(decoder);
+  if (err != DE265_OK)
+  {
+    // Freeing the decoder failed.
+    if (decError != err)
+      decError = err;
+    return false;
+  }
+  decoder = nullptr;
+  currentOutputImage = nullptr;
+
+  QMutexLocker lock(&workerThreadBudgetMutex);
+  workerThreadsInUse -= nrWorkerThreads;
+  nrWorkerThreads = 0;
+  return true;
+}
+
+int hevcDecoderLibde265::reserveWorkerThreads()
+{
+  // By default, all decoders together use one thread per core
+  QSettings settings;
+  int budget = getOptimalThreadCount();
+  if (settings.value("Decoders/SetLibde265Threads", false).toBool())
+    budget = settings.value("Decoders/Libde265Threads", budget).toInt();
+
+  // The user waits for the interactive decoder, so it gets half of the budget. The rest is split between the
+  // caching decoders. There is one per caching thread, but not more than MAX_NR_CACHING_DECODERS. The caching
+  // threads already keep their cores busy, so a caching decoder may also decode without worker threads.
+  const int interactiveShare = qMax(budget / 2, qMin(budget, LIBDE265_MIN_INTERACTIVE_WORKER_THREADS));
+  int share;
+  if (isCachingDecoder)
+  {
+    int nrCachingDecoders = getOptimalThreadCount();
+    if (settings.value("VideoCache/SetNrThreads", false).toBool())
+      nrCachingDecoders = settings.value("VideoCache/NrThreads", nrCachingDecoders).toInt();
+    nrCachingDecoders = clip(nrCachingDecoders, 1, MAX_NR_CACHING_DECODERS);
+    share = clip((budget - interactiveShare) / nrCachingDecoders, 0, LIBDE265_MAX_WORKER_THREADS);
+  }
+  else
+    share = clip(interactiveShare, 1, LIBDE265_MAX_WORKER_THREADS);
+
+  // Don't take more than what is left of the budget (but the interactive decoder always gets a thread)
+  QMutexLocker lock(&workerThreadBudgetMutex);
+  int nrThreads = clip(budget - workerThreadsInUse, isCachingDecoder ? 0 : 1, share);
+  workerThreadsInUse += nrThreads;
+  DEBUG_LIBDE265("hevcDecoderLibde265::reserveWorkerThreads %d (share %d, in use %d of %d)", nrThreads, share, workerThreadsInUse, budget);
+  return nrThreads;
+}
+
 QByteArray hevcDecoderLibde265::loadYUVFrameData(int frameIdx)
 {
-  // At first check if the request is for the frame that has been requested in the
-  // last call to this function.
-  if (frameIdx == currentOutputBufferFrameIndex)
+  if (!decodeFrame(frameIdx))
+    return QByteArray();
+
+  // Copy the picture into the output buffer (only once per frame)
+  if (!currentOutputBufferFilled)
   {
-    assert(!currentOutputBuffer.isEmpty()); // Must not be empty or something is wrong
-    return currentOutputBuffer;
+    copyImgToByteArray(currentOutputImage, currentOutputBuffer);
+    currentOutputBufferFilled = true;
   }
+  return currentOutputBuffer;
+}
+
+bool hevcDecoderLibde265::loadYUVFramePlanes(int frameIdx, yuvPlanes &planes)
+{
+  if (!decodeFrame(frameIdx))
+    return false;
+
+  // The planes can only be used directly if the picture has the size and format of the frame
+  if (de265_get_chroma_format(currentOutputImage) == de265_chroma_mono)
+    return false;
+  if (de265_get_image_width(currentOutputImage, 0) != frameSize.width() || de265_get_image_height(currentOutputImage, 0) != frameSize.height())
+    return false;
+  for (int c = 0; c < 3; c++)
+  {
+    if ((de265_get_bits_per_pixel(currentOutputImage, c) > 8) != (nrBitsC0 > 8))
+      return false;
+    planes.plane[c] = getImagePlane(currentOutputImage, c, &planes.stride[c]);
+    if (planes.plane[c] == nullptr)
+      return false;
+  }
+  return true;
+}
+
+bool hevcDecoderLibde265::decodeFrame(int frameIdx)
+{
+  // At first check if the request is for the frame that has been requested in the
+  // last call to this function. The picture is still in the decoder.
+  if (frameIdx == currentOutputBufferFrameIndex && currentOutputImage != nullptr)
+    return true;
+
+  DEBUG_LIBDE265("hevcDecoderLibde265::decodeFrame Start request %d", frameIdx);
 
-  DEBUG_LIBDE265("hevcDecoderLibde265::loadYUVFrameData Start request %d", frameIdx);
+  // The last picture is not valid anymore once we continue decoding. Give it back to the decoder.
+  if (currentOutputImage != nullptr)
+    de265_release_next_picture(decoder);
+  currentOutputImage = nullptr;
+  currentOutputBufferFilled = false;
 
   // We have to decode the requested frame.
   bool seeked = false;
   QList<QByteArray> parameterSets;
-  if ((int)frameIdx < currentOutputBufferFrameIndex || currentOutputBufferFrameIndex == -1)
+  if ((int)frameIdx <= currentOutputBufferFrameIndex || currentOutputBufferFrameIndex == -1)
   {
     // The requested frame lies before the current one. We will have to rewind and start decoding from there.
     int seekFrameIdx = annexBFile->getClosestSeekableFrameNumber(frameIdx);
 
-    DEBUG_LIBDE265("hevcDecoderLibde265::loadYUVFrameData Seek to %d", seekFrameIdx);
+    DEBUG_LIBDE265("hevcDecoderLibde265::decodeFrame Seek to %d", seekFrameIdx);
     parameterSets = annexBFile->seekToFrameNumber(seekFrameIdx);
     currentOutputBufferFrameIndex = seekFrameIdx - 1;
     seeked = true;
@@ -270,7 +384,7 @@ QByteArray hevcDecoderLibde265::loadYUVFrameData(int frameIdx)
     if (seekFrameIdx > currentOutputBufferFrameIndex)
     {
       // Yes we can (and should) seek ahead in the file
-      DEBUG_LIBDE265("hevcDecoderLibde265::loadYUVFrameData Seek to %d", seekFrameIdx);
+      DEBUG_LIBDE265("hevcDecoderLibde265::decodeFrame Seek to %d", seekFrameIdx);
       parameterSets = annexBFile->seekToFrameNumber(seekFrameIdx);
       currentOutputBufferFrameIndex = seekFrameIdx - 1;
       seeked = true;
@@ -283,26 +397,28 @@ QByteArray hevcDecoderLibde265::loadYUVFrameData(int frameIdx)
     // Then start normal decoding
 
     if (parameterSets.size() == 0)
-      return QByteArray();
+      return false;
 
-    // Delete decoder
-    de265_error err = de265_free_decoder(decoder);
-    if (err != DE265_OK)
+    if (de265_reset != nullptr && decoder != nullptr)
     {
-      // Freeing the decoder failed.
-      if (decError != err)
-        decError = err;
-      return QByteArray();
+      // Reset the decoder. This keeps the decoder context and its parameters instead of allocating a new one.
+      de265_reset(decoder);
+      // The signal to decode may have changed
+      setDecodeSignalParameters();
     }
+    else
+    {
+      // Delete decoder
+      if (!freeDecoder())
+        return false;
 
-    decoder = nullptr;
-
-    // Create new decoder
-    allocateNewDecoder();
+      // Create new decoder
+      allocateNewDecoder();
+    }
 
     // Feed the parameter sets
     for (QByteArray ps : parameterSets)
-      err = de265_push_data(decoder, ps.data(), ps.size(), 0, nullptr);
+      de265_push_data(decoder, ps.data(), ps.size(), 0, nullptr);
   }
 
   // Perform the decoding right now blocking the main thread.
@@ -325,14 +441,14 @@ QByteArray hevcDecoderLibde265::loadYUVFrameData(int frameIdx)
         if (chunk.size() > 0)
         {
           err = de265_push_data(decoder, chunk.data(), chunk.size(), 0, nullptr);
-          DEBUG_LIBDE265("hevcDecoderLibde265::loadYUVFrameData push data %d bytes - err %s", chunk.size(), de265_get_error_text(err));
+          DEBUG_LIBDE265("hevcDecoderLibde265::decodeFrame push data %d bytes - err %s", chunk.size(), de265_get_error_text(err));
           if (err != DE265_OK && err != DE265_ERROR_WAITING_FOR_INPUT_DATA)
           {
             // An error occurred
             if (decError != err)
               decError = err;
-            DEBUG_LIBDE265("hevcDecoderLibde265::loadYUVFrameData Error %s", de265_get_error_text(err));
-            return QByteArray();
+            DEBUG_LIBDE265("hevcDecoderLibde265::decodeFrame Error %s", de265_get_error_text(err));
+            return false;
           }
         }
 
@@ -346,22 +462,23 @@ QByteArray hevcDecoderLibde265::loadYUVFrameData(int frameIdx)
         // The decoder wants more data but there is no more file.
         // We found the end of the sequence. Get the remaining frames from the decoder until
         // more is 0.
-        DEBUG_LIBDE265("hevcDecoderLibde265::loadYUVFrameData Waiting for input bit file at end.");
+        DEBUG_LIBDE265("hevcDecoderLibde265::decodeFrame Waiting for input bit file at end.");
       }
       else if (err != DE265_OK)
       {
         // Something went wrong
         more = 0;
-        DEBUG_LIBDE265("hevcDecoderLibde265::loadYUVFrameData Error %s", de265_get_error_text(err));
+        DEBUG_LIBDE265("hevcDecoderLibde265::decodeFrame Error %s", de265_get_error_text(err));
         break;
       }
 
-      const de265_image* img = de265_get_next_picture(decoder);
+      // Only peek at the picture. It is released when we are done with it.
+      const de265_image* img = de265_peek_next_picture(decoder);
       if (img)
       {
         // We have received an output image
         currentOutputBufferFrameIndex++;
-        DEBUG_LIBDE265("hevcDecoderLibde265::loadYUVFrameData Picture decoded %d", currentOutputBufferFrameIndex);
+        DEBUG_LIBDE265("hevcDecoderLibde265::decodeFrame Picture decoded %d", currentOutputBufferFrameIndex);
 
         // Check if the chroma format and the frame size matches the already set values (these were read from the annex B file).
         de265_chroma fmt = de265_get_chroma_format(img);
@@ -369,20 +486,19 @@ QByteArray hevcDecoderLibde265::loadYUVFrameData(int frameIdx)
             (fmt == de265_chroma_420 && pixelFormat != YUV_420) ||
             (fmt == de265_chroma_422 && pixelFormat != YUV_422) ||
             (fmt == de265_chroma_444 && pixelFormat != YUV_444))
-          DEBUG_LIBDE265("hevcNextGenDecoderJEM::loadYUVFrameData recieved frame has different chroma format. Set: %d Pic: %d", pixelFormat, fmt);
+          DEBUG_LIBDE265("hevcDecoderLibde265::decodeFrame recieved frame has different chroma format. Set: %d Pic: %d", pixelFormat, fmt);
         int bits = de265_get_bits_per_pixel(img, 0);
         if (bits != nrBitsC0)
-          DEBUG_LIBDE265("hevcNextGenDecoderJEM::loadYUVFrameData recieved frame has different bit depth. Set: %d Pic: %d", nrBitsC0, bits);
+          DEBUG_LIBDE265("hevcDecoderLibde265::decodeFrame recieved frame has different bit depth. Set: %d Pic: %d", nrBitsC0, bits);
         QSize picSize = QSize(de265_get_image_width(img, 0), de265_get_image_height(img, 0));
         if (picSize != frameSize)
-          DEBUG_LIBDE265("hevcNextGenDecoderJEM::loadYUVFrameData recieved frame has different size. Set: %dx%d Pic: %dx%d", frameSize.width(), frameSize.height(), picSize.width(), picSize.height());
+          DEBUG_LIBDE265("hevcDecoderLibde265::decodeFrame recieved frame has different size. Set: %dx%d Pic: %dx%d", frameSize.width(), frameSize.height(), picSize.width(), picSize.height());
 
         if (currentOutputBufferFrameIndex == frameIdx)
         {
-          // This is the frame that we want to decode
-            
-          // Put image data into buffer
-          copyImgToByteArray(img, currentOutputBuffer);
+          // This is the frame that we want to decode. It is copied from the decoder when it is requested. Until then
+          // (or until its planes are converted), it is kept in the output queue of the decoder.
+          currentOutputImage = img;
 
           if (retrieveStatistics)
           {
@@ -394,10 +510,18 @@ QByteArray hevcDecoderLibde265::loadYUVFrameData(int frameIdx)
           }
 
           // Picture decoded
-          DEBUG_LIBDE265("hevcDecoderLibde265::loadYUVFrameData decoded the requested frame %d", currentOutputBufferFrameIndex);
+          DEBUG_LIBDE265("hevcDecoderLibde265::decodeFrame decoded the requested frame %d", currentOutputBufferFrameIndex);
             
-          return currentOutputBuffer;
+          return true;
+        }
+        else if (isIntermediateFrameWanted(currentOutputBufferFrameIndex))
+        {
+          // Hand the frame that we decoded on the way to the requested one to the intermediate frame handler
+          QByteArray intermediateFrame;
+          copyImgToByteArray(img, intermediateFrame);
+          intermediateFrameDecoded(currentOutputBufferFrameIndex, intermediateFrame);
         }
+        de265_release_next_picture(decoder);
       }
     }
 
@@ -407,8 +531,8 @@ QByteArray hevcDecoderLibde265::loadYUVFrameData(int frameIdx)
       if (decError != err)
         decError = err;
 
-      DEBUG_LIBDE265("hevcDecoderLibde265::loadYUVFrameData Error %s", de265_get_error_text(err));
-      return QByteArray();
+      DEBUG_LIBDE265("hevcDecoderLibde265::decodeFrame Error %s", de265_get_error_text(err));
+      return false;
     }
     if (more == 0)
     {
@@ -416,13 +540,27 @@ QByteArray hevcDecoderLibde265::loadYUVFrameData(int frameIdx)
       // We are at the end of the sequence.
 
       // This should not happen because before decoding, we check if the frame to decode is in the list of nal units that will be decoded.
-      DEBUG_LIBDE265("hevcDecoderLibde265::loadYUVFrameData more == 0");
+      DEBUG_LIBDE265("hevcDecoderLibde265::decodeFrame more == 0");
 
-      return QByteArray();
+      return false;
     }
   }
   
-  return QByteArray();
+  return false;
+}
+
+const uint8_t *hevcDecoderLibde265::getImagePlane(const de265_image *src, int component, int *stride) const
+{
+  // Get the plane of the signal that is displayed
+  if (decodeSignal == 0 || nrSignalsSupported == 1)
+    return de265_get_image_plane(src, component, stride);
+  if (decodeSignal == 1)
+    return de265_internals_get_image_plane(src, DE265_INTERNALS_DECODER_PARAM_SAVE_PREDICTION, component, stride);
+  if (decodeSignal == 2)
+    return de265_internals_get_image_plane(src, DE265_INTERNALS_DECODER_PARAM_SAVE_RESIDUAL, component, stride);
+  if (decodeSignal == 3)
+    return de265_internals_get_image_plane(src, DE265_INTERNALS_DECODER_PARAM_SAVE_TR_COEFF, component, stride);
+  return nullptr;
 }
 
 #if SSE_CONVERSION
@@ -449,24 +587,14 @@ void hevcDecoderLibde265::copyImgToByteArray(const de265_image *src, QByteArray
 
   DEBUG_LIBDE265("hevcDecoderLibde265::copyImgToByteArray nrBytes %d", nrBytes);
 
-  // Is the output big enough?
-  if (dst.capacity() < nrBytes)
-    dst.resize(nrBytes);
+  // Get an output buffer of the right size
+  prepareOutputBuffer(dst, nrBytes);
 
   // We can now copy from src to dst
   char* dst_c = dst.data();
   for (int c = 0; c < nrPlanes; c++)
   {
-    const uint8_t* img_c = nullptr;
-    if (decodeSignal == 0 || nrSignalsSupported == 1)
-      img_c = de265_get_image_plane(src, c, &stride);
-    else if (decodeSignal == 1)
-      img_c = de265_internals_get_image_plane(src, DE265_INTERNALS_DECODER_PARAM_SAVE_PREDICTION, c, &stride);
-    else if (decodeSignal == 2)
-      img_c = de265_internals_get_image_plane(src, DE265_INTERNALS_DECODER_PARAM_SAVE_RESIDUAL, c, &stride);
-    else if (decodeSignal == 3)
-      img_c = de265_internals_get_image_plane(src, DE265_INTERNALS_DECODER_PARAM_SAVE_TR_COEFF, c, &stride);
-    
+    const uint8_t* img_c = getImagePlane(src, c, &stride);
     if (img_c == nullptr)
       return;
 
@@ -482,6 +610,8 @@ void hevcDecoderLibde265::copyImgToByteArray(const de265_image *src, QByteArray
       dst_c += size;
     }
   }
+
+  putOutputBuffer(dst);
 }
 
 void hevcDecoderLibde265::cacheStatistics(const de265_image *img)
@@ -791,7 +921,7 @@ statisticsData hevcDecoderLibde265::getStatisticsData(int frameIdx, int typeIdx)
       // This can be done like this:
       currentOutputBufferFrameIndex++;
 
-    loadYUVFrameData(frameIdx);
+    decodeFrame(frameIdx);
   }
 
   return curPOCStats[typeIdx];
@@ -64,8 +64,10 @@ struct hevcDecoderLibde265_Functions
   de265_error            (*de265_decode)               (de265_decoder_context*, int*);
   de265_error            (*de265_push_data)            (de265_decoder_context*, const void*, int, de265_PTS, void*);
   de265_error            (*de265_flush_data)           (de265_decoder_context*);
-  const de265_image*     (*de265_get_next_picture)     (de265_decoder_context*);
+  const de265_image*     (*de265_peek_next_picture)    (de265_decoder_context*);
+  void                   (*de265_release_next_picture) (de265_decoder_context*);
   de265_error            (*de265_free_decoder)         (de265_decoder_context*);
+  void                   (*de265_reset)                (de265_decoder_context*);
 
   // libde265 decoder library function pointers for internals
   void (*de265_internals_get_CTB_Info_Layout)		   (const de265_image*, int*, int*, int*);
@@ -101,6 +103,7 @@ public:
 
   // Load the raw YUV data for the given frame
   QByteArray loadYUVFrameData(int frameIdx) Q_DECL_OVERRIDE;
+  bool loadYUVFramePlanes(int frameIdx, yuvPlanes &planes) Q_DECL_OVERRIDE;
 
   // Get the statistics values for the given frame (decode if necessary)
   statisticsData getStatisticsData(int frameIdx, int typeIdx) Q_DECL_OVERRIDE;
@@ -134,6 +137,13 @@ private:
   template <typename T> T resolveInternals(T &ptr, const char *symbol);
 
   void allocateNewDecoder();
+  bool freeDecoder();  // Return false if freeing the decoder failed
+  void setDecodeSignalParameters();
+
+  // All libde265 decoders (the interactive and the caching decoders of all open files) share one budget of worker
+  // threads. Each decoder reserves its share when it is allocated and returns it when it is freed.
+  int reserveWorkerThreads();
+  int nrWorkerThreads;
   
   // Was there an error? If everything is OK it will be DE265_OK.
   de265_error decError;
@@ -148,6 +158,15 @@ private:
   void getPBSubPosition(int partMode, int CUSizePix, int pbIdx, int *pbX, int *pbY, int *pbW, int *pbH) const;
   void cacheStatistics_TUTree_recursive(uint8_t *const tuInfo, int tuInfoWidth, int tuUnitSizePix, int iPOC, int tuIdx, int tuWidth_units, int trDepth, bool isIntra, uint8_t *const intraDirY, uint8_t *const intraDirC, int intraDir_infoUnit_size, int widthInIntraDirUnits);
 
+  // Decode the given frame. After this, currentOutputImage is the picture of the frame. It stays in the output queue
+  // of the decoder (so that libde265 can not reuse its buffer) until the decoder is used again.
+  bool decodeFrame(int frameIdx);
+  const de265_image *currentOutputImage;
+  bool currentOutputBufferFilled;  //< Was currentOutputImage copied to currentOutputBuffer?
+
+  // Get the plane of the signal that is displayed (reconstruction, prediction, residual or transform coefficients)
+  const uint8_t *getImagePlane(const de265_image *src, int component, int *stride) const;
+
 #if SSE_CONVERSION
   byteArrayAligned currentOutputBuffer;
   void copyImgToByteArray(const de265_image *src, byteArrayAligned &dst);
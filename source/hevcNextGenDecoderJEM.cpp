@@ -422,6 +422,12 @@ QByteArray hevcNextGenDecoderJEM::loadYUVFrameData(int frameIdx)
         else
         {
           DEBUG_DECJEM("hevcNextGenDecoderJEM::loadYUVFrameData decoded the unrequested frame %d - POC %d", currentOutputBufferFrameIndex, libJEMDEC_get_POC(pic));
+          if (isIntermediateFrameWanted(currentOutputBufferFrameIndex))
+          {
+            QByteArray intermediateFrame;
+            copyImgToByteArray(pic, intermediateFrame);
+            intermediateFrameDecoded(currentOutputBufferFrameIndex, intermediateFrame);
+          }
         }
 
         // Try to get another picture
@@ -464,9 +470,8 @@ void hevcNextGenDecoderJEM::copyImgToByteArray(libJEMDec_picture *src, QByteArra
   int nrBytesOutput = (outSizeY + outSizeCb + outSizeCr) * (outputTwoByte ? 2 : 1);
   DEBUG_DECJEM("hevcNextGenDecoderJEM::copyImgToByteArray nrBytesOutput %d", nrBytesOutput);
 
-  // Is the output big enough?
-  if (dst.capacity() < nrBytesOutput)
-    dst.resize(nrBytesOutput);
+  // Get an output buffer of the right size
+  prepareOutputBuffer(dst, nrBytesOutput);
 
   // The source (from HM) is always short (16bit). The destination is a QByteArray so
   // we have to cast it right.
@@ -520,6 +525,8 @@ void hevcNextGenDecoderJEM::copyImgToByteArray(libJEMDec_picture *src, QByteArra
       }
     }
   }
+
+  putOutputBuffer(dst);
 }
 
 void hevcNextGenDecoderJEM::cacheStatistics(libJEMDec_picture *img)
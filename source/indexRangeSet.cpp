@@ -0,0 +1,137 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "indexRangeSet.h"
+
+#include <algorithm>
+
+indexRangeSet::indexRangeSet(const QList<indexRange> &rangeList) : nrIndices(0)
+{
+  for (const indexRange &r : rangeList)
+    insert(r);
+}
+
+void indexRangeSet::insert(indexRange range)
+{
+  if (range.first > range.second)
+    return;
+
+  // Merge all ranges that overlap or touch the new range into the new range
+  auto it = ranges.upperBound(range.second + 1);
+  while (it != ranges.begin())
+  {
+    --it;
+    if (it.value() < range.first - 1)
+      break;
+    range.first = std::min(range.first, it.key());
+    range.second = std::max(range.second, it.value());
+    nrIndices -= it.value() - it.key() + 1;
+    it = ranges.erase(it);
+  }
+
+  ranges.insert(range.first, range.second);
+  nrIndices += range.second - range.first + 1;
+}
+
+void indexRangeSet::remove(int idx)
+{
+  auto it = ranges.upperBound(idx);
+  if (it == ranges.begin())
+    return;
+  --it;
+  const int start = it.key();
+  const int end = it.value();
+  if (idx > end)
+    return;
+
+  // Split the range
+  ranges.erase(it);
+  if (start < idx)
+    ranges.insert(start, idx - 1);
+  if (idx < end)
+    ranges.insert(idx + 1, end);
+  nrIndices--;
+}
+
+bool indexRangeSet::contains(int idx) const
+{
+  auto it = ranges.upperBound(idx);
+  if (it == ranges.begin())
+    return false;
+  --it;
+  return idx <= it.value();
+}
+
+QList<indexRange> indexRangeSet::getRanges() const
+{
+  QList<indexRange> rangeList;
+  for (auto it = ranges.begin(); it != ranges.end(); ++it)
+    rangeList.append(indexRange(it.key(), it.value()));
+  return rangeList;
+}
+
+QList<indexRange> indexRangeSet::getRanges(indexRange limit) const
+{
+  QList<indexRange> rangeList;
+  if (limit.first > limit.second)
+    return rangeList;
+
+  // Start with the range that contains limit.first (if there is one)
+  auto it = ranges.upperBound(limit.first);
+  if (it != ranges.begin())
+    --it;
+  for (; it != ranges.end() && it.key() <= limit.second; ++it)
+  {
+    const indexRange r(std::max(it.key(), limit.first), std::min(it.value(), limit.second));
+    if (r.first <= r.second)
+      rangeList.append(r);
+  }
+  return rangeList;
+}
+
+QList<indexRange> indexRangeSet::getMissingRanges(indexRange limit) const
+{
+  QList<indexRange> missing;
+  if (limit.first > limit.second)
+    return missing;
+
+  int pos = limit.first;
+  for (const indexRange &r : getRanges(limit))
+  {
+    if (r.first > pos)
+      missing.append(indexRange(pos, r.first - 1));
+    pos = r.second + 1;
+  }
+  if (pos <= limit.second)
+    missing.append(indexRange(pos, limit.second));
+  return missing;
+}
@@ -0,0 +1,76 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef INDEXRANGESET_H
+#define INDEXRANGESET_H
+
+#include <QList>
+#include <QMap>
+#include "typedef.h"
+
+/* A set of indices (e.g. frame indices) which is stored as a list of disjoint ranges.
+ * This is much more compact than a list of all indices if the indices are mostly consecutive (like the
+ * frames in the cache). All operations work on the ranges so their cost depends on the number of ranges
+ * and not on the number of indices in the set.
+ */
+class indexRangeSet
+{
+public:
+  indexRangeSet() : nrIndices(0) {}
+  explicit indexRangeSet(const QList<indexRange> &rangeList);
+
+  void insert(int idx) { insert(indexRange(idx, idx)); }
+  void insert(indexRange range);
+  void remove(int idx);
+  void clear() { ranges.clear(); nrIndices = 0; }
+
+  bool contains(int idx) const;
+  int count() const { return nrIndices; }
+  bool isEmpty() const { return nrIndices == 0; }
+  // The first and last index in the set. Only valid if the set is not empty.
+  int first() const { return ranges.firstKey(); }
+  int last() const { return ranges.last(); }
+
+  // Get all ranges (sorted)
+  QList<indexRange> getRanges() const;
+  // Get all ranges within the given range (the ranges are clipped to the given range)
+  QList<indexRange> getRanges(indexRange limit) const;
+  // Get the ranges within the given range that are not in the set
+  QList<indexRange> getMissingRanges(indexRange limit) const;
+
+private:
+  // The ranges (start -> end). The ranges do not overlap and do not touch.
+  QMap<int, int> ranges;
+  int nrIndices;
+};
+
+#endif // INDEXRANGESET_H
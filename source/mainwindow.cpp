@@ -42,6 +42,7 @@
 #include <QShortcut>
 #include "playlistItems.h"
 #include "settingsDialog.h"
+#include "videoHandlerYUVSIMD.h"
 
 MainWindow::MainWindow(bool useAlternativeSources, QWidget *parent) : QMainWindow(parent)
 {
@@ -756,6 +757,13 @@ void MainWindow::performanceTest()
       info.append(QString("pixmapImageFormat %1\n").arg(pixelFormatToString(pixmapImageFormat())));
       info.append(QString("getOptimalThreadCount %1\n").arg(getOptimalThreadCount()));
       info.append(QString("systemMemorySizeInMB %1\n").arg(systemMemorySizeInMB()));
+      info.append(QString("YUV conversion instruction set %1\n").arg(YUV_SIMD::getInstructionSetName(YUV_SIMD::getSupportedInstructionSet())));
+      YUV_SIMD::InstructionSet failedSet;
+      YUV_SIMD::conversionParameters failedPar;
+      if (YUV_SIMD::testKernels(failedSet, failedPar))
+        info.append("YUV conversion kernel test OK\n");
+      else
+        info.append(QString("YUV conversion kernel test FAILED (%1, %2 bit, subsampling %3x%4, chroma offset %5/8, width %6)\n").arg(YUV_SIMD::getInstructionSetName(failedSet)).arg(failedPar.bitsPerSample).arg(failedPar.subsamplingHor).arg(failedPar.subsamplingVer).arg(failedPar.chromaOffsetY8).arg(failedPar.width));
 
       QMessageBox::information(this, "Internal Info", info);
     }
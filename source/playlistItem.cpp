@@ -31,6 +31,8 @@
 */
 
 #include "playlistItem.h"
+
+#include <algorithm>
 #include <QPainter>
 
 unsigned int playlistItem::idCounter = 0;
@@ -41,6 +43,7 @@ playlistItem::playlistItem(const QString &itemNameOrFileName, playlistItemType t
   setType(type);
   cachingEnabled = false;
   itemTaggedForDeletion = false;
+  lastFrameLoadDurationMs = -1;
 
   // Whenever a playlistItem is created, we give it an ID (which is unique for this instance of YUView)
   id = idCounter++;
@@ -74,6 +77,22 @@ indexRange playlistItem::getFrameIdxRange() const
   return indexRange(0, startEndFrame.second - startEndFrame.first);
 }
 
+QList<indexRange> playlistItem::getCachedFrameRanges() const
+{
+  QList<int> cachedFrames = getCachedFrames();
+  std::sort(cachedFrames.begin(), cachedFrames.end());
+
+  QList<indexRange> ranges;
+  for (int f : cachedFrames)
+  {
+    if (!ranges.isEmpty() && ranges.last().second + 1 >= f)
+      ranges.last().second = std::max(ranges.last().second, f);
+    else
+      ranges.append(indexRange(f, f));
+  }
+  return ranges;
+}
+
 void playlistItem::drawItem(QPainter *painter, int frameIdx, double zoomFactor, bool drawRawValues)
 {
   Q_UNUSED(frameIdx);
@@ -163,8 +182,10 @@ void playlistItem::setStartEndFrame(indexRange range, bool emitSignal)
 {
   // Set the new start/end frame (clip if first)
   indexRange startEndFrameLimit = getStartEndFrameLimits();
+  startEndFrameMutex.lock();
   startEndFrame.first = std::max(startEndFrameLimit.first, range.first);
   startEndFrame.second = std::min(startEndFrameLimit.second, range.second);
+  startEndFrameMutex.unlock();
 
   if (!ui.created())
     // spin boxes not created yet
@@ -197,8 +218,10 @@ void playlistItem::slotVideoControlChanged()
       recache = RECACHE_UPDATE;
 
     // Get the currently set values from the controls
+    startEndFrameMutex.lock();
     startEndFrame.first  = ui.startSpinBox->value();
     startEndFrame.second = ui.endSpinBox->value();
+    startEndFrameMutex.unlock();
     frameRate = ui.rateSpinBox->value();
     sampling  = ui.samplingSpinBox->value();
 
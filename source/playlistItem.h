@@ -34,6 +34,7 @@
 #define PLAYLISTITEM_H
 
 #include <QDir>
+#include <QMutex>
 #include <QTreeWidgetItem>
 #include "fileInfoWidget.h"
 #include "typedef.h"
@@ -141,6 +142,9 @@ public:
   // Only emit signals (loading complete) if emitSignals is set. If this item is used in a container (like an overlay), the overlay
   // will emit the appropriate signals.
   virtual void loadFrame(int frameIdx, bool playback, bool loadRawData, bool emitSignals=true) { Q_UNUSED(frameIdx); Q_UNUSED(playback); Q_UNUSED(loadRawData); Q_UNUSED(emitSignals); }
+  // How long (in ms) did the last loadFrame() call take to load the requested frame? Loading the double buffer is not
+  // included. This is -1 if the frame was not loaded from the source (e.g. because it was already decoded ahead).
+  double getLastFrameLoadDuration() const { return lastFrameLoadDurationMs; }
   
   // Return the source values under the given pixel position.
   // For example a YUV source will provide Y,U and V values. An RGB source might provide RGB values,
@@ -175,6 +179,10 @@ public:
   virtual bool taggedForDeletion() const { return itemTaggedForDeletion; }
   // Is there a limit on the number of threads that can cache from this item at the same time? (-1 = no limit)
   virtual int cachingThreadLimit() { return -1; }
+  // If the frames of the item have to be decoded in order (e.g. coded video), return the frames from which decoding can
+  // be started (random access points). If multiple threads cache the item, each thread is given a different segment
+  // between two of these points. The default is an empty list (every frame can be loaded independently).
+  virtual QList<int> getRandomAccessPoints() const { return QList<int>(); }
   // Tag the item as "to be deleted"
   void tagItemForDeletion() { itemTaggedForDeletion = true; }
   // Cache the given frame. This function is thread save. So multiple instances of this function can run at the same time.
@@ -182,9 +190,14 @@ public:
   virtual void cacheFrame(int idx, bool testMode) { Q_UNUSED(idx); Q_UNUSED(testMode); }
   // Get a list of all cached frames (just the frame indices)
   virtual QList<int> getCachedFrames() const { return QList<int>(); }
+  // Get the cached frames as a sorted list of ranges. Reimplement this if the item can do this faster than
+  // by sorting the list of cached frames.
+  virtual QList<indexRange> getCachedFrameRanges() const;
   virtual int getNumberCachedFrames() const { return 0; }
   // How many bytes will caching one frame use (in bytes)?
   virtual unsigned int getCachingFrameSize() const { return 0; }
+  // Does the item cache the raw frame data (which is converted when drawn) instead of the converted images?
+  virtual bool isCachingRawData() const { return false; }
   // Remove the frame with the given index from the cache.
   virtual void removeFrameFromCache(int idx) { Q_UNUSED(idx); }
   virtual void removeAllFramesFromCache() {};
@@ -212,6 +225,8 @@ public:
   // Using the set start frame, get the index within the item.
   int getFrameIdxInternal(int frameIdx) const { return frameIdx + startEndFrame.first; }
   int getFrameIdxExternal(int frameIdxInternal) const { return frameIdxInternal - startEndFrame.first; }
+  // Get the start/end frame. Use this if the value is needed in a thread other than the main thread.
+  indexRange getStartEndFrame() const { QMutexLocker lock(&startEndFrameMutex); return startEndFrame; }
   
 signals:
   // Something in the item changed. If redraw is set, a redraw of the item is necessary.
@@ -248,6 +263,9 @@ protected:
   // before we can actually delete it. An item that is tagged for deletion should not be cached/loaded anymore.
   bool itemTaggedForDeletion;
 
+  // Set this in loadFrame() (see getLastFrameLoadDuration())
+  double lastFrameLoadDurationMs;
+
   // When saving the playlist, append the properties of the playlist item (the id)
   void appendPropertiesToPlaylist(QDomElementYUView &d) const;
   // Load the properties (the playlist ID)
@@ -261,6 +279,8 @@ protected:
   double      frameRate;
   int         sampling;
   indexRange  startEndFrame;
+  // Locked when startEndFrame is changed after the item was created (see getStartEndFrame())
+  mutable QMutex startEndFrameMutex;
 
   // ------ playlistItem_Static
   double duration;    // The duration that this item is shown for
@@ -32,6 +32,7 @@
 
 #include "playlistItemDifference.h"
 
+#include <QElapsedTimer>
 #include <QPainter>
 
 // Activate this if you want to know when which difference is loaded
@@ -216,6 +217,7 @@ void playlistItemDifference::loadFrame(int frameIdx, bool playing, bool loadRawD
   const int frameIdxInternal = getFrameIdxInternal(frameIdx);
   
   auto state = difference.needsLoading(frameIdxInternal, loadRawData);
+  lastFrameLoadDurationMs = -1;
   if (state == LoadingNeeded)
   {
     // Load the requested current frame
@@ -224,7 +226,10 @@ void playlistItemDifference::loadFrame(int frameIdx, bool playing, bool loadRawD
     // Since every playlist item can have it's own relative indexing, we need two frame indices
     int idx0 = getChildPlaylistItem(0)->getFrameIdxInternal(frameIdxInternal);
     int idx1 = getChildPlaylistItem(1)->getFrameIdxInternal(frameIdxInternal);
+    QElapsedTimer loadTimer;
+    loadTimer.start();
     difference.loadFrameDifference(frameIdxInternal, idx0, idx1);
+    lastFrameLoadDurationMs = loadTimer.nsecsElapsed() / 1000000.0;
     isDifferenceLoading = false;
     if (emitSignals)
       emit signalItemChanged(true, RECACHE_NONE);
@@ -32,10 +32,13 @@
 
 #include "playlistItemFFmpegFile.h"
 
+#include <algorithm>
 #include <QDebug>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QUrl>
 #include <QPainter>
+#include <QSettings>
 
 #include "fileSource.h"
 
@@ -47,6 +50,9 @@
 #define DEBUG_FFMPEG(fmt,...) ((void)0)
 #endif
 
+// Every caching decoder needs memory for its own decoder context and picture buffers. Do not allocate more than this.
+#define MAX_NR_CACHING_DECODERS 8
+
 playlistItemFFmpegFile::playlistItemFFmpegFile(const QString &ffmpegFilePath)
   : playlistItemWithVideo(ffmpegFilePath, playlistItem_Indexed)
 {
@@ -56,12 +62,22 @@ playlistItemFFmpegFile::playlistItemFFmpegFile(const QString &ffmpegFilePath)
 
   // So far, there was no error
   decoderReady = true;
+  nrCachingDecoders = 1;
+  nrFramesScanned = 0;
+  intermediateFramesCached = false;
+  lookAhead.setDecodeFunction([this](int idx, QImage &image) { return decodeLookAheadFrame(idx, image); });
 
   // Set the video pointer correctly
   video.reset(new videoHandlerYUV());
+  // Decoding a frame again is expensive. Keep frames that are removed from the cache in the spill file.
+  video->setSpillEvictedFrames(true);
 
   // Connect the basic signals from the video
   playlistItemWithVideo::connectVideo();
+  // The frames that were decoded ahead were converted with the old settings
+  connect(video.data(), &videoHandler::signalHandlerChanged, this, [this]{ lookAhead.clear(); });
+
+  loadingDecoder.setFrameBufferPool(&bufferPool);
 
   // Open the file
   if (!loadingDecoder.openFile(ffmpegFilePath))
@@ -72,13 +88,12 @@ playlistItemFFmpegFile::playlistItemFFmpegFile(const QString &ffmpegFilePath)
     return;
   }
 
-  if (!cachingDecoder.openFile(ffmpegFilePath, &loadingDecoder))
-  {
-    // Opening the input file failed.
-    DEBUG_FFMPEG("Opening the input file with the caching decoder failed.");
-    decoderReady = false;
-    return;
-  }
+  loadingDecoder.setIntermediateFrameHandler([this](int idx) { return wantIntermediateFrame(idx); },
+                                             [this](int idx, const QByteArray &data) { cacheIntermediateFrame(idx, data); });
+
+  // Each caching decoder can start decoding at one of the key frames
+  keyFrames = loadingDecoder.getKeyFrameNumbers();
+  updateNrCachingDecoders();
 
   // Fill the list of statistics that we can provide
   fillStatisticList();
@@ -88,6 +103,9 @@ playlistItemFFmpegFile::playlistItemFFmpegFile(const QString &ffmpegFilePath)
 
   // Set the frame number limits and frame rate
   startEndFrame = getStartEndFrameLimits();
+  nrFramesScanned = loadingDecoder.getNumberPOCs();
+  if (loadingDecoder.isBackgroundScanRunning())
+    timer.start(1000, this);
   frameRate = loadingDecoder.getFrameRate();
   yuvVideo->setFrameSize(loadingDecoder.getFrameSize());
   statSource.statFrameSize = loadingDecoder.getFrameSize();
@@ -206,6 +224,8 @@ infoData playlistItemFFmpegFile::getInfo() const
     QSize videoSize = video->getFrameSize();
     info.items.append(infoItem("Resolution", QString("%1x%2").arg(videoSize.width()).arg(videoSize.height()), "The video resolution in pixel (width x height)"));
     info.items.append(infoItem("Num Frames", QString::number(loadingDecoder.getNumberPOCs()), "The number of pictures in the stream."));
+    if (loadingDecoder.isBackgroundScanRunning())
+      info.items.append(infoItem("Parsing:", QString("%1%...").arg(loadingDecoder.getBackgroundScanProgress())));
     info.items.append(loadingDecoder.getDecoderInfo());
     if (loadingDecoder.canShowNALInfo())
       info.items.append(infoItem("NAL units", "Show NAL units", "Show a detailed list of all NAL units.", true));
@@ -249,7 +269,7 @@ void playlistItemFFmpegFile::loadYUVData(int frameIdxInternal, bool caching)
 
   DEBUG_FFMPEG("playlistItemFFmpegFile::loadYUVData %d %s", frameIdxInternal, caching ? "caching" : "");
 
-  if (frameIdxInternal > startEndFrame.second || frameIdxInternal < 0)
+  if (frameIdxInternal > getStartEndFrame().second || frameIdxInternal < 0)
   {
     DEBUG_FFMPEG("playlistItemFFmpegFile::loadYUVData Invalid frame index");
     return;
@@ -259,10 +279,25 @@ void playlistItemFFmpegFile::loadYUVData(int frameIdxInternal, bool caching)
   QByteArray decByteArray;
 
   if (caching)
-    decByteArray = cachingDecoder.loadYUVFrameData(frameIdxInternal);
+  {
+    FFmpegDecoder *cachingDecoder = acquireCachingDecoder(frameIdxInternal);
+    if (cachingDecoder == nullptr)
+      return;
+    decByteArray = cachingDecoder->loadYUVFrameData(frameIdxInternal);
+    releaseCachingDecoder(cachingDecoder, decByteArray.isEmpty() ? -1 : frameIdxInternal);
+  }
   else
+  {
     decByteArray = loadingDecoder.loadYUVFrameData(frameIdxInternal);
 
+    // Let the video cache know about the frames that were cached on the way
+    if (intermediateFramesCached)
+    {
+      intermediateFramesCached = false;
+      emit signalItemChanged(false, RECACHE_UPDATE);
+    }
+  }
+
   if (!decByteArray.isEmpty())
   {
     videoHandlerYUV *yuvVideo = dynamic_cast<videoHandlerYUV*>(video.data());
@@ -271,6 +306,25 @@ void playlistItemFFmpegFile::loadYUVData(int frameIdxInternal, bool caching)
   }
 }
 
+bool playlistItemFFmpegFile::wantIntermediateFrame(int frameIdxInternal)
+{
+  const indexRange range = getStartEndFrame();
+  if (!cachingEnabled || frameIdxInternal < range.first || frameIdxInternal > range.second)
+    return false;
+  if (!video->needsCaching(frameIdxInternal, false))
+    return false;
+  // Don't push other frames out of the cache. Only use the space that the video cache has not used yet.
+  return videoHandler::reserveFreeCacheSpace(video->getCachingFrameSize());
+}
+
+void playlistItemFFmpegFile::cacheIntermediateFrame(int frameIdxInternal, const QByteArray &data)
+{
+  DEBUG_FFMPEG("playlistItemFFmpegFile::cacheIntermediateFrame %d", frameIdxInternal);
+  // The frame is converted when it is drawn. The loading thread has to go on decoding the requested frame.
+  video->cacheRawFrame(frameIdxInternal, data);
+  intermediateFramesCached = true;
+}
+
 void playlistItemFFmpegFile::createPropertiesWidget()
 {
   // Absolutely always only call this once
@@ -324,10 +378,20 @@ void playlistItemFFmpegFile::reloadItemSource()
   // TODO: The caching decoder must also be reloaded
   //       All items in the cache are also now invalid
 
+  // The look ahead decoder is opened again when it is needed
+  lookAhead.stop();
+  lookAheadDecoder.reset();
+
   loadingDecoder.reloadItemSource();
 
   // Set the frame number limits
+  startEndFrameMutex.lock();
   startEndFrame = getStartEndFrameLimits();
+  startEndFrameMutex.unlock();
+  cachingDecoderMutex.lock();
+  keyFrames = loadingDecoder.getKeyFrameNumbers();
+  cachingDecoderMutex.unlock();
+  updateNrCachingDecoders();
 
   // Reset the videoHandlerYUV source. With the next draw event, the videoHandlerYUV will request to decode the frame again.
   video->invalidateAllBuffers();
@@ -343,9 +407,209 @@ void playlistItemFFmpegFile::cacheFrame(int frameIdx, bool testMode)
     return;
 
   // Cache a certain frame. This is always called in a separate thread.
-  cachingMutex.lock();
-  video->cacheFrame(getFrameIdxInternal(frameIdx), testMode);
-  cachingMutex.unlock();
+  const int frameIdxInternal = getFrameIdxInternal(frameIdx);
+  if (frameIdxInternal < 0 || frameIdxInternal > getStartEndFrame().second || !video->needsCaching(frameIdxInternal, testMode))
+    return;
+  if (!testMode && video->restoreFromSpillFile(frameIdxInternal))
+    return;
+
+  // Decode the frame with one of the caching decoders. The decoded data is not passed through the shared raw data
+  // buffer of the videoHandlerYUV so that multiple threads can cache frames of this item at the same time.
+  FFmpegDecoder *cachingDecoder = acquireCachingDecoder(frameIdxInternal);
+  if (cachingDecoder == nullptr)
+    return;
+  // If possible, convert the picture planes of the decoder directly into the cached image. This is done
+  // before the decoder is released because the planes are only valid until the decoder is used again.
+  videoHandlerYUV *yuvVideo = dynamic_cast<videoHandlerYUV*>(video.data());
+  YUV_Internals::yuvPlanes planes;
+  bool cachedFromPlanes = false;
+  if (cachingDecoder->loadYUVFramePlanes(frameIdxInternal, planes))
+    cachedFromPlanes = yuvVideo->cacheFrameFromPlanes(frameIdxInternal, planes, testMode);
+  QByteArray decByteArray;
+  if (!cachedFromPlanes)
+    decByteArray = cachingDecoder->loadYUVFrameData(frameIdxInternal);
+  const bool decoded = cachedFromPlanes || !decByteArray.isEmpty();
+  releaseCachingDecoder(cachingDecoder, decoded ? frameIdxInternal : -1);
+
+  DEBUG_FFMPEG("playlistItemFFmpegFile::cacheFrame %d %s", frameIdxInternal, decoded ? "" : "failed");
+  if (!decByteArray.isEmpty())
+    video->cacheFrame(frameIdxInternal, decByteArray, testMode);
+}
+
+bool playlistItemFFmpegFile::decodeLookAheadFrame(int frameIdxInternal, QImage &image)
+{
+  if (!lookAheadDecoder)
+  {
+    lookAheadDecoder.reset(new FFmpegDecoder());
+    // This is called from the look ahead thread. The decoder is a QObject so move it to the thread of the item.
+    lookAheadDecoder->moveToThread(thread());
+    // Another decoder is given so the bitstream is not scanned again
+    if (!lookAheadDecoder->openFile(plItemNameOrFileName, &loadingDecoder))
+    {
+      DEBUG_FFMPEG("playlistItemFFmpegFile::decodeLookAheadFrame opening the input file with the look ahead decoder failed");
+      lookAheadDecoder.reset();
+      return false;
+    }
+    lookAheadDecoder->setFrameBufferPool(&bufferPool);
+  }
+
+  DEBUG_FFMPEG("playlistItemFFmpegFile::decodeLookAheadFrame %d", frameIdxInternal);
+
+  // If possible, convert the planes of the decoded frame without copying them first
+  videoHandlerYUV *yuvVideo = dynamic_cast<videoHandlerYUV*>(video.data());
+  YUV_Internals::yuvPlanes planes;
+  if (lookAheadDecoder->loadYUVFramePlanes(frameIdxInternal, planes) && yuvVideo->convertFrameFromPlanes(planes, image))
+    return true;
+  const QByteArray decByteArray = lookAheadDecoder->loadYUVFrameData(frameIdxInternal);
+  return !decByteArray.isEmpty() && yuvVideo->convertFrameFromRawData(decByteArray, image);
+}
+
+void playlistItemFFmpegFile::timerEvent(QTimerEvent *event)
+{
+  if (event->timerId() != timer.timerId())
+    return playlistItemWithVideo::timerEvent(event);
+
+  // When the background scan is done, this is the last update
+  if (!loadingDecoder.isBackgroundScanRunning())
+    timer.stop();
+  updateScannedFrames();
+}
+
+void playlistItemFFmpegFile::updateScannedFrames()
+{
+  const int nrFrames = loadingDecoder.getNumberPOCs();
+  if (nrFrames == nrFramesScanned)
+    return;
+  DEBUG_FFMPEG("playlistItemFFmpegFile::updateScannedFrames %d frames", nrFrames);
+
+  // If the end frame was the last frame, it stays the last frame
+  indexRange range = startEndFrame;
+  if (range.second == nrFramesScanned - 1)
+    range.second = nrFrames - 1;
+  nrFramesScanned = nrFrames;
+  setStartEndFrame(range, false);
+
+  cachingDecoderMutex.lock();
+  keyFrames = loadingDecoder.getKeyFrameNumbers();
+  cachingDecoderMutex.unlock();
+  updateNrCachingDecoders();
+
+  // The new frames can be cached
+  emit signalItemChanged(false, RECACHE_UPDATE);
+}
+
+QList<int> playlistItemFFmpegFile::getRandomAccessPoints() const
+{
+  QList<int> points;
+  for (int frameIdxInternal : keyFrames)
+    if (frameIdxInternal >= startEndFrame.first && frameIdxInternal <= startEndFrame.second)
+      points.append(getFrameIdxExternal(frameIdxInternal));
+  return points;
+}
+
+void playlistItemFFmpegFile::updateSettings()
+{
+  loadingDecoder.updateFileWatchSetting();
+  statSource.updateSettings();
+  updateNrCachingDecoders();
+}
+
+void playlistItemFFmpegFile::updateNrCachingDecoders()
+{
+  // One decoder per caching thread. More decoders than segments between key frames are of no use.
+  QSettings settings;
+  settings.beginGroup("VideoCache");
+  int nrThreads = getOptimalThreadCount();
+  if (settings.value("SetNrThreads", false).toBool())
+    nrThreads = settings.value("NrThreads", nrThreads).toInt();
+  settings.endGroup();
+
+  QMutexLocker lock(&cachingDecoderMutex);
+  nrCachingDecoders = clip(qMin(nrThreads, keyFrames.count()), 1, MAX_NR_CACHING_DECODERS);
+  DEBUG_FFMPEG("playlistItemFFmpegFile::updateNrCachingDecoders %d", nrCachingDecoders);
+}
+
+FFmpegDecoder *playlistItemFFmpegFile::acquireCachingDecoder(int frameIdxInternal)
+{
+  QMutexLocker lock(&cachingDecoderMutex);
+
+  // The key frame before the requested frame. A decoder that decoded a frame between this key frame
+  // and the requested frame can continue decoding from there.
+  auto it = std::upper_bound(keyFrames.begin(), keyFrames.end(), frameIdxInternal);
+  const int segmentStart = (it == keyFrames.begin()) ? 0 : *(it - 1);
+
+  while (true)
+  {
+    int continueSlot = -1;
+    int freeSlot = -1;
+    for (int i = 0; i < cachingDecoders.count(); i++)
+    {
+      const cachingDecoderSlot &slot = cachingDecoders[i];
+      if (slot.inUse)
+        continue;
+      if (slot.lastFrameIdx >= segmentStart && slot.lastFrameIdx < frameIdxInternal)
+      {
+        if (continueSlot == -1 || slot.lastFrameIdx > cachingDecoders[continueSlot].lastFrameIdx)
+          continueSlot = i;
+      }
+      else if (freeSlot == -1)
+        freeSlot = i;
+    }
+
+    // If no decoder can continue, prefer allocating a new one. The free decoders may still be
+    // needed to continue decoding of their segments.
+    int useSlot = continueSlot;
+    if (useSlot == -1 && cachingDecoders.count() < nrCachingDecoders)
+    {
+      cachingDecoderSlot newSlot;
+      newSlot.decoder.reset(new FFmpegDecoder());
+      newSlot.decoder->setFrameBufferPool(&bufferPool);
+      newSlot.inUse = false;
+      newSlot.lastFrameIdx = -1;
+      // This is called from a caching thread. The decoder is a QObject so move it to the thread of the item.
+      newSlot.decoder->moveToThread(thread());
+      // Another decoder is given so the bitstream is not scanned again
+      if (newSlot.decoder->openFile(plItemNameOrFileName, &loadingDecoder))
+      {
+        DEBUG_FFMPEG("playlistItemFFmpegFile::acquireCachingDecoder allocated caching decoder %d", cachingDecoders.count());
+        cachingDecoders.append(newSlot);
+        useSlot = cachingDecoders.count() - 1;
+      }
+      else
+      {
+        // Opening the input file failed. Don't try this again.
+        DEBUG_FFMPEG("playlistItemFFmpegFile::acquireCachingDecoder opening the input file with a caching decoder failed");
+        if (cachingDecoders.isEmpty())
+          return nullptr;
+        nrCachingDecoders = cachingDecoders.count();
+      }
+    }
+    if (useSlot == -1)
+      useSlot = freeSlot;
+
+    if (useSlot != -1)
+    {
+      cachingDecoders[useSlot].inUse = true;
+      return cachingDecoders[useSlot].decoder.data();
+    }
+
+    // All decoders are in use. Wait until one is released.
+    cachingDecoderReleased.wait(&cachingDecoderMutex);
+  }
+}
+
+void playlistItemFFmpegFile::releaseCachingDecoder(FFmpegDecoder *decoder, int lastFrameIdx)
+{
+  QMutexLocker lock(&cachingDecoderMutex);
+  for (cachingDecoderSlot &slot : cachingDecoders)
+  {
+    if (slot.decoder.data() == decoder)
+    {
+      slot.inUse = false;
+      slot.lastFrameIdx = lastFrameIdx;
+    }
+  }
+  cachingDecoderReleased.wakeOne();
 }
 
 void playlistItemFFmpegFile::loadFrame(int frameIdx, bool playing, bool loadRawdata, bool emitSignals)
@@ -353,6 +617,15 @@ void playlistItemFFmpegFile::loadFrame(int frameIdx, bool playing, bool loadRawd
   auto stateYUV = video->needsLoading(frameIdx, loadRawdata);
   auto stateStat = statSource.needsLoading(frameIdx);
 
+  // During playback, the next frames are decoded ahead. Any other request stops this.
+  const bool useLookAhead = playing && !loadRawdata && decoderReady;
+  if (useLookAhead)
+    lookAhead.setPlayhead(frameIdx, getStartEndFrame().second, qint64(video->getFrameSize().width()) * video->getFrameSize().height() * 4);
+  else
+    lookAhead.stop(false);
+  QImage lookAheadImage;
+  lastFrameLoadDurationMs = -1;
+
   if (stateYUV == LoadingNeeded || stateStat == LoadingNeeded)
   {
     isFrameLoading = true;
@@ -361,7 +634,15 @@ void playlistItemFFmpegFile::loadFrame(int frameIdx, bool playing, bool loadRawd
     {
       // Load the requested current frame
       DEBUG_FFMPEG("playlistItemFFmpegFile::loadFrame loading frame %d %s", frameIdx, playing ? "(playing)" : "");
-      video->loadFrame(frameIdx);
+      if (useLookAhead && lookAhead.takeFrame(frameIdx, lookAheadImage))
+        video->setLoadedFrame(frameIdx, lookAheadImage);
+      else
+      {
+        QElapsedTimer loadTimer;
+        loadTimer.start();
+        video->loadFrame(frameIdx);
+        lastFrameLoadDurationMs = loadTimer.nsecsElapsed() / 1000000.0;
+      }
     }
     if (stateStat == LoadingNeeded)
     {
@@ -379,11 +660,14 @@ void playlistItemFFmpegFile::loadFrame(int frameIdx, bool playing, bool loadRawd
   {
     // Load the next frame into the double buffer
     int nextFrameIdx = frameIdx + 1;
-    if (nextFrameIdx <= startEndFrame.second)
+    if (nextFrameIdx <= getStartEndFrame().second)
     {
       DEBUG_FFMPEG("playlistItemFFmpegFile::loadFrame loading frame into double buffer %d %s", nextFrameIdx, playing ? "(playing)" : "");
       isFrameLoadingDoubleBuffer = true;
-      video->loadFrame(nextFrameIdx, true);
+      if (useLookAhead && lookAhead.takeFrame(nextFrameIdx, lookAheadImage))
+        video->setLoadedFrame(nextFrameIdx, lookAheadImage, true);
+      else
+        video->loadFrame(nextFrameIdx, true);
       isFrameLoadingDoubleBuffer = false;
       if (emitSignals)
         emit signalItemDoubleBufferLoaded();
@@ -33,7 +33,12 @@
 #ifndef PLAYLISTITEMFFMPEGFILE_H
 #define PLAYLISTITEMFFMPEGFILE_H
 
+#include <QBasicTimer>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QWaitCondition>
 #include "FFmpegDecoder.h"
+#include "frameLookAhead.h"
 #include "playlistItemWithVideo.h"
 #include "statisticHandler.h"
 #include "videoHandlerYUV.h"
@@ -78,12 +83,16 @@ public:
   // ----- Detection of source/file change events -----
   virtual bool isSourceChanged()        Q_DECL_OVERRIDE { return loadingDecoder.isFileChanged(); }
   virtual void reloadItemSource()       Q_DECL_OVERRIDE;
-  virtual void updateSettings()         Q_DECL_OVERRIDE { loadingDecoder.updateFileWatchSetting(); statSource.updateSettings(); }
+  virtual void updateSettings()         Q_DECL_OVERRIDE;
 
-  // Cache the frame with the given index.
-  // For FFMpeg items, a mutex must be locked when caching a frame (only one frame can be cached at a time).
+  // Cache the frame with the given index. Each caching thread uses its own decoder from the pool of caching decoders.
   void cacheFrame(int idx, bool testMode) Q_DECL_OVERRIDE;
 
+  // Every caching thread needs its own decoder. The frames between two key frames should be cached in order
+  // by one thread so that no unnecessary decoding is performed.
+  virtual int cachingThreadLimit() Q_DECL_OVERRIDE { return nrCachingDecoders; }
+  virtual QList<int> getRandomAccessPoints() const Q_DECL_OVERRIDE;
+
   // Load the frame in the video item. Emit signalItemChanged(true,false) when done.
   virtual void loadFrame(int frameIdx, bool playing, bool loadRawData, bool emitSignals=true) Q_DECL_OVERRIDE;
 
@@ -102,10 +111,45 @@ private:
   // Override from playlistItemIndexed. The FFMpeg decoder can tell us how many POSs there are.
   virtual indexRange getStartEndFrameLimits() const Q_DECL_OVERRIDE { return indexRange(0, loadingDecoder.getNumberPOCs() - 1); }
 
-  // We allocate two decoder: One for loading images in the foreground and one for caching in the background.
-  // This is better if random access and linear decoding (caching) is performed at the same time.
+  // We allocate one decoder for loading images in the foreground and a pool of decoders for caching in the background.
+  // This is better if random access and linear decoding (caching) is performed at the same time. The caching decoders
+  // are created when they are needed. Each one decodes a different segment of the sequence (between two key frames)
+  // so that multiple threads can cache frames at the same time.
+  // All decoders take the buffers for the decoded frames from this pool
+  frameBufferPool bufferPool;
   FFmpegDecoder loadingDecoder;
-  FFmpegDecoder cachingDecoder;
+  struct cachingDecoderSlot
+  {
+    QSharedPointer<FFmpegDecoder> decoder;
+    bool inUse;
+    int lastFrameIdx;   // The last frame that was decoded by this decoder (-1 if none)
+  };
+  QList<cachingDecoderSlot> cachingDecoders;
+  int nrCachingDecoders;
+  QMutex cachingDecoderMutex;
+  QWaitCondition cachingDecoderReleased;
+
+  // Get a caching decoder that is not used by another thread. If possible, a decoder is chosen which can continue
+  // decoding up to the given frame without seeking. Return it with releaseCachingDecoder when decoding is done.
+  FFmpegDecoder *acquireCachingDecoder(int frameIdxInternal);
+  void releaseCachingDecoder(FFmpegDecoder *decoder, int lastFrameIdx);
+  void updateNrCachingDecoders();
+
+  // After a seek, the loading decoder decodes the frames from the key frame up to the requested frame.
+  // These are put into the cache (as raw data) as long as there is free space in the video cache.
+  bool wantIntermediateFrame(int frameIdxInternal);
+  void cacheIntermediateFrame(int frameIdxInternal, const QByteArray &data);
+  bool intermediateFramesCached;
+
+  // The frame indices (internal) of the key frames in the file
+  QList<int> keyFrames;
+
+  // Only the beginning of the file is scanned when it is opened. While the rest of it is scanned in the background,
+  // the timer regularly updates the number of frames and the key frames.
+  QBasicTimer timer;
+  int nrFramesScanned;
+  virtual void timerEvent(QTimerEvent *event) Q_DECL_OVERRIDE; // Overloaded from QObject. Called when the timer fires.
+  void updateScannedFrames();
 
   // The statistics source
   statisticHandler statSource;
@@ -113,12 +157,15 @@ private:
   // fill the list of statistic types that we can provide
   void fillStatisticList();
 
-  // Only cache one frame at a time. Caching should also always be done in display order of the frames.
-  // TODO: Could we somehow make shure that caching is always performed in display order?
-  QMutex cachingMutex;
-
   bool decoderReady;
 
+  // During playback, the frames after the playhead are decoded and converted in a background thread so that frames
+  // which take longer to decode do not stall playback. The look ahead uses a decoder of its own which is created
+  // in the look ahead thread when it is first needed.
+  QScopedPointer<FFmpegDecoder> lookAheadDecoder;
+  bool decodeLookAheadFrame(int frameIdxInternal, QImage &image);
+  frameLookAhead lookAhead;
+
 private slots:
   void updateStatSource(bool bRedraw) { emit signalItemChanged(bRedraw, RECACHE_NONE); }
 };
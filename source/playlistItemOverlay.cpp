@@ -376,6 +376,7 @@ void playlistItemOverlay::loadFrame(int frameIdx, bool playing, bool loadRawData
   // Does one of the items need loading?
   bool itemLoadedDoubleBuffer = false;
   bool itemLoaded = false;
+  lastFrameLoadDurationMs = -1;
 
   for (int i = 0; i < childCount(); i++)
   {
@@ -387,6 +388,9 @@ void playlistItemOverlay::loadFrame(int frameIdx, bool playing, bool loadRawData
       // We will emit the signal that loading is complete when all overlay items have loaded.
       DEBUG_OVERLAY("playlistItemWithVideo::loadFrame loading frame %d%s%s", frameIdx, playing ? " playing" : "", loadRawData ? " raw" : "");
       item->loadFrame(frameIdx, playing, loadRawData, false);
+      // Loading the overlay takes as long as loading all of its items
+      if (state == LoadingNeeded && item->getLastFrameLoadDuration() >= 0)
+        lastFrameLoadDurationMs = qMax(lastFrameLoadDurationMs, 0.0) + item->getLastFrameLoadDuration();
     }
 
     if (state == LoadingNeeded)
@@ -32,8 +32,11 @@
 
 #include "playlistItemRawCodedVideo.h"
 
+#include <algorithm>
+#include <QElapsedTimer>
 #include <QInputDialog>
 #include <QPainter>
+#include <QSettings>
 #include <QtConcurrent>
 #include <QUrl>
 #include "hevcDecoderHM.h"
@@ -61,9 +64,13 @@ playlistItemRawCodedVideo::playlistItemRawCodedVideo(const QString &hevcFilePath
   // Set the video pointer correctly
   video.reset(new videoHandlerYUV());
   videoHandlerYUV *yuvVideo = dynamic_cast<videoHandlerYUV*>(video.data());
+  // Decoding a frame again is expensive. Keep frames that are removed from the cache in the spill file.
+  video->setSpillEvictedFrames(true);
 
   // Connect the basic signals from the video
   playlistItemWithVideo::connectVideo();
+  // The frames that were decoded ahead were converted with the old settings
+  connect(video.data(), &videoHandler::signalHandlerChanged, this, [this]{ lookAhead.clear(); });
 
   // Nothing is currently being loaded
   isFrameLoading = false;
@@ -77,25 +84,23 @@ playlistItemRawCodedVideo::playlistItemRawCodedVideo(const QString &hevcFilePath
   if (displaySignal < 0)
     displaySignal = 0;
   
-  // Allocate the decoders
+  // Allocate the decoder for loading. The caching decoders are allocated when they are needed.
+  nrCachingDecoders = 1;
+  nrCachingDecodersAllocating = 0;
+  nrFramesScanned = 0;
+  loadingDecoderFileGrowth = 0;
   decoderEngineType = e;
-  if (e == decoderLibde265)
-  {
-    loadingDecoder.reset(new hevcDecoderLibde265(displaySignal));
-    cachingDecoder.reset(new hevcDecoderLibde265(displaySignal, true));
-  }
-  else if (e == decoderHM)
-  {
-    loadingDecoder.reset(new hevcDecoderHM(displaySignal));
-    cachingDecoder.reset(new hevcDecoderHM(displaySignal, true));
-  }
-  else if (e == decoderJEM)
-  {
-    loadingDecoder.reset(new hevcNextGenDecoderJEM(displaySignal));
-    cachingDecoder.reset(new hevcNextGenDecoderJEM(displaySignal, true));
-  }
-  else
+  QSettings settings;
+  followGrowingFile = settings.value("FollowGrowingFiles", false).toBool();
+  intermediateFramesCached = false;
+  lookAheadDecoderFileGrowth = 0;
+  lookAhead.setDecodeFunction([this](int idx, QImage &image) { return decodeLookAheadFrame(idx, image); });
+  loadingDecoder.reset(createDecoder(false, displaySignal));
+  if (!loadingDecoder)
     return;
+  loadingDecoder->setFrameBufferPool(&bufferPool);
+  loadingDecoder->setIntermediateFrameHandler([this](int idx) { return wantIntermediateFrame(idx); },
+                                              [this](int idx, const QByteArray &data) { cacheIntermediateFrame(idx, data); });
 
   // Reset display signal if this is not supported by the decoder
   if (displaySignal > loadingDecoder->wrapperNrSignalsSupported())
@@ -119,12 +124,14 @@ playlistItemRawCodedVideo::playlistItemRawCodedVideo(const QString &hevcFilePath
   // The bitstream looks valid and the decoder is operational.
   fileState = noError;
 
-  if (cachingDecoder && !cachingDecoder->openFile(hevcFilePath, loadingDecoder.data()))
-  {
-    // Loading the normal decoder worked, but loading another decoder for caching failed.
-    // That is strange.
-    cachingEnabled = false;
-  }
+  // Each caching decoder can start decoding at one of the random access points
+  randomAccessPoints = loadingDecoder->getFileSource()->getRandomAccessPoints();
+  updateNrCachingDecoders();
+
+  // If the bitstream is still scanned in the background, more frames will become available
+  nrFramesScanned = loadingDecoder->getNumberPOCs();
+  if (loadingDecoder->getFileSource()->isBackgroundScanRunning() || followGrowingFile)
+    timer.start(1000, this);
 
   // Fill the list of statistics that we can provide
   fillStatisticList();
@@ -204,6 +211,10 @@ infoData playlistItemRawCodedVideo::getInfo() const
   // At first append the file information part (path, date created, file size...)
   info.items.append(loadingDecoder->getFileInfoList());
 
+  // Show the progress of the background scan of the bitstream (if running)
+  if (loadingDecoder->getFileSource()->isBackgroundScanRunning())
+    info.items.append(infoItem("Parsing:", QString("%1%...").arg(loadingDecoder->getFileSource()->getBackgroundScanProgress())));
+
   if (fileState != noError)
     info.items.append(infoItem("Error", loadingDecoder->decoderErrorString()));
   if (fileState == onlyParsing)
@@ -300,7 +311,7 @@ void playlistItemRawCodedVideo::loadYUVData(int frameIdxInternal, bool caching)
   yuvVideo->setYUVPixelFormat(loadingDecoder->getYUVPixelFormat());
   statSource.statFrameSize = loadingDecoder->getFrameSize();
 
-  if (frameIdxInternal > startEndFrame.second || frameIdxInternal < 0)
+  if (frameIdxInternal > getStartEndFrame().second || frameIdxInternal < 0)
   {
     DEBUG_HEVC("playlistItemRawCodedVideo::loadYUVData Invalid frame index");
     return;
@@ -309,10 +320,26 @@ void playlistItemRawCodedVideo::loadYUVData(int frameIdxInternal, bool caching)
   // Just get the frame from the correct decoder
   QByteArray decByteArray;
   if (caching)
+  {
+    decoderBase *cachingDecoder = acquireCachingDecoder(frameIdxInternal);
+    if (cachingDecoder == nullptr)
+      return;
     decByteArray = cachingDecoder->loadYUVFrameData(frameIdxInternal);
+    releaseCachingDecoder(cachingDecoder, decByteArray.isEmpty() ? -1 : frameIdxInternal);
+  }
   else
+  {
+    updateDecoderAfterFileGrew(loadingDecoder.data(), loadingDecoderFileGrowth);
     decByteArray = loadingDecoder->loadYUVFrameData(frameIdxInternal);
 
+    // Let the video cache know about the frames that were cached on the way
+    if (intermediateFramesCached)
+    {
+      intermediateFramesCached = false;
+      emit signalItemChanged(false, RECACHE_UPDATE);
+    }
+  }
+
   if (!decByteArray.isEmpty())
   {
     yuvVideo->rawYUVData = decByteArray;
@@ -320,6 +347,53 @@ void playlistItemRawCodedVideo::loadYUVData(int frameIdxInternal, bool caching)
   }
 }
 
+bool playlistItemRawCodedVideo::wantIntermediateFrame(int frameIdxInternal)
+{
+  const indexRange range = getStartEndFrame();
+  if (!cachingEnabled || frameIdxInternal < range.first || frameIdxInternal > range.second)
+    return false;
+  if (!video->needsCaching(frameIdxInternal, false))
+    return false;
+  // Don't push other frames out of the cache. Only use the space that the video cache has not used yet.
+  return videoHandler::reserveFreeCacheSpace(video->getCachingFrameSize());
+}
+
+void playlistItemRawCodedVideo::cacheIntermediateFrame(int frameIdxInternal, const QByteArray &data)
+{
+  DEBUG_HEVC("playlistItemRawCodedVideo::cacheIntermediateFrame %d", frameIdxInternal);
+  // The frame is converted when it is drawn. The loading thread has to go on decoding the requested frame.
+  video->cacheRawFrame(frameIdxInternal, data);
+  intermediateFramesCached = true;
+}
+
+bool playlistItemRawCodedVideo::decodeLookAheadFrame(int frameIdxInternal, QImage &image)
+{
+  if (!lookAheadDecoder)
+  {
+    // Another decoder is given so the bitstream is not parsed again
+    lookAheadDecoder.reset(createDecoder(false, displaySignal));
+    if (!lookAheadDecoder || !lookAheadDecoder->openFile(plItemNameOrFileName, loadingDecoder.data()))
+    {
+      DEBUG_HEVC("playlistItemRawCodedVideo::decodeLookAheadFrame opening the look ahead decoder failed");
+      lookAheadDecoder.reset();
+      return false;
+    }
+    lookAheadDecoder->setFrameBufferPool(&bufferPool);
+    lookAheadDecoderFileGrowth = fileGrowthCounter.load();
+  }
+  updateDecoderAfterFileGrew(lookAheadDecoder.data(), lookAheadDecoderFileGrowth);
+
+  DEBUG_HEVC("playlistItemRawCodedVideo::decodeLookAheadFrame %d", frameIdxInternal);
+
+  // If possible, convert the picture planes of the decoder without copying them first
+  videoHandlerYUV *yuvVideo = dynamic_cast<videoHandlerYUV*>(video.data());
+  YUV_Internals::yuvPlanes planes;
+  if (lookAheadDecoder->loadYUVFramePlanes(frameIdxInternal, planes) && yuvVideo->convertFrameFromPlanes(planes, image))
+    return true;
+  const QByteArray decByteArray = lookAheadDecoder->loadYUVFrameData(frameIdxInternal);
+  return !decByteArray.isEmpty() && yuvVideo->convertFrameFromRawData(decByteArray, image);
+}
+
 void playlistItemRawCodedVideo::createPropertiesWidget()
 {
   // Absolutely always only call this once
@@ -373,6 +447,7 @@ void playlistItemRawCodedVideo::loadStatisticToCache(int frameIdx, int typeIdx)
   if (!loadingDecoder->wrapperInternalsSupported())
     return;
 
+  updateDecoderAfterFileGrew(loadingDecoder.data(), loadingDecoderFileGrowth);
   statSource.statsCache[typeIdx] = loadingDecoder->getStatisticsData(frameIdxInternal, typeIdx);
 }
 
@@ -401,10 +476,23 @@ void playlistItemRawCodedVideo::reloadItemSource()
   // TODO: The caching decoder must also be reloaded
   //       All items in the cache are also now invalid
 
+  // The look ahead decoder is opened again when it is needed
+  lookAhead.stop();
+  lookAheadDecoder.reset();
+
   loadingDecoder->reloadItemSource();
 
   // Set the frame number limits
+  startEndFrameMutex.lock();
   startEndFrame = getStartEndFrameLimits();
+  startEndFrameMutex.unlock();
+  cachingDecoderMutex.lock();
+  randomAccessPoints = loadingDecoder->getFileSource()->getRandomAccessPoints();
+  cachingDecoderMutex.unlock();
+  updateNrCachingDecoders();
+  nrFramesScanned = loadingDecoder->getNumberPOCs();
+  if (loadingDecoder->getFileSource()->isBackgroundScanRunning() || followGrowingFile)
+    timer.start(1000, this);
 
   // Reset the videoHandlerYUV source. With the next draw event, the videoHandlerYUV will request to decode the frame again.
   video->invalidateAllBuffers();
@@ -419,10 +507,296 @@ void playlistItemRawCodedVideo::cacheFrame(int frameIdx, bool testMode)
   if (!cachingEnabled)
     return;
 
-  // Cache a certain frame. This is always called in a separate thread.
-  cachingMutex.lock();
-  video->cacheFrame(getFrameIdxInternal(frameIdx), testMode);
-  cachingMutex.unlock();
+  // Cache a certain frame. This is always called in a separate thread. The start/end frame can be changed
+  // by the main thread at any time.
+  const indexRange range = getStartEndFrame();
+  const int frameIdxInternal = frameIdx + range.first;
+  if (frameIdxInternal < 0 || frameIdxInternal > range.second || !video->needsCaching(frameIdxInternal, testMode))
+    return;
+  if (!testMode && video->restoreFromSpillFile(frameIdxInternal))
+    return;
+
+  // Decode the frame with one of the caching decoders. The decoded data is not passed through the shared raw data
+  // buffer of the videoHandlerYUV so that multiple threads can cache frames of this item at the same time.
+  decoderBase *cachingDecoder = acquireCachingDecoder(frameIdxInternal);
+  if (cachingDecoder == nullptr)
+    return;
+  // If possible, convert the picture planes of the decoder directly into the cached image. This is done
+  // before the decoder is released because the planes are only valid until the decoder is used again.
+  videoHandlerYUV *yuvVideo = dynamic_cast<videoHandlerYUV*>(video.data());
+  YUV_Internals::yuvPlanes planes;
+  bool cachedFromPlanes = false;
+  if (cachingDecoder->loadYUVFramePlanes(frameIdxInternal, planes))
+    cachedFromPlanes = yuvVideo->cacheFrameFromPlanes(frameIdxInternal, planes, testMode);
+  QByteArray decByteArray;
+  if (!cachedFromPlanes)
+    decByteArray = cachingDecoder->loadYUVFrameData(frameIdxInternal);
+  const bool decoded = cachedFromPlanes || !decByteArray.isEmpty();
+  releaseCachingDecoder(cachingDecoder, decoded ? frameIdxInternal : -1);
+
+  DEBUG_HEVC("playlistItemRawCodedVideo::cacheFrame %d %s", frameIdxInternal, decoded ? "" : "failed");
+  if (!decByteArray.isEmpty())
+    video->cacheFrame(frameIdxInternal, decByteArray, testMode);
+}
+
+void playlistItemRawCodedVideo::timerEvent(QTimerEvent *event)
+{
+  if (event->timerId() != timer.timerId())
+    return playlistItemWithVideo::timerEvent(event);
+
+  if (followGrowingFile)
+  {
+    followAppendedData();
+    return;
+  }
+
+  // When the background scan is done, this is the last update
+  if (!loadingDecoder->getFileSource()->isBackgroundScanRunning())
+    timer.stop();
+  updateScannedFrames();
+}
+
+void playlistItemRawCodedVideo::followAppendedData()
+{
+  fileSourceAnnexBFile *file = loadingDecoder->getFileSource();
+  if (!file->scanAppendedData())
+  {
+    // The file can not be followed. If it was changed, the file watcher will ask the user to reload it.
+    timer.stop();
+    return;
+  }
+
+  const int nrFramesBefore = nrFramesScanned;
+  const int firstChangedFrameIdx = file->takeFirstChangedFrameIdx();
+  updateScannedFrames();
+  if (nrFramesScanned == nrFramesBefore && firstChangedFrameIdx == -1)
+    return;
+
+  // The decoders may have to continue reading behind the old end of the file
+  fileGrowthCounter.ref();
+  if (firstChangedFrameIdx != -1)
+  {
+    // New pictures are output before pictures that were already shown. All following frames moved.
+    DEBUG_HEVC("playlistItemRawCodedVideo::followAppendedData Frame indices changed from %d", firstChangedFrameIdx);
+    frameIndicesChangedAtGrowth.store(fileGrowthCounter.load());
+    lookAhead.clear();
+    video->invalidateAllBuffers();
+    emit signalItemChanged(true, RECACHE_CLEAR);
+  }
+}
+
+void playlistItemRawCodedVideo::updateDecoderAfterFileGrew(decoderBase *decoder, int &decoderFileGrowth)
+{
+  const int fileGrowth = fileGrowthCounter.load();
+  if (decoderFileGrowth == fileGrowth)
+    return;
+  decoder->continueAfterFileGrew(decoderFileGrowth < frameIndicesChangedAtGrowth.load());
+  decoderFileGrowth = fileGrowth;
+}
+
+bool playlistItemRawCodedVideo::isSourceChanged()
+{
+  // If data was only appended to a file that is followed, this is no change that requires a reload
+  if (followGrowingFile && loadingDecoder->getFileSource()->scanAppendedData())
+    return false;
+  return loadingDecoder->isFileChanged();
+}
+
+void playlistItemRawCodedVideo::updateScannedFrames()
+{
+  const int nrFrames = loadingDecoder->getNumberPOCs();
+  if (nrFrames == nrFramesScanned)
+    return;
+  DEBUG_HEVC("playlistItemRawCodedVideo::updateScannedFrames %d frames", nrFrames);
+
+  // If the end frame was the last frame, it stays the last frame
+  indexRange range = startEndFrame;
+  if (range.second == nrFramesScanned - 1)
+    range.second = nrFrames - 1;
+  nrFramesScanned = nrFrames;
+  setStartEndFrame(range, false);
+
+  cachingDecoderMutex.lock();
+  randomAccessPoints = loadingDecoder->getFileSource()->getRandomAccessPoints();
+  cachingDecoderMutex.unlock();
+  updateNrCachingDecoders();
+
+  // The new frames can be cached
+  emit signalItemChanged(false, RECACHE_UPDATE);
+}
+
+QList<int> playlistItemRawCodedVideo::getRandomAccessPoints() const
+{
+  QList<int> points;
+  for (int frameIdxInternal : randomAccessPoints)
+    if (frameIdxInternal >= startEndFrame.first && frameIdxInternal <= startEndFrame.second)
+      points.append(getFrameIdxExternal(frameIdxInternal));
+  return points;
+}
+
+void playlistItemRawCodedVideo::updateSettings()
+{
+  loadingDecoder->updateFileWatchSetting();
+  statSource.updateSettings();
+  updateNrCachingDecoders();
+
+  // Following a file only works if it was opened with the setting enabled. If it is disabled, the timer stops
+  // once the background scan is done.
+  QSettings settings;
+  followGrowingFile = settings.value("FollowGrowingFiles", false).toBool();
+  if (followGrowingFile && !timer.isActive())
+    timer.start(1000, this);
+}
+
+void playlistItemRawCodedVideo::updateNrCachingDecoders()
+{
+  // One decoder per caching thread. More decoders than segments between random access points are of no use.
+  QSettings settings;
+  settings.beginGroup("VideoCache");
+  const bool videoCacheEnabled = settings.value("Enabled", true).toBool();
+  int nrThreads = getOptimalThreadCount();
+  if (settings.value("SetNrThreads", false).toBool())
+    nrThreads = settings.value("NrThreads", nrThreads).toInt();
+  settings.endGroup();
+
+  QMutexLocker lock(&cachingDecoderMutex);
+  if (videoCacheEnabled)
+    nrCachingDecoders = clip(qMin(nrThreads, randomAccessPoints.count()), 1, MAX_NR_CACHING_DECODERS);
+  else
+    // Without caching threads, no caching decoders are needed
+    nrCachingDecoders = 0;
+  DEBUG_HEVC("playlistItemRawCodedVideo::updateNrCachingDecoders %d", nrCachingDecoders);
+
+  // Free the decoders that are not needed anymore so that their memory and worker threads are returned. Decoders
+  // that are in use right now are freed when they are released.
+  QList<QSharedPointer<decoderBase>> unusedDecoders;
+  for (int i = cachingDecoders.count() - 1; i >= 0 && cachingDecoders.count() > nrCachingDecoders; i--)
+    if (!cachingDecoders[i].inUse)
+      unusedDecoders.append(cachingDecoders.takeAt(i).decoder);
+  lock.unlock();
+  unusedDecoders.clear();
+}
+
+decoderBase *playlistItemRawCodedVideo::createDecoder(bool cachingDecoder, int signal) const
+{
+  if (decoderEngineType == decoderLibde265)
+    return new hevcDecoderLibde265(signal, cachingDecoder);
+  if (decoderEngineType == decoderHM)
+    return new hevcDecoderHM(signal, cachingDecoder);
+  if (decoderEngineType == decoderJEM)
+    return new hevcNextGenDecoderJEM(signal, cachingDecoder);
+  return nullptr;
+}
+
+decoderBase *playlistItemRawCodedVideo::acquireCachingDecoder(int frameIdxInternal)
+{
+  QMutexLocker lock(&cachingDecoderMutex);
+
+  // The random access point before the requested frame. A decoder that decoded a frame between this point
+  // and the requested frame can continue decoding from there.
+  auto it = std::upper_bound(randomAccessPoints.begin(), randomAccessPoints.end(), frameIdxInternal);
+  const int segmentStart = (it == randomAccessPoints.begin()) ? 0 : *(it - 1);
+
+  while (true)
+  {
+    int continueSlot = -1;
+    int freeSlot = -1;
+    for (int i = 0; i < cachingDecoders.count(); i++)
+    {
+      const cachingDecoderSlot &slot = cachingDecoders[i];
+      if (slot.inUse)
+        continue;
+      if (slot.lastFrameIdx >= segmentStart && slot.lastFrameIdx < frameIdxInternal)
+      {
+        if (continueSlot == -1 || slot.lastFrameIdx > cachingDecoders[continueSlot].lastFrameIdx)
+          continueSlot = i;
+      }
+      else if (freeSlot == -1)
+        freeSlot = i;
+    }
+
+    // If no decoder can continue, prefer allocating a new one. The free decoders may still be
+    // needed to continue decoding of their segments.
+    int useSlot = continueSlot;
+    if (useSlot == -1 && cachingDecoders.count() + nrCachingDecodersAllocating < nrCachingDecoders)
+    {
+      // Opening a decoder takes a while. Don't block the other caching threads meanwhile.
+      nrCachingDecodersAllocating++;
+      const int signal = displaySignal;
+      lock.unlock();
+
+      cachingDecoderSlot newSlot;
+      newSlot.decoder.reset(createDecoder(true, signal));
+      if (newSlot.decoder)
+        newSlot.decoder->setFrameBufferPool(&bufferPool);
+      newSlot.inUse = true;
+      newSlot.lastFrameIdx = -1;
+      newSlot.fileGrowth = fileGrowthCounter.load();
+      // Another decoder is given so the bitstream is not parsed again
+      const bool opened = newSlot.decoder && newSlot.decoder->openFile(plItemNameOrFileName, loadingDecoder.data());
+
+      lock.relock();
+      nrCachingDecodersAllocating--;
+      if (opened)
+      {
+        DEBUG_HEVC("playlistItemRawCodedVideo::acquireCachingDecoder allocated caching decoder %d", cachingDecoders.count());
+        cachingDecoders.append(newSlot);
+        useSlot = cachingDecoders.count() - 1;
+      }
+      else
+      {
+        // Loading the normal decoder worked, but loading another decoder for caching failed.
+        // That is strange. Don't try this again.
+        DEBUG_HEVC("playlistItemRawCodedVideo::acquireCachingDecoder allocating a caching decoder failed");
+        nrCachingDecoders = cachingDecoders.count() + nrCachingDecodersAllocating;
+        cachingDecoderReleased.wakeAll();
+        if (nrCachingDecoders == 0)
+          return nullptr;
+        // The decoders may have changed while the lock was released
+        continue;
+      }
+    }
+    if (useSlot == -1)
+      useSlot = freeSlot;
+
+    if (useSlot != -1)
+    {
+      cachingDecoderSlot &slot = cachingDecoders[useSlot];
+      slot.inUse = true;
+      // The display signal may have been changed while the decoder was in use by another thread
+      slot.decoder->setDecodeSignal(displaySignal);
+      updateDecoderAfterFileGrew(slot.decoder.data(), slot.fileGrowth);
+      return slot.decoder.data();
+    }
+
+    // All decoders are in use. Wait until one is released.
+    if (cachingDecoders.isEmpty() && nrCachingDecodersAllocating == 0)
+      return nullptr;
+    cachingDecoderReleased.wait(&cachingDecoderMutex);
+  }
+}
+
+void playlistItemRawCodedVideo::releaseCachingDecoder(decoderBase *decoder, int lastFrameIdx)
+{
+  QMutexLocker lock(&cachingDecoderMutex);
+  QSharedPointer<decoderBase> unusedDecoder;
+  for (int i = 0; i < cachingDecoders.count(); i++)
+  {
+    if (cachingDecoders[i].decoder.data() != decoder)
+      continue;
+    if (cachingDecoders.count() > nrCachingDecoders)
+      // The number of caching decoders was reduced while this one was in use (see updateNrCachingDecoders())
+      unusedDecoder = cachingDecoders.takeAt(i).decoder;
+    else
+    {
+      cachingDecoders[i].inUse = false;
+      cachingDecoders[i].lastFrameIdx = lastFrameIdx;
+    }
+    break;
+  }
+  cachingDecoderReleased.wakeOne();
+  lock.unlock();
+  unusedDecoder.clear();
 }
 
 void playlistItemRawCodedVideo::loadFrame(int frameIdx, bool playing, bool loadRawdata, bool emitSignals)
@@ -434,6 +808,15 @@ void playlistItemRawCodedVideo::loadFrame(int frameIdx, bool playing, bool loadR
   auto stateYUV = video->needsLoading(frameIdxInternal, loadRawdata);
   auto stateStat = statSource.needsLoading(frameIdxInternal);
 
+  // During playback, the next frames are decoded ahead. Any other request stops this.
+  const bool useLookAhead = playing && !loadRawdata;
+  if (useLookAhead)
+    lookAhead.setPlayhead(frameIdxInternal, getStartEndFrame().second, qint64(video->getFrameSize().width()) * video->getFrameSize().height() * 4);
+  else
+    lookAhead.stop(false);
+  QImage lookAheadImage;
+  lastFrameLoadDurationMs = -1;
+
   if (stateYUV == LoadingNeeded || stateStat == LoadingNeeded)
   {
     isFrameLoading = true;
@@ -441,7 +824,15 @@ void playlistItemRawCodedVideo::loadFrame(int frameIdx, bool playing, bool loadR
     {
       // Load the requested current frame
       DEBUG_HEVC("playlistItemRawFile::loadFrame loading frame %d %s", frameIdxInternal, playing ? "(playing)" : "");
-      video->loadFrame(frameIdxInternal);
+      if (useLookAhead && lookAhead.takeFrame(frameIdxInternal, lookAheadImage))
+        video->setLoadedFrame(frameIdxInternal, lookAheadImage);
+      else
+      {
+        QElapsedTimer loadTimer;
+        loadTimer.start();
+        video->loadFrame(frameIdxInternal);
+        lastFrameLoadDurationMs = loadTimer.nsecsElapsed() / 1000000.0;
+      }
     }
     if (stateStat == LoadingNeeded)
     {
@@ -458,11 +849,14 @@ void playlistItemRawCodedVideo::loadFrame(int frameIdx, bool playing, bool loadR
   {
     // Load the next frame into the double buffer
     int nextFrameIdx = frameIdxInternal + 1;
-    if (nextFrameIdx <= startEndFrame.second)
+    if (nextFrameIdx <= getStartEndFrame().second)
     {
       DEBUG_HEVC("playlistItemRawFile::loadFrame loading frame into double buffer %d %s", nextFrameIdx, playing ? "(playing)" : "");
       isFrameLoadingDoubleBuffer = true;
-      video->loadFrame(nextFrameIdx, true);
+      if (useLookAhead && lookAhead.takeFrame(nextFrameIdx, lookAheadImage))
+        video->setLoadedFrame(nextFrameIdx, lookAheadImage, true);
+      else
+        video->loadFrame(nextFrameIdx, true);
       isFrameLoadingDoubleBuffer = false;
       if (emitSignals)
         emit signalItemDoubleBufferLoaded();
@@ -488,9 +882,15 @@ void playlistItemRawCodedVideo::displaySignalComboBoxChanged(int idx)
 {
   if (displaySignal != idx)
   {
+    // The caching decoders may be in use by a caching thread right now. The new signal is set when a caching
+    // decoder is acquired the next time.
+    cachingDecoderMutex.lock();
     displaySignal = idx;
+    cachingDecoderMutex.unlock();
     loadingDecoder->setDecodeSignal(idx);
-    cachingDecoder->setDecodeSignal(idx);
+    lookAhead.stop();
+    if (lookAheadDecoder)
+      lookAheadDecoder->setDecodeSignal(idx);
 
     // A different display signal was chosen. Invalidate the cache and signal that we will need a redraw.
     videoHandlerYUV *yuvVideo = dynamic_cast<videoHandlerYUV*>(video.data());
@@ -33,7 +33,13 @@
 #ifndef PLAYLISTITEMHEVCFILE_H
 #define PLAYLISTITEMHEVCFILE_H
 
+#include <QAtomicInt>
+#include <QBasicTimer>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QWaitCondition>
 #include "decoderBase.h"
+#include "frameLookAhead.h"
 #include "playlistItemWithVideo.h"
 #include "statisticHandler.h"
 #include "ui_playlistItemHEVCFile.h"
@@ -90,9 +96,9 @@ public:
   static void getSupportedFileExtensions(QStringList &allExtensions, QStringList &filters);
 
   // ----- Detection of source/file change events -----
-  virtual bool isSourceChanged()        Q_DECL_OVERRIDE { return loadingDecoder->isFileChanged(); }
+  virtual bool isSourceChanged()        Q_DECL_OVERRIDE;
   virtual void reloadItemSource()       Q_DECL_OVERRIDE;
-  virtual void updateSettings()         Q_DECL_OVERRIDE { loadingDecoder->updateFileWatchSetting(); statSource.updateSettings(); }
+  virtual void updateSettings()         Q_DECL_OVERRIDE;
 
   // Do we need to load the given frame first?
   virtual itemLoadingState needsLoading(int frameIdx, bool loadRawData) Q_DECL_OVERRIDE;
@@ -102,13 +108,13 @@ public:
   virtual bool isLoading() const Q_DECL_OVERRIDE { return isFrameLoading; }
   virtual bool isLoadingDoubleBuffer() const Q_DECL_OVERRIDE { return isFrameLoadingDoubleBuffer; }
 
-  // Cache the frame with the given index.
-  // For HEVC items, a mutex must be locked when caching a frame (only one frame can be cached at a time).
+  // Cache the frame with the given index. Each caching thread uses its own decoder from the pool of caching decoders.
   void cacheFrame(int idx, bool testMode) Q_DECL_OVERRIDE;
 
-  // We only have one caching decoder so it is better if only one thread caches frames from this item.
-  // This way, the frames will always be cached in the right order and no unnecessary decoding is performed.
-  virtual int cachingThreadLimit() Q_DECL_OVERRIDE { return 1; }
+  // Every caching thread needs its own decoder. The frames between two random access points should be cached
+  // in order by one thread so that no unnecessary decoding is performed.
+  virtual int cachingThreadLimit() Q_DECL_OVERRIDE { return nrCachingDecoders; }
+  virtual QList<int> getRandomAccessPoints() const Q_DECL_OVERRIDE;
 
   // Ask the user which decoder engine to use
   static decoderEngine askForDecoderEngine(QWidget *parent);
@@ -135,10 +141,60 @@ protected:
   } hevcFileState;
   hevcFileState fileState;
 
-  // We allocate two decoder: One for loading images in the foreground and one for caching in the background.
-  // This is better if random access and linear decoding (caching) is performed at the same time.
+  // We allocate one decoder for loading images in the foreground and a pool of decoders for caching in the background.
+  // This is better if random access and linear decoding (caching) is performed at the same time. The caching decoders
+  // are created when they are needed. Each one decodes a different segment of the sequence (between two random access
+  // points) so that multiple threads can cache frames at the same time.
+  // All decoders take the buffers for the decoded frames from this pool
+  frameBufferPool bufferPool;
   QScopedPointer<decoderBase> loadingDecoder;
-  QScopedPointer<decoderBase> cachingDecoder;
+  struct cachingDecoderSlot
+  {
+    QSharedPointer<decoderBase> decoder;
+    bool inUse;
+    int lastFrameIdx;   // The last frame that was decoded by this decoder (-1 if none)
+    int fileGrowth;     // The value of fileGrowthCounter when the decoder was last used
+  };
+  QList<cachingDecoderSlot> cachingDecoders;
+  int nrCachingDecoders;
+  int nrCachingDecodersAllocating;  // Caching decoders that are being opened right now (without the lock held)
+  QMutex cachingDecoderMutex;
+  QWaitCondition cachingDecoderReleased;
+
+  // Get a caching decoder that is not used by another thread. If possible, a decoder is chosen which can continue
+  // decoding up to the given frame without seeking. Return it with releaseCachingDecoder when decoding is done.
+  decoderBase *acquireCachingDecoder(int frameIdxInternal);
+  void releaseCachingDecoder(decoderBase *decoder, int lastFrameIdx);
+  void updateNrCachingDecoders();
+
+  // The frame indices (internal) of the random access points in the bitstream
+  QList<int> randomAccessPoints;
+
+  // Large bitstreams are scanned in the background. While the scan is running, the timer regularly updates the
+  // number of frames and the random access points.
+  QBasicTimer timer;
+  int nrFramesScanned;
+  virtual void timerEvent(QTimerEvent *event) Q_DECL_OVERRIDE; // Overloaded from QObject. Called when the timer fires.
+  void updateScannedFrames();
+
+  // Follow a file that is still being written. The timer keeps running and the scan continues when data was appended.
+  // Each time the file grows, fileGrowthCounter is incremented. A decoder that was last used before that
+  // has to be told so that it does not stop at the old end of the file.
+  bool followGrowingFile;
+  void followAppendedData();
+  QAtomicInt fileGrowthCounter;
+  QAtomicInt frameIndicesChangedAtGrowth;  //< The value of fileGrowthCounter when the frame indices last changed
+  int loadingDecoderFileGrowth;
+  void updateDecoderAfterFileGrew(decoderBase *decoder, int &decoderFileGrowth);
+
+  // After a seek, the loading decoder decodes the frames from the random access point up to the requested frame.
+  // These are put into the cache (as raw data) as long as there is free space in the video cache.
+  bool wantIntermediateFrame(int frameIdxInternal);
+  void cacheIntermediateFrame(int frameIdxInternal, const QByteArray &data);
+  bool intermediateFramesCached;
+
+  // Create a new decoder of the selected decoder engine
+  decoderBase *createDecoder(bool cachingDecoder, int signal) const;
 
   // Which type of decoder do we use?
   decoderEngine decoderEngineType;
@@ -147,10 +203,6 @@ protected:
   bool isFrameLoading;
   bool isFrameLoadingDoubleBuffer;
 
-  // Only cache one frame at a time. Caching should also always be done in display order of the frames.
-  // TODO: Could we somehow make shure that caching is always performed in display order?
-  QMutex cachingMutex;
-
   // The statistics source
   statisticHandler statSource;
 
@@ -160,6 +212,14 @@ protected:
   // Which of the signals is being displayed? Reconstruction(0), Prediction(1) or Residual(2)
   int displaySignal;
 
+  // During playback, the frames after the playhead are decoded and converted in a background thread so that frames
+  // which take longer to decode do not stall playback. The look ahead uses a decoder of its own which is created
+  // in the look ahead thread when it is first needed.
+  QScopedPointer<decoderBase> lookAheadDecoder;
+  int lookAheadDecoderFileGrowth;
+  bool decodeLookAheadFrame(int frameIdxInternal, QImage &image);
+  frameLookAhead lookAhead;
+
   SafeUi<Ui::playlistItemHEVCFile_Widget> ui;
 
   static QStringList decoderEngineNames;
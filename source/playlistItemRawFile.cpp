@@ -34,6 +34,7 @@
 
 #include <QFileInfo>
 #include <QPainter>
+#include <QSettings>
 #include <QtConcurrent>
 #include <QUrl>
 #include <QVBoxLayout>
@@ -48,6 +49,10 @@ using namespace YUV_Internals;
 #define DEBUG_RAWFILE(fmt,...) ((void)0)
 #endif
 
+// The number of frames that are read ahead during playback and the maximum memory used for this
+#define READ_AHEAD_NR_FRAMES 4
+#define READ_AHEAD_MAX_BYTES qint64(256*1024*1024)
+
 playlistItemRawFile::playlistItemRawFile(const QString &rawFilePath, const QSize &frameSize, const QString &sourcePixelFormat, const QString &fmt)
   : playlistItemWithVideo(rawFilePath, playlistItem_Indexed)
 {
@@ -55,6 +60,10 @@ playlistItemRawFile::playlistItemRawFile(const QString &rawFilePath, const QSize
   // Set the Qt::AA_UseHighDpiPixmaps attribute and then just use QIcon(":image.png")
   // If there is also a image@2x.png in the qrc, Qt will use this for high DPI
   isY4MFile = false;
+  y4mFrameStride = 0;
+  lastLoadedFrameIdx = -1;
+  readAheadSlots.resize(READ_AHEAD_NR_FRAMES);
+  readAheadDirection = 0;
 
   // Set the properties of the playlistItem
   setIcon(0, convertIcon(":img_video.png"));
@@ -69,6 +78,15 @@ playlistItemRawFile::playlistItemRawFile(const QString &rawFilePath, const QSize
     return;
   }
 
+  // If the file is still being written, the frames that are appended are added
+  QSettings settings;
+  followGrowingFile = settings.value("FollowGrowingFiles", false).toBool();
+  if (followGrowingFile)
+    followTimer.start(1000, this);
+
+  // Map the file into memory if this is enabled. If mapping fails, the frames are read from the file.
+  updateMemoryMapping();
+
   // Create a new videoHandler instance depending on the input format
   QFileInfo fi(rawFilePath);
   QString ext = fi.suffix();
@@ -120,7 +138,7 @@ playlistItemRawFile::playlistItemRawFile(const QString &rawFilePath, const QSize
     startEndFrame = getStartEndFrameLimits();
 
   // If the videHandler requests raw data, we provide it from the file
-  connect(video.data(), SIGNAL(signalRequestRawData(int, bool)), this, SLOT(loadRawData(int)), Qt::DirectConnection);
+  connect(video.data(), SIGNAL(signalRequestRawData(int, bool)), this, SLOT(loadRawData(int, bool)), Qt::DirectConnection);
   connect(video.data(), &videoHandler::signalUpdateFrameLimits, this,  &playlistItemRawFile::slotUpdateFrameLimits);
 
   // Connect the basic signals from the video
@@ -130,6 +148,12 @@ playlistItemRawFile::playlistItemRawFile(const QString &rawFilePath, const QSize
   cachingEnabled = true;
 }
 
+playlistItemRawFile::~playlistItemRawFile()
+{
+  // The background reads access the file and the buffers of this item
+  cancelReadAhead(true);
+}
+
 qint64 playlistItemRawFile::getNumberFrames() const
 {
   if (!dataSource.isOk() || !video->isFormatValid())
@@ -139,7 +163,10 @@ qint64 playlistItemRawFile::getNumberFrames() const
   }
 
   if (isY4MFile)
+  {
+    QMutexLocker lock(&y4mFrameIndicesMutex);
     return y4mFrameIndices.count();
+  }
 
   // The file was opened successfully
   qint64 bpf = getBytesPerFrame();
@@ -312,6 +339,7 @@ bool playlistItemRawFile::parseY4MFile()
     stride = width * height * 3;
   if (format.bitsPerSample > 8)
     stride *= 2;
+  y4mFrameStride = stride;
   
   while (true)
   {
@@ -458,37 +486,282 @@ playlistItemRawFile *playlistItemRawFile::newplaylistItemRawFile(const QDomEleme
   return newFile;
 }
 
-void playlistItemRawFile::loadRawData(int frameIdxInternal)
+void playlistItemRawFile::loadRawData(int frameIdxInternal, bool caching)
 {
   if (!video->isFormatValid())
     return;
 
-  DEBUG_RAWFILE("playlistItemRawFile::loadRawData %d", frameIdx);
+  DEBUG_RAWFILE("playlistItemRawFile::loadRawData %d %s", frameIdxInternal, caching ? "caching" : "");
 
-  // Load the raw data for the given frameIdx from file and set it in the video
-  qint64 fileStartPos;
-  if (isY4MFile)
-    fileStartPos = y4mFrameIndices.at(frameIdxInternal);
-  else
-    fileStartPos = frameIdxInternal * getBytesPerFrame();
-  qint64 nrBytes = getBytesPerFrame();
-
-  if (rawFormat == YUV)
+  // The video handler keeps (shallow) copies of its raw data buffer, so the frame is copied into it and does not
+  // reference the mapping (if the file is mapped).
+  QByteArray &rawData = (rawFormat == YUV) ? getYUVVideo()->rawYUVData : getRGBVideo()->rawRGBData;
+  if (caching)
   {
-    if (dataSource.readBytes(getYUVVideo()->rawYUVData, fileStartPos, nrBytes) < nrBytes)
+    // Caching does not change the access pattern of playback
+    if (!readRawFrame(frameIdxInternal, rawData))
       return; // Error
-    getYUVVideo()->rawYUVData_frameIdx = frameIdxInternal;
   }
-  else if (rawFormat == RGB)
+  else
   {
-    if (dataSource.readBytes(getRGBVideo()->rawRGBData, fileStartPos, nrBytes) < nrBytes)
+    // In which direction are the frames loaded? A jump to another frame cancels the read ahead.
+    int direction = 0;
+    if (frameIdxInternal == lastLoadedFrameIdx + 1)
+      direction = 1;
+    else if (frameIdxInternal == lastLoadedFrameIdx - 1)
+      direction = -1;
+    if (direction != readAheadDirection)
+      cancelReadAhead();
+    readAheadDirection = direction;
+    lastLoadedFrameIdx = frameIdxInternal;
+
+    if (dataSource.isMemoryMapped())
+    {
+      // Tell the OS how the file is accessed. During playback the next frame can already be prefetched.
+      dataSource.adviseSequentialAccess(direction != 0);
+      if (direction != 0 && getFrameStartPos(frameIdxInternal + direction) >= 0)
+        dataSource.prefetchMappedBytes(getFrameStartPos(frameIdxInternal + direction), getBytesPerFrame());
+    }
+
+    if (!takeReadAheadFrame(frameIdxInternal, rawData) && !readRawFrame(frameIdxInternal, rawData))
       return; // Error
-    getRGBVideo()->rawRGBData_frameIdx = frameIdxInternal;
+
+    if (direction != 0 && !dataSource.isMemoryMapped())
+      startReadAhead(frameIdxInternal);
   }
 
+  if (rawFormat == YUV)
+    getYUVVideo()->rawYUVData_frameIdx = frameIdxInternal;
+  else if (rawFormat == RGB)
+    getRGBVideo()->rawRGBData_frameIdx = frameIdxInternal;
+
   DEBUG_RAWFILE("playlistItemRawFile::loadRawData %d Done", frameIdxInternal);
 }
 
+bool playlistItemRawFile::takeReadAheadFrame(int frameIdxInternal, QByteArray &rawData)
+{
+  for (readAheadSlot &slot : readAheadSlots)
+  {
+    if (slot.frameIdx != frameIdxInternal)
+      continue;
+
+    // The read might still be running
+    slot.future.waitForFinished();
+    slot.frameIdx = -1;
+    const qint64 nrBytes = getBytesPerFrame();
+    if (!slot.future.result() || slot.startPos != getFrameStartPos(frameIdxInternal) || slot.data.size() < nrBytes)
+      // The read failed or the format changed in the meantime
+      return false;
+
+    // Swap the buffers. The previous buffer of the video handler is used for the next read ahead.
+    rawData.swap(slot.data);
+    DEBUG_RAWFILE("playlistItemRawFile::takeReadAheadFrame %d", frameIdxInternal);
+    return true;
+  }
+  return false;
+}
+
+void playlistItemRawFile::startReadAhead(int frameIdxInternal)
+{
+  const qint64 nrBytes = getBytesPerFrame();
+  if (nrBytes <= 0)
+    return;
+
+  // Limit the memory that is used for the read ahead buffers
+  const int nrFrames = int(qMin(qint64(readAheadSlots.count()), READ_AHEAD_MAX_BYTES / nrBytes));
+  const int windowStart = frameIdxInternal + readAheadDirection;
+  const int windowEnd = frameIdxInternal + nrFrames * readAheadDirection;
+  auto inWindow = [=](int idx) { return (readAheadDirection > 0) ? (idx >= windowStart && idx <= windowEnd) : (idx <= windowStart && idx >= windowEnd); };
+
+  for (int i = 1; i <= nrFrames; i++)
+  {
+    const int frameIdx = frameIdxInternal + i * readAheadDirection;
+    const qint64 startPos = getFrameStartPos(frameIdx);
+    if (frameIdx < startEndFrame.first || frameIdx > startEndFrame.second || startPos < 0)
+      break;
+
+    // Is the frame already being read? Otherwise, find a slot that is not used.
+    bool alreadyScheduled = false;
+    int freeSlot = -1;
+    for (int s = 0; s < readAheadSlots.count(); s++)
+    {
+      const readAheadSlot &slot = readAheadSlots[s];
+      if (slot.frameIdx == frameIdx)
+        alreadyScheduled = true;
+      else if (freeSlot == -1 && !slot.future.isRunning() && (slot.frameIdx == -1 || !inWindow(slot.frameIdx)))
+        freeSlot = s;
+    }
+    if (alreadyScheduled)
+      continue;
+    if (freeSlot == -1)
+      break;
+
+    DEBUG_RAWFILE("playlistItemRawFile::startReadAhead %d", frameIdx);
+    readAheadSlot &slot = readAheadSlots[freeSlot];
+    slot.frameIdx = frameIdx;
+    slot.startPos = startPos;
+    QByteArray *buffer = &slot.data;
+    fileSource *source = &dataSource;
+    slot.future = QtConcurrent::run([source, buffer, startPos, nrBytes]() { return source->readBytes(*buffer, startPos, nrBytes) >= nrBytes; });
+  }
+}
+
+void playlistItemRawFile::cancelReadAhead(bool waitForReads)
+{
+  // Reads that are already running can not be stopped. Their slots are not reused until the reads are finished.
+  for (readAheadSlot &slot : readAheadSlots)
+  {
+    slot.frameIdx = -1;
+    if (waitForReads)
+      slot.future.waitForFinished();
+  }
+}
+
+qint64 playlistItemRawFile::getFrameStartPos(int frameIdxInternal) const
+{
+  if (frameIdxInternal < 0)
+    return -1;
+  if (isY4MFile)
+  {
+    QMutexLocker lock(&y4mFrameIndicesMutex);
+    return (frameIdxInternal < y4mFrameIndices.count()) ? qint64(y4mFrameIndices.at(frameIdxInternal)) : -1;
+  }
+  return frameIdxInternal * getBytesPerFrame();
+}
+
+bool playlistItemRawFile::readRawFrame(int frameIdxInternal, QByteArray &rawData)
+{
+  qint64 fileStartPos = getFrameStartPos(frameIdxInternal);
+  qint64 nrBytes = getBytesPerFrame();
+  if (fileStartPos < 0)
+    return false;
+
+  if (mappingRef != nullptr)
+  {
+    // No copy. The converter reads the data directly from the mapping.
+    QByteArray mappedData = dataSource.getMappedBytes(fileStartPos, nrBytes, *mappingRef);
+    if (!mappedData.isEmpty())
+    {
+      rawData = mappedData;
+      return true;
+    }
+  }
+
+  return dataSource.readBytes(rawData, fileStartPos, nrBytes) >= nrBytes;
+}
+
+void playlistItemRawFile::updateMemoryMapping()
+{
+  QSettings settings;
+  dataSource.setMemoryMapping(settings.value("MemoryMapRawFiles", false).toBool() && !followGrowingFile);
+}
+
+void playlistItemRawFile::cacheFrame(int frameIdx, bool testMode)
+{
+  if (testMode)
+    dataSource.clearFileCache();
+
+  if (rawFormat != YUV)
+  {
+    playlistItemWithVideo::cacheFrame(frameIdx, testMode);
+    return;
+  }
+
+  if (!cachingEnabled || !video->isFormatValid())
+    return;
+
+  // Read the frame into a local buffer instead of the shared raw data buffer of the videoHandlerYUV.
+  // The reads from the file do not block each other so multiple threads can cache frames at the same time.
+  const int frameIdxInternal = getFrameIdxInternal(frameIdx);
+  if (!video->needsCaching(frameIdxInternal, testMode))
+    return;
+  // The raw data cache must hold its own copy of the frame and not a reference into the mapping. Otherwise, the
+  // frame is converted directly from the mapping which stays mapped until the conversion is done.
+  QSharedPointer<QFile> mappingRef;
+  QByteArray rawData;
+  if (!readRawFrame(frameIdxInternal, rawData, video->isCachingRawData() ? nullptr : &mappingRef))
+    return;
+  video->cacheFrame(frameIdxInternal, rawData, testMode);
+}
+
+void playlistItemRawFile::updateSettings()
+{
+  dataSource.updateFileWatchSetting();
+
+  QSettings settings;
+  followGrowingFile = settings.value("FollowGrowingFiles", false).toBool();
+  if (followGrowingFile)
+    followTimer.start(1000, this);
+  else
+    followTimer.stop();
+
+  updateMemoryMapping();
+}
+
+bool playlistItemRawFile::isSourceChanged()
+{
+  // If frames were only appended to a file that is followed, this is no change that requires a reload
+  if (followGrowingFile)
+    followAppendedFrames();
+  return dataSource.isFileChanged();
+}
+
+void playlistItemRawFile::timerEvent(QTimerEvent *event)
+{
+  if (event->timerId() != followTimer.timerId())
+    return playlistItemWithVideo::timerEvent(event);
+  followAppendedFrames();
+}
+
+void playlistItemRawFile::followAppendedFrames()
+{
+  if (!video->isFormatValid())
+    return;
+
+  const int nrFramesBefore = int(getNumberFrames());
+  if (dataSource.updateAppendedData() <= 0)
+    // Nothing was appended or the file was modified in another way. In that case, the file watcher will ask the user to reload it.
+    return;
+  if (isY4MFile)
+    parseAppendedY4MFrames();
+
+  const int nrFrames = int(getNumberFrames());
+  if (nrFrames == nrFramesBefore)
+    return;
+  DEBUG_RAWFILE("playlistItemRawFile::followAppendedFrames %d frames", nrFrames);
+
+  // If the end frame was the last frame, it stays the last frame
+  indexRange range = startEndFrame;
+  if (range.second == nrFramesBefore - 1)
+    range.second = nrFrames - 1;
+  setStartEndFrame(range, false);
+
+  // The new frames can be cached
+  emit signalItemChanged(false, RECACHE_UPDATE);
+}
+
+void playlistItemRawFile::parseAppendedY4MFrames()
+{
+  // Continue behind the last frame. Only frames that were written completely are added.
+  QMutexLocker lock(&y4mFrameIndicesMutex);
+  if (y4mFrameIndices.isEmpty())
+    return;
+  qint64 offset = y4mFrameIndices.last() + y4mFrameStride;
+  QByteArray rawData;
+  while (dataSource.readBytes(rawData, offset, 20) == 20 && rawData.startsWith("FRAME"))
+  {
+    int internalOffset = 5;
+    while (internalOffset < 20 && rawData.at(internalOffset) != 10)
+      internalOffset++;
+    if (internalOffset == 20 || offset + internalOffset + 1 + y4mFrameStride > dataSource.getFileSize())
+      break;
+
+    offset += internalOffset + 1;
+    y4mFrameIndices.append(offset);
+    offset += y4mFrameStride;
+  }
+}
+
 ValuePairListSets playlistItemRawFile::getPixelValues(const QPoint &pixelPos, int frameIdx)
 {
   const int frameIdxInternal = getFrameIdxInternal(frameIdx);
@@ -523,6 +796,9 @@ qint64 playlistItemRawFile::getBytesPerFrame() const
 
 void playlistItemRawFile::reloadItemSource()
 {
+  // The frames that were read ahead are invalid now
+  cancelReadAhead(true);
+
   // Reopen the file
   dataSource.openFile(plItemNameOrFileName);
   if (!dataSource.isOk())
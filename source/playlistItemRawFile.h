@@ -33,8 +33,11 @@
 #ifndef PLAYLISTITEMRAWFILE_H
 #define PLAYLISTITEMRAWFILE_H
 
+#include <QBasicTimer>
 #include <QFuture>
+#include <QMutex>
 #include <QString>
+#include <QVector>
 #include "fileSource.h"
 #include "playlistItemWithVideo.h"
 #include "typedef.h"
@@ -50,6 +53,7 @@ public:
   // extensions (getSupportedFileExtensions), set the format "fmt" to either "rgb" or "yuv". If you already know the frame size and/or 
   // sourcePixelFormat, you can set them as well.
   playlistItemRawFile(const QString &rawFilePath, const QSize &frameSize=QSize(-1,-1), const QString &sourcePixelFormat=QString(), const QString &fmt=QString());
+  ~playlistItemRawFile();
 
   // Overload from playlistItem. Save the raw file item to playlist.
   virtual void savePlaylist(QDomElement &root, const QDir &playlistDir) const Q_DECL_OVERRIDE;
@@ -71,17 +75,17 @@ public:
   static void getSupportedFileExtensions(QStringList &allExtensions, QStringList &filters);
 
   // ----- Detection of source/file change events -----
-  virtual bool isSourceChanged()  Q_DECL_OVERRIDE { return dataSource.isFileChanged(); }
+  virtual bool isSourceChanged()  Q_DECL_OVERRIDE;
   virtual void reloadItemSource() Q_DECL_OVERRIDE;
-  virtual void updateSettings()   Q_DECL_OVERRIDE { dataSource.updateFileWatchSetting(); }
+  virtual void updateSettings()   Q_DECL_OVERRIDE;
 
-  // Cache the given frame
-  virtual void cacheFrame(int idx, bool testMode) Q_DECL_OVERRIDE { if (testMode) dataSource.clearFileCache(); playlistItemWithVideo::cacheFrame(idx, testMode); }
+  // Cache the given frame. YUV frames are read into a local buffer so that multiple threads can cache frames at the same time.
+  virtual void cacheFrame(int idx, bool testMode) Q_DECL_OVERRIDE;
 
 public slots:
   // Load the raw data for the given frame index from file. This slot is called by the videoHandler if the frame that is
   // requested to be drawn has not been loaded yet.
-  virtual void loadRawData(int frameIdxInternal);
+  virtual void loadRawData(int frameIdxInternal, bool caching);
 
 protected:
   // Override from playlistItemIndexed. For a raw file the index range is 0...numFrames-1. 
@@ -114,6 +118,41 @@ private:
   const videoHandlerRGB *getRGBVideo() const { return dynamic_cast<const videoHandlerRGB*>(video.data()); }
 
   qint64 getBytesPerFrame() const;
+  // Get the position of the given frame in the file (-1 if invalid)
+  qint64 getFrameStartPos(int frameIdxInternal) const;
+  // Read the raw data of the given frame from the file. Return false if reading failed.
+  // If the file is memory mapped and mappingRef is given, the returned array directly references the mapping. The
+  // array may only be used as long as mappingRef is held. Otherwise the data is copied into rawData.
+  bool readRawFrame(int frameIdxInternal, QByteArray &rawData, QSharedPointer<QFile> *mappingRef=nullptr);
+  // Map the file if this is enabled in the settings. A file that is followed may be truncated or rewritten while it
+  // is open. It is not mapped but read with positional reads.
+  void updateMemoryMapping();
+  // The last frame that was loaded by loadRawData. Used to give the OS a hint on the access pattern.
+  int lastLoadedFrameIdx;
+
+  // --- Read ahead: If the frames are loaded one after the other (playback), the next frames in the playback direction
+  // are read in the background so that the next call to loadRawData does not have to wait for the file.
+  // The buffers are reused. The read ahead is cancelled if another frame is requested (seek).
+  struct readAheadSlot
+  {
+    readAheadSlot() : frameIdx(-1), startPos(-1) {}
+    int frameIdx;      // The frame that is read into this slot (-1 if the slot is free)
+    qint64 startPos;   // The position in the file that the frame was read from
+    QByteArray data;
+    QFuture<bool> future;
+  };
+  QVector<readAheadSlot> readAheadSlots;
+  int readAheadDirection;
+  // Get the frame from the read ahead buffers. The data is swapped into rawData. Return false if the frame is not there.
+  bool takeReadAheadFrame(int frameIdxInternal, QByteArray &rawData);
+  void startReadAhead(int frameIdxInternal);
+  void cancelReadAhead(bool waitForReads=false);
+
+  // Follow a file that is still being written. The timer regularly checks if frames were appended to the file.
+  bool followGrowingFile;
+  QBasicTimer followTimer;
+  virtual void timerEvent(QTimerEvent *event) Q_DECL_OVERRIDE; // Overloaded from QObject. Called when the timer fires.
+  void followAppendedFrames();
 
   // A y4m file is a raw YUV file but it adds a header (which has information about the YUV format)
   // and start indicators for every frame. This file will parse the header and save all the byte
@@ -121,6 +160,10 @@ private:
   bool parseY4MFile();
   bool isY4MFile;
   QList<quint64> y4mFrameIndices;
+  qint64 y4mFrameStride;
+  // The frames that were appended to a followed file are added while other threads read the frame positions
+  mutable QMutex y4mFrameIndicesMutex;
+  void parseAppendedY4MFrames();
 };
 
 #endif // PLAYLISTITEMRAWFILE_H
@@ -32,6 +32,8 @@
 
 #include "playlistItemWithVideo.h"
 
+#include <QElapsedTimer>
+
 // Activate this if you want to know when which buffer is loaded/converted to image and so on.
 #define PLAYLISTITEMWITHVIDEO_DEBUG_LOADING 0
 #if PLAYLISTITEMWITHVIDEO_DEBUG_LOADING && !NDEBUG
@@ -53,6 +55,8 @@ void playlistItemWithVideo::connectVideo()
 {
   // Forward these signals from the video source up
   connect(video.data(), &videoHandler::signalHandlerChanged, this, &playlistItem::signalItemChanged);
+  // This is emitted while drawing. Check for loading after the draw event is done.
+  connect(video.data(), &videoHandler::signalCurrentFrameLoadingNeeded, this, [this]{ emit signalItemChanged(true, RECACHE_NONE); }, Qt::QueuedConnection);
 }
 
 void playlistItemWithVideo::drawItem(QPainter *painter, int frameIdx, double zoomFactor, bool drawRawValues)
@@ -73,13 +77,17 @@ void playlistItemWithVideo::loadFrame(int frameIdx, bool playing, bool loadRawDa
 {
   const int frameIdxInternal = getFrameIdxInternal(frameIdx);
   auto state = video->needsLoading(frameIdxInternal, loadRawData);
+  lastFrameLoadDurationMs = -1;
 
   if (state == LoadingNeeded)
   {
     // Load the requested current frame
     DEBUG_PLVIDEO("playlistItemWithVideo::loadFrame loading frame %d%s%s", frameIdxInternal, playing ? " playing" : "", loadRawData ? " raw" : "");
     isFrameLoading = true;
+    QElapsedTimer loadTimer;
+    loadTimer.start();
     video->loadFrame(frameIdxInternal);
+    lastFrameLoadDurationMs = loadTimer.nsecsElapsed() / 1000000.0;
     isFrameLoading = false;
     if (emitSignals)
       emit signalItemChanged(true, RECACHE_NONE);
@@ -123,4 +131,13 @@ QList<int> playlistItemWithVideo::getCachedFrames() const
   for (int i : internalIndices)
     retList.append(getFrameIdxExternal(i));
   return retList;
+}
+
+QList<indexRange> playlistItemWithVideo::getCachedFrameRanges() const
+{
+  // Convert the ranges from internal to external indices
+  QList<indexRange> retList = video->getCachedFrameRanges();
+  for (indexRange &r : retList)
+    r = indexRange(getFrameIdxExternal(r.first), getFrameIdxExternal(r.second));
+  return retList;
 }
\ No newline at end of file
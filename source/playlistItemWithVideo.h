@@ -62,9 +62,11 @@ public:
   virtual void cacheFrame(int frameIdx, bool testMode) Q_DECL_OVERRIDE { if (!cachingEnabled) return; video->cacheFrame(getFrameIdxInternal(frameIdx), testMode); }
   // Get a list of all cached frames (just the frame indices)
   virtual QList<int> getCachedFrames() const Q_DECL_OVERRIDE;
+  virtual QList<indexRange> getCachedFrameRanges() const Q_DECL_OVERRIDE;
   virtual int getNumberCachedFrames() const Q_DECL_OVERRIDE { return video->getNumberCachedFrames(); }
   // How many bytes will caching one frame use (in bytes)?
   virtual unsigned int getCachingFrameSize() const Q_DECL_OVERRIDE { return video->getCachingFrameSize(); }
+  virtual bool isCachingRawData() const Q_DECL_OVERRIDE { return video->isCachingRawData(); }
   // Remove the given frame from the cache
   virtual void removeFrameFromCache(int idx) Q_DECL_OVERRIDE { video->removeFrameFromCache(getFrameIdxInternal(idx)); }
   virtual void removeAllFramesFromCache() Q_DECL_OVERRIDE { video->removeAllFrameFromCache(); }
@@ -73,28 +73,11 @@ public:
     }
 
     // Draw the cached frames
-    QList<int> frameList = plItem->getCachedFrames();
     indexRange range = plItem->getFrameIdxRange();
-    if (frameList.count() > 0)
+    for (const indexRange &cached : plItem->getCachedFrameRanges())
     {
-      int lastPos = frameList[0];
-      for (int i = 1; i < frameList.count(); i++)
-      {
-        int pos = frameList[i];
-        if (pos > lastPos + 1)
-        {
-          // This is the end of a block. Draw it
-          int xStart = (int)((float)lastPos / range.second * s.width());
-          int xEnd   = (int)((float)pos     / range.second * s.width());
-          painter.fillRect(xStart, 0, xEnd - xStart, s.height(), QColor(33,150,243));
-
-          // A new rectangle starts here
-          lastPos = pos;
-        }
-      }
-      // Draw the last rectangle that goes to the end of the list
-      int xStart = (int)((float)lastPos / range.second * s.width());
-      int xEnd   = (int)((float)frameList.last() / range.second * s.width());
+      int xStart = (int)((float)cached.first / range.second * s.width());
+      int xEnd   = (int)((float)cached.second / range.second * s.width());
       painter.fillRect(xStart, 0, xEnd - xStart, s.height(), QColor(33,150,243));
     }
 
@@ -41,6 +41,7 @@
 #include "hevcNextGenDecoderJEM.h"
 #include "hevcDecoderHM.h"
 #include "hevcDecoderLibde265.h"
+#include "videoCacheEvictionPolicy.h"
 
 #define MIN_CACHE_SIZE_IN_MB (20u)
 
@@ -58,6 +59,8 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
 
   // "Generals" tab
   ui.checkBoxWatchFiles->setChecked(settings.value("WatchFiles", true).toBool());
+  ui.checkBoxFollowGrowingFiles->setChecked(settings.value("FollowGrowingFiles", false).toBool());
+  ui.checkBoxMemoryMapRawFiles->setChecked(settings.value("MemoryMapRawFiles", false).toBool());
   ui.checkBoxContinuePlaybackNewSelection->setChecked(settings.value("ContinuePlaybackOnSequenceSelection", false).toBool());
   ui.checkBoxAskToSave->setChecked(settings.value("AskToSaveOnExit", true).toBool());
   // UI
@@ -113,12 +116,18 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
   else
     ui.spinBoxNrThreads->setValue(getOptimalThreadCount());
   ui.spinBoxNrThreads->setEnabled(ui.checkBoxNrThreads->isChecked());
+  ui.comboBoxEvictionPolicy->addItems(videoCacheEvictionPolicy::getPolicyNames());
+  ui.comboBoxEvictionPolicy->setCurrentIndex(settings.value("EvictionPolicy", videoCacheEvictionPolicy::PolicyPlaylistOrder).toInt());
   // Playback
   ui.checkBoxPausPlaybackForCaching->setChecked(settings.value("PlaybackPauseCaching", true).toBool());
   bool playbackCaching = settings.value("PlaybackCachingEnabled", false).toBool();
   ui.checkBoxEnablePlaybackCaching->setChecked(playbackCaching);
   ui.spinBoxThreadLimit->setValue(settings.value("PlaybackCachingThreadLimit", 1).toInt());
   ui.spinBoxThreadLimit->setEnabled(playbackCaching);
+  // Spill file
+  ui.groupBoxSpillFile->setChecked(settings.value("SpillFileEnabled", false).toBool());
+  ui.spinBoxSpillFileSize->setValue(settings.value("SpillFileSizeMB", 4000).toInt());
+  ui.checkBoxSpillFileCompression->setChecked(settings.value("SpillFileCompression", false).toBool());
   settings.endGroup();
 
   // "Decoders" tab
@@ -127,6 +136,12 @@ SettingsDialog::SettingsDialog(QWidget *parent) :
   ui.lineEditLibde265File->setText(settings.value("libde265File", "").toString());
   ui.lineEditLibHMFile->setText(settings.value("libHMFile", "").toString());
   ui.lineEditLibJEMFile->setText(settings.value("libJEMFile", "").toString());
+  ui.checkBoxLibde265Threads->setChecked(settings.value("SetLibde265Threads", false).toBool());
+  if (ui.checkBoxLibde265Threads->isChecked())
+    ui.spinBoxLibde265Threads->setValue(settings.value("Libde265Threads", getOptimalThreadCount()).toInt());
+  else
+    ui.spinBoxLibde265Threads->setValue(getOptimalThreadCount());
+  ui.spinBoxLibde265Threads->setEnabled(ui.checkBoxLibde265Threads->isChecked());
   // FFMpeg files
   ui.lineEditAVFormat->setText(settings.value("FFMpeg.avformat", "").toString());
   ui.lineEditAVCodec->setText(settings.value("FFMpeg.avcodec", "").toString());
@@ -152,6 +167,13 @@ void SettingsDialog::on_checkBoxNrThreads_stateChanged(int newState)
     ui.spinBoxNrThreads->setValue(getOptimalThreadCount());
 }
 
+void SettingsDialog::on_checkBoxLibde265Threads_stateChanged(int newState)
+{
+  ui.spinBoxLibde265Threads->setEnabled(newState);
+  if (newState == Qt::Unchecked)
+    ui.spinBoxLibde265Threads->setValue(getOptimalThreadCount());
+}
+
 void SettingsDialog::on_checkBoxEnablePlaybackCaching_stateChanged(int state)
 {
   // Enable/disable the spinBoxThreadLimit
@@ -307,6 +329,8 @@ void SettingsDialog::on_pushButtonSave_clicked()
 
   // "General" tab
   settings.setValue("WatchFiles", ui.checkBoxWatchFiles->isChecked());
+  settings.setValue("FollowGrowingFiles", ui.checkBoxFollowGrowingFiles->isChecked());
+  settings.setValue("MemoryMapRawFiles", ui.checkBoxMemoryMapRawFiles->isChecked());
   settings.setValue("ContinuePlaybackOnSequenceSelection", ui.checkBoxContinuePlaybackNewSelection->isChecked());
   settings.setValue("AskToSaveOnExit", ui.checkBoxAskToSave->isChecked());
   // UI
@@ -335,9 +359,13 @@ void SettingsDialog::on_pushButtonSave_clicked()
   settings.setValue("ThresholdValueMB", getCacheSizeInMB());
   settings.setValue("SetNrThreads", ui.checkBoxNrThreads->isChecked());
   settings.setValue("NrThreads", ui.spinBoxNrThreads->value());
+  settings.setValue("EvictionPolicy", ui.comboBoxEvictionPolicy->currentIndex());
   settings.setValue("PlaybackPauseCaching", ui.checkBoxPausPlaybackForCaching->isChecked());
   settings.setValue("PlaybackCachingEnabled", ui.checkBoxEnablePlaybackCaching->isChecked());
   settings.setValue("PlaybackCachingThreadLimit", ui.spinBoxThreadLimit->value());
+  settings.setValue("SpillFileEnabled", ui.groupBoxSpillFile->isChecked());
+  settings.setValue("SpillFileSizeMB", ui.spinBoxSpillFileSize->value());
+  settings.setValue("SpillFileCompression", ui.checkBoxSpillFileCompression->isChecked());
   settings.endGroup();
 
   // "Decoders" tab
@@ -347,6 +375,8 @@ void SettingsDialog::on_pushButtonSave_clicked()
   settings.setValue("libde265File", ui.lineEditLibde265File->text());
   settings.setValue("libHMFile", ui.lineEditLibHMFile->text());
   settings.setValue("libJEMFile", ui.lineEditLibJEMFile->text());
+  settings.setValue("SetLibde265Threads", ui.checkBoxLibde265Threads->isChecked());
+  settings.setValue("Libde265Threads", ui.spinBoxLibde265Threads->value());
   // FFMpeg files
   settings.setValue("FFMpeg.avformat", ui.lineEditAVFormat->text());
   settings.setValue("FFMpeg.avcodec", ui.lineEditAVCodec->text());
@@ -52,6 +52,7 @@ private slots:
   void on_sliderThreshold_valueChanged(int value);
   // Caching threads check box
   void on_checkBoxNrThreads_stateChanged(int newState);
+  void on_checkBoxLibde265Threads_stateChanged(int newState);
   void on_checkBoxEnablePlaybackCaching_stateChanged(int state);
 
   // Colors buttons
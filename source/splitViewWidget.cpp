@@ -1796,6 +1796,9 @@ void splitViewWidget::update(bool newFrame, bool itemRedraw)
     if (item[0])
     {
       auto state = item[0]->needsLoading(frameIdx, loadRawData);
+      if (newFrame && !isSeparateWidget)
+        // Let the cache know which frames are used (and if they were in the cache)
+        cache->frameAccessed(item[0], frameIdx, state != LoadingNeeded);
       if (state == LoadingNeeded)
       {
         // The frame needs to be loaded first.
@@ -1816,6 +1819,9 @@ void splitViewWidget::update(bool newFrame, bool itemRedraw)
     if (splitting && item[1])
     {
       auto state = item[1]->needsLoading(frameIdx, loadRawData);
+      if (newFrame && !isSeparateWidget)
+        // Let the cache know which frames are used (and if they were in the cache)
+        cache->frameAccessed(item[1], frameIdx, state != LoadingNeeded);
       if (state == LoadingNeeded)
       {
         // The frame needs to be loaded first.
@@ -33,14 +33,19 @@
 #include "videoCache.h"
 
 #include <algorithm>
+#include <cstdlib>
 #include <QMessageBox>
 #include <QPainter>
 #include <QScrollArea>
+#include <QSet>
 #include <QSettings>
 #include <QStylePainter>
 #include <QThread>
+#include "indexRangeSet.h"
 #include "playbackController.h"
 #include "playlistItem.h"
+#include "videoCacheSpillFile.h"
+#include "videoHandler.h"
 
 // This debug setting has two values:
 // 1: Basic operation is written to qDebug: If a new item is selected, what is the decision to cache/remove next?
@@ -60,9 +65,14 @@
 #define DEBUG_CACHING_DETAIL(fmt,...) ((void)0)
 #endif
 
-videoCache::cacheJob::cacheJob(playlistItem *item, indexRange range) :
+// The maximum number of per frame access times that are kept for an item. If there are more, the
+// access times of frames that are not in the cache are dropped.
+#define MAX_NR_FRAME_ACCESS_ENTRIES 10000
+
+videoCache::cacheJob::cacheJob(playlistItem *item, indexRange range, bool inOrder) :
   plItem(item),
-  frameRange(range)
+  frameRange(range),
+  decodeInOrder(inOrder)
 {
 }
 
@@ -93,6 +103,9 @@ void videoCacheStatusWidget::paintEvent(QPaintEvent *event)
   for (int i = 0; i < relativeValsEnd.count(); i++)
   {
     QColor c = colors.at(i % colors.count());
+    if (blockIsRawData.at(i))
+      // Items that cache raw frames are drawn in a lighter color
+      c = c.lighter(140);
     float endVal = relativeValsEnd.at(i);
     int xEnd = int(endVal * width);
     painter.fillRect(xStart, 0, xEnd - xStart, height, c);
@@ -103,7 +116,13 @@ void videoCacheStatusWidget::paintEvent(QPaintEvent *event)
 
   // Draw the fill status as text
   //painter.setBrush(palette().windowText());
-  QString pTxt = QString("%1 MB / %2 MB / %3 KB/s").arg(cacheLevelMB).arg(cacheLevelMaxMB).arg(cacheRateInBytesPerMs);
+  QString pTxt = QString("%1 MB").arg(cacheLevelMB);
+  if (cacheLevelRawMB > 0)
+    pTxt += QString(" (%1 MB raw)").arg(cacheLevelRawMB);
+  pTxt += QString(" / %1 MB").arg(cacheLevelMaxMB);
+  if (spillLevelMB > 0)
+    pTxt += QString(" / %1 MB on disk").arg(spillLevelMB);
+  pTxt += QString(" / %1 KB/s").arg(cacheRateInBytesPerMs);
   painter.drawText(0, 0, width, height, Qt::AlignCenter, pTxt);
 
   // Only draw the border
@@ -125,10 +144,12 @@ void videoCacheStatusWidget::updateStatus(PlaylistTreeWidget *playlist, unsigned
 
   // Clear the old percent values
   relativeValsEnd.clear();
+  blockIsRawData.clear();
 
   // Let's find out how much space in the cache is used.
   // In combination with cacheLevelMax we also know how much space is free.
   qint64 cacheLevel = 0;
+  qint64 cacheLevelRaw = 0;
   for (int i = 0; i < allItems.count(); i++)
   {
     playlistItem *item = allItems.at(i);
@@ -139,11 +160,16 @@ void videoCacheStatusWidget::updateStatus(PlaylistTreeWidget *playlist, unsigned
 
     float endVal = (float)(cacheLevel + itemCacheSize) / cacheLevelMax;
     relativeValsEnd.append(endVal);
+    blockIsRawData.append(item->isCachingRawData());
     cacheLevel += itemCacheSize;
+    if (item->isCachingRawData())
+      cacheLevelRaw += itemCacheSize;
   }
 
   // Save the values that will be shown as text
   cacheLevelMB = cacheLevel / 1000000;
+  cacheLevelRawMB = cacheLevelRaw / 1000000;
+  spillLevelMB = videoCacheSpillFile::globalInstance()->getUsedSize() / 1000000;
   cacheRateInBytesPerMs = cacheRate;
 
   // Also redraw if the values were updated
@@ -154,8 +180,13 @@ class loadingWorker : public QObject
 {
   Q_OBJECT
 public:
-  loadingWorker(QObject *parent) : QObject(parent) { currentCacheItem = nullptr; working = false; id = id_counter++; }
+  loadingWorker(QObject *parent) : QObject(parent) { currentCacheItem = nullptr; working = false; lastJobDurationMs = 0; lastJobFrame = -1; id = id_counter++; }
   playlistItem *getCacheItem() { return currentCacheItem; }
+  int getCacheFrame() { return currentFrame; }
+  // The item of the last finished job and how long the job took
+  playlistItem *getLastJobItem() { return lastJobItem; }
+  int getLastJobFrame() { return lastJobFrame; }
+  double getLastJobDuration() { return lastJobDurationMs; }
   void setJob(playlistItem *item, int frame, bool test=false) { currentCacheItem = item; currentFrame = frame; testMode = test; }
   void setWorking(bool state) { working = state; }
   bool isWorking() { return working; }
@@ -172,6 +203,9 @@ private slots:
 private:
   playlistItem *currentCacheItem;
   int currentFrame;
+  QPointer<playlistItem> lastJobItem;
+  int lastJobFrame;
+  double lastJobDurationMs;
   bool working;
   bool testMode;
   int id;   // A static ID of the thread. Only used in getStatus().
@@ -186,7 +220,12 @@ void loadingWorker::processCacheJobInternal()
 
   // Just cache the frame that was given to us.
   // This is performed in the thread that this worker is currently placed in.
+  QElapsedTimer jobTimer;
+  jobTimer.start();
   currentCacheItem->cacheFrame(currentFrame, testMode);
+  lastJobDurationMs = jobTimer.nsecsElapsed() / 1000000.0;
+  lastJobItem = currentCacheItem;
+  lastJobFrame = currentFrame;
   
   currentCacheItem = nullptr;
   emit loadingFinished();
@@ -198,7 +237,12 @@ void loadingWorker::processLoadingJobInternal(bool playing, bool loadRawData)
 
   // Load the frame of the item that was given to us.
   // This is performed in the thread (the loading thread with higher priority.
+  QElapsedTimer jobTimer;
+  jobTimer.start();
   currentCacheItem->loadFrame(currentFrame, playing, loadRawData);
+  lastJobDurationMs = jobTimer.nsecsElapsed() / 1000000.0;
+  lastJobItem = currentCacheItem;
+  lastJobFrame = currentFrame;
 
   emit loadingFinished();
   currentCacheItem = nullptr;
@@ -251,6 +295,14 @@ videoCache::videoCache(PlaylistTreeWidget *playlistTreeWidget, PlaybackControlle
   watchingItem = nullptr;
   workerState = workerIdle;
   testMode = false;
+  cacheDeQueueReversed = false;
+  cacheQueueInvalid = true;
+  cacheLevelCurrent = 0;
+  accessCounter = 0;
+  nrCacheHits = 0;
+  nrCacheMisses = 0;
+  nrEvictedFrames = 0;
+  missReloadTimeMs = 0;
   
   // Create the interactive threads
   for (int i=0; i<2; i++)
@@ -335,6 +387,17 @@ void videoCache::updateSettings()
   settings.beginGroup("VideoCache");
   cachingEnabled = settings.value("Enabled", true).toBool();
   cacheLevelMax = (qint64)settings.value("ThresholdValueMB", 49).toUInt() * 1000 * 1000;
+  updateFreeCacheSpace();
+
+  // The spill file on disk for decoded frames that are removed from the cache
+  const bool spillFileEnabled = cachingEnabled && settings.value("SpillFileEnabled", false).toBool();
+  const qint64 spillFileSize = (qint64)settings.value("SpillFileSizeMB", 4000).toUInt() * 1000 * 1000;
+  videoCacheSpillFile::globalInstance()->setup(spillFileEnabled, spillFileSize, settings.value("SpillFileCompression", false).toBool());
+
+  // Which frames are removed from the cache first?
+  int policy = clip(settings.value("EvictionPolicy", videoCacheEvictionPolicy::PolicyPlaylistOrder).toInt(), 0, videoCacheEvictionPolicy::PolicyNum - 1);
+  if (evictionPolicy.isNull() || evictionPolicy->getType() != policy)
+    evictionPolicy.reset(videoCacheEvictionPolicy::create(videoCacheEvictionPolicy::policyType(policy)));
 
   // See if the user changed the number of threads
   int targetNrThreads = getOptimalThreadCount();
@@ -382,6 +445,7 @@ void videoCache::updateSettings()
   }
 
   // Also update the cache status and schedule an update of the caching.
+  cacheQueueInvalid = true;
   updateCacheStatus();
   scheduleCachingListUpdate();
 
@@ -415,6 +479,87 @@ void videoCache::loadFrame(playlistItem * item, int frameIndex, int loadingSlot)
   }
 }
 
+void videoCache::frameAccessed(playlistItem *item, int frameIndex, bool cacheHit)
+{
+  if (item == nullptr || item->taggedForDeletion())
+    return;
+
+  if (cacheHit)
+    nrCacheHits++;
+  else
+    nrCacheMisses++;
+
+  accessCounter++;
+  itemAccessInfo &info = accessInfo[item];
+  if (!cacheHit)
+  {
+    // The frame will be loaded by an interactive thread. Measure how long that takes.
+    info.missPending = true;
+    info.missedFrame = frameIndex;
+  }
+  if (info.lastFrame >= 0 && frameIndex != info.lastFrame)
+    info.direction = (frameIndex > info.lastFrame) ? 1 : -1;
+  info.lastAccess = accessCounter;
+  info.lastFrame = frameIndex;
+  if (item->isIndexedByFrame())
+  {
+    auto previousAccess = info.frameAccess.find(frameIndex);
+    if (previousAccess != info.frameAccess.end())
+      info.accessOrder.remove(*previousAccess);
+    info.frameAccess[frameIndex] = accessCounter;
+    info.accessOrder.insert(accessCounter, frameIndex);
+    if (info.frameAccess.count() > MAX_NR_FRAME_ACCESS_ENTRIES)
+    {
+      // Only the access times of frames that are in the cache are of interest for the eviction policy.
+      // Drop the rest so that the history does not grow without bound while playing long sequences.
+      const indexRangeSet cachedFrames(item->getCachedFrameRanges());
+      for (auto it = info.frameAccess.begin(); it != info.frameAccess.end();)
+      {
+        if (it.key() != frameIndex && !cachedFrames.contains(it.key()))
+        {
+          info.accessOrder.remove(it.value());
+          it = info.frameAccess.erase(it);
+        }
+        else
+          ++it;
+      }
+    }
+  }
+}
+
+void videoCache::forgetFrameAccess(const playlistItem *item, int frameIndex)
+{
+  auto it = accessInfo.find(item);
+  if (it == accessInfo.end())
+    return;
+  auto frame = it->frameAccess.find(frameIndex);
+  if (frame != it->frameAccess.end())
+  {
+    it->accessOrder.remove(*frame);
+    it->frameAccess.erase(frame);
+  }
+}
+
+void videoCache::forgetAllFrameAccesses(const playlistItem *item)
+{
+  auto it = accessInfo.find(item);
+  if (it != accessInfo.end())
+  {
+    it->frameAccess.clear();
+    it->accessOrder.clear();
+  }
+}
+
+void videoCache::addReloadCostMeasurement(const playlistItem *item, double durationMs)
+{
+  itemAccessInfo &info = accessInfo[item];
+  if (info.reloadCost < 0)
+    info.reloadCost = durationMs;
+  else
+    // Use a moving average so that the estimate follows changes of the item (e.g. switching to caching of raw data)
+    info.reloadCost = 0.9 * info.reloadCost + 0.1 * durationMs;
+}
+
 void videoCache::interactiveLoaderFinished()
 {
   // Get the thread that caused this call
@@ -423,6 +568,26 @@ void videoCache::interactiveLoaderFinished()
   int threadID = (interactiveThread[0]->worker() == worker) ? 0 : 1;
   assert(worker == interactiveThread[0]->worker() || worker == interactiveThread[1]->worker());
 
+  // If the frame was loaded because it was not in the cache, this is the price that we paid for the miss. Other
+  // loads (e.g. of the double buffer) are not counted. Neither is the time for loading the double buffer.
+  playlistItem *loadedItem = worker->getLastJobItem();
+  if (loadedItem && !loadedItem->taggedForDeletion())
+  {
+    auto info = accessInfo.find(loadedItem);
+    if (info != accessInfo.end() && info->missPending && info->missedFrame == worker->getLastJobFrame())
+    {
+      info->missPending = false;
+      // Frames that were decoded ahead during playback were loaded in (almost) no time. This is not what it costs
+      // to reload a frame of the item.
+      const double loadDuration = loadedItem->getLastFrameLoadDuration();
+      if (loadDuration >= 0)
+      {
+        missReloadTimeMs += loadDuration;
+        addReloadCostMeasurement(loadedItem, loadDuration);
+      }
+    }
+  }
+
   // Check the list of items that are scheduled for deletion. Because a loading thread finished, maybe now we can delete the item(s).
   bool itemDeleted = false;
   for (auto it = itemsToDelete.begin(); it != itemsToDelete.end();)
@@ -513,15 +678,46 @@ void videoCache::updateCacheQueue()
   // Now calculate the new list of frames to cache and run the cacher
   DEBUG_CACHING("videoCache::updateCacheQueue");
 
-  // Firstly clear the old cache queues
-  cacheQueue.clear();
-  cacheDeQueue.clear();
-
   // Get all items from the playlist. There are two lists. For the caching status (how full is the cache) we have to consider
   // all items in the playlist. However, we only cache top level items and no child items.
   QList<playlistItem*> allItems = playlist->getAllPlaylistItems();
   QList<playlistItem*> allItemsTop = playlist->getAllPlaylistItems(true);
 
+  // If nothing that the queues depend on changed since the last update, we can keep working with the current queues.
+  QVector<qint64> newCacheQueueState = getCacheQueueState(allItems);
+  if (!cacheQueueInvalid && newCacheQueueState == cacheQueueState)
+  {
+    DEBUG_CACHING("videoCache::updateCacheQueue Nothing changed. Keeping the current queues.");
+    // Only update the entries of the items whose frame range changed (e.g. a file that is followed grew)
+    for (playlistItem *item : allItems)
+    {
+      const indexRange range = item->getFrameIdxRange();
+      indexRange &queueRange = cacheQueueFrameRanges[item];
+      if (range != queueRange)
+      {
+        updateItemFrameRange(item, queueRange, range);
+        queueRange = range;
+      }
+    }
+    // Resync the cache level in case caching of a frame failed
+    cacheLevelCurrent = 0;
+    for (playlistItem *item : allItems)
+      cacheLevelCurrent += item->getNumberCachedFrames() * qint64(item->getCachingFrameSize());
+    updateFreeCacheSpace();
+    return;
+  }
+  cacheQueueState = newCacheQueueState;
+  cacheQueueInvalid = false;
+  cacheQueueFrameRanges.clear();
+  for (playlistItem *item : allItems)
+    cacheQueueFrameRanges.insert(item, item->getFrameIdxRange());
+
+  // Firstly clear the old cache queues
+  cacheQueue.clear();
+  plannedCacheJobs.clear();
+  cacheDeQueue.clear();
+  cacheDeQueueReversed = false;
+
   if (allItemsTop.count() == 0)
     // No cachable items in the playlist.
     return;
@@ -565,11 +761,7 @@ void videoCache::updateCacheQueue()
   qint64 cacheLevel = 0;
   for (playlistItem *item : allItems)
   {
-    indexRange range = item->getFrameIdxRange();
-    QList<int> cached_frames = item->getCachedFrames();
-    for (int i : cached_frames)
-      if (i < range.first || i > range.second)
-        item->removeFrameFromCache(i);
+    removeFramesOutsideRange(item);
 
     qint64 cachingFrameSize = item->getCachingFrameSize();
     cacheLevel += item->getNumberCachedFrames() * cachingFrameSize;
@@ -584,14 +776,15 @@ void videoCache::updateCacheQueue()
     do
     {
       // Delete cached frames from this item until the cache is free enough
-      QList<int> cachedFrames = allItems[i]->getCachedFrames();
       unsigned int frameSize = allItems[i]->getCachingFrameSize();
-      for (int f : cachedFrames)
+      for (const indexRange &cached : allItems[i]->getCachedFrameRanges())
       {
-        allItems[i]->removeFrameFromCache(f);
-        cacheLevel -= frameSize;
-        if (cacheLevel < cacheLevelMax)
-          break;
+        for (int f = cached.first; f <= cached.second && cacheLevel >= cacheLevelMax; f++)
+        {
+          allItems[i]->removeFrameFromCache(f);
+          forgetFrameAccess(allItems[i], f);
+          cacheLevel -= frameSize;
+        }
       }
 
       // Go to the previous item
@@ -605,6 +798,7 @@ void videoCache::updateCacheQueue()
   }
   // Save the current level of the cache
   cacheLevelCurrent = cacheLevel;
+  updateFreeCacheSpace();
 
   // How much space do we need to cache the entire item?
   indexRange range = selection[0]->getFrameIdxRange(); // These are the frames that we want to cache
@@ -651,10 +845,8 @@ void videoCache::updateCacheQueue()
             enqueueCacheJob(allItems[i], addFrames);
             newCacheLevel += nrFramesCachable * allItems[i]->getCachingFrameSize();
             // ... and the rest should be removed (if they are cached)
-            QList<int> cachedFrames = allItems[i]->getCachedFrames();
-            for (int f : cachedFrames)
-              if (f < addFrames.first || f > addFrames.second)
-                cacheDeQueue.enqueue(plItemFrame(allItems[i], f));
+            if (addFrames.second < itemRange.second)
+              cacheDeQueue.enqueue(cacheJob(allItems[i], indexRange(addFrames.second + 1, itemRange.second)));
 
             // The cache is now full. We switch to "deleting" mode.
             adding = false;
@@ -663,9 +855,7 @@ void videoCache::updateCacheQueue()
         else
         {
           // Enqueue all frames (that are cached) from the item as "can be deleted".
-          QList<int> cachedFrames = allItems[i]->getCachedFrames();
-          for (int f : cachedFrames)
-            cacheDeQueue.enqueue(plItemFrame(allItems[i], f));
+          enqueueRemovableFrames(allItems[i]);
         }
       }
 
@@ -675,8 +865,8 @@ void videoCache::updateCacheQueue()
         i = 0;
     } while (i != itemPos);
 
-    // Done. However, the list of frames that can be deleted is sorted the wrong way around. Reverse it.
-    std::reverse(cacheDeQueue.begin(), cacheDeQueue.end());
+    // Done. However, the list of frames that can be deleted is sorted the wrong way around. Remove them in reverse order.
+    cacheDeQueueReversed = true;
   }
   else // playback is not running
   {
@@ -690,9 +880,7 @@ void videoCache::updateCacheQueue()
         if (item != selection[0])
         {
           // Mark all frames of this item as "can be removed if required"
-          QList<int> cachedFrames = item->getCachedFrames();
-          for (int f : cachedFrames)
-            cacheDeQueue.enqueue(plItemFrame(item, f));
+          enqueueRemovableFrames(item);
         }
       }
 
@@ -707,92 +895,101 @@ void videoCache::updateCacheQueue()
       DEBUG_CACHING("videoCache::updateCacheQueue Not enough space for caching, deleting frames");
       // There is currently not enough space in the cache to cache all remaining frames but in general the cache can hold all frames.
       // Delete frames from the cache until it fits.
-
-      // We go through all other items and get the frames that we will delete.
-      // We start with the item before the one before the currently selected one and go back through the list,
-      // wrap around and keep going until we are at the current selected item. Then (as the last resort) we
-      // go to the item before the currently selected one.
-      int i = itemPos - 1;
-      // Go back in the list to the previous item that is indexed
-      while(true)
-      {
-        if (i < 0)
-          i = allItems.count() - 1;
-        if (allItems[i]->isIndexedByFrame())
-          break;
-        i--;
-      }
-      // Go back one item further to the one before the one before the currently selected one.
-      i--;
-      while(true)
+      if (!evictionPolicy->keepsPlaylistOrder())
       {
-        if (i < 0)
-          i = allItems.count() - 1;
-        if (allItems[i]->isIndexedByFrame())
-          break;
-        i--;
+        // Let the eviction policy decide which frames to remove. Mark all frames of all other items as "can be removed
+        // if required". Only as many frames as needed to cache the current item will actually be removed.
+        for (playlistItem *item : allItems)
+          if (item != selection[0])
+            enqueueRemovableFrames(item);
       }
-
-      // Get the cache level without the current item (frames from the current item do not really occupy space in the cache. We want to cache them anyways)
-      qint64 cacheLevelWithoutCurrent = cacheLevel - selection[0]->getNumberCachedFrames() * qint64(selection[0]->getCachingFrameSize());
-      while ((itemSpaceNeeded + cacheLevelWithoutCurrent) > cacheLevelMax)
+      else
       {
-        if (i == itemPos)
-          // We went through the whole list and arrived back at the beginning.
-          // If playback is running, we go to the previous item at last.
-          i--;
-        if (i < 0)
+        // We go through all other items and get the frames that we will delete.
+        // We start with the item before the one before the currently selected one and go back through the list,
+        // wrap around and keep going until we are at the current selected item. Then (as the last resort) we
+        // go to the item before the currently selected one.
+        int i = itemPos - 1;
+        // Go back in the list to the previous item that is indexed
+        while(true)
         {
-          // There is no previous item or the previous item is the first one in the list
-          i = allItems.count() - 1;
+          if (i < 0)
+            i = allItems.count() - 1;
+          if (allItems[i]->isIndexedByFrame())
+            break;
+          i--;
         }
-        if (allItems[i]->getNumberCachedFrames() == 0)
+        // Go back one item further to the one before the one before the currently selected one.
+        i--;
+        while(true)
         {
+          if (i < 0)
+            i = allItems.count() - 1;
+          if (allItems[i]->isIndexedByFrame())
+            break;
           i--;
-          continue;  // Nothing to delete for this item
         }
 
-        // Which frames are cached for the item at position i?
-        QList<int> cachedFrames = allItems[i]->getCachedFrames();
-        qint64 cachedFramesSize = cachedFrames.count() * qint64(allItems[i]->getCachingFrameSize());
-
-        if (additionalItemSpaceNeeded < cachedFramesSize)
+        // Get the cache level without the current item (frames from the current item do not really occupy space in the cache. We want to cache them anyways)
+        qint64 cacheLevelWithoutCurrent = cacheLevel - selection[0]->getNumberCachedFrames() * qint64(selection[0]->getCachingFrameSize());
+        while ((itemSpaceNeeded + cacheLevelWithoutCurrent) > cacheLevelMax)
         {
-          // If we delete all frames from item i, there is more than enough space. So we only delete as many frames as needed.
-          qint64 nrFrames = additionalItemSpaceNeeded / allItems[i]->getCachingFrameSize() + 1;
+          if (i == itemPos)
+            // We went through the whole list and arrived back at the beginning.
+            // If playback is running, we go to the previous item at last.
+            i--;
+          if (i < 0)
+          {
+            // There is no previous item or the previous item is the first one in the list
+            i = allItems.count() - 1;
+          }
+          if (allItems[i]->getNumberCachedFrames() == 0)
+          {
+            i--;
+            continue;  // Nothing to delete for this item
+          }
+
+          // How much space do the cached frames of the item at position i need?
+          const qint64 frameSize = allItems[i]->getCachingFrameSize();
+          qint64 cachedFramesSize = allItems[i]->getNumberCachedFrames() * frameSize;
 
-          // Delete nrFrames frames from the back
-          for (int f = cachedFrames.count() - 1; f >= 0 && nrFrames > 0 ; f--)
+          if (additionalItemSpaceNeeded < cachedFramesSize)
           {
-            cacheDeQueue.enqueue(plItemFrame(allItems[i], cachedFrames[f]));
-            cacheLevelWithoutCurrent -= allItems[i]->getCachingFrameSize();
-            if ((cacheLevelWithoutCurrent + itemSpaceNeeded) <= cacheLevelMax)
-              // Now there is enough space
-              break;
+            // If we delete all frames from item i, there is more than enough space. So we only delete as many frames as needed.
+            qint64 nrFrames = (cacheLevelWithoutCurrent + itemSpaceNeeded - cacheLevelMax + frameSize - 1) / frameSize;
+
+            // Delete nrFrames frames from the back. Find the first frame of these.
+            QList<indexRange> cachedRanges = allItems[i]->getCachedFrameRanges();
+            int firstFrame = cachedRanges.last().second;
+            for (int r = cachedRanges.count() - 1; r >= 0 && nrFrames > 0; r--)
+            {
+              const qint64 nrFramesInRange = cachedRanges[r].second - cachedRanges[r].first + 1;
+              const qint64 nrFramesFromRange = std::min(nrFrames, nrFramesInRange);
+              firstFrame = cachedRanges[r].second - int(nrFramesFromRange) + 1;
+              nrFrames -= nrFramesFromRange;
+              cacheLevelWithoutCurrent -= nrFramesFromRange * frameSize;
+            }
+            cacheDeQueue.enqueue(cacheJob(allItems[i], indexRange(firstFrame, cachedRanges.last().second)));
           }
-        }
-        else
-        {
-          // Deleting all frames from this item will not be enough.
-          // Mark all frames of this item as "can be removed if required"
-          QList<int> cachedFrames = allItems[i]->getCachedFrames();
-          for (int f : cachedFrames)
+          else
           {
-            cacheDeQueue.enqueue(plItemFrame(allItems[i], f));
+            // Deleting all frames from this item will not be enough.
+            // Mark all frames of this item as "can be removed if required"
+            enqueueRemovableFrames(allItems[i]);
+            cacheLevelWithoutCurrent -= cachedFramesSize;
           }
-          cacheLevelWithoutCurrent -= cachedFramesSize;
-        }
 
-        if (i == itemPos-1)
-        {
-          // We went through all items and tried to delete frames but there is still not enough space.
-          // That is not possible because we determined that the curretn item should fit if we just delete enough frames.
-          DEBUG_CACHING("videoCache::updateCacheQueue ERROR! Deleting loop processed all frames but still not enough space in the cache.");
-          break;
-        }
+          if (i == itemPos-1)
+          {
+            // We went through all items and tried to delete frames but there is still not enough space.
+            // That is not possible because we determined that the curretn item should fit if we just delete enough frames.
+            DEBUG_CACHING("videoCache::updateCacheQueue ERROR! Deleting loop processed all frames but still not enough space in the cache.");
+            break;
+          }
 
-        // Go to the next (previous) item
-        i--;
+          // Go to the next (previous) item
+          i--;
+        }
       }
 
       // Enqueue the job. This is the only job.
@@ -884,37 +1081,257 @@ void videoCache::updateCacheQueue()
   }
   if (!cacheDeQueue.isEmpty())
   {
-    qDebug("videoCache::updateCacheQueue updateCacheQueue summary -- deQueue:");
-    playlistItem *lastItem = nullptr;
-    QString itemStr;
-    for (const plItemFrame &f : cacheDeQueue)
+    qDebug("videoCache::updateCacheQueue updateCacheQueue summary -- deQueue%s:", cacheDeQueueReversed ? " (reversed)" : "");
+    for (const cacheJob &j : cacheDeQueue)
     {
-      if (f.first != lastItem)
+      QString itemStr = j.plItem->getName();
+      itemStr.append(" - ");
+      itemStr.append(QString::number(j.frameRange.first) + "-" + QString::number(j.frameRange.second));
+      qDebug() << itemStr;
+    }
+  }
+#endif
+}
+
+QVector<qint64> videoCache::getCacheQueueState(const QList<playlistItem*> &allItems) const
+{
+  auto selection = playlist->getSelectedItems();
+  QVector<qint64> state;
+  state.reserve(5 + allItems.count() * 4);
+  state << qint64(quintptr((playlistItem*)selection[0])) << qint64(quintptr((playlistItem*)selection[1]));
+  state << (playback->playing() ? 1 : 0) << cacheLevelMax << evictionPolicy->getType();
+  for (playlistItem *item : allItems)
+  {
+    state << qint64(quintptr(item)) << item->getCachingFrameSize();
+    state << (item->isCachable() ? 1 : 0) << (item->isIndexedByFrame() ? 1 : 0);
+  }
+  return state;
+}
+
+void videoCache::updateItemFrameRange(playlistItem *item, indexRange oldRange, indexRange newRange)
+{
+  DEBUG_CACHING("videoCache::updateItemFrameRange %s %d-%d", item->getName().toLatin1().data(), newRange.first, newRange.second);
+  removeFramesOutsideRange(item);
+
+  // If all frames of the item were to be cached (or could be removed), this also applies to all frames in the new range.
+  // Otherwise, only the part that is still within the range of the item is kept.
+  auto updateRanges = [=](QList<cacheJob> &jobs)
+  {
+    for (auto it = jobs.begin(); it != jobs.end();)
+    {
+      if (it->plItem == item)
       {
-        // New item
-        if (lastItem != nullptr)
-          // Print the last items frames
-          qDebug() << itemStr;
-        lastItem = f.first;
-        itemStr = lastItem->getName();
-        itemStr.append(" - ");
+        if (it->frameRange == oldRange)
+          it->frameRange = newRange;
+        else
+          it->frameRange = indexRange(std::max(it->frameRange.first, newRange.first), std::min(it->frameRange.second, newRange.second));
+        if (it->frameRange.first > it->frameRange.second)
+        {
+          it = jobs.erase(it);
+          continue;
+        }
       }
-      itemStr.append(" " + QString::number(f.second));
+      ++it;
+    }
+  };
+  updateRanges(plannedCacheJobs);
+  updateRanges(cacheDeQueue);
+  requeueCacheJobs(item);
+}
+
+void videoCache::removeFramesOutsideRange(playlistItem *item)
+{
+  indexRange range = item->getFrameIdxRange();
+  for (const indexRange &cached : item->getCachedFrameRanges())
+  {
+    // Only look at the parts of the cached ranges that are outside of the range
+    for (int i = cached.first; i <= std::min(cached.second, range.first - 1); i++)
+    {
+      item->removeFrameFromCache(i);
+      forgetFrameAccess(item, i);
+    }
+    for (int i = std::max(cached.first, range.second + 1); i <= cached.second; i++)
+    {
+      item->removeFrameFromCache(i);
+      forgetFrameAccess(item, i);
     }
-    qDebug() << itemStr;
   }
-#endif
+}
+
+void videoCache::clearCacheOfItem(playlistItem *item)
+{
+  item->removeAllFramesFromCache();
+  forgetAllFrameAccesses(item);
+  // The planned frames of the item have to be cached again
+  requeueCacheJobs(item);
+}
+
+void videoCache::enqueueRemovableFrames(playlistItem *item)
+{
+  // Frames are only removed if they are cached when space is needed. So this also covers the frames that are cached later.
+  if (item->isIndexedByFrame())
+    cacheDeQueue.enqueue(cacheJob(item, item->getFrameIdxRange()));
+}
+
+bool videoCache::getNextFrameToEvict(plItemFrame &frame)
+{
+  const bool playlistOrder = evictionPolicy->keepsPlaylistOrder();
+
+  // Items without a measurement of the reload cost get the average of all measured items
+  double averageReloadCost = 0;
+  int nrMeasuredItems = 0;
+  if (!playlistOrder)
+  {
+    for (const itemAccessInfo &info : accessInfo)
+      if (info.reloadCost >= 0)
+      {
+        averageReloadCost += info.reloadCost;
+        nrMeasuredItems++;
+      }
+  }
+  averageReloadCost = (nrMeasuredItems > 0) ? averageReloadCost / nrMeasuredItems : 1.0;
+
+  bool frameFound = false;
+  double lowestScore = 0;
+  for (int j = 0; j < cacheDeQueue.count(); j++)
+  {
+    // If the cacheDeQueue is reversed, the frames are removed starting from the last frame of the last range
+    const cacheJob &job = cacheDeQueue.at(cacheDeQueueReversed ? cacheDeQueue.count() - 1 - j : j);
+    if (job.plItem.isNull())
+      continue;
+    const indexRangeSet cachedFrames(job.plItem->getCachedFrameRanges());
+    const QList<indexRange> cachedRanges = cachedFrames.getRanges(job.frameRange);
+    if (cachedRanges.isEmpty())
+      continue;
+
+    if (playlistOrder)
+    {
+      frame = plItemFrame(job.plItem, cacheDeQueueReversed ? cachedRanges.last().second : cachedRanges.first().first);
+      return true;
+    }
+
+    // All frames of the item that were never shown have the same age. Within a cached range, the frames at the ends are
+    // the farthest away from the last shown frame. Of the frames that were shown, the one that was shown the longest
+    // time ago is the oldest. One of these frames always has the lowest score so we don't have to rank all frames.
+    QList<int> candidateFrames;
+    for (int r = 0; r < cachedRanges.count(); r++)
+    {
+      const indexRange &range = cachedRanges.at(cacheDeQueueReversed ? cachedRanges.count() - 1 - r : r);
+      candidateFrames << (cacheDeQueueReversed ? range.second : range.first);
+      if (range.first != range.second)
+        candidateFrames << (cacheDeQueueReversed ? range.first : range.second);
+    }
+    const itemAccessInfo info = accessInfo.value(job.plItem);
+    for (auto it = info.accessOrder.constBegin(); it != info.accessOrder.constEnd(); ++it)
+      if (it.value() >= job.frameRange.first && it.value() <= job.frameRange.second && cachedFrames.contains(it.value()))
+      {
+        candidateFrames << it.value();
+        break;
+      }
+
+    const int lastFrame = (info.lastFrame >= 0) ? info.lastFrame : job.plItem->getFrameIdxRange().first;
+    for (int f : candidateFrames)
+    {
+      // Frames that were never shown were cached because the item was used. They get the last access of the item.
+      const quint64 lastAccess = info.frameAccess.value(f, info.lastAccess);
+
+      videoCacheEvictionPolicy::evictionCandidate c;
+      c.age = accessCounter - lastAccess;
+      c.distance = std::abs(f - lastFrame);
+      c.behind = (f - lastFrame) * info.direction < 0;
+      c.reloadCost = (info.reloadCost >= 0) ? info.reloadCost : averageReloadCost;
+
+      // Frames with the same score are removed in the order of the cacheDeQueue
+      const double score = evictionPolicy->score(c);
+      if (!frameFound || score < lowestScore)
+      {
+        frame = plItemFrame(job.plItem, f);
+        lowestScore = score;
+        frameFound = true;
+      }
+    }
+  }
+  return frameFound;
 }
 
 void videoCache::enqueueCacheJob(playlistItem* item, indexRange range)
+{
+  plannedCacheJobs.append(cacheJob(item, range));
+  cacheQueue.append(getMissingCacheJobs(item, range));
+}
+
+QList<videoCache::cacheJob> videoCache::getMissingCacheJobs(playlistItem* item, indexRange range) const
 {
   // Only schedule frames for caching that were not yet cached.
-  QList<int> cachedFrames = item->getCachedFrames();
-  int i = range.first;
-  while (cachedFrames.contains(i) && i < range.second)
-    range.first = ++i;
-  if (range.first != range.second)
-    cacheQueue.append(cacheJob(item, range));
+  indexRangeSet cachedFrames(item->getCachedFrameRanges());
+  QList<indexRange> missingRanges = cachedFrames.getMissingRanges(range);
+  QList<cacheJob> jobs;
+
+  // If multiple threads can cache the item but the frames have to be decoded in order, split the ranges at the random
+  // access points. This way, each thread can work on a different segment.
+  QList<int> randomAccessPoints;
+  if (item->cachingThreadLimit() != 1)
+    randomAccessPoints = item->getRandomAccessPoints();
+  if (randomAccessPoints.isEmpty())
+  {
+    for (const indexRange &missing : missingRanges)
+      jobs.append(cacheJob(item, missing));
+    return jobs;
+  }
+
+  for (const indexRange &missing : missingRanges)
+  {
+    auto it = std::upper_bound(randomAccessPoints.constBegin(), randomAccessPoints.constEnd(), missing.first);
+    int segmentStart = missing.first;
+    while (it != randomAccessPoints.constEnd() && *it <= missing.second)
+    {
+      jobs.append(cacheJob(item, indexRange(segmentStart, *it - 1), true));
+      segmentStart = *it;
+      it++;
+    }
+    jobs.append(cacheJob(item, indexRange(segmentStart, missing.second), true));
+  }
+  return jobs;
+}
+
+void videoCache::requeueCacheJobs(playlistItem *item)
+{
+  int planPos = -1;
+  for (int i = 0; i < plannedCacheJobs.count() && planPos < 0; i++)
+    if (plannedCacheJobs[i].plItem == item)
+      planPos = i;
+  if (planPos < 0)
+    // The item is not scheduled for caching
+    return;
+
+  // Remove the old jobs of the item. The new jobs go where the old ones were or (if there were none left) before the
+  // jobs of the items that come after the item in the plan.
+  QSet<const playlistItem*> laterItems;
+  for (int i = planPos + 1; i < plannedCacheJobs.count(); i++)
+    if (plannedCacheJobs[i].plItem != item)
+      laterItems.insert(plannedCacheJobs[i].plItem.data());
+  int queuePos = -1;
+  for (int i = 0; i < cacheQueue.count();)
+  {
+    if (cacheQueue[i].plItem == item)
+    {
+      if (queuePos < 0)
+        queuePos = i;
+      cacheQueue.removeAt(i);
+      continue;
+    }
+    if (queuePos < 0 && laterItems.contains(cacheQueue[i].plItem.data()))
+      queuePos = i;
+    i++;
+  }
+  if (queuePos < 0)
+    queuePos = cacheQueue.count();
+
+  for (const cacheJob &planned : plannedCacheJobs)
+    if (planned.plItem == item)
+      for (const cacheJob &job : getMissingCacheJobs(item, planned.frameRange))
+        cacheQueue.insert(queuePos++, job);
+  DEBUG_CACHING("videoCache::requeueCacheJobs %s", item->getName().toLatin1().data());
 }
 
 void videoCache::startCaching()
@@ -974,6 +1391,9 @@ void videoCache::threadCachingFinished()
   loadingWorker *worker = dynamic_cast<loadingWorker*>(sender);
   Q_ASSERT_X(worker->isWorking(), "videoCache::threadCachingFinished", "The worker that just finished was not working?");
   worker->setWorking(false);
+  playlistItem *cachedItem = worker->getLastJobItem();
+  if (!testMode && cachedItem && !cachedItem->taggedForDeletion())
+    addReloadCostMeasurement(cachedItem, worker->getLastJobDuration());
   DEBUG_CACHING_DETAIL("videoCache::threadCachingFinished - state %d - worker %p", workerState, worker);
 
   // Check if all threads have stopped.
@@ -1079,7 +1499,7 @@ void videoCache::threadCachingFinished()
     if (!itemCaching)
     {
       // No job is caching the item anymore. Clear the cache now.
-      (*it)->removeAllFramesFromCache();
+      clearCacheOfItem(*it);
       it = itemsToClearCache.erase(it);
     }
     else
@@ -1124,9 +1544,10 @@ void videoCache::threadCachingFinished()
   }
   else if (workerState == workerRunning)
   {
-    // Get the thread of the worker and push the next cache job to it
+    // Get the thread of the worker and push the next cache job to it. Idle threads may also be able to continue
+    // now (their jobs might have been blocked by a thread limit or by a thread working on the same segment).
     for (loadingThread *t : cachingThreadList)
-      if (t->worker() == worker)
+      if (t->worker() == worker || !t->worker()->isWorking())
         jobsRunning |= pushNextJobToThread(t);
   }
 
@@ -1237,6 +1658,17 @@ bool videoCache::pushNextJobToThread(loadingThread *thread)
           // Go to the next item. We can not add another thread to this one.
           continue;
       }
+      if (job.decodeInOrder)
+      {
+        // Is another thread currently caching the frame before this one? Then it should also cache
+        // the next frame. Otherwise, decoding would have to start from the random access point again.
+        bool segmentBusy = false;
+        for (loadingThread *t : cachingThreadList)
+          if (t->worker()->isWorking() && t->worker()->getCacheItem() == job.plItem && t->worker()->getCacheFrame() == job.frameRange.first - 1)
+            segmentBusy = true;
+        if (segmentBusy)
+          continue;
+      }
 
       // We can start another thread for this item
       plItem = job.plItem;
@@ -1263,17 +1695,25 @@ bool videoCache::pushNextJobToThread(loadingThread *thread)
   int frameToCache = range.first;
 
   // First check if we need to free up space to cache this frame.
-  while (cacheLevelCurrent + frameSize >= cacheLevelMax && !cacheDeQueue.isEmpty())
+  bool noFrameToRemove = false;
+  while (cacheLevelCurrent + frameSize >= cacheLevelMax)
   {
-    plItemFrame frameToRemove = cacheDeQueue.dequeue();
+    plItemFrame frameToRemove;
+    if (!getNextFrameToEvict(frameToRemove))
+    {
+      noFrameToRemove = true;
+      break;
+    }
     unsigned int frameToRemoveSize = frameToRemove.first->getCachingFrameSize();
 
     DEBUG_CACHING_DETAIL("videoCache::pushNextJobToThread Remove frame %d of %s", frameToRemove.second, frameToRemove.first->getName().toStdString().c_str());
     frameToRemove.first->removeFrameFromCache(frameToRemove.second);
+    forgetFrameAccess(frameToRemove.first.data(), frameToRemove.second);
     cacheLevelCurrent -= frameToRemoveSize;
+    nrEvictedFrames++;
   }
 
-  if (cacheDeQueue.isEmpty() && cacheLevelCurrent + frameSize > cacheLevelMax)
+  if (noFrameToRemove && cacheLevelCurrent + frameSize > cacheLevelMax)
   {
     // There is still not enough space but there are no more frames that we can remove.
     // The updateCacheQueue function should never create a situation where this is possible ...
@@ -1290,10 +1730,18 @@ bool videoCache::pushNextJobToThread(loadingThread *thread)
 
   // Update the cache level
   cacheLevelCurrent += frameSize;
+  updateFreeCacheSpace();
 
   return true;
 }
 
+void videoCache::updateFreeCacheSpace()
+{
+  // Nothing may be put into the cache outside of the caching threads if caching is disabled
+  qint64 freeSpace = cachingEnabled ? cacheLevelMax - cacheLevelCurrent : 0;
+  videoHandler::setFreeCacheSpace(std::max(freeSpace, qint64(0)));
+}
+
 void videoCache::itemAboutToBeDeleted(playlistItem* item)
 {
   // One of the items is about to be deleted. Let's stop the caching. Then the item can be deleted
@@ -1312,12 +1760,14 @@ void videoCache::itemAboutToBeDeleted(playlistItem* item)
 
     // An item is about to be deleted. We need to rethink what to cache next.
     workerState = workerIntReqRestart;
+    cacheQueueInvalid = true;
   }
 
   if (cachingItem || loadingItem)
   {
     // The item can be deleted when all caching/loading threads of the item returned.
     itemsToDelete.append(item);
+    accessInfo.remove(item);
     DEBUG_CACHING("videoCache::itemAboutToBeDeleted delete item later %s", item->getName().toLatin1().data());
   }
   else
@@ -1335,6 +1785,7 @@ void videoCache::itemAboutToBeDeleted(playlistItem* item)
     }
     // The item can be deleted now.
     item->deleteLater();
+    accessInfo.remove(item);
     DEBUG_CACHING("videoCache::itemAboutToBeDeleted delete item now %s", item->getName().toLatin1().data());
   }
 
@@ -1346,10 +1797,17 @@ void videoCache::itemNeedsRecache(playlistItem* item, recacheIndicator clearItem
   if (clearItemCache == RECACHE_NONE)
     return;
   else if (clearItemCache == RECACHE_UPDATE)
+  {
+    // The queues are only rebuilt if something that they depend on changed. If only the frame range of the
+    // item changed, only its entries are updated.
     scheduleCachingListUpdate();
+  }
   else
   {
     // Something about the given playlistitem changed and all items in the cache are invalid.
+    // The cost to load a frame of the item might also have changed.
+    if (accessInfo.contains(item))
+      accessInfo[item].reloadCost = -1;
     // If a thread is currently caching the given item, we have to stop caching, clear the cache,
     // rethink what to cache and restart the caching.
     if (workerState != workerIdle)
@@ -1368,13 +1826,13 @@ void videoCache::itemNeedsRecache(playlistItem* item, recacheIndicator clearItem
       }
       else
         // We can clear the cache now
-        item->removeAllFramesFromCache();
+        clearCacheOfItem(item);
       workerState = workerIntReqRestart;
     }
     else
     {
       // The worker thread is idle. We can just clear the item cache now.
-      item->removeAllFramesFromCache();
+      clearCacheOfItem(item);
       // This also implies that we want to rethink what to cache
       scheduleCachingListUpdate();
     }
@@ -1436,6 +1894,12 @@ void videoCache::updateCachingInfoLabel(bool forceNotVisible)
   labelText.append("Caching:\n");
   for (loadingThread *t : cachingThreadList)
     labelText.append(t->worker()->getStatus());
+  labelText.append(QString("Eviction: %1\n").arg(videoCacheEvictionPolicy::getPolicyNames().at(evictionPolicy->getType())));
+  const quint64 nrAccesses = nrCacheHits + nrCacheMisses;
+  if (nrAccesses > 0)
+    labelText.append(QString("Hit rate: %1% (%2/%3)\n").arg(100.0 * nrCacheHits / nrAccesses, 0, 'f', 1).arg(nrCacheHits).arg(nrAccesses));
+  labelText.append(QString("Load time of missed frames: %1 ms\n").arg(qint64(missReloadTimeMs)));
+  labelText.append(QString("Evicted frames: %1\n").arg(nrEvictedFrames));
   cachingInfoLabel->setText(labelText);
 }
 
@@ -35,13 +35,18 @@
 
 #include <QDockWidget>
 #include <QElapsedTimer>
+#include <QHash>
 #include <QLabel>
+#include <QMap>
 #include <QPointer>
 #include <QProgressDialog>
 #include <QQueue>
+#include <QScopedPointer>
 #include <QTimer>
+#include <QVector>
 #include <QWidget>
 #include "playlistTreeWidget.h"
+#include "videoCacheEvictionPolicy.h"
 
 class videoHandler;
 class videoCache;
@@ -51,14 +56,18 @@ class videoCacheStatusWidget : public QWidget
   Q_OBJECT
 
 public:
-  videoCacheStatusWidget(QWidget *parent) : QWidget(parent), cacheLevelMB(0), cacheRateInBytesPerMs(0), cacheLevelMaxMB(0) {}
+  videoCacheStatusWidget(QWidget *parent) : QWidget(parent), cacheLevelMB(0), cacheLevelRawMB(0), spillLevelMB(0), cacheRateInBytesPerMs(0), cacheLevelMaxMB(0) {}
   // Override the paint event
   virtual void paintEvent(QPaintEvent *event) Q_DECL_OVERRIDE;
   void updateStatus(PlaylistTreeWidget *playlistWidget, unsigned int cacheRate);
 private:
   // The floating point values (0 to 1) of the end positions of the blocks to draw
   QList<float> relativeValsEnd;
+  // For each block: Does the item cache raw frames (true) or converted images (false)?
+  QList<bool> blockIsRawData;
   unsigned int cacheLevelMB;
+  unsigned int cacheLevelRawMB;   //< The part of cacheLevelMB that is used by items that cache raw frames
+  unsigned int spillLevelMB;      //< How much of the spill file on disk is used
   unsigned int cacheRateInBytesPerMs;
   qint64 cacheLevelMaxMB;
 };
@@ -82,6 +91,10 @@ public:
   // item that can be visible at the same time.
   void loadFrame(playlistItem *item, int frameIndex, int loadingSlot);
 
+  // The given frame of the item is about to be shown. cacheHit indicates if the frame could be shown right away
+  // or if it has to be loaded first. This access history is used by the eviction policy.
+  void frameAccessed(playlistItem *item, int frameIndex, bool cacheHit);
+
   // Setup the caching info dock widget here.
   void setupControls(QDockWidget *dock);
 
@@ -122,12 +135,15 @@ private slots:
  
 private:
   // A cache job. Has a pointer to a playlist item and a range of frames to be cached.
+  // If the frames of the range have to be decoded in order (the range is a segment between two random access points),
+  // only one thread at a time should cache frames from the job.
   struct cacheJob
   {
-    cacheJob() {}
-    cacheJob(playlistItem *item, indexRange range);
+    cacheJob() : decodeInOrder(false) {}
+    cacheJob(playlistItem *item, indexRange range, bool inOrder=false);
     QPointer<playlistItem> plItem;
     indexRange frameRange;
+    bool decodeInOrder;
   };
   typedef QPair<QPointer<playlistItem>, int> plItemFrame;
 
@@ -143,14 +159,80 @@ private:
   bool cachingEnabled;
   // The queue of caching jobs that are scheduled
   QQueue<cacheJob> cacheQueue;
-  // The queue with a list of frames/items that can be removed from the queue if necessary
-  QQueue<plItemFrame> cacheDeQueue;
+  // The ranges of frames (per item and in the order of the cacheQueue) that the cacheQueue was created from.
+  // The jobs of a single item can be created again from these (see requeueCacheJobs()).
+  QList<cacheJob> plannedCacheJobs;
+  // The queue with ranges of frames of items that can be removed from the cache if necessary. Only the frames
+  // within these ranges that are actually cached can be removed.
+  QQueue<cacheJob> cacheDeQueue;
+  // If set, the frames from the cacheDeQueue are removed in reverse order
+  bool cacheDeQueueReversed;
+  // Mark all frames of the item as "can be removed if necessary" (also the ones that are cached later)
+  void enqueueRemovableFrames(playlistItem *item);
+  // Get the frame that should be removed from the cache next. Only the frames within the ranges of the cacheDeQueue
+  // that are cached right now are considered. The cached ranges of the items are looked up (and not every single frame)
+  // so this does not get more expensive with the number of cached frames. Return false if no frame can be removed.
+  bool getNextFrameToEvict(plItemFrame &frame);
   // If a frame is removed can be determined by the following cache states:
   qint64 cacheLevelMax;
   qint64 cacheLevelCurrent;
+  // Tell the video handlers how much space in the cache is still free (see videoHandler::cacheRawFrame())
+  void updateFreeCacheSpace();
 
   // Enqueue the job in the queue. If all frames within the range are already cached in the item, do nothing.
   void enqueueCacheJob(playlistItem* item, indexRange range);
+  // Get the jobs for caching the frames within the range that are not cached yet
+  QList<cacheJob> getMissingCacheJobs(playlistItem* item, indexRange range) const;
+  // Create the jobs of the item in the cacheQueue again from the plannedCacheJobs (e.g. because the cache of the
+  // item was cleared). The jobs of all other items are not changed.
+  void requeueCacheJobs(playlistItem *item);
+
+  // The policy which decides which frames from the cacheDeQueue are removed first
+  QScopedPointer<videoCacheEvictionPolicy> evictionPolicy;
+
+  // Everything that the cache queues depend on (selection, playback state, the items and their properties).
+  // If this did not change since the last update of the cache queues, the queues are still valid and do not
+  // have to be rebuilt. The cached frames are not part of this (the queues are always applied to the frames
+  // that are cached right now) and neither are the frame ranges of the items (see cacheQueueFrameRanges).
+  QVector<qint64> getCacheQueueState(const QList<playlistItem*> &allItems) const;
+  QVector<qint64> cacheQueueState;
+  // Set if the cache queues must be rebuilt even if the state did not change (e.g. the settings changed)
+  bool cacheQueueInvalid;
+  // The frame range of every item when the queues were created. If only the range of an item changed, only the
+  // entries of this item in the queues are updated (see updateItemFrameRange()).
+  QHash<const playlistItem*, indexRange> cacheQueueFrameRanges;
+  void updateItemFrameRange(playlistItem *item, indexRange oldRange, indexRange newRange);
+  // Remove all cached frames of the item that are outside of its frame range
+  void removeFramesOutsideRange(playlistItem *item);
+  // Clear the cache of the item and schedule caching its frames again
+  void clearCacheOfItem(playlistItem *item);
+
+  // The access history of one item. This is what the eviction policy works with.
+  struct itemAccessInfo
+  {
+    itemAccessInfo() : lastAccess(0), lastFrame(-1), direction(1), reloadCost(-1), missPending(false), missedFrame(-1) {}
+    quint64 lastAccess;               //< The accessCounter when a frame of the item was shown the last time
+    int lastFrame;                    //< The last shown frame
+    int direction;                    //< The direction in which the user went through the item the last time (1 or -1)
+    QHash<int, quint64> frameAccess;  //< The accessCounter for every frame when it was shown the last time
+    QMap<quint64, int> accessOrder;   //< The same as frameAccess but sorted by the accessCounter (accessCounter -> frame)
+    double reloadCost;                //< The average measured time in ms to load one frame (-1 if not measured yet)
+    bool missPending;                 //< Was a frame not in the cache when it was shown and is it still being loaded?
+    int missedFrame;                  //< The frame that was not in the cache (if missPending is set)
+  };
+  QHash<const playlistItem*, itemAccessInfo> accessInfo;
+  quint64 accessCounter;
+  // A frame (or all frames) of the item left the cache. The access history of these frames is not needed anymore.
+  void forgetFrameAccess(const playlistItem *item, int frameIndex);
+  void forgetAllFrameAccesses(const playlistItem *item);
+  // A frame of the item was loaded/cached in the given time. Update the reload cost estimate of the item.
+  void addReloadCostMeasurement(const playlistItem *item, double durationMs);
+
+  // Counters for the caching info
+  quint64 nrCacheHits;
+  quint64 nrCacheMisses;
+  quint64 nrEvictedFrames;
+  double missReloadTimeMs;  //< The sum of the time spent loading frames that were not in the cache
 
   unsigned int cacheRateInBytesPerMs;
 
@@ -0,0 +1,103 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "videoCacheEvictionPolicy.h"
+
+namespace
+{
+  // Frames behind the last shown frame are considered to be this much farther away
+  const int DIRECTION_BEHIND_WEIGHT = 4;
+
+  class policyPlaylistOrder : public videoCacheEvictionPolicy
+  {
+  public:
+    virtual policyType getType() const Q_DECL_OVERRIDE { return PolicyPlaylistOrder; }
+    virtual bool keepsPlaylistOrder() const Q_DECL_OVERRIDE { return true; }
+    virtual double score(const evictionCandidate &candidate) const Q_DECL_OVERRIDE { Q_UNUSED(candidate); return 0; }
+  };
+
+  class policyLRU : public videoCacheEvictionPolicy
+  {
+  public:
+    virtual policyType getType() const Q_DECL_OVERRIDE { return PolicyLRU; }
+    virtual double score(const evictionCandidate &candidate) const Q_DECL_OVERRIDE { return -double(candidate.age); }
+  };
+
+  class policyDistance : public videoCacheEvictionPolicy
+  {
+  public:
+    virtual policyType getType() const Q_DECL_OVERRIDE { return PolicyDistance; }
+    virtual double score(const evictionCandidate &candidate) const Q_DECL_OVERRIDE { return -double(candidate.distance); }
+  };
+
+  class policyDirection : public videoCacheEvictionPolicy
+  {
+  public:
+    virtual policyType getType() const Q_DECL_OVERRIDE { return PolicyDirection; }
+    virtual double score(const evictionCandidate &candidate) const Q_DECL_OVERRIDE
+    {
+      const int weight = candidate.behind ? DIRECTION_BEHIND_WEIGHT : 1;
+      return -double(candidate.distance) * weight;
+    }
+  };
+
+  class policyCostAware : public videoCacheEvictionPolicy
+  {
+  public:
+    virtual policyType getType() const Q_DECL_OVERRIDE { return PolicyCostAware; }
+    // Frames that are cheap to load again (e.g. raw frames from a file) and that were not used for a long time go first.
+    // Frames that are expensive to get again (e.g. decoded frames of a coded video) are kept longer.
+    virtual double score(const evictionCandidate &candidate) const Q_DECL_OVERRIDE { return candidate.reloadCost / (1.0 + candidate.age); }
+  };
+}
+
+videoCacheEvictionPolicy *videoCacheEvictionPolicy::create(policyType type)
+{
+  switch (type)
+  {
+  case PolicyLRU:
+    return new policyLRU();
+  case PolicyDistance:
+    return new policyDistance();
+  case PolicyDirection:
+    return new policyDirection();
+  case PolicyCostAware:
+    return new policyCostAware();
+  default:
+    return new policyPlaylistOrder();
+  }
+}
+
+QStringList videoCacheEvictionPolicy::getPolicyNames()
+{
+  return QStringList() << "Playlist order" << "Least recently used" << "Distance to shown frame" << "Distance and navigation direction" << "Reload cost and recency";
+}
@@ -0,0 +1,88 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VIDEOCACHEEVICTIONPOLICY_H
+#define VIDEOCACHEEVICTIONPOLICY_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+/* The eviction policy decides which of the cached frames that may be removed from the video cache are
+ * removed first. The video cache describes the frames that can be removed with an evictionCandidate.
+ * The policy assigns a score to each candidate and the frame with the lowest score is removed first.
+ * The video cache does not rank every cached frame. Per item, it only considers the ends of the cached
+ * ranges and the shown frame that was accessed least recently. So the score must not increase with the
+ * age or the distance of a frame.
+ *
+ * The playlist order policy keeps the order in which the video cache found the frames (that is the
+ * classic heuristic based on the position of the items in the playlist). All other policies only rank
+ * the frames using the access history that is recorded by the video cache.
+ */
+class videoCacheEvictionPolicy
+{
+public:
+  // The available policies. The values are saved in the settings so do not change the order.
+  enum policyType
+  {
+    PolicyPlaylistOrder,  // Remove frames based on the position of the item in the playlist
+    PolicyLRU,            // Remove the frames that were not shown for the longest time first
+    PolicyDistance,       // Remove the frames that are farthest away from the last shown frame of their item first
+    PolicyDirection,      // Like PolicyDistance but frames behind the last shown frame (in navigation direction) go first
+    PolicyCostAware,      // Weight the recency of a frame with the cost to load it again
+    PolicyNum
+  };
+
+  // Everything that we know about a frame that could be removed from the cache
+  struct evictionCandidate
+  {
+    evictionCandidate() : age(0), distance(0), behind(false), reloadCost(0) {}
+    quint64 age;        // Number of accesses in the cache since the frame (or its item) was accessed the last time
+    int distance;       // Distance to the last shown frame of the item
+    bool behind;        // Is the frame behind the last shown frame (with respect to the navigation direction)?
+    double reloadCost;  // Estimated time in ms it takes to get this frame into the cache again
+  };
+
+  virtual ~videoCacheEvictionPolicy() {}
+
+  static videoCacheEvictionPolicy *create(policyType type);
+  static QStringList getPolicyNames();
+
+  virtual policyType getType() const = 0;
+  // If true, the order of the candidates is not changed. The video cache then also selects the frames
+  // that may be removed using the playlist order.
+  virtual bool keepsPlaylistOrder() const { return false; }
+  // Get the score of the candidate. Candidates with a lower score are removed first.
+  virtual double score(const evictionCandidate &candidate) const = 0;
+};
+
+#endif // VIDEOCACHEEVICTIONPOLICY_H
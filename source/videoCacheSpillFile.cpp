@@ -0,0 +1,443 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "videoCacheSpillFile.h"
+
+#include <algorithm>
+#include <cstring>
+#include <QDir>
+#include <QStandardPaths>
+
+// The size of one slot in the spill file
+#define SPILL_FILE_SLOT_SIZE (1024 * 1024)
+// The fast compression level that is used (if compression is enabled)
+#define SPILL_FILE_COMPRESSION_LEVEL 1
+// If frames are evicted faster than they can be written to the spill file, don't hold more than this in the queue.
+// The frames that were queued first are dropped then.
+#define SPILL_FILE_MAX_QUEUE_SIZE (qint64(512) * 1024 * 1024)
+
+// Activate this if you want to know when frames are written to/read from the spill file.
+#define VIDEOCACHESPILLFILE_DEBUG 0
+#if VIDEOCACHESPILLFILE_DEBUG && !NDEBUG
+#include <QDebug>
+#define DEBUG_SPILL qDebug
+#else
+#define DEBUG_SPILL(fmt,...) ((void)0)
+#endif
+
+videoCacheSpillFile::videoCacheSpillFile() :
+  enabled(false),
+  compressFrames(false),
+  maxSize(0),
+  mappedData(nullptr),
+  nrSlots(0),
+  storeQueueSize(0),
+  storingFrameValid(false),
+  stopStoring(false),
+  writer(this)
+{
+}
+
+videoCacheSpillFile::~videoCacheSpillFile()
+{
+  QMutexLocker lock(&mutex);
+  stopStoring = true;
+  storeQueueChanged.wakeAll();
+  lock.unlock();
+  writer.wait();
+
+  lock.relock();
+  reset();
+}
+
+videoCacheSpillFile *videoCacheSpillFile::globalInstance()
+{
+  static videoCacheSpillFile instance;
+  return &instance;
+}
+
+void videoCacheSpillFile::setup(bool enable, qint64 maxSizeInBytes, bool compress)
+{
+  QMutexLocker lock(&mutex);
+  compressFrames = compress;
+  if (enable == enabled && maxSizeInBytes == maxSize)
+    return;
+
+  reset();
+  enabled = enable;
+  maxSize = maxSizeInBytes;
+  if (!enabled)
+    return;
+
+  nrSlots = int(maxSize / SPILL_FILE_SLOT_SIZE);
+  file.setFileTemplate(getSpillFileDirectory() + "/YUView_spill_XXXXXX.bin");
+  if (nrSlots <= 0 || !file.open() || !file.resize(qint64(nrSlots) * SPILL_FILE_SLOT_SIZE))
+  {
+    DEBUG_SPILL("videoCacheSpillFile::setup Error creating the spill file");
+    reset();
+    enabled = false;
+    return;
+  }
+
+  mappedData = file.map(0, file.size());
+  if (mappedData == nullptr)
+  {
+    DEBUG_SPILL("videoCacheSpillFile::setup Error mapping the spill file");
+    reset();
+    enabled = false;
+    return;
+  }
+
+  freeSlots.reserve(nrSlots);
+  for (int i = nrSlots - 1; i >= 0; i--)
+    freeSlots.append(i);
+  DEBUG_SPILL("videoCacheSpillFile::setup Spill file %s with %d slots", file.fileName().toLatin1().data(), nrSlots);
+}
+
+bool videoCacheSpillFile::isEnabled() const
+{
+  QMutexLocker lock(&mutex);
+  return enabled;
+}
+
+void videoCacheSpillFile::store(const void *owner, int frameIdx, const QImage &image)
+{
+  if (image.isNull())
+    return;
+  pendingFrame frame;
+  frame.key = frameKey(owner, frameIdx);
+  frame.image = image;
+  frame.size = image.bytesPerLine() * image.height();
+  queueFrame(frame);
+}
+
+void videoCacheSpillFile::store(const void *owner, int frameIdx, const QByteArray &rawData)
+{
+  if (rawData.isEmpty())
+    return;
+  pendingFrame frame;
+  frame.key = frameKey(owner, frameIdx);
+  frame.rawData = rawData;
+  frame.size = rawData.size();
+  queueFrame(frame);
+}
+
+void videoCacheSpillFile::queueFrame(const pendingFrame &frame)
+{
+  QMutexLocker lock(&mutex);
+  if (!enabled || stopStoring || entries.contains(frame.key) || findPendingFrame(frame.key) != nullptr)
+    return;
+
+  while (!storeQueue.isEmpty() && storeQueueSize + frame.size > SPILL_FILE_MAX_QUEUE_SIZE)
+  {
+    DEBUG_SPILL("videoCacheSpillFile::queueFrame Queue full. Drop frame %d", storeQueue.first().key.second);
+    storeQueueSize -= storeQueue.first().size;
+    storeQueue.removeFirst();
+  }
+  storeQueue.append(frame);
+  storeQueueSize += frame.size;
+
+  if (!writer.isRunning())
+    writer.start(QThread::LowPriority);
+  storeQueueChanged.wakeAll();
+}
+
+const videoCacheSpillFile::pendingFrame *videoCacheSpillFile::findPendingFrame(const frameKey &key) const
+{
+  if (storingFrameValid && storingFrame.key == key)
+    return &storingFrame;
+  for (const pendingFrame &frame : storeQueue)
+    if (frame.key == key)
+      return &frame;
+  return nullptr;
+}
+
+void videoCacheSpillFile::removePendingFrame(const frameKey &key)
+{
+  // The frame that is being stored right now is dropped when the thread is done with it
+  if (storingFrameValid && storingFrame.key == key)
+    storingFrameValid = false;
+  for (int i = 0; i < storeQueue.size(); i++)
+  {
+    if (storeQueue[i].key == key)
+    {
+      storeQueueSize -= storeQueue[i].size;
+      storeQueue.removeAt(i);
+      return;
+    }
+  }
+}
+
+bool videoCacheSpillFile::load(const void *owner, int frameIdx, QImage &image)
+{
+  QMutexLocker lock(&mutex);
+  const frameKey key(owner, frameIdx);
+  if (const pendingFrame *frame = findPendingFrame(key))
+  {
+    // The frame was not written yet. It is back in the cache now and is queued again when it is evicted again.
+    if (frame->image.isNull())
+      return false;
+    image = frame->image;
+    removePendingFrame(key);
+    DEBUG_SPILL("videoCacheSpillFile::load queued image %d", frameIdx);
+    return true;
+  }
+
+  auto it = entries.find(key);
+  if (!enabled || it == entries.end() || !it->isImage)
+    return false;
+
+  QByteArray data = readData(*it);
+  const bool compressed = it->compressed;
+  const QSize imageSize = it->imageSize;
+  const QImage::Format imageFormat = it->imageFormat;
+  const int bytesPerLine = it->bytesPerLine;
+  lock.unlock();
+
+  if (compressed)
+    data = qUncompress(data);
+  QImage newImage(imageSize, imageFormat);
+  if (newImage.isNull() || newImage.bytesPerLine() != bytesPerLine || data.size() != newImage.bytesPerLine() * newImage.height())
+    return false;
+  memcpy(newImage.bits(), data.constData(), data.size());
+  image = newImage;
+  DEBUG_SPILL("videoCacheSpillFile::load image %d", frameIdx);
+  return true;
+}
+
+bool videoCacheSpillFile::load(const void *owner, int frameIdx, QByteArray &rawData)
+{
+  QMutexLocker lock(&mutex);
+  const frameKey key(owner, frameIdx);
+  if (const pendingFrame *frame = findPendingFrame(key))
+  {
+    if (frame->rawData.isEmpty())
+      return false;
+    rawData = frame->rawData;
+    removePendingFrame(key);
+    DEBUG_SPILL("videoCacheSpillFile::load queued raw data %d", frameIdx);
+    return true;
+  }
+
+  auto it = entries.find(key);
+  if (!enabled || it == entries.end() || it->isImage)
+    return false;
+
+  QByteArray data = readData(*it);
+  const bool compressed = it->compressed;
+  lock.unlock();
+
+  rawData = compressed ? qUncompress(data) : data;
+  DEBUG_SPILL("videoCacheSpillFile::load raw data %d", frameIdx);
+  return !rawData.isEmpty();
+}
+
+bool videoCacheSpillFile::contains(const void *owner, int frameIdx) const
+{
+  QMutexLocker lock(&mutex);
+  const frameKey key(owner, frameIdx);
+  return entries.contains(key) || findPendingFrame(key) != nullptr;
+}
+
+void videoCacheSpillFile::removeAll(const void *owner)
+{
+  QMutexLocker lock(&mutex);
+  QList<frameKey> keys;
+  for (auto it = entries.constBegin(); it != entries.constEnd(); it++)
+    if (it.key().first == owner)
+      keys.append(it.key());
+  for (const frameKey &key : keys)
+    removeEntry(key);
+
+  for (int i = storeQueue.size() - 1; i >= 0; i--)
+  {
+    if (storeQueue[i].key.first == owner)
+    {
+      storeQueueSize -= storeQueue[i].size;
+      storeQueue.removeAt(i);
+    }
+  }
+  if (storingFrameValid && storingFrame.key.first == owner)
+    storingFrameValid = false;
+}
+
+int videoCacheSpillFile::getNrFrames() const
+{
+  QMutexLocker lock(&mutex);
+  return entries.size();
+}
+
+qint64 videoCacheSpillFile::getUsedSize() const
+{
+  QMutexLocker lock(&mutex);
+  return qint64(nrSlots - freeSlots.size()) * SPILL_FILE_SLOT_SIZE;
+}
+
+void videoCacheSpillFile::processStoreQueue()
+{
+  QMutexLocker lock(&mutex);
+  while (true)
+  {
+    while (storeQueue.isEmpty() && !stopStoring)
+      storeQueueChanged.wait(&mutex);
+    if (stopStoring)
+      return;
+
+    storingFrame = storeQueue.takeFirst();
+    storeQueueSize -= storingFrame.size;
+    storingFrameValid = true;
+    const pendingFrame frame = storingFrame;
+    const bool isImage = !frame.image.isNull();
+    const bool compress = compressFrames;
+    lock.unlock();
+
+    const uchar *data = isImage ? frame.image.constBits() : (const uchar*)frame.rawData.constData();
+    int size = frame.size;
+
+    // Compressing takes much longer than copying the data so we don't block the other threads while doing it
+    bool compressed = false;
+    QByteArray compressedData;
+    if (compress)
+    {
+      compressedData = qCompress(data, size, SPILL_FILE_COMPRESSION_LEVEL);
+      if (compressedData.size() < size)
+      {
+        // Only use the compressed data if it is actually smaller
+        data = (const uchar*)compressedData.constData();
+        size = compressedData.size();
+        compressed = true;
+      }
+    }
+
+    lock.relock();
+    // The frame may have been removed (or the spill file was disabled) in the meantime
+    if (storingFrameValid && enabled && !entries.contains(frame.key))
+      storeData(frame.key, data, size, compressed, isImage, frame.image);
+    storingFrame = pendingFrame();
+    storingFrameValid = false;
+  }
+}
+
+bool videoCacheSpillFile::storeData(const frameKey &key, const uchar *data, int size, bool compressed, bool isImage, const QImage &image)
+{
+  spillEntry entry;
+  entry.compressed = compressed;
+
+  const int nrSlotsNeeded = (size + SPILL_FILE_SLOT_SIZE - 1) / SPILL_FILE_SLOT_SIZE;
+  if (nrSlotsNeeded > nrSlots)
+    // The frame does not fit into the spill file at all
+    return false;
+
+  // Free slots by removing the frames that were not used for the longest time
+  while (freeSlots.size() < nrSlotsNeeded && !lruList.isEmpty())
+  {
+    DEBUG_SPILL("videoCacheSpillFile::storeData Drop frame %d", lruList.first().second);
+    removeEntry(lruList.first());
+  }
+
+  entry.size = size;
+  entry.isImage = isImage;
+  if (isImage)
+  {
+    entry.imageSize = image.size();
+    entry.imageFormat = image.format();
+    entry.bytesPerLine = image.bytesPerLine();
+  }
+  entry.lruPosition = lruList.insert(lruList.end(), key);
+
+  // Copy the data into the slots
+  for (int i = 0; i < nrSlotsNeeded; i++)
+  {
+    const int slot = freeSlots.takeLast();
+    const int bytes = std::min(size - i * SPILL_FILE_SLOT_SIZE, SPILL_FILE_SLOT_SIZE);
+    memcpy(mappedData + qint64(slot) * SPILL_FILE_SLOT_SIZE, data + qint64(i) * SPILL_FILE_SLOT_SIZE, bytes);
+    entry.slots.append(slot);
+  }
+
+  entries.insert(key, entry);
+  DEBUG_SPILL("videoCacheSpillFile::storeData frame %d in %d slots%s", key.second, nrSlotsNeeded, entry.compressed ? " (compressed)" : "");
+  return true;
+}
+
+QByteArray videoCacheSpillFile::readData(spillEntry &entry)
+{
+  // Move the frame to the end of the LRU list
+  const frameKey key = *entry.lruPosition;
+  lruList.erase(entry.lruPosition);
+  entry.lruPosition = lruList.insert(lruList.end(), key);
+
+  QByteArray data;
+  data.resize(entry.size);
+  for (int i = 0; i < entry.slots.size(); i++)
+  {
+    const int bytes = std::min(entry.size - i * SPILL_FILE_SLOT_SIZE, SPILL_FILE_SLOT_SIZE);
+    memcpy(data.data() + qint64(i) * SPILL_FILE_SLOT_SIZE, mappedData + qint64(entry.slots[i]) * SPILL_FILE_SLOT_SIZE, bytes);
+  }
+  return data;
+}
+
+void videoCacheSpillFile::removeEntry(const frameKey &key)
+{
+  auto it = entries.find(key);
+  if (it == entries.end())
+    return;
+  freeSlots += it->slots;
+  lruList.erase(it->lruPosition);
+  entries.erase(it);
+}
+
+void videoCacheSpillFile::reset()
+{
+  storeQueue.clear();
+  storeQueueSize = 0;
+  storingFrameValid = false;
+  entries.clear();
+  lruList.clear();
+  freeSlots.clear();
+  if (mappedData)
+    file.unmap(mappedData);
+  mappedData = nullptr;
+  if (file.isOpen())
+  {
+    file.resize(0);
+    file.close();
+  }
+  nrSlots = 0;
+}
+
+QString videoCacheSpillFile::getSpillFileDirectory()
+{
+  const QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation);
+  if (!cacheDir.isEmpty() && QDir().mkpath(cacheDir))
+    return cacheDir;
+  return QDir::tempPath();
+}
@@ -0,0 +1,167 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VIDEOCACHESPILLFILE_H
+#define VIDEOCACHESPILLFILE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QImage>
+#include <QLinkedList>
+#include <QList>
+#include <QMutex>
+#include <QPair>
+#include <QTemporaryFile>
+#include <QThread>
+#include <QVector>
+#include <QWaitCondition>
+
+/* The spill file is a second level cache on disk for frames that were removed from the video cache.
+ * Decoding a frame of a coded video again can be very expensive (the decoder has to seek to the previous random
+ * access point and decode everything from there). So instead of throwing these frames away, the video handlers
+ * store them in the spill file and load them from there if they are needed again.
+ *
+ * The spill file is a memory mapped temporary file (in the cache directory of the user) which is divided into slots of
+ * a fixed size. A frame is stored in as many slots as it needs (the slots do not have to be consecutive). If the spill
+ * file is full, the frames that were not used for the longest time are removed. Optionally, the frames can be
+ * compressed. The (de)compression is performed without holding the lock.
+ *
+ * Frames are evicted from the video cache in the main thread. So store() only puts the frame (a shallow copy) into a
+ * queue. A background thread copies (and compresses) the queued frames into the spill file. Queued frames can already
+ * be loaded again.
+ *
+ * There is only one spill file which is shared by all items. The frames are identified by the owner (the video
+ * handler) and the frame index. All functions are thread safe.
+ */
+class videoCacheSpillFile
+{
+public:
+  ~videoCacheSpillFile();
+
+  static videoCacheSpillFile *globalInstance();
+
+  // Set up the spill file. If the size changes, all spilled frames are dropped.
+  void setup(bool enabled, qint64 maxSizeInBytes, bool compress);
+  bool isEnabled() const;
+
+  // Queue the frame for storing in the spill file (if it is not already in there).
+  void store(const void *owner, int frameIdx, const QImage &image);
+  void store(const void *owner, int frameIdx, const QByteArray &rawData);
+  // Load the frame. Return false if the frame is not in the spill file (or if it was stored in the other type).
+  bool load(const void *owner, int frameIdx, QImage &image);
+  bool load(const void *owner, int frameIdx, QByteArray &rawData);
+  bool contains(const void *owner, int frameIdx) const;
+
+  // Remove all frames of the given owner (e.g. because its frames are not valid anymore).
+  void removeAll(const void *owner);
+
+  // Some statistics
+  int getNrFrames() const;
+  qint64 getUsedSize() const;
+
+private:
+  videoCacheSpillFile();
+
+  typedef QPair<const void*, int> frameKey;
+  struct spillEntry
+  {
+    QVector<int> slots;
+    int size;             //< The number of bytes stored in the slots
+    bool compressed;
+    bool isImage;         //< Is this a QImage (or the raw data)?
+    QSize imageSize;
+    QImage::Format imageFormat;
+    int bytesPerLine;
+    QLinkedList<frameKey>::iterator lruPosition;  //< The position of the frame in lruList
+  };
+
+  // A frame that is waiting to be stored
+  struct pendingFrame
+  {
+    pendingFrame() : size(0) {}
+    frameKey key;
+    QImage image;         //< Either the image ...
+    QByteArray rawData;   //< ... or the raw data is set
+    int size;
+  };
+  void queueFrame(const pendingFrame &frame);
+  // Get the queued frame (or the frame that is being stored right now). The mutex must be locked.
+  const pendingFrame *findPendingFrame(const frameKey &key) const;
+  void removePendingFrame(const frameKey &key);
+
+  // The thread that stores the queued frames
+  class storeThread : public QThread
+  {
+  public:
+    storeThread(videoCacheSpillFile *spillFile) : spillFile(spillFile) {}
+  protected:
+    virtual void run() Q_DECL_OVERRIDE { spillFile->processStoreQueue(); }
+  private:
+    videoCacheSpillFile *spillFile;
+  };
+  // Compress the queued frames (if enabled) and store them until the thread is stopped. The mutex is not held
+  // while compressing.
+  void processStoreQueue();
+  // Write the data to free slots (remove the least recently used frames if needed) and add the entry.
+  // The mutex must be locked.
+  bool storeData(const frameKey &key, const uchar *data, int size, bool compressed, bool isImage, const QImage &image);
+  // Read the (possibly compressed) data of the entry. The mutex must be locked.
+  QByteArray readData(spillEntry &entry);
+  void removeEntry(const frameKey &key);
+  void reset();
+  // Get the directory for the spill file. This is the cache directory of the user (the temp directory is often in memory).
+  static QString getSpillFileDirectory();
+
+  mutable QMutex mutex;
+  bool enabled;
+  bool compressFrames;
+  qint64 maxSize;
+
+  QTemporaryFile file;
+  uchar *mappedData;
+  QVector<int> freeSlots;
+  int nrSlots;
+
+  QHash<frameKey, spillEntry> entries;
+  // All frames in the order of their last use (the least recently used first)
+  QLinkedList<frameKey> lruList;
+
+  QList<pendingFrame> storeQueue;
+  qint64 storeQueueSize;          //< The size of all frames in the storeQueue in bytes
+  pendingFrame storingFrame;      //< The frame that the thread is storing right now
+  bool storingFrameValid;         //< Is storingFrame set and still valid (it was not removed in the meantime)?
+  bool stopStoring;
+  QWaitCondition storeQueueChanged;
+  storeThread writer;
+};
+
+#endif // VIDEOCACHESPILLFILE_H
@@ -33,6 +33,7 @@
 #include "videoHandler.h"
 
 #include <QPainter>
+#include "videoCacheSpillFile.h"
 
 // Activate this if you want to know when which buffer is loaded/converted to image and so on.
 #define VIDEOHANDLER_DEBUG_LOADING 0
@@ -44,6 +45,8 @@
 
 // --------- videoHandler -------------------------------------
 
+QAtomicInteger<qint64> videoHandler::freeCacheSpace(0);
+
 videoHandler::videoHandler()
 {
   // Initialize variables
@@ -51,6 +54,15 @@ videoHandler::videoHandler()
   currentImage_frameIndex = -1;
   doubleBufferImageFrameIdx = -1;
   cacheValid = true;
+  cacheRawData = false;
+  spillEvictedFrames = false;
+}
+
+videoHandler::~videoHandler()
+{
+  // Our frames in the spill file can never be used again
+  if (spillEvictedFrames)
+    videoCacheSpillFile::globalInstance()->removeAll(this);
 }
 
 void videoHandler::slotVideoControlChanged()
@@ -97,7 +109,7 @@ itemLoadingState videoHandler::needsLoading(int frameIdx, bool loadRawValues)
       DEBUG_VIDEO("videoHandler::needsLoading %d is current and %d found in double buffer", frameIdx, frameIdx+1);
       return LoadingNotNeeded;
     }
-    else if (cacheValid && imageCache.contains(frameIdx + 1))
+    else if (cacheValid && isInCacheInternal(frameIdx + 1))
     {
       DEBUG_VIDEO("videoHandler::needsLoading %d is current and %d found in cache", frameIdx, frameIdx+1);
       return LoadingNotNeeded;
@@ -114,7 +126,7 @@ itemLoadingState videoHandler::needsLoading(int frameIdx, bool loadRawValues)
   if (doubleBufferImageFrameIdx == frameIdx)
   {
     // The frame in question is in the double buffer...
-    if (cacheValid && imageCache.contains(frameIdx + 1))
+    if (cacheValid && isInCacheInternal(frameIdx + 1))
     {
       // ... and the one after that is in the cache.
       DEBUG_VIDEO("videoHandler::needsLoading %d found in double buffer. Next frame in cache.", frameIdx);
@@ -131,7 +143,7 @@ itemLoadingState videoHandler::needsLoading(int frameIdx, bool loadRawValues)
   }
 
   // Check the cache
-  if (cacheValid && imageCache.contains(frameIdx))
+  if (cacheValid && isInCacheInternal(frameIdx))
   {
     // What about the next frame? Is it also in the cache or in the double buffer?
     if (doubleBufferImageFrameIdx == frameIdx + 1)
@@ -139,7 +151,7 @@ itemLoadingState videoHandler::needsLoading(int frameIdx, bool loadRawValues)
       DEBUG_VIDEO("videoHandler::needsLoading %d in cache and %d found in double buffer", frameIdx, frameIdx+1);
       return LoadingNotNeeded;
     }
-    else if (cacheValid && imageCache.contains(frameIdx + 1))
+    else if (cacheValid && isInCacheInternal(frameIdx + 1))
     {
       DEBUG_VIDEO("videoHandler::needsLoading %d in cache and %d found in cache", frameIdx, frameIdx+1);
       return LoadingNotNeeded;
@@ -180,6 +192,18 @@ void videoHandler::drawFrame(QPainter *painter, int frameIdx, double zoomFactor,
         currentImageIdx = frameIdx;
         DEBUG_VIDEO("videoHandler::drawFrame %d loaded from cache", frameIdx);
       }
+      else if (cacheValid && rawDataCache.contains(frameIdx))
+      {
+        // Only the raw data is cached. Convert it now.
+        const QByteArray rawData = rawDataCache[frameIdx];
+        lock.unlock();
+        QImage newImage;
+        convertRawDataFromCache(frameIdx, rawData, newImage);
+        QMutexLocker imageLock(&currentImageSetMutex);
+        currentImage = newImage;
+        currentImageIdx = frameIdx;
+        DEBUG_VIDEO("videoHandler::drawFrame %d converted from raw data cache", frameIdx);
+      }
     }
   }
 
@@ -230,7 +254,7 @@ QRgb videoHandler::getPixelVal(int x, int y)
 int videoHandler::getNrFramesCached() const
 {
   QMutexLocker lock(&imageCacheAccess);
-  return imageCache.size();
+  return cachedFrameSet.count();
 }
 
 // Put the frame into the cache (if it is not already in there)
@@ -238,10 +262,25 @@ void videoHandler::cacheFrame(int frameIdx, bool testMode)
 {
   DEBUG_VIDEO("videoHandler::cacheFrame %d %s", frameIdx, testMode ? "testMode" : "");
 
-  if (cacheValid && isInCache(frameIdx) && !testMode)
+  if (!needsCaching(frameIdx, testMode) || (!testMode && restoreFromSpillFile(frameIdx)))
+    return;
+
+  if (cacheRawData)
   {
-    // No need to add it again
-    DEBUG_VIDEO("videoHandler::cacheFrame frame %i already in cache - returning", frameIdx);
+    // Only cache the raw data. It is converted when the frame is drawn.
+    QByteArray rawData;
+    if (loadRawDataForCaching(frameIdx, rawData))
+    {
+      DEBUG_VIDEO("videoHandler::cacheFrame insert raw data of frame %i into cache", frameIdx);
+      QMutexLocker imageCacheLock(&imageCacheAccess);
+      if (cacheValid && !testMode)
+      {
+        rawDataCache.insert(frameIdx, rawData);
+        cachedFrameSet.insert(frameIdx);
+      }
+    }
+    else
+      DEBUG_VIDEO("videoHandler::cacheFrame loading raw data of frame %i for caching failed", frameIdx);
     return;
   }
 
@@ -255,14 +294,126 @@ void videoHandler::cacheFrame(int frameIdx, bool testMode)
     DEBUG_VIDEO("videoHandler::cacheFrame insert frame %i into cache", frameIdx);
     QMutexLocker imageCacheLock(&imageCacheAccess);
     if (cacheValid && !testMode)
+    {
       imageCache.insert(frameIdx, cacheImage);
+      cachedFrameSet.insert(frameIdx);
+    }
   }
   else
     DEBUG_VIDEO("videoHandler::cacheFrame loading frame %i for caching failed", frameIdx);
 }
 
+bool videoHandler::needsCaching(int frameIdx, bool testMode)
+{
+  if (testMode)
+    // In test mode, the frame is always loaded and converted
+    return true;
+
+  if (cacheValid && isInCache(frameIdx))
+  {
+    // No need to add it again
+    DEBUG_VIDEO("videoHandler::needsCaching frame %i already in cache", frameIdx);
+    return false;
+  }
+  return true;
+}
+
+bool videoHandler::restoreFromSpillFile(int frameIdx)
+{
+  if (!spillEvictedFrames)
+    return false;
+
+  // If the frame was spilled to disk before, we can get it from there.
+  videoCacheSpillFile *spillFile = videoCacheSpillFile::globalInstance();
+  QImage cacheImage;
+  QByteArray rawData;
+  // Frames that were put into the cache as raw data (see cacheRawFrame()) were also spilled as raw data.
+  if ((cacheRawData || !spillFile->load(this, frameIdx, cacheImage)) && !spillFile->load(this, frameIdx, rawData))
+    return false;
+  QMutexLocker imageCacheLock(&imageCacheAccess);
+  if (cacheValid)
+  {
+    if (!cacheImage.isNull())
+      imageCache.insert(frameIdx, cacheImage);
+    else
+      rawDataCache.insert(frameIdx, rawData);
+    cachedFrameSet.insert(frameIdx);
+  }
+  DEBUG_VIDEO("videoHandler::restoreFromSpillFile frame %i restored from the spill file", frameIdx);
+  return true;
+}
+
+void videoHandler::cacheFrame(int frameIdx, const QByteArray &rawData, bool testMode)
+{
+  DEBUG_VIDEO("videoHandler::cacheFrame %d from raw data %s", frameIdx, testMode ? "testMode" : "");
+
+  if (rawData.size() < int(getRawCachingFrameSize()))
+  {
+    DEBUG_VIDEO("videoHandler::cacheFrame raw data of frame %i incomplete", frameIdx);
+    return;
+  }
+
+  if (cacheRawData)
+  {
+    QMutexLocker imageCacheLock(&imageCacheAccess);
+    if (cacheValid && !testMode)
+    {
+      rawDataCache.insert(frameIdx, rawData);
+      cachedFrameSet.insert(frameIdx);
+    }
+    return;
+  }
+
+  // Convert the raw data now and cache the image
+  QImage cacheImage;
+  convertRawDataForCaching(frameIdx, rawData, cacheImage);
+  if (!cacheImage.isNull())
+    insertImageIntoCache(frameIdx, cacheImage, testMode);
+  else
+    DEBUG_VIDEO("videoHandler::cacheFrame converting raw data of frame %i failed", frameIdx);
+}
+
+void videoHandler::cacheRawFrame(int frameIdx, const QByteArray &rawData)
+{
+  DEBUG_VIDEO("videoHandler::cacheRawFrame %d", frameIdx);
+
+  if (!supportsRawDataCaching() || rawData.size() < int(getRawCachingFrameSize()))
+    return;
+
+  QMutexLocker imageCacheLock(&imageCacheAccess);
+  if (cacheValid && !isInCacheInternal(frameIdx))
+  {
+    rawDataCache.insert(frameIdx, rawData);
+    cachedFrameSet.insert(frameIdx);
+  }
+}
+
+bool videoHandler::reserveFreeCacheSpace(qint64 nrBytes)
+{
+  qint64 freeSpace = freeCacheSpace.load();
+  while (freeSpace >= nrBytes)
+  {
+    if (freeCacheSpace.testAndSetOrdered(freeSpace, freeSpace - nrBytes))
+      return true;
+    freeSpace = freeCacheSpace.load();
+  }
+  return false;
+}
+
+void videoHandler::insertImageIntoCache(int frameIdx, const QImage &image, bool testMode)
+{
+  QMutexLocker imageCacheLock(&imageCacheAccess);
+  if (cacheValid && !testMode)
+  {
+    imageCache.insert(frameIdx, image);
+    cachedFrameSet.insert(frameIdx);
+  }
+}
+
 unsigned int videoHandler::getCachingFrameSize() const
 {
+  if (cacheRawData)
+    return getRawCachingFrameSize();
   auto bytes = bytesPerPixel(platformImageFormat());
   return frameSize.width() * frameSize.height() * bytes;
 }
@@ -270,27 +421,48 @@ unsigned int videoHandler::getCachingFrameSize() const
 QList<int> videoHandler::getCachedFrames() const
 {
   QMutexLocker lock(&imageCacheAccess);
-  return imageCache.keys();
+  return imageCache.keys() + rawDataCache.keys();
+}
+
+QList<indexRange> videoHandler::getCachedFrameRanges() const
+{
+  QMutexLocker lock(&imageCacheAccess);
+  return cachedFrameSet.getRanges();
 }
 
 int videoHandler::getNumberCachedFrames() const
 {
   QMutexLocker lock(&imageCacheAccess);
-  return imageCache.size();
+  return cachedFrameSet.count();
 }
 
 bool videoHandler::isInCache(int idx) const
 {
   QMutexLocker lock(&imageCacheAccess);
-  return imageCache.contains(idx);
+  return isInCacheInternal(idx);
 }
 
 void videoHandler::removeFrameFromCache(int frameIdx)
 {
   DEBUG_VIDEO("removeFrameFromCache %d", frameIdx);
   QMutexLocker lock(&imageCacheAccess);
-  imageCache.remove(frameIdx);
+  // Take the frame (this is only a shallow copy) out of the cache. It is spilled after the lock is released.
+  const bool spill = spillEvictedFrames && cacheValid;
+  const QImage image = imageCache.take(frameIdx);
+  const QByteArray rawData = rawDataCache.take(frameIdx);
+  cachedFrameSet.remove(frameIdx);
   lock.unlock();
+
+  if (spill)
+  {
+    // Move the frame to the spill file. If it is needed again, loading it from there is faster. This only queues the
+    // frame. The spill file writes it in its own thread.
+    videoCacheSpillFile *spillFile = videoCacheSpillFile::globalInstance();
+    if (!image.isNull())
+      spillFile->store(this, frameIdx, image);
+    else if (!rawData.isEmpty())
+      spillFile->store(this, frameIdx, rawData);
+  }
 }
 
 void videoHandler::removeAllFrameFromCache()
@@ -298,8 +470,25 @@ void videoHandler::removeAllFrameFromCache()
   DEBUG_VIDEO("removeAllFrameFromCache");
   QMutexLocker lock(&imageCacheAccess);
   imageCache.clear();
+  rawDataCache.clear();
+  cachedFrameSet.clear();
   cacheValid = true;
   lock.unlock();
+
+  // The cache is cleared if the frames are not valid anymore. This also applies to the spilled frames.
+  if (spillEvictedFrames)
+    videoCacheSpillFile::globalInstance()->removeAll(this);
+}
+
+void videoHandler::setCacheRawData(bool cacheRaw)
+{
+  if (cacheRaw == cacheRawData || (cacheRaw && !supportsRawDataCaching()))
+    return;
+
+  // The frames in the cache are of the wrong type now. Clear the cache and recache.
+  cacheRawData = cacheRaw;
+  setCacheInvalid();
+  emit signalHandlerChanged(false, RECACHE_CLEAR);
 }
 
 void videoHandler::loadFrame(int frameIndex, bool loadToDoubleBuffer)
@@ -319,17 +508,22 @@ void videoHandler::loadFrame(int frameIndex, bool loadToDoubleBuffer)
       return;
   }
 
+  setLoadedFrame(frameIndex, requestedFrame, loadToDoubleBuffer);
+}
+
+void videoHandler::setLoadedFrame(int frameIndex, const QImage &image, bool loadToDoubleBuffer)
+{
   if (loadToDoubleBuffer)
   {
-    // Save the requested frame in the double buffer
-    doubleBufferImage = requestedFrame;
+    // Save the frame in the double buffer
+    doubleBufferImage = image;
     doubleBufferImageFrameIdx = frameIndex;
   }
   else
   {
-    // Set the requested frame as the current frame
+    // Set the frame as the current frame
     QMutexLocker imageLock(&currentImageSetMutex);
-    currentImage = requestedFrame;
+    currentImage = image;
     currentImageIdx = frameIndex;
   }
 }
@@ -364,7 +558,11 @@ void videoHandler::invalidateAllBuffers()
   requestedFrame_idx = -1;
 
   imageCache.clear();
+  rawDataCache.clear();
+  cachedFrameSet.clear();
   cacheValid = true;
+  if (spillEvictedFrames)
+    videoCacheSpillFile::globalInstance()->removeAll(this);
 }
 
 void videoHandler::activateDoubleBuffer()
@@ -34,6 +34,8 @@
 #define VIDEOHANDLER_H
 
 #include "frameHandler.h"
+#include "indexRangeSet.h"
+#include <QAtomicInteger>
 #include <QBasicTimer>
 #include <QFileInfo>
 #include <QMutex>
@@ -49,6 +51,7 @@ public:
   /*
   */
   videoHandler();
+  ~videoHandler();
   
   // Draw the frame with the given frame index and zoom factor. If onLoadShowLasFrame is set, show the last frame
   // if the frame with the current frame index is loaded in the background.
@@ -58,12 +61,39 @@ public:
   // These methods are all thread-safe and can be invoked from any thread.
   int getNrFramesCached() const;
   void cacheFrame(int frameIdx, bool testMode);
+  // Items that decode the raw data for caching themselves (e.g. with multiple decoders in parallel) can use these instead
+  // of cacheFrame. needsCaching returns false if the frame is already cached. Otherwise, try restoreFromSpillFile first
+  // (if the frame was spilled to disk, it is put back into the cache). If that fails, the raw data of the frame has to be
+  // provided to cacheFrame. It is then cached (and converted if necessary).
+  bool needsCaching(int frameIdx, bool testMode);
+  bool restoreFromSpillFile(int frameIdx);
+  void cacheFrame(int frameIdx, const QByteArray &rawData, bool testMode);
+  // Put the raw data of a frame that the item decoded anyway (e.g. on the way to another frame) into the cache. The raw
+  // data is always cached as is (also if the converted images are cached). It is only converted when it is drawn.
+  void cacheRawFrame(int frameIdx, const QByteArray &rawData);
+  // The video cache publishes how much space in the cache is still free. Frames that are put into the cache outside of
+  // the caching threads (see cacheRawFrame()) must reserve their space first so that they never push other frames out.
+  static void setFreeCacheSpace(qint64 nrBytes) { freeCacheSpace.store(nrBytes); }
+  static bool reserveFreeCacheSpace(qint64 nrBytes);
   unsigned int getCachingFrameSize() const; // How much bytes will be used when caching one frame?
   QList<int> getCachedFrames() const;
+  // Get the cached frames as a list of ranges. This is much faster than getCachedFrames() if many frames are cached.
+  QList<indexRange> getCachedFrameRanges() const;
   int getNumberCachedFrames() const;
   bool isInCache(int idx) const;
   virtual void removeFrameFromCache(int frameIdx);
   virtual void removeAllFrameFromCache();
+
+  // --- Raw data caching: Instead of the converted RGB images, the raw frames (in the source format) can be cached.
+  // These are only converted to RGB when they are drawn. For most formats, this needs much less memory per frame.
+  bool isCachingRawData() const { return cacheRawData; }
+  void setCacheRawData(bool cacheRaw);
+  // Can this handler cache the raw frame data? The default is no.
+  virtual bool supportsRawDataCaching() const { return false; }
+
+  // If set, frames that are removed from the cache are moved to the spill file on disk (if enabled in the settings).
+  // Use this if (re)loading a frame is expensive (e.g. for decoded frames).
+  void setSpillEvictedFrames(bool spill) { spillEvictedFrames = spill; }
   
   // Same as the calculateDifference in frameHandler. For a video we have to make sure that the right frame is loaded first.
   virtual QImage calculateDifference(frameHandler *item2, const int frameIdxItem0, const int frameIdxItem1, QList<infoItem> &differenceInfoList, const int amplificationFactor, const bool markDifference) Q_DECL_OVERRIDE;
@@ -88,18 +118,21 @@ public:
 
   // The user changed the frame. Do we need to load something before we can draw it? Do we need to update the double buffer?
   // loadRawValues: Do we also need to update the buffer of the raw values because they will be drawn?
-  itemLoadingState needsLoading(int frameIndex, bool loadRawValues);
+  virtual itemLoadingState needsLoading(int frameIndex, bool loadRawValues);
 
   // The video handler want's to draw a frame but it's not cached yet and has to be loaded.
   // A sub class can change this implementation to request raw data of a certain format instead of an image.
   // After this function was called, currentFrame should contain the requested frame and currentFrameIdx should
   // be equal to frameIndex.
   virtual void loadFrame(int frameIndex, bool loadToDoubleBuffer=false);
+  // Set the image of a frame that was loaded and converted some other way (e.g. decoded ahead during playback) as
+  // the current frame or put it into the double buffer.
+  virtual void setLoadedFrame(int frameIndex, const QImage &image, bool loadToDoubleBuffer=false);
 
   int getCurrentImageIndex() { return currentImageIdx; }
 
   // Set the image in the double buffer as the current image. After this, a new image can be loaded to the double buffer.
-  void activateDoubleBuffer();
+  virtual void activateDoubleBuffer();
   
 signals:
 
@@ -109,6 +142,10 @@ signals:
 
   // The video handler requests a certain frame to be loaded. After this signal is emitted, the frame should be in requestedFrame.
   void signalRequestFrame(int frameIdx, bool caching);
+
+  // The current frame has to be loaded again before it can be drawn completely (e.g. because a different part of it is
+  // visible now). needsLoading() will request this.
+  void signalCurrentFrameLoadingNeeded();
     
 protected:
 
@@ -129,6 +166,16 @@ protected:
   // the requested frame. No other internal state of the specific video format handler should be changed.
   // currentFrame/currentFrameIdx is still the frame on screen. This is called from a background thread.
   virtual void loadFrameForCaching(int frameIndex, QImage &frameToCache);
+
+  // If raw data caching is enabled, these are used instead of loadFrameForCaching. Load the raw data of the given frame
+  // for caching (this is called from a background thread) and convert a raw frame from the cache to an image (this is
+  // called when the frame is drawn). The size of one raw frame is returned by getRawCachingFrameSize().
+  virtual bool loadRawDataForCaching(int frameIndex, QByteArray &rawData) { Q_UNUSED(frameIndex); Q_UNUSED(rawData); return false; }
+  virtual void convertRawDataFromCache(int frameIndex, const QByteArray &rawData, QImage &image) { Q_UNUSED(frameIndex); Q_UNUSED(rawData); Q_UNUSED(image); }
+  // Convert raw data that was loaded by the item for caching (see cacheFrame(int, const QByteArray&, bool)). This is
+  // called from a caching thread.
+  virtual void convertRawDataForCaching(int frameIndex, const QByteArray &rawData, QImage &image) { convertRawDataFromCache(frameIndex, rawData, image); }
+  virtual unsigned int getRawCachingFrameSize() const { return 0; }
     
   // Only one thread at a time should request something to be loaded. 
   QMutex requestDataMutex;
@@ -149,6 +196,18 @@ protected:
   // --- Caching
   QMutex mutable     imageCacheAccess;
   QMap<int, QImage>  imageCache;
+  // If cacheRawData is set, the raw frames are cached in here (and imageCache is not used). Frames that were added with
+  // cacheRawFrame() are also in here.
+  bool                  cacheRawData;
+  QMap<int, QByteArray> rawDataCache;
+  // The indices of all frames in imageCache and rawDataCache
+  indexRangeSet         cachedFrameSet;
+  // Put the converted image of the given frame into the cache (unless testMode is set or the cache is invalid)
+  void insertImageIntoCache(int frameIdx, const QImage &image, bool testMode);
+  // Is the frame in one of the caches? The imageCacheAccess mutex must be locked.
+  bool isInCacheInternal(int frameIdx) const { return imageCache.contains(frameIdx) || rawDataCache.contains(frameIdx); }
+  // Move evicted frames to the spill file (see setSpillEvictedFrames())
+  bool spillEvictedFrames;
   // Is the cache valid? The cache can be ivalid in the following scenario:
   // Somethign about how an item is shown changes (e.g. the resolution) but caching of the item is currently performed.
   // If we just cleared the cache, the wrong (currently being cached) frames would still end up in the cache. So we emit
@@ -156,6 +215,9 @@ protected:
   // Until then, however, the items that are in the cache (or are being put into the cache by the still running threads) are invalid.
   bool cacheValid;
 
+  // The free space in the video cache (see setFreeCacheSpace())
+  static QAtomicInteger<qint64> freeCacheSpace;
+
 private slots:
   // Override the slotVideoControlChanged slot. For a videoHandler, also the number of frames might have changed.
   void slotVideoControlChanged() Q_DECL_OVERRIDE;
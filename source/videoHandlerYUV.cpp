@@ -33,11 +33,16 @@
 #include "videoHandlerYUV.h"
 
 #include <algorithm>
+#include <cmath>
 #include <cstdio>
-#include <xmmintrin.h>
 #include <QDir>
 #include <QPainter>
+#include <QThreadPool>
+#include <QtConcurrent>
+#include <QVector>
 #include "fileInfoWidget.h"
+#include "videoCacheSpillFile.h"
+#include "videoHandlerYUVSIMD.h"
 
 using namespace YUV_Internals;
 
@@ -56,6 +61,18 @@ const int yuvRgbConvCoeffs[6][5] =
 const int yuvRgbConvScaleLuma[255] = 
 { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 2, 3, 4, 5, 6, 8, 9, 10, 11, 12, 13, 15, 16, 17, 18, 19, 20, 22, 23, 24, 25, 26, 27, 29, 30, 31, 32, 33, 34, 36, 37, 38, 39, 40, 41, 43, 44, 45, 46, 47, 48, 50, 51, 52, 53, 54, 55, 57, 58, 59, 60, 61, 62, 64, 65, 66, 67, 68, 69, 71, 72, 73, 74, 75, 76, 78, 79, 80, 81, 82, 83, 85, 86, 87, 88, 89, 90, 91, 93, 94, 95, 96, 97, 98, 100, 101, 102, 103, 104, 105, 107, 108, 109, 110, 111, 112, 114, 115, 116, 117, 118, 119, 121, 122, 123, 124, 125, 126, 128, 129, 130, 131, 132, 133, 135, 136, 137, 138, 139, 140, 142, 143, 144, 145, 146, 147, 149, 150, 151, 152, 153, 154, 156, 157, 158, 159, 160, 161, 163, 164, 165, 166, 167, 168, 170, 171, 172, 173, 174, 175, 176, 178, 179, 180, 181, 182, 183, 185, 186, 187, 188, 189, 190, 192, 193, 194, 195, 196, 197, 199, 200, 201, 202, 203, 204, 206, 207, 208, 209, 210, 211, 213, 214, 215, 216, 217, 218, 220, 221, 222, 223, 224, 225, 227, 228, 229, 230, 231, 232, 234, 235, 236, 237, 238, 239, 241, 242, 243, 244, 245, 246, 248, 249, 250, 251, 252, 253, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255 };
 
+// When converting a frame in parallel (interactive loading), the frame is split into horizontal stripes
+// of at least this many lines.
+#define CONVERSION_STRIPE_MIN_HEIGHT 64
+
+// Only the visible part of a frame is converted if the converted image is at most 1/VIEWPORT_CONVERSION_MAX_FRACTION
+// of the size of the full frame. The converted part is extended by VIEWPORT_CONVERSION_MARGIN_PERCENT of its size in
+// each direction so that small moves of the view do not trigger a new conversion.
+#define VIEWPORT_CONVERSION_MAX_FRACTION 4
+#define VIEWPORT_CONVERSION_MARGIN_PERCENT 25
+// How many converted parts of the current frame do we keep? (Usually one for the view and one for the zoom box)
+#define VIEWPORT_IMAGE_CACHE_SIZE 2
+
 // Activate this if you want to know when which buffer is loaded/converted to image and so on.
 #define VIDEOHANDLERYUV_DEBUG_LOADING 0
 #if VIDEOHANDLERYUV_DEBUG_LOADING && !NDEBUG
@@ -644,6 +661,12 @@ videoHandlerYUV::videoHandlerYUV() : videoHandler()
   currentFrameRawYUVData_frameIdx = -1;
   rawYUVData_frameIdx = -1;
   showPixelValuesAsDiff = false;
+
+  viewportOnlyFrameIdx = -1;
+  drawnViewportSinceLoad = false;
+  drawnFullSinceLoad = false;
+  viewportStep = 1;
+  viewportConversionNeeded = false;
 }
 
 videoHandlerYUV::~videoHandlerYUV()
@@ -675,154 +698,228 @@ void videoHandlerYUV::drawFrame(QPainter *painter, int frameIdx, double zoomFact
 
     // Draw the text
     painter->drawText(textRect, msg);
+    return;
   }
+
+  // Create the video QRect with the size of the sequence and center it.
+  QRect videoRect;
+  videoRect.setSize(frameSize * zoomFactor);
+  videoRect.moveCenter(QPoint(0,0));
+
+  // Is only a small part of the frame visible (or is the frame drawn downscaled)? Remember this (and the visible part)
+  // so that the next loadFrame() only converts this part of the frame.
+  QRect visibleRect;
+  int step = 1;
+  const bool viewportDraw = getViewportConversionRect(painter, videoRect, visibleRect, step);
+  if (viewportDraw)
+    drawnViewportSinceLoad = true;
   else
-    videoHandler::drawFrame(painter, frameIdx, zoomFactor, drawRawData);
-}
-
-/// --- Convert from the current YUV input format to YUV 444
-
-#if SSE_CONVERSION_420_ALT
-void videoHandlerYUV::yuv420_to_argb8888(quint8 *yp, quint8 *up, quint8 *vp, quint32 sy, quint32 suv, int width, int height, quint8 *rgb, quint32 srgb)
-{
-  __m128i y0r0, y0r1, u0, v0;
-  __m128i y00r0, y01r0, y00r1, y01r1;
-  __m128i u00, u01, v00, v01;
-  __m128i rv00, rv01, gu00, gu01, gv00, gv01, bu00, bu01;
-  __m128i r00, r01, g00, g01, b00, b01;
-  __m128i rgb0123, rgb4567, rgb89ab, rgbcdef;
-  __m128i gbgb;
-  __m128i ysub, uvsub;
-  __m128i zero, facy, facrv, facgu, facgv, facbu;
-  __m128i *srcy128r0, *srcy128r1;
-  __m128i *dstrgb128r0, *dstrgb128r1;
-  __m64   *srcu64, *srcv64;
-
-
-  //    Implement the following conversion:
-  //    B = 1.164(Y - 16)                   + 2.018(U - 128)
-  //    G = 1.164(Y - 16) - 0.813(V - 128)  - 0.391(U - 128)
-  //    R = 1.164(Y - 16) + 1.596(V - 128)
-
-  int x, y;
-  // constants
-  ysub  = _mm_set1_epi32(0x00100010); // value 16 for subtraction
-  uvsub = _mm_set1_epi32(0x00800080); // value 128
-
-  // multiplication factors bit shifted by 6
-  facy  = _mm_set1_epi32(0x004a004a);
-  facrv = _mm_set1_epi32(0x00660066);
-  facgu = _mm_set1_epi32(0x00190019);
-  facgv = _mm_set1_epi32(0x00340034);
-  facbu = _mm_set1_epi32(0x00810081);
-
-  zero  = _mm_set1_epi32(0x00000000);
-
-  for(y = 0; y < height; y += 2)
-  {
-    srcy128r0 = (__m128i *)(yp + sy*y);
-    srcy128r1 = (__m128i *)(yp + sy*y + sy);
-    srcu64 = (__m64 *)(up + suv*(y/2));
-    srcv64 = (__m64 *)(vp + suv*(y/2));
-
-    // dst row 0 and row 1
-    dstrgb128r0 = (__m128i *)(rgb + srgb*y);
-    dstrgb128r1 = (__m128i *)(rgb + srgb*y + srgb);
-
-    for(x = 0; x < width; x += 16)
-    {
-      u0 = _mm_loadl_epi64((__m128i *)srcu64); srcu64++;
-      v0 = _mm_loadl_epi64((__m128i *)srcv64); srcv64++;
-
-      y0r0 = _mm_load_si128(srcy128r0++);
-      y0r1 = _mm_load_si128(srcy128r1++);
-
-      // expand to 16 bit, subtract and multiply constant y factors
-      y00r0 = _mm_mullo_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(y0r0, zero), ysub), facy);
-      y01r0 = _mm_mullo_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(y0r0, zero), ysub), facy);
-      y00r1 = _mm_mullo_epi16(_mm_sub_epi16(_mm_unpacklo_epi8(y0r1, zero), ysub), facy);
-      y01r1 = _mm_mullo_epi16(_mm_sub_epi16(_mm_unpackhi_epi8(y0r1, zero), ysub), facy);
-
-      // expand u and v so they're aligned with y values
-      u0  = _mm_unpacklo_epi8(u0,  zero);
-      u00 = _mm_sub_epi16(_mm_unpacklo_epi16(u0, u0), uvsub);
-      u01 = _mm_sub_epi16(_mm_unpackhi_epi16(u0, u0), uvsub);
-
-      v0  = _mm_unpacklo_epi8(v0,  zero);
-      v00 = _mm_sub_epi16(_mm_unpacklo_epi16(v0, v0), uvsub);
-      v01 = _mm_sub_epi16(_mm_unpackhi_epi16(v0, v0), uvsub);
-
-      // common factors on both rows.
-      rv00 = _mm_mullo_epi16(facrv, v00);
-      rv01 = _mm_mullo_epi16(facrv, v01);
-      gu00 = _mm_mullo_epi16(facgu, u00);
-      gu01 = _mm_mullo_epi16(facgu, u01);
-      gv00 = _mm_mullo_epi16(facgv, v00);
-      gv01 = _mm_mullo_epi16(facgv, v01);
-      bu00 = _mm_mullo_epi16(facbu, u00);
-      bu01 = _mm_mullo_epi16(facbu, u01);
-
-      // add together and bit shift to the right
-      r00 = _mm_srai_epi16(_mm_add_epi16(y00r0, rv00), 6);
-      r01 = _mm_srai_epi16(_mm_add_epi16(y01r0, rv01), 6);
-      g00 = _mm_srai_epi16(_mm_sub_epi16(_mm_sub_epi16(y00r0, gu00), gv00), 6);
-      g01 = _mm_srai_epi16(_mm_sub_epi16(_mm_sub_epi16(y01r0, gu01), gv01), 6);
-      b00 = _mm_srai_epi16(_mm_add_epi16(y00r0, bu00), 6);
-      b01 = _mm_srai_epi16(_mm_add_epi16(y01r0, bu01), 6);
-
-      r00 = _mm_packus_epi16(r00, r01);
-      g00 = _mm_packus_epi16(g00, g01);
-      b00 = _mm_packus_epi16(b00, b01);
-
-      // shuffle back together to lower 0rgb0rgb...
-      r01     = _mm_unpacklo_epi8(r00,  zero); // 0r0r...
-      gbgb    = _mm_unpacklo_epi8(b00,  g00);  // gbgb...
-      rgb0123 = _mm_unpacklo_epi16(gbgb, r01);  // lower 0rgb0rgb...
-      rgb4567 = _mm_unpackhi_epi16(gbgb, r01);  // upper 0rgb0rgb...
-
-      // shuffle back together to upper 0rgb0rgb...
-      r01     = _mm_unpackhi_epi8(r00,  zero);
-      gbgb    = _mm_unpackhi_epi8(b00,  g00);
-      rgb89ab = _mm_unpacklo_epi16(gbgb, r01);
-      rgbcdef = _mm_unpackhi_epi16(gbgb, r01);
-
-      // write to dst
-      _mm_store_si128(dstrgb128r0++, rgb0123);
-      _mm_store_si128(dstrgb128r0++, rgb4567);
-      _mm_store_si128(dstrgb128r0++, rgb89ab);
-      _mm_store_si128(dstrgb128r0++, rgbcdef);
-
-      // row 1
-      r00 = _mm_srai_epi16(_mm_add_epi16(y00r1, rv00), 6);
-      r01 = _mm_srai_epi16(_mm_add_epi16(y01r1, rv01), 6);
-      g00 = _mm_srai_epi16(_mm_sub_epi16(_mm_sub_epi16(y00r1, gu00), gv00), 6);
-      g01 = _mm_srai_epi16(_mm_sub_epi16(_mm_sub_epi16(y01r1, gu01), gv01), 6);
-      b00 = _mm_srai_epi16(_mm_add_epi16(y00r1, bu00), 6);
-      b01 = _mm_srai_epi16(_mm_add_epi16(y01r1, bu01), 6);
-
-      r00 = _mm_packus_epi16(r00, r01);
-      g00 = _mm_packus_epi16(g00, g01);
-      b00 = _mm_packus_epi16(b00, b01);
-
-      r01     = _mm_unpacklo_epi8(r00,  zero);
-      gbgb    = _mm_unpacklo_epi8(b00,  g00);
-      rgb0123 = _mm_unpacklo_epi16(gbgb, r01);
-      rgb4567 = _mm_unpackhi_epi16(gbgb, r01);
-
-      r01     = _mm_unpackhi_epi8(r00,  zero);
-      gbgb    = _mm_unpackhi_epi8(b00,  g00);
-      rgb89ab = _mm_unpacklo_epi16(gbgb, r01);
-      rgbcdef = _mm_unpackhi_epi16(gbgb, r01);
-
-      _mm_store_si128(dstrgb128r1++, rgb0123);
-      _mm_store_si128(dstrgb128r1++, rgb4567);
-      _mm_store_si128(dstrgb128r1++, rgb89ab);
-      _mm_store_si128(dstrgb128r1++, rgbcdef);
+    drawnFullSinceLoad = true;
+
+  if (frameIdx != currentImageIdx && frameIdx == doubleBufferImageFrameIdx)
+    activateDoubleBuffer();
+
+  QMutexLocker lock(&currentImageSetMutex);
+  if (viewportDraw)
+  {
+    viewportRect = visibleRect;
+    viewportStep = step;
+  }
+  if (frameIdx == currentImageIdx && frameIdx == viewportOnlyFrameIdx)
+  {
+    // Only parts of the current frame were converted. Draw what we have. If this does not cover what is visible
+    // now (or the full frame is needed), the frame is loaded again and the missing part is converted in the loading thread.
+    const bool covered = viewportDraw ? drawViewportImage(painter, frameIdx, videoRect, visibleRect, step) : drawViewportImage(painter, frameIdx, videoRect, QRect(QPoint(0, 0), frameSize), 1);
+    const bool requestLoading = !covered && !viewportConversionNeeded;
+    if (!covered)
+      viewportConversionNeeded = true;
+    lock.unlock();
+
+    if (requestLoading)
+      emit signalCurrentFrameLoadingNeeded();
+    if (drawRawData && zoomFactor >= SPLITVIEW_DRAW_VALUES_ZOOMFACTOR)
+      drawPixelValues(painter, frameIdx, videoRect, zoomFactor);
+    return;
+  }
+  lock.unlock();
+
+  videoHandler::drawFrame(painter, frameIdx, zoomFactor, drawRawData);
+}
+
+// Get the part of the frame that is visible in the painter (in frame coordinates and aligned to the chroma
+// subsampling). step is the downscaling factor (a power of 2) that is sufficient for the zoom factor. Return true
+// if converting only this part is worth it (it is much smaller than the full frame).
+bool videoHandlerYUV::getViewportConversionRect(QPainter *painter, const QRect &videoRect, QRect &visibleRect, int &step) const
+{
+  if (!srcPixelFormat.planar || painter->device() == nullptr || videoRect.isEmpty() || !frameSize.isValid())
+    return false;
+  if (srcPixelFormat.uvInterleaved && (srcPixelFormat.planeOrder == Order_YUVA || srcPixelFormat.planeOrder == Order_YVUA))
+    return false;
+
+  // The visible part of the painter in item coordinates (the item is drawn centered around (0,0))
+  QRectF drawArea = painter->worldTransform().inverted().mapRect(QRectF(0, 0, painter->device()->width(), painter->device()->height()));
+  if (painter->hasClipping())
+    drawArea &= painter->clipBoundingRect();
+
+  // Convert to frame coordinates
+  const double scaleX = double(videoRect.width()) / frameSize.width();
+  const double scaleY = double(videoRect.height()) / frameSize.height();
+  const double left   = (drawArea.left()   - videoRect.left()) / scaleX;
+  const double right  = (drawArea.right()  - videoRect.left()) / scaleX;
+  const double top    = (drawArea.top()    - videoRect.top())  / scaleY;
+  const double bottom = (drawArea.bottom() - videoRect.top())  / scaleY;
+
+  // If the frame is drawn downscaled, we can skip samples
+  const double zoomFactor = std::min(scaleX, scaleY);
+  step = 1;
+  while (step * 2 * zoomFactor <= 1.0)
+    step *= 2;
+
+  // Align the rect to the chroma subsampling (times the step) and clip it to the frame
+  const int alignX = step * srcPixelFormat.getSubsamplingHor();
+  const int alignY = step * srcPixelFormat.getSubsamplingVer();
+  const int maxX = frameSize.width() / alignX * alignX;
+  const int maxY = frameSize.height() / alignY * alignY;
+  const int x0 = clip(int(std::floor(left   / alignX)) * alignX, 0, maxX);
+  const int x1 = clip(int(std::ceil (right  / alignX)) * alignX, 0, maxX);
+  const int y0 = clip(int(std::floor(top    / alignY)) * alignY, 0, maxY);
+  const int y1 = clip(int(std::ceil (bottom / alignY)) * alignY, 0, maxY);
+  visibleRect = QRect(x0, y0, std::max(x1 - x0, 0), std::max(y1 - y0, 0));
+
+  const qint64 convertedPixels = qint64(visibleRect.width() / step) * (visibleRect.height() / step);
+  return convertedPixels * VIEWPORT_CONVERSION_MAX_FRACTION <= qint64(frameSize.width()) * frameSize.height();
+}
+
+// Convert the part of the frame in currentFrameRawYUVData that was visible in the last viewport draw call (with a
+// margin so that the view can be moved a bit without loading again). This is called from the loading thread.
+bool videoHandlerYUV::convertViewportImage(int frameIdx, viewportImage &newImage)
+{
+  currentImageSetMutex.lock();
+  const QRect visibleRect = viewportRect;
+  const int step = viewportStep;
+  currentImageSetMutex.unlock();
+
+  newImage.frameIdx = frameIdx;
+  newImage.step = step;
+  if (visibleRect.isEmpty())
+  {
+    // Nothing of the frame is visible
+    newImage.rect = QRect();
+    newImage.image = QImage();
+    return true;
+  }
+
+  // Extend the rect by the margin (keep it aligned) and convert that part
+  const int alignX = step * srcPixelFormat.getSubsamplingHor();
+  const int alignY = step * srcPixelFormat.getSubsamplingVer();
+  const int marginX = (visibleRect.width()  * VIEWPORT_CONVERSION_MARGIN_PERCENT / 100 + alignX - 1) / alignX * alignX;
+  const int marginY = (visibleRect.height() * VIEWPORT_CONVERSION_MARGIN_PERCENT / 100 + alignY - 1) / alignY * alignY;
+  const QRect frameRect(0, 0, frameSize.width() / alignX * alignX, frameSize.height() / alignY * alignY);
+  newImage.rect = visibleRect.adjusted(-marginX, -marginY, marginX, marginY) & frameRect;
+
+  QByteArray croppedYUV;
+  if (!cropYUVPlanar(currentFrameRawYUVData, newImage.rect, step, croppedYUV))
+    return false;
+  convertYUVToImage(croppedYUV, newImage.image, srcPixelFormat, newImage.rect.size() / step, true);
+  return !newImage.image.isNull();
+}
+
+// Draw the converted parts of the given frame (the newest one on top). Return true if the visible part of the frame
+// is covered by a part that was converted with at least the resolution of the given step.
+// The caller must lock the currentImageSetMutex.
+bool videoHandlerYUV::drawViewportImage(QPainter *painter, int frameIdx, const QRect &videoRect, const QRect &visibleRect, int step)
+{
+  const double scaleX = double(videoRect.width()) / frameSize.width();
+  const double scaleY = double(videoRect.height()) / frameSize.height();
+  bool covered = visibleRect.isEmpty();
+  for (int i = viewportImageCache.size() - 1; i >= 0; i--)
+  {
+    const viewportImage &img = viewportImageCache[i];
+    if (img.frameIdx != frameIdx || img.image.isNull())
+      continue;
+
+    // Draw the converted part at its position within the frame
+    const QRectF targetRect(videoRect.left() + img.rect.left() * scaleX, videoRect.top() + img.rect.top() * scaleY, img.rect.width() * scaleX, img.rect.height() * scaleY);
+    painter->drawImage(targetRect, img.image);
+    if (img.step <= step && img.rect.contains(visibleRect))
+      covered = true;
+  }
+  return covered;
+}
+
+// Copy the given rect out of the current planar YUV frame (in srcPixelFormat). Only every step-th sample (in both
+// directions) is copied so that the result is the downscaled rect. The rect must be aligned to the chroma subsampling
+// times the step. The output has the same format and the size rect.size()/step.
+bool videoHandlerYUV::cropYUVPlanar(const QByteArray &sourceBuffer, const QRect &rect, int step, QByteArray &targetBuffer) const
+{
+  const yuvPixelFormat format = srcPixelFormat;
+  const QSize targetSize = rect.size() / step;
+  if (!format.planar || sourceBuffer.size() < format.bytesPerFrame(frameSize) || targetSize.isEmpty())
+    return false;
+
+  const int bytesPerSample = (format.bitsPerSample + 7) / 8;
+  const int subH = format.getSubsamplingHor();
+  const int subV = format.getSubsamplingVer();
+  const bool hasAlpha = (format.planeOrder == Order_YUVA || format.planeOrder == Order_YVUA);
+  if (format.uvInterleaved && hasAlpha)
+    return false;
+
+  targetBuffer.resize(format.bytesPerFrame(targetSize));
+  const unsigned char *src = (const unsigned char*)sourceBuffer.constData();
+  unsigned char *dst = (unsigned char*)targetBuffer.data();
 
+  // Copy a part of one plane. After this, src and dst point to the next plane.
+  auto copyPlane = [&](int planeWidth, int planeHeight, int x0, int y0, int targetWidth, int targetHeight, int valuesPerSample)
+  {
+    const int bytesPerPos = bytesPerSample * valuesPerSample;
+    const int srcStride = planeWidth * bytesPerPos;
+    for (int y = 0; y < targetHeight; y++)
+    {
+      const unsigned char *srcLine = src + (y0 + y * step) * srcStride + x0 * bytesPerPos;
+      if (step == 1)
+        memcpy(dst, srcLine, targetWidth * bytesPerPos);
+      else
+        for (int x = 0; x < targetWidth; x++)
+          memcpy(dst + x * bytesPerPos, srcLine + x * step * bytesPerPos, bytesPerPos);
+      dst += targetWidth * bytesPerPos;
     }
+    src += planeHeight * srcStride;
+  };
+
+  // Luma
+  copyPlane(frameSize.width(), frameSize.height(), rect.x(), rect.y(), targetSize.width(), targetSize.height(), 1);
+
+  // Chroma
+  if (format.subsampling != YUV_400)
+  {
+    const int chromaWidth = frameSize.width() / subH;
+    const int chromaHeight = frameSize.height() / subV;
+    const int nrChromaPlanes = format.uvInterleaved ? 1 : 2;
+    for (int c = 0; c < nrChromaPlanes; c++)
+      copyPlane(chromaWidth, chromaHeight, rect.x() / subH, rect.y() / subV, targetSize.width() / subH, targetSize.height() / subV, format.uvInterleaved ? 2 : 1);
   }
+
+  // Alpha
+  if (hasAlpha)
+    copyPlane(frameSize.width(), frameSize.height(), rect.x(), rect.y(), targetSize.width(), targetSize.height(), 1);
+
+  return true;
+}
+
+QRgb videoHandlerYUV::getPixelVal(int x, int y)
+{
+  QMutexLocker setLock(&currentImageSetMutex);
+  if (currentImageIdx != -1 && currentImageIdx == viewportOnlyFrameIdx)
+  {
+    // Only parts of the current frame were converted. Take the value from the one that contains the pixel.
+    for (const viewportImage &img : viewportImageCache)
+      if (img.frameIdx == currentImageIdx && !img.image.isNull() && img.rect.contains(x, y))
+        return img.image.pixel((x - img.rect.left()) / img.step, (y - img.rect.top()) / img.step);
+    return qRgb(0, 0, 0);
+  }
+  setLock.unlock();
+  return videoHandler::getPixelVal(x, y);
 }
-#endif
 
 QLayout *videoHandlerYUV::createYUVVideoHandlerControls(bool isSizeFixed)
 {
@@ -878,6 +975,7 @@ QLayout *videoHandlerYUV::createYUVVideoHandlerControls(bool isSizeFixed)
   ui.chromaOffsetSpinBox->setMaximum(1000);
   ui.chromaOffsetSpinBox->setValue(mathParameters[Chroma].offset);
   ui.chromaInvertCheckBox->setChecked(mathParameters[Chroma].invert);
+  ui.cacheRawDataCheckBox->setChecked(cacheRawData);
 
   // Connect all the change signals from the controls to "connectWidgetSignals()"
   connect(ui.yuvFormatComboBox, QOverload<int>::of(&QComboBox::currentIndexChanged), this, &videoHandlerYUV::slotYUVFormatControlChanged);
@@ -890,6 +988,7 @@ QLayout *videoHandlerYUV::createYUVVideoHandlerControls(bool isSizeFixed)
   connect(ui.chromaScaleSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &videoHandlerYUV::slotYUVControlChanged);
   connect(ui.chromaOffsetSpinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &videoHandlerYUV::slotYUVControlChanged);
   connect(ui.chromaInvertCheckBox, &QCheckBox::stateChanged, this, &videoHandlerYUV::slotYUVControlChanged);
+  connect(ui.cacheRawDataCheckBox, &QCheckBox::stateChanged, this, &videoHandlerYUV::slotYUVControlChanged);
 
   if (!isSizeFixed && newVBoxLayout)
     newVBoxLayout->addLayout(ui.topVBoxLayout);
@@ -986,7 +1085,9 @@ void videoHandlerYUV::slotYUVControlChanged()
   // The control that caused the slot to be called
   QObject *sender = QObject::sender();
 
-  if (sender == ui.colorComponentsComboBox ||
+  if (sender == ui.cacheRawDataCheckBox)
+    setCacheRawData(ui.cacheRawDataCheckBox->isChecked());
+  else if (sender == ui.colorComponentsComboBox ||
            sender == ui.chromaInterpolationComboBox ||
            sender == ui.colorConversionComboBox ||
            sender == ui.lumaScaleSpinBox ||
@@ -1010,6 +1111,12 @@ void videoHandlerYUV::slotYUVControlChanged()
     // Emit that this item needs redraw and the cache needs updating.
     currentImageIdx = -1;
     currentImage_frameIndex = -1;
+    if (cacheRawData)
+    {
+      // The cached raw data is still valid. Only the conversion changed.
+      emit signalHandlerChanged(true, RECACHE_NONE);
+      return;
+    }
     setCacheInvalid();
     emit signalHandlerChanged(true, RECACHE_CLEAR);
   }
@@ -1625,28 +1732,121 @@ void videoHandlerYUV::loadFrame(int frameIndex, bool loadToDoubleBuffer)
     // We cannot load a frame if the format is not known
     return;
 
+  // If the frame was only drawn partly (or downscaled) since the last load, we only convert the part of the frame that
+  // was visible in the last draw call (see convertViewportImage()).
+  const bool viewportOnly = drawnViewportSinceLoad && !drawnFullSinceLoad;
+  if (!loadToDoubleBuffer)
+  {
+    drawnViewportSinceLoad = false;
+    drawnFullSinceLoad = false;
+  }
+
+  // If the frame was spilled to disk, take the converted frame from there instead of loading (decoding) it again.
+  QImage spilledImage;
+  if (spillEvictedFrames && !viewportOnly && (loadToDoubleBuffer || currentImageIdx != frameIndex) && videoCacheSpillFile::globalInstance()->load(this, frameIndex, spilledImage))
+  {
+    DEBUG_YUV("videoHandlerYUV::loadFrame %d taken from spill file", frameIndex);
+    setLoadedFrame(frameIndex, spilledImage, loadToDoubleBuffer);
+    return;
+  }
+
   // Does the data in currentFrameRawYUVData need to be updated?
   if (!loadRawYUVData(frameIndex))
     // Loading failed or it is still being performed in the background
     return;
 
   // The data in currentFrameRawYUVData is now up to date. If necessary
-  // convert the data to RGB.
-  if (loadToDoubleBuffer)
+  // convert the data to RGB. This is an interactive request, so we use all cores for the conversion.
+  viewportImage newViewportImage;
+  if (viewportOnly && convertViewportImage(frameIndex, newViewportImage))
+  {
+    QMutexLocker setLock(&currentImageSetMutex);
+    if (loadToDoubleBuffer)
+    {
+      // The part of the frame is activated with the double buffer (see activateDoubleBuffer())
+      doubleBufferViewportImage = newViewportImage;
+      doubleBufferImage = QImage();
+      doubleBufferImageFrameIdx = frameIndex;
+    }
+    else
+    {
+      if (currentImageIdx != frameIndex || viewportOnlyFrameIdx != frameIndex)
+        viewportImageCache.clear();
+      viewportImageCache.prepend(newViewportImage);
+      while (viewportImageCache.size() > VIEWPORT_IMAGE_CACHE_SIZE)
+        viewportImageCache.removeLast();
+      viewportOnlyFrameIdx = frameIndex;
+      currentImageIdx = frameIndex;
+      viewportConversionNeeded = false;
+    }
+  }
+  else if (loadToDoubleBuffer)
   {
     QImage newImage;
-    convertYUVToImage(currentFrameRawYUVData, newImage, srcPixelFormat, frameSize);
+    convertYUVToImage(currentFrameRawYUVData, newImage, srcPixelFormat, frameSize, true);
+    QMutexLocker setLock(&currentImageSetMutex);
     doubleBufferImage = newImage;
     doubleBufferImageFrameIdx = frameIndex;
+    doubleBufferViewportImage.frameIdx = -1;
   }
-  else if (currentImageIdx != frameIndex)
+  else if (currentImageIdx != frameIndex || viewportOnlyFrameIdx == frameIndex)
   {
+    // Also convert the full frame if only parts of the current frame were converted so far
     QImage newImage;
-    convertYUVToImage(currentFrameRawYUVData, newImage, srcPixelFormat, frameSize);
+    convertYUVToImage(currentFrameRawYUVData, newImage, srcPixelFormat, frameSize, true);
     QMutexLocker setLock(&currentImageSetMutex);    
     currentImage = newImage;
     currentImageIdx = frameIndex;
+    viewportOnlyFrameIdx = -1;
+    viewportConversionNeeded = false;
+  }
+}
+
+itemLoadingState videoHandlerYUV::needsLoading(int frameIndex, bool loadRawValues)
+{
+  QMutexLocker setLock(&currentImageSetMutex);
+  if (viewportConversionNeeded && frameIndex == currentImageIdx && frameIndex == viewportOnlyFrameIdx)
+    // A part of the current frame is visible that was not converted yet
+    return LoadingNeeded;
+  setLock.unlock();
+  return videoHandler::needsLoading(frameIndex, loadRawValues);
+}
+
+void videoHandlerYUV::activateDoubleBuffer()
+{
+  QMutexLocker setLock(&currentImageSetMutex);
+  if (doubleBufferImageFrameIdx != -1 && doubleBufferViewportImage.frameIdx == doubleBufferImageFrameIdx)
+  {
+    // Only a part of the frame in the double buffer was converted
+    viewportImageCache.clear();
+    viewportImageCache.append(doubleBufferViewportImage);
+    viewportOnlyFrameIdx = doubleBufferImageFrameIdx;
+    currentImageIdx = doubleBufferImageFrameIdx;
+    viewportConversionNeeded = false;
+    return;
   }
+  setLock.unlock();
+  videoHandler::activateDoubleBuffer();
+}
+
+void videoHandlerYUV::setLoadedFrame(int frameIndex, const QImage &image, bool loadToDoubleBuffer)
+{
+  QMutexLocker setLock(&currentImageSetMutex);
+  if (loadToDoubleBuffer)
+  {
+    doubleBufferImage = image;
+    doubleBufferImageFrameIdx = frameIndex;
+    doubleBufferViewportImage.frameIdx = -1;
+    return;
+  }
+
+  // The full frame is converted
+  drawnViewportSinceLoad = false;
+  drawnFullSinceLoad = false;
+  currentImage = image;
+  currentImageIdx = frameIndex;
+  viewportOnlyFrameIdx = -1;
+  viewportConversionNeeded = false;
 }
 
 void videoHandlerYUV::loadFrameForCaching(int frameIndex, QImage &frameToCache)
@@ -1673,6 +1873,85 @@ void videoHandlerYUV::loadFrameForCaching(int frameIndex, QImage &frameToCache)
   convertYUVToImage(tmpBufferRawYUVDataCaching, frameToCache, yuvFormat, curFrameSize);
 }
 
+bool videoHandlerYUV::loadRawDataForCaching(int frameIndex, QByteArray &rawData)
+{
+  DEBUG_YUV("videoHandlerYUV::loadRawDataForCaching %d", frameIndex);
+
+  QMutexLocker lock(&requestDataMutex);
+  emit signalRequestRawData(frameIndex, true);
+  if (frameIndex != rawYUVData_frameIdx || rawYUVData.size() < getBytesPerFrame())
+  {
+    // Loading failed
+    DEBUG_YUV("videoHandlerYUV::loadRawDataForCaching Loading failed");
+    return false;
+  }
+
+  rawData = rawYUVData;
+  return true;
+}
+
+void videoHandlerYUV::convertRawDataFromCache(int frameIndex, const QByteArray &rawData, QImage &image)
+{
+  DEBUG_YUV("videoHandlerYUV::convertRawDataFromCache %d", frameIndex);
+  Q_UNUSED(frameIndex);
+  convertYUVToImage(rawData, image, srcPixelFormat, frameSize, true);
+}
+
+void videoHandlerYUV::convertRawDataForCaching(int frameIndex, const QByteArray &rawData, QImage &image)
+{
+  DEBUG_YUV("videoHandlerYUV::convertRawDataForCaching %d", frameIndex);
+  Q_UNUSED(frameIndex);
+
+  // Get the YUV format and the size here, so that the caching process does not crash if this changes.
+  // The caching threads already run in parallel so the conversion is not split up any further.
+  yuvPixelFormat yuvFormat = srcPixelFormat;
+  const QSize curFrameSize = frameSize;
+  convertYUVToImage(rawData, image, yuvFormat, curFrameSize);
+}
+
+bool videoHandlerYUV::cacheFrameFromPlanes(int frameIdx, const yuvPlanes &planes, bool testMode)
+{
+  DEBUG_YUV("videoHandlerYUV::cacheFrameFromPlanes %d", frameIdx);
+
+  if (isCachingRawData())
+    return false;
+
+  QImage cacheImage;
+  if (!convertFrameFromPlanes(planes, cacheImage))
+    return false;
+
+  insertImageIntoCache(frameIdx, cacheImage, testMode);
+  return true;
+}
+
+bool videoHandlerYUV::convertFrameFromPlanes(const yuvPlanes &planes, QImage &image)
+{
+  // Get the YUV format and the size here, so that the conversion does not crash if this changes.
+  const yuvPixelFormat yuvFormat = srcPixelFormat;
+  const QSize curFrameSize = frameSize;
+
+  // Only the vectorized conversion can read planes with padding
+  if (!yuvFormat.planar || yuvFormat.uvInterleaved || !canConvertToRGB(yuvFormat, curFrameSize) || !canUseSIMDConversion(yuvFormat))
+    return false;
+
+  createImageForConversion(image, curFrameSize);
+  if (!convertYUVPlanarToRGBSIMD(planes, image.bits(), curFrameSize, yuvFormat, false))
+    return false;
+  convertImageToPlatformFormat(image);
+  return true;
+}
+
+bool videoHandlerYUV::convertFrameFromRawData(const QByteArray &rawData, QImage &image)
+{
+  const yuvPixelFormat yuvFormat = srcPixelFormat;
+  const QSize curFrameSize = frameSize;
+  if (rawData.size() < yuvFormat.bytesPerFrame(curFrameSize))
+    return false;
+
+  convertYUVToImage(rawData, image, yuvFormat, curFrameSize);
+  return !image.isNull();
+}
+
 // Load the raw YUV data for the given frame index into currentFrameRawYUVData.
 bool videoHandlerYUV::loadRawYUVData(int frameIndex)
 {
@@ -1682,6 +1961,23 @@ bool videoHandlerYUV::loadRawYUVData(int frameIndex)
 
   DEBUG_YUV("videoHandlerYUV::loadRawYUVData %d", frameIndex);
 
+  // If the raw data of the frame is cached (or was spilled to disk), we can take it from there.
+  imageCacheAccess.lock();
+  bool inRawDataCache = cacheValid && rawDataCache.contains(frameIndex);
+  QByteArray cachedRawData = inRawDataCache ? rawDataCache.value(frameIndex) : QByteArray();
+  imageCacheAccess.unlock();
+  if (!inRawDataCache && spillEvictedFrames)
+    inRawDataCache = videoCacheSpillFile::globalInstance()->load(this, frameIndex, cachedRawData);
+  if (inRawDataCache)
+  {
+    requestDataMutex.lock();
+    currentFrameRawYUVData = cachedRawData;
+    currentFrameRawYUVData_frameIdx = frameIndex;
+    requestDataMutex.unlock();
+    DEBUG_YUV("videoHandlerYUV::loadRawYUVData %d taken from raw data cache", frameIndex);
+    return true;
+  }
+
   // The function loadFrameForCaching also uses the signalRequesRawYUVData to request raw data.
   // However, only one thread can use this at a time.
   requestDataMutex.lock();
@@ -1718,11 +2014,9 @@ inline int clip8Bit(int val)
  */
 inline int transformYUV(const bool invert, const int scale, const int offset, const unsigned int value, const int clipMax)
 {
-  int newValue = value;
-  if (invert)
-    newValue = -(newValue - offset) * scale + offset;  // Scale + Offset + Invert
-  else
-    newValue = (newValue - offset) * scale + offset;  // Scale + Offset
+  // Inverting is the same as scaling with the negative scale factor. No need to branch for that.
+  const int signedScale = invert ? -scale : scale;
+  int newValue = ((int)value - offset) * signedScale + offset;  // Scale + Offset (+ Invert)
 
   // Clip to 8 bit
   if (newValue < 0)
@@ -1733,14 +2027,32 @@ inline int transformYUV(const bool invert, const int scale, const int offset, co
   return newValue;
 }
 
-inline void convertYUVToRGB8Bit(const unsigned int valY, const unsigned int valU, const unsigned int valV, int &valR, int &valG, int &valB, const int RGBConv[5], const bool fullRange, const int bps)
+/* The properties of the input samples that do not change within a frame. The conversion functions below are templates
+ * that are instantiated for every valid combination of these, so that none of them has to be checked for every sample.
+ * The instance to use is selected once per frame in convertYUVPlanarToRGB().
+ * twoBytes:     More than 8 bit per sample. Every sample is stored in two bytes.
+ * bigEndian:    The two bytes per sample are in big endian order.
+ * highBitDepth: More than 14 bit per sample. See convertYUVToRGB8Bit.
+ * fullRange:    Convert using the full range (0...max) instead of the limited range.
+ */
+template<bool twoBytesPerSample, bool bigEndianSamples, bool moreThan14Bit, bool fullRangeConversion>
+struct sampleFormat
+{
+  static const bool twoBytes = twoBytesPerSample;
+  static const bool bigEndian = bigEndianSamples;
+  static const bool highBitDepth = moreThan14Bit;
+  static const bool fullRange = fullRangeConversion;
+};
+
+template<class F>
+inline void convertYUVToRGB8Bit(const unsigned int valY, const unsigned int valU, const unsigned int valV, int &valR, int &valG, int &valB, const int RGBConv[5], const int bps)
 {
-  if (bps > 14)
+  if (F::highBitDepth)
   {
     // The bit depth of an int (32) is not enough to perform a YUV -> RGB conversion for a bit depth > 14 bits.
     // We could use 64 bit values but for what? We are clipping the result to 8 bit anyways so let's just
     // get rid of 2 of the bits for the YUV values.
-    const int yOffset = (fullRange ? 0 : 16<<(bps-10));
+    const int yOffset = (F::fullRange ? 0 : 16<<(bps-10));
     const int cZero = 128<<(bps-10);
 
     const int Y_tmp = ((valY >> 2) - yOffset) * RGBConv[0];
@@ -1757,7 +2069,7 @@ inline void convertYUVToRGB8Bit(const unsigned int valY, const unsigned int valU
   }
   else
   {
-    const int yOffset = (fullRange ? 0 : 16<<(bps-8));
+    const int yOffset = (F::fullRange ? 0 : 16<<(bps-8));
     const int cZero = 128<<(bps-8);
 
     const int Y_tmp = (valY - yOffset) * RGBConv[0];
@@ -1774,22 +2086,32 @@ inline void convertYUVToRGB8Bit(const unsigned int valY, const unsigned int valU
   }
 }
 
-inline int getValueFromSource(const unsigned char * restrict src, const int idx, const int bps, const bool bigEndian)
+template<class F>
+inline int getValueFromSource(const unsigned char * restrict src, const int idx)
 {
-  if (bps > 8)
+  if (F::twoBytes)
     // Read two bytes in the right order
-    return (bigEndian) ? src[idx*2] << 8 | src[idx*2+1] : src[idx*2] | src[idx*2+1] << 8;
+    return (F::bigEndian) ? src[idx*2] << 8 | src[idx*2+1] : src[idx*2] | src[idx*2+1] << 8;
   else
     // Just read one byte
     return src[idx];
 }
 
-inline void setValueInBuffer(unsigned char * restrict dst, const int val, const int idx, const int bps, const bool bigEndian)
+inline int getValueFromSource(const unsigned char * restrict src, const int idx, const int bps, const bool bigEndian)
 {
   if (bps > 8)
+    return (bigEndian) ? getValueFromSource<sampleFormat<true, true, false, false> >(src, idx) : getValueFromSource<sampleFormat<true, false, false, false> >(src, idx);
+  else
+    return getValueFromSource<sampleFormat<false, false, false, false> >(src, idx);
+}
+
+template<class F>
+inline void setValueInBuffer(unsigned char * restrict dst, const int val, const int idx)
+{
+  if (F::twoBytes)
   {
     // Write two bytes
-    if (bigEndian)
+    if (F::bigEndian)
     {
       dst[idx*2] = val >> 8;
       dst[idx*2+1] = val & 0xff;
@@ -1805,23 +2127,37 @@ inline void setValueInBuffer(unsigned char * restrict dst, const int val, const
     dst[idx] = val;
 }
 
+inline void setValueInBuffer(unsigned char * restrict dst, const int val, const int idx, const int bps, const bool bigEndian)
+{
+  if (bps > 8)
+  {
+    if (bigEndian)
+      setValueInBuffer<sampleFormat<true, true, false, false> >(dst, val, idx);
+    else
+      setValueInBuffer<sampleFormat<true, false, false, false> >(dst, val, idx);
+  }
+  else
+    setValueInBuffer<sampleFormat<false, false, false, false> >(dst, val, idx);
+}
+
 // For every input sample in src, apply YUV transformation, (scale to 8 bit if required) and set the value as RGB (monochrome).
 // inValSkip: skip this many values in the input for every value. For pure planar formats, this 1. If the UV components are interleaved, this is 2 or 3.
+template<class F>
 inline void YUVPlaneToRGBMonochrome_444(const int componentSize, const yuvMathParameters math, const unsigned char * restrict src, unsigned char * restrict dst,
-                                        const int inMax, const int bps, const bool bigEndian, const int inValSkip, const bool fullRange)
+                                        const int inMax, const int bps, const int inValSkip)
 {
   const bool applyMath = math.yuvMathRequired();
   const int shiftTo8Bit = bps - 8;
   for (int i = 0; i < componentSize; ++i)
   {
-    int newVal = getValueFromSource(src, i*inValSkip, bps, bigEndian);
+    int newVal = getValueFromSource<F>(src, i*inValSkip);
     if (applyMath)
       newVal = transformYUV(math.invert, math.scale, math.offset, newVal, inMax);
 
     // Scale to 8 bit (if required)
     if (shiftTo8Bit > 0)
       newVal = clip8Bit(newVal >> shiftTo8Bit);
-    if (!fullRange)
+    if (!F::fullRange)
     {
       assert(newVal >= 0 && newVal <= 255);
       newVal = yuvRgbConvScaleLuma[newVal];
@@ -1837,21 +2173,22 @@ inline void YUVPlaneToRGBMonochrome_444(const int componentSize, const yuvMathPa
 
 // For every input sample in the YZV 422 src, apply interpolation (sample and hold), apply YUV transformation, (scale to 8 bit if required)
 // and set the value as RGB (monochrome).
+template<class F>
 inline void YUVPlaneToRGBMonochrome_422(const int componentSize, const yuvMathParameters math, const unsigned char * restrict src, unsigned char * restrict dst,
-                                        const int inMax, const int bps, const bool bigEndian, const int inValSkip, const bool fullRange)
+                                        const int inMax, const int bps, const int inValSkip)
 {
   const bool applyMath = math.yuvMathRequired();
   const int shiftTo8Bit = bps - 8;
   for (int i = 0; i < componentSize; ++i)
   {
-    int newVal = getValueFromSource(src, i*inValSkip, bps, bigEndian);
+    int newVal = getValueFromSource<F>(src, i*inValSkip);
     if (applyMath)
       newVal = transformYUV(math.invert, math.scale, math.offset, newVal, inMax);
 
     // Scale and clip to 8 bit
     if (shiftTo8Bit > 0)
       newVal = clip8Bit(newVal >> shiftTo8Bit);
-    if (!fullRange)
+    if (!F::fullRange)
     {
       assert(newVal >= 0 && newVal <= 255);
       newVal = yuvRgbConvScaleLuma[newVal];
@@ -1868,8 +2205,9 @@ inline void YUVPlaneToRGBMonochrome_422(const int componentSize, const yuvMathPa
   }
 }
 
+template<class F>
 inline void YUVPlaneToRGBMonochrome_420(const int w, const int h, const yuvMathParameters math, const unsigned char * restrict src, unsigned char * restrict dst,
-                                        const int inMax, const int bps, const bool bigEndian, const int inValSkip, const bool fullRange)
+                                        const int inMax, const int bps, const int inValSkip)
 {
   const bool applyMath = math.yuvMathRequired();
   const int shiftTo8Bit = bps - 8;
@@ -1877,14 +2215,14 @@ inline void YUVPlaneToRGBMonochrome_420(const int w, const int h, const yuvMathP
     for (int x = 0; x < w/2; x++)
     {
       const int srcIdx = y*(w/2)+x;
-      int newVal = getValueFromSource(src, srcIdx*inValSkip, bps, bigEndian);
+      int newVal = getValueFromSource<F>(src, srcIdx*inValSkip);
       if (applyMath)
         newVal = transformYUV(math.invert, math.scale, math.offset, newVal, inMax);
 
       // Scale and clip to 8 bit
       if (shiftTo8Bit > 0)
         newVal = clip8Bit(newVal >> shiftTo8Bit);
-      if (!fullRange)
+      if (!F::fullRange)
       {
         assert(newVal >= 0 && newVal <= 255);
         newVal = yuvRgbConvScaleLuma[newVal];
@@ -1911,8 +2249,9 @@ inline void YUVPlaneToRGBMonochrome_420(const int w, const int h, const yuvMathP
     }
 }
 
+template<class F>
 inline void YUVPlaneToRGBMonochrome_440(const int w, const int h, const yuvMathParameters math, const unsigned char * restrict src, unsigned char * restrict dst,
-                                        const int inMax, const int bps, const bool bigEndian, const int inValSkip, const bool fullRange)
+                                        const int inMax, const int bps, const int inValSkip)
 {
   const bool applyMath = math.yuvMathRequired();
   const int shiftTo8Bit = bps - 8;
@@ -1920,14 +2259,14 @@ inline void YUVPlaneToRGBMonochrome_440(const int w, const int h, const yuvMathP
     for (int x = 0; x < w; x++)
     {
       const int srcIdx = y*w+x;
-      int newVal = getValueFromSource(src, srcIdx*inValSkip, bps, bigEndian);
+      int newVal = getValueFromSource<F>(src, srcIdx*inValSkip);
       if (applyMath)
         newVal = transformYUV(math.invert, math.scale, math.offset, newVal, inMax);
 
       // Scale and clip to 8 bit
       if (shiftTo8Bit > 0)
         newVal = clip8Bit(newVal >> shiftTo8Bit);
-      if (!fullRange)
+      if (!F::fullRange)
       {
         assert(newVal >= 0 && newVal <= 255);
         newVal = yuvRgbConvScaleLuma[newVal];
@@ -1946,8 +2285,9 @@ inline void YUVPlaneToRGBMonochrome_440(const int w, const int h, const yuvMathP
     }
 }
 
+template<class F>
 inline void YUVPlaneToRGBMonochrome_410(const int w, const int h, const yuvMathParameters math, const unsigned char * restrict src, unsigned char * restrict dst,
-  const int inMax, const int bps, const bool bigEndian, const int inValSkip, const bool fullRange)
+  const int inMax, const int bps, const int inValSkip)
 {
   // Horizontal subsampling by 4, vertical subsampling by 4
   const bool applyMath = math.yuvMathRequired();
@@ -1956,7 +2296,7 @@ inline void YUVPlaneToRGBMonochrome_410(const int w, const int h, const yuvMathP
     for (int x = 0; x < w/4; x++)
     {
       const int srcIdx = y*(w/4)+x;
-      int newVal = getValueFromSource(src, srcIdx*inValSkip, bps, bigEndian);
+      int newVal = getValueFromSource<F>(src, srcIdx*inValSkip);
 
       if (applyMath)
         newVal = transformYUV(math.invert, math.scale, math.offset, newVal, inMax);
@@ -1964,7 +2304,7 @@ inline void YUVPlaneToRGBMonochrome_410(const int w, const int h, const yuvMathP
       // Scale and clip to 8 bit
       if (shiftTo8Bit > 0)
         newVal = clip8Bit(newVal >> shiftTo8Bit);
-      if (!fullRange)
+      if (!F::fullRange)
       {
         assert(newVal >= 0 && newVal <= 255);
         newVal = yuvRgbConvScaleLuma[newVal];
@@ -1982,22 +2322,23 @@ inline void YUVPlaneToRGBMonochrome_410(const int w, const int h, const yuvMathP
     }
 }
 
+template<class F>
 inline void YUVPlaneToRGBMonochrome_411(const int componentSize, const yuvMathParameters math, const unsigned char * restrict src, unsigned char * restrict dst,
-                                        const int inMax, const int bps, const bool bigEndian, const int inValSkip, const bool fullRange)
+                                        const int inMax, const int bps, const int inValSkip)
 {
   // Horizontally U and V are subsampled by 4
   const bool applyMath = math.yuvMathRequired();
   const int shiftTo8Bit = bps - 8;
   for (int i = 0; i < componentSize; ++i)
   {
-    int newVal = getValueFromSource(src, i*inValSkip, bps, bigEndian);
+    int newVal = getValueFromSource<F>(src, i*inValSkip);
     if (applyMath)
       newVal = transformYUV(math.invert, math.scale, math.offset, newVal, inMax);
 
     // Scale and clip to 8 bit
     if (shiftTo8Bit > 0)
       newVal = clip8Bit(newVal >> shiftTo8Bit);
-    if (!fullRange)
+    if (!F::fullRange)
     {
       assert(newVal >= 0 && newVal <= 255);
       newVal = yuvRgbConvScaleLuma[newVal];
@@ -2078,6 +2419,7 @@ inline int interpolateUV8Pos(int prev, int cur, const int offsetX8)
 }
 
 // Re-sample the chroma component so that the chroma samples and the luma samples are aligned after this operation.
+template<class F>
 inline void UVPlaneResamplingChromaOffset(const yuvPixelFormat format, const int w, const int h, 
                                           const unsigned char * restrict srcU, const unsigned char * restrict srcV, const int inValSkip,
                                           unsigned char * restrict dstU, unsigned char * restrict dstV)
@@ -2090,7 +2432,6 @@ inline void UVPlaneResamplingChromaOffset(const yuvPixelFormat format, const int
   const int offsetY8 = (possibleValsY == 1) ? format.chromaOffset[1] * 4 : (possibleValsY == 3) ? format.chromaOffset[1] * 2 : format.chromaOffset[1];
 
   // The format to use for input/output
-  const bool bigEndian = format.bigEndian;
   const int bps = format.bitsPerSample;
 
   const int stride = bps > 8 ? w*2 : w;
@@ -2101,23 +2442,23 @@ inline void UVPlaneResamplingChromaOffset(const yuvPixelFormat format, const int
     {
       // On the left side, there is no previous sample, so the first value is never changed.
       const int srcIdx = y * stride * inValSkip;
-      int prevU = getValueFromSource(srcU, srcIdx, bps, bigEndian);
-      int prevV = getValueFromSource(srcV, srcIdx, bps, bigEndian);
-      setValueInBuffer(dstU, prevU, y*stride, bps, bigEndian);
-      setValueInBuffer(dstV, prevV, y*stride, bps, bigEndian);
+      int prevU = getValueFromSource<F>(srcU, srcIdx);
+      int prevV = getValueFromSource<F>(srcV, srcIdx);
+      setValueInBuffer<F>(dstU, prevU, y*stride);
+      setValueInBuffer<F>(dstV, prevV, y*stride);
 
       for (int x = 0; x < w-1; x++)
       {
         // Calculate the new current value using the previous and the current value
         const int srcIdxInLine = srcIdx + (x+1)*inValSkip;
-        int curU = getValueFromSource(srcU, srcIdxInLine, bps, bigEndian);
-        int curV = getValueFromSource(srcV, srcIdxInLine, bps, bigEndian);
+        int curU = getValueFromSource<F>(srcU, srcIdxInLine);
+        int curV = getValueFromSource<F>(srcV, srcIdxInLine);
 
         // Perform interpolation and save the value for the current UV value. Goto next value.
         int newU = interpolateUV8Pos(prevU, curU, offsetX8);
         int newV = interpolateUV8Pos(prevV, curV, offsetX8);
-        setValueInBuffer(dstU, newU, y*stride+x, bps, bigEndian);
-        setValueInBuffer(dstV, newV, y*stride+x, bps, bigEndian);
+        setValueInBuffer<F>(dstU, newU, y*stride+x);
+        setValueInBuffer<F>(dstV, newV, y*stride+x);
 
         prevU = curU;
         prevV = curV;
@@ -2136,23 +2477,23 @@ inline void UVPlaneResamplingChromaOffset(const yuvPixelFormat format, const int
     for (int x = 0; x < w; x++)
     {
       // On the top, there is no previous sample, so the first value is never changed.
-      int prevU = getValueFromSource(srcUStep2, x*valSkipStep2, bps, bigEndian);
-      int prevV = getValueFromSource(srcVStep2, x*valSkipStep2, bps, bigEndian);
-      setValueInBuffer(dstU, prevU, x, bps, bigEndian);
-      setValueInBuffer(dstV, prevV, x, bps, bigEndian);
+      int prevU = getValueFromSource<F>(srcUStep2, x*valSkipStep2);
+      int prevV = getValueFromSource<F>(srcVStep2, x*valSkipStep2);
+      setValueInBuffer<F>(dstU, prevU, x);
+      setValueInBuffer<F>(dstV, prevV, x);
 
       for (int y = 0; y < h-1; y++)
       {
         // Calculate the new current value using the previous and the current value
         const int srcIdx = (y+1) * w + x;
-        int curU = getValueFromSource(srcUStep2, srcIdx*valSkipStep2, bps, bigEndian);
-        int curV = getValueFromSource(srcVStep2, srcIdx*valSkipStep2, bps, bigEndian);
+        int curU = getValueFromSource<F>(srcUStep2, srcIdx*valSkipStep2);
+        int curV = getValueFromSource<F>(srcVStep2, srcIdx*valSkipStep2);
 
         // Perform interpolation and save the value for the current UV value. Goto next value.
         int newU = interpolateUV8Pos(prevU, curU, offsetY8);
         int newV = interpolateUV8Pos(prevV, curV, offsetY8);
-        setValueInBuffer(dstU, newU, srcIdx, bps, bigEndian);
-        setValueInBuffer(dstV, newV, srcIdx, bps, bigEndian);
+        setValueInBuffer<F>(dstU, newU, srcIdx);
+        setValueInBuffer<F>(dstV, newV, srcIdx);
 
         prevU = curU;
         prevV = curV;
@@ -2161,18 +2502,19 @@ inline void UVPlaneResamplingChromaOffset(const yuvPixelFormat format, const int
   }
 }
 
+template<class F>
 inline void YUVPlaneToRGB_444(const int componentSize, const yuvMathParameters mathY, const yuvMathParameters mathC,
                               const unsigned char * restrict srcY, const unsigned char * restrict srcU, const unsigned char * restrict srcV,
-                              unsigned char * restrict dst, const int RGBConv[5], const bool fullRange, const int inMax, const int bps, const bool bigEndian, const int inValSkip)
+                              unsigned char * restrict dst, const int RGBConv[5], const int inMax, const int bps, const int inValSkip)
 {
   const bool applyMathLuma = mathY.yuvMathRequired();
   const bool applyMathChroma = mathC.yuvMathRequired();
 
   for (int i = 0; i < componentSize; ++i)
   {
-    unsigned int valY = getValueFromSource(srcY, i, bps, bigEndian);
-    unsigned int valU = getValueFromSource(srcU, i*inValSkip, bps, bigEndian);
-    unsigned int valV = getValueFromSource(srcV, i*inValSkip, bps, bigEndian);
+    unsigned int valY = getValueFromSource<F>(srcY, i);
+    unsigned int valU = getValueFromSource<F>(srcU, i*inValSkip);
+    unsigned int valV = getValueFromSource<F>(srcV, i*inValSkip);
 
     if (applyMathLuma)
       valY = transformYUV(mathY.invert, mathY.scale, mathY.offset, valY, inMax);
@@ -2184,7 +2526,7 @@ inline void YUVPlaneToRGB_444(const int componentSize, const yuvMathParameters m
 
     // Get the RGB values for this sample
     int valR, valG, valB;
-    convertYUVToRGB8Bit(valY, valU, valV, valR, valG, valB, RGBConv, fullRange, bps);
+    convertYUVToRGB8Bit<F>(valY, valU, valV, valR, valG, valB, RGBConv, bps);
 
     // Save the RGB values
     dst[i*4  ] = valB;
@@ -2194,9 +2536,10 @@ inline void YUVPlaneToRGB_444(const int componentSize, const yuvMathParameters m
   }
 }
 
+template<class F>
 inline void YUVPlaneToRGB_422(const int w, const int h, const yuvMathParameters mathY, const yuvMathParameters mathC,
                               const unsigned char * restrict srcY, const unsigned char * restrict srcU, const unsigned char * restrict srcV,
-                              unsigned char * restrict dst, const int RGBConv[5], const bool fullRange, const int inMax, const InterpolationMode interpolation, const int bps, const bool bigEndian, const int inValSkip)
+                              unsigned char * restrict dst, const int RGBConv[5], const int inMax, const InterpolationMode interpolation, const int bps, const int inValSkip)
 {
   const bool applyMathLuma = mathY.yuvMathRequired();
   const bool applyMathChroma = mathC.yuvMathRequired();
@@ -2204,8 +2547,8 @@ inline void YUVPlaneToRGB_422(const int w, const int h, const yuvMathParameters
   for (int y = 0; y < h; y++)
   {
     const int srcIdxUV = y*w/2;
-    int curUSample = getValueFromSource(srcU, srcIdxUV*inValSkip, bps, bigEndian);
-    int curVSample = getValueFromSource(srcV, srcIdxUV*inValSkip, bps, bigEndian);
+    int curUSample = getValueFromSource<F>(srcU, srcIdxUV*inValSkip);
+    int curVSample = getValueFromSource<F>(srcV, srcIdxUV*inValSkip);
     if (applyMathChroma)
     {
       curUSample = transformYUV(mathC.invert, mathC.scale, mathC.offset, curUSample, inMax);
@@ -2216,8 +2559,8 @@ inline void YUVPlaneToRGB_422(const int w, const int h, const yuvMathParameters
     {
       // Get the next U/V sample
       const int srcPosLineUV = srcIdxUV + x + 1;
-      int nextUSample = getValueFromSource(srcU, srcPosLineUV*inValSkip, bps, bigEndian);
-      int nextVSample = getValueFromSource(srcV, srcPosLineUV*inValSkip, bps, bigEndian);
+      int nextUSample = getValueFromSource<F>(srcU, srcPosLineUV*inValSkip);
+      int nextVSample = getValueFromSource<F>(srcV, srcPosLineUV*inValSkip);
       if (applyMathChroma)
       {
         nextUSample = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextUSample, inMax);
@@ -2229,8 +2572,8 @@ inline void YUVPlaneToRGB_422(const int w, const int h, const yuvMathParameters
       int interpolatedV = interpolateUVSample(interpolation, curVSample, nextVSample);
 
       // Get the 2 Y samples
-      int valY1 = getValueFromSource(srcY, y*w+x*2,   bps, bigEndian);
-      int valY2 = getValueFromSource(srcY, y*w+x*2+1, bps, bigEndian);
+      int valY1 = getValueFromSource<F>(srcY, y*w+x*2);
+      int valY2 = getValueFromSource<F>(srcY, y*w+x*2+1);
       if (applyMathLuma)
       {
         valY1 = transformYUV(mathY.invert, mathY.scale, mathY.offset, valY1, inMax);
@@ -2239,8 +2582,8 @@ inline void YUVPlaneToRGB_422(const int w, const int h, const yuvMathParameters
 
       // Convert to 2 RGB values and save them (BGRA)
       int valR1, valR2, valG1, valG2, valB1, valB2;
-      convertYUVToRGB8Bit(valY1, curUSample   , curVSample   , valR1, valG1, valB1, RGBConv, fullRange, bps);
-      convertYUVToRGB8Bit(valY2, interpolatedU, interpolatedV, valR2, valG2, valB2, RGBConv, fullRange, bps);
+      convertYUVToRGB8Bit<F>(valY1, curUSample   , curVSample   , valR1, valG1, valB1, RGBConv, bps);
+      convertYUVToRGB8Bit<F>(valY2, interpolatedU, interpolatedV, valR2, valG2, valB2, RGBConv, bps);
       const int pos = (y*w+x*2)*4;
       dst[pos  ] = valB1;
       dst[pos+1] = valG1;
@@ -2259,8 +2602,8 @@ inline void YUVPlaneToRGB_422(const int w, const int h, const yuvMathParameters
     // For the last row, there is no next sample. Just reuse the current one again. No interpolation required either.
 
     // Get the 2 Y samples
-    int valY1 = getValueFromSource(srcY, (y+1)*w-2, bps, bigEndian);
-    int valY2 = getValueFromSource(srcY, (y+1)*w-1, bps, bigEndian);
+    int valY1 = getValueFromSource<F>(srcY, (y+1)*w-2);
+    int valY2 = getValueFromSource<F>(srcY, (y+1)*w-1);
     if (applyMathLuma)
     {
       valY1 = transformYUV(mathY.invert, mathY.scale, mathY.offset, valY1, inMax);
@@ -2269,8 +2612,8 @@ inline void YUVPlaneToRGB_422(const int w, const int h, const yuvMathParameters
 
     // Convert to 2 RGB values and save them
     int valR1, valR2, valG1, valG2, valB1, valB2;
-    convertYUVToRGB8Bit(valY1, curUSample, curVSample, valR1, valG1, valB1, RGBConv, fullRange, bps);
-    convertYUVToRGB8Bit(valY2, curUSample, curVSample, valR2, valG2, valB2, RGBConv, fullRange, bps);
+    convertYUVToRGB8Bit<F>(valY1, curUSample, curVSample, valR1, valG1, valB1, RGBConv, bps);
+    convertYUVToRGB8Bit<F>(valY2, curUSample, curVSample, valR2, valG2, valB2, RGBConv, bps);
     const int pos = ((y+1)*w)*4;
     dst[pos-8] = valB1;
     dst[pos-7] = valG1;
@@ -2283,9 +2626,10 @@ inline void YUVPlaneToRGB_422(const int w, const int h, const yuvMathParameters
   }
 }
 
+template<class F>
 inline void YUVPlaneToRGB_440(const int w, const int h, const yuvMathParameters mathY, const yuvMathParameters mathC,
                               const unsigned char * restrict srcY, const unsigned char * restrict srcU, const unsigned char * restrict srcV,
-                              unsigned char * restrict dst, const int RGBConv[5], const bool fullRange,const int inMax, const InterpolationMode interpolation, const int bps, const bool bigEndian, const int inValSkip)
+                              unsigned char * restrict dst, const int RGBConv[5], const int inMax, const InterpolationMode interpolation, const int bps, const int inValSkip)
 {
   const bool applyMathLuma = mathY.yuvMathRequired();
   const bool applyMathChroma = mathC.yuvMathRequired();
@@ -2293,8 +2637,8 @@ inline void YUVPlaneToRGB_440(const int w, const int h, const yuvMathParameters
 
   for (int x = 0; x < w; x++)
   {
-    int curUSample = getValueFromSource(srcU, x*inValSkip, bps, bigEndian);
-    int curVSample = getValueFromSource(srcV, x*inValSkip, bps, bigEndian);
+    int curUSample = getValueFromSource<F>(srcU, x*inValSkip);
+    int curVSample = getValueFromSource<F>(srcV, x*inValSkip);
     if (applyMathChroma)
     {
       curUSample = transformYUV(mathC.invert, mathC.scale, mathC.offset, curUSample, inMax);
@@ -2305,8 +2649,8 @@ inline void YUVPlaneToRGB_440(const int w, const int h, const yuvMathParameters
     {
       // Get the next U/V sample
       const int srcIdxUV = y*w+x;
-      int nextUSample = getValueFromSource(srcU, srcIdxUV*inValSkip, bps, bigEndian);
-      int nextVSample = getValueFromSource(srcV, srcIdxUV*inValSkip, bps, bigEndian);
+      int nextUSample = getValueFromSource<F>(srcU, srcIdxUV*inValSkip);
+      int nextVSample = getValueFromSource<F>(srcV, srcIdxUV*inValSkip);
       if (applyMathChroma)
       {
         nextUSample = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextUSample, inMax);
@@ -2318,8 +2662,8 @@ inline void YUVPlaneToRGB_440(const int w, const int h, const yuvMathParameters
       int interpolatedV = interpolateUVSample(interpolation, curVSample, nextVSample);
 
       // Get the 2 Y samples
-      int valY1 = getValueFromSource(srcY,     y*2*w+x, bps, bigEndian);
-      int valY2 = getValueFromSource(srcY, (y*2+1)*w+x, bps, bigEndian);
+      int valY1 = getValueFromSource<F>(srcY,     y*2*w+x);
+      int valY2 = getValueFromSource<F>(srcY, (y*2+1)*w+x);
       if (applyMathLuma)
       {
         valY1 = transformYUV(mathY.invert, mathY.scale, mathY.offset, valY1, inMax);
@@ -2328,8 +2672,8 @@ inline void YUVPlaneToRGB_440(const int w, const int h, const yuvMathParameters
 
       // Convert to 2 RGB values and save them
       int valR1, valR2, valG1, valG2, valB1, valB2;
-      convertYUVToRGB8Bit(valY1, curUSample   , curVSample   , valR1, valG1, valB1, RGBConv, fullRange, bps);
-      convertYUVToRGB8Bit(valY2, interpolatedU, interpolatedV, valR2, valG2, valB2, RGBConv, fullRange, bps);
+      convertYUVToRGB8Bit<F>(valY1, curUSample   , curVSample   , valR1, valG1, valB1, RGBConv, bps);
+      convertYUVToRGB8Bit<F>(valY2, interpolatedU, interpolatedV, valR2, valG2, valB2, RGBConv, bps);
       const int pos1 = (y*2*w+x)*4;
       const int pos2 = pos1 + 4*w;
       dst[pos1  ] = valB1;
@@ -2349,8 +2693,8 @@ inline void YUVPlaneToRGB_440(const int w, const int h, const yuvMathParameters
     // For the last column, there is no next sample. Just reuse the current one again. No interpolation required either.
 
     // Get the 2 Y samples
-    int valY1 = getValueFromSource(srcY, (h-2)*w+x, bps, bigEndian);
-    int valY2 = getValueFromSource(srcY, (h-1)*w+x, bps, bigEndian);
+    int valY1 = getValueFromSource<F>(srcY, (h-2)*w+x);
+    int valY2 = getValueFromSource<F>(srcY, (h-1)*w+x);
     if (applyMathLuma)
     {
       valY1 = transformYUV(mathY.invert, mathY.scale, mathY.offset, valY1, inMax);
@@ -2359,8 +2703,8 @@ inline void YUVPlaneToRGB_440(const int w, const int h, const yuvMathParameters
 
     // Convert to 2 RGB values and save them
     int valR1, valR2, valG1, valG2, valB1, valB2;
-    convertYUVToRGB8Bit(valY1, curUSample, curVSample, valR1, valG1, valB1, RGBConv, fullRange, bps);
-    convertYUVToRGB8Bit(valY2, curUSample, curVSample, valR2, valG2, valB2, RGBConv, fullRange, bps);
+    convertYUVToRGB8Bit<F>(valY1, curUSample, curVSample, valR1, valG1, valB1, RGBConv, bps);
+    convertYUVToRGB8Bit<F>(valY2, curUSample, curVSample, valR2, valG2, valB2, RGBConv, bps);
     const int pos1 = ((h-2)*w+x)*4;
     const int pos2 = pos1 + w*4;
     dst[pos1  ] = valB1;
@@ -2374,9 +2718,10 @@ inline void YUVPlaneToRGB_440(const int w, const int h, const yuvMathParameters
   }
 }
 
+template<class F>
 inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters mathY, const yuvMathParameters mathC,
                               const unsigned char * restrict srcY, const unsigned char * restrict srcU, const unsigned char * restrict srcV,
-                              unsigned char * restrict dst, const int RGBConv[5], const bool fullRange,const int inMax, const InterpolationMode interpolation, const int bps, const bool bigEndian, const int inValSkip)
+                              unsigned char * restrict dst, const int RGBConv[5], const int inMax, const InterpolationMode interpolation, const int bps, const int inValSkip)
 {
   const bool applyMathLuma = mathY.yuvMathRequired();
   const bool applyMathChroma = mathC.yuvMathRequired();
@@ -2388,10 +2733,10 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
     // Get the current U/V samples for this y line and the next one (_NL)
     const int srcIdxUV0 = y*wh;
     const int srcIdxUV1 = (y+1)*wh;
-    int curU    = getValueFromSource(srcU, srcIdxUV0*inValSkip, bps, bigEndian);
-    int curV    = getValueFromSource(srcV, srcIdxUV0*inValSkip, bps, bigEndian);
-    int curU_NL = getValueFromSource(srcU, srcIdxUV1*inValSkip, bps, bigEndian);
-    int curV_NL = getValueFromSource(srcV, srcIdxUV1*inValSkip, bps, bigEndian);
+    int curU    = getValueFromSource<F>(srcU, srcIdxUV0*inValSkip);
+    int curV    = getValueFromSource<F>(srcV, srcIdxUV0*inValSkip);
+    int curU_NL = getValueFromSource<F>(srcU, srcIdxUV1*inValSkip);
+    int curV_NL = getValueFromSource<F>(srcV, srcIdxUV1*inValSkip);
     if (applyMathChroma)
     {
       curU    = transformYUV(mathC.invert, mathC.scale, mathC.offset, curU, inMax);
@@ -2405,10 +2750,10 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
       // Get the next U/V sample for this line and the next one
       const int srcIdxUVLine0 = srcIdxUV0 + x + 1;
       const int srcIdxUVLine1 = srcIdxUV1 + x + 1;
-      int nextU    = getValueFromSource(srcU, srcIdxUVLine0*inValSkip, bps, bigEndian);
-      int nextV    = getValueFromSource(srcV, srcIdxUVLine0*inValSkip, bps, bigEndian);
-      int nextU_NL = getValueFromSource(srcU, srcIdxUVLine1*inValSkip, bps, bigEndian);
-      int nextV_NL = getValueFromSource(srcV, srcIdxUVLine1*inValSkip, bps, bigEndian);
+      int nextU    = getValueFromSource<F>(srcU, srcIdxUVLine0*inValSkip);
+      int nextV    = getValueFromSource<F>(srcV, srcIdxUVLine0*inValSkip);
+      int nextU_NL = getValueFromSource<F>(srcU, srcIdxUVLine1*inValSkip);
+      int nextV_NL = getValueFromSource<F>(srcV, srcIdxUVLine1*inValSkip);
       if (applyMathChroma)
       {
         nextU    = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextU, inMax);
@@ -2426,10 +2771,10 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
       int interpolatedV_Bi  = interpolateUVSample2D(interpolation, curV, nextV, curV_NL, nextV_NL);   // 2D interpolation
 
       // Get the 4 Y samples
-      int valY1 = getValueFromSource(srcY, (y*w+x)*2,   bps, bigEndian);
-      int valY2 = getValueFromSource(srcY, (y*w+x)*2+1, bps, bigEndian);
-      int valY3 = getValueFromSource(srcY, (y*2+1)*w+x*2,   bps, bigEndian);
-      int valY4 = getValueFromSource(srcY, (y*2+1)*w+x*2+1, bps, bigEndian);
+      int valY1 = getValueFromSource<F>(srcY, (y*w+x)*2);
+      int valY2 = getValueFromSource<F>(srcY, (y*w+x)*2+1);
+      int valY3 = getValueFromSource<F>(srcY, (y*2+1)*w+x*2);
+      int valY4 = getValueFromSource<F>(srcY, (y*2+1)*w+x*2+1);
       if (applyMathLuma)
       {
         valY1 = transformYUV(mathY.invert, mathY.scale, mathY.offset, valY1, inMax);
@@ -2440,8 +2785,8 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
 
       // Convert to 4 RGB values and save them
       int valR1, valR2, valG1, valG2, valB1, valB2;
-      convertYUVToRGB8Bit(valY1, curU             , curV             , valR1, valG1, valB1, RGBConv, fullRange, bps);
-      convertYUVToRGB8Bit(valY2, interpolatedU_Hor, interpolatedV_Hor, valR2, valG2, valB2, RGBConv, fullRange, bps);
+      convertYUVToRGB8Bit<F>(valY1, curU             , curV             , valR1, valG1, valB1, RGBConv, bps);
+      convertYUVToRGB8Bit<F>(valY2, interpolatedU_Hor, interpolatedV_Hor, valR2, valG2, valB2, RGBConv, bps);
       const int pos1 = (y*2*w+x*2)*4;
       dst[pos1  ] = valB1;
       dst[pos1+1] = valG1;
@@ -2451,8 +2796,8 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
       dst[pos1+5] = valG2;
       dst[pos1+6] = valR2;
       dst[pos1+7] = 255;
-      convertYUVToRGB8Bit(valY3, interpolatedU_Ver, interpolatedV_Ver, valR1, valG1, valB1, RGBConv, fullRange, bps);  // Second line
-      convertYUVToRGB8Bit(valY4, interpolatedU_Bi , interpolatedV_Bi , valR2, valG2, valB2, RGBConv, fullRange, bps);
+      convertYUVToRGB8Bit<F>(valY3, interpolatedU_Ver, interpolatedV_Ver, valR1, valG1, valB1, RGBConv, bps);  // Second line
+      convertYUVToRGB8Bit<F>(valY4, interpolatedU_Bi , interpolatedV_Bi , valR2, valG2, valB2, RGBConv, bps);
       const int pos2 = pos1 + w*4;  // Next line
       dst[pos2  ] = valB1;
       dst[pos2+1] = valG1;
@@ -2475,10 +2820,10 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
     int interpolatedV_Ver = interpolateUVSample(interpolation, curV, curV_NL);
 
     // Get the 4 Y samples
-    int valY1 = getValueFromSource(srcY, (y*2+1)*w-2, bps, bigEndian);
-    int valY2 = getValueFromSource(srcY, (y*2+1)*w-1, bps, bigEndian);
-    int valY3 = getValueFromSource(srcY, (y*2+2)*w-2, bps, bigEndian);
-    int valY4 = getValueFromSource(srcY, (y*2+2)*w-1, bps, bigEndian);
+    int valY1 = getValueFromSource<F>(srcY, (y*2+1)*w-2);
+    int valY2 = getValueFromSource<F>(srcY, (y*2+1)*w-1);
+    int valY3 = getValueFromSource<F>(srcY, (y*2+2)*w-2);
+    int valY4 = getValueFromSource<F>(srcY, (y*2+2)*w-1);
     if (applyMathLuma)
     {
       valY1 = transformYUV(mathY.invert, mathY.scale, mathY.offset, valY1, inMax);
@@ -2489,8 +2834,8 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
 
     // Convert to 4 RGB values and save them
     int valR1, valR2, valG1, valG2, valB1, valB2;
-    convertYUVToRGB8Bit(valY1, curU, curV, valR1, valG1, valB1, RGBConv, fullRange, bps);
-    convertYUVToRGB8Bit(valY2, curU, curV, valR2, valG2, valB2, RGBConv, fullRange, bps);
+    convertYUVToRGB8Bit<F>(valY1, curU, curV, valR1, valG1, valB1, RGBConv, bps);
+    convertYUVToRGB8Bit<F>(valY2, curU, curV, valR2, valG2, valB2, RGBConv, bps);
     const int pos1 = ((y*2+1)*w)*4;
     dst[pos1-8] = valB1;
     dst[pos1-7] = valG1;
@@ -2500,8 +2845,8 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
     dst[pos1-3] = valG2;
     dst[pos1-2] = valR2;
     dst[pos1-1] = 255;
-    convertYUVToRGB8Bit(valY3, interpolatedU_Ver, interpolatedV_Ver, valR1, valG1, valB1, RGBConv, fullRange, bps);  // Second line
-    convertYUVToRGB8Bit(valY4, interpolatedU_Ver, interpolatedV_Ver, valR2, valG2, valB2, RGBConv, fullRange, bps);
+    convertYUVToRGB8Bit<F>(valY3, interpolatedU_Ver, interpolatedV_Ver, valR1, valG1, valB1, RGBConv, bps);  // Second line
+    convertYUVToRGB8Bit<F>(valY4, interpolatedU_Ver, interpolatedV_Ver, valR2, valG2, valB2, RGBConv, bps);
     const int pos2 = pos1 + w*4;  // Next line
     dst[pos2-8] = valB1;
     dst[pos2-7] = valG1;
@@ -2521,8 +2866,8 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
 
   // Get 2 chroma samples from this line
   const int srcIdxUV = y*wh;
-  int curU = getValueFromSource(srcU, srcIdxUV*inValSkip, bps, bigEndian);
-  int curV = getValueFromSource(srcV, srcIdxUV*inValSkip, bps, bigEndian);
+  int curU = getValueFromSource<F>(srcU, srcIdxUV*inValSkip);
+  int curV = getValueFromSource<F>(srcV, srcIdxUV*inValSkip);
   if (applyMathChroma)
   {
     curU = transformYUV(mathC.invert, mathC.scale, mathC.offset, curU, inMax);
@@ -2533,8 +2878,8 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
   {
     // Get the next U/V sample for this line and the next one
     const int srcIdxLineUV = srcIdxUV + x + 1;
-    int nextU = getValueFromSource(srcU, srcIdxLineUV*inValSkip, bps, bigEndian);
-    int nextV = getValueFromSource(srcV, srcIdxLineUV*inValSkip, bps, bigEndian);
+    int nextU = getValueFromSource<F>(srcU, srcIdxLineUV*inValSkip);
+    int nextV = getValueFromSource<F>(srcV, srcIdxLineUV*inValSkip);
     if (applyMathChroma)
     {
       nextU = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextU, inMax);
@@ -2546,10 +2891,10 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
     int interpolatedV_Hor = interpolateUVSample(interpolation, curV, nextV);
 
     // Get the 4 Y samples
-    int valY1 = getValueFromSource(srcY, (y*w+x)*2,      bps, bigEndian);
-    int valY2 = getValueFromSource(srcY, (y*w+x)*2+1,    bps, bigEndian);
-    int valY3 = getValueFromSource(srcY, (y2+1)*w+x*2,   bps, bigEndian);
-    int valY4 = getValueFromSource(srcY, (y2+1)*w+x*2+1, bps, bigEndian);
+    int valY1 = getValueFromSource<F>(srcY, (y*w+x)*2);
+    int valY2 = getValueFromSource<F>(srcY, (y*w+x)*2+1);
+    int valY3 = getValueFromSource<F>(srcY, (y2+1)*w+x*2);
+    int valY4 = getValueFromSource<F>(srcY, (y2+1)*w+x*2+1);
     if (applyMathLuma)
     {
       valY1 = transformYUV(mathY.invert, mathY.scale, mathY.offset, valY1, inMax);
@@ -2560,8 +2905,8 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
 
     // Convert to 4 RGB values and save them
     int valR1, valR2, valG1, valG2, valB1, valB2;
-    convertYUVToRGB8Bit(valY1, curU             , curV             , valR1, valG1, valB1, RGBConv, fullRange, bps);
-    convertYUVToRGB8Bit(valY2, interpolatedU_Hor, interpolatedV_Hor, valR2, valG2, valB2, RGBConv, fullRange, bps);
+    convertYUVToRGB8Bit<F>(valY1, curU             , curV             , valR1, valG1, valB1, RGBConv, bps);
+    convertYUVToRGB8Bit<F>(valY2, interpolatedU_Hor, interpolatedV_Hor, valR2, valG2, valB2, RGBConv, bps);
     const int pos1 = (y2*w+x*2)*4;
     dst[pos1  ] = valB1;
     dst[pos1+1] = valG1;
@@ -2571,8 +2916,8 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
     dst[pos1+5] = valG2;
     dst[pos1+6] = valR2;
     dst[pos1+7] = 255;
-    convertYUVToRGB8Bit(valY3, curU             , curV             , valR1, valG1, valB1, RGBConv, fullRange, bps);  // Second line
-    convertYUVToRGB8Bit(valY4, interpolatedU_Hor, interpolatedV_Hor, valR2, valG2, valB2, RGBConv, fullRange, bps);
+    convertYUVToRGB8Bit<F>(valY3, curU             , curV             , valR1, valG1, valB1, RGBConv, bps);  // Second line
+    convertYUVToRGB8Bit<F>(valY4, interpolatedU_Hor, interpolatedV_Hor, valR2, valG2, valB2, RGBConv, bps);
     const int pos2 = pos1 + w*4;  // Next line
     dst[pos2  ] = valB1;
     dst[pos2+1] = valG1;
@@ -2592,10 +2937,10 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
   // Just sample and hold. No interpolation is required.
 
   // Get the 4 Y samples
-  int valY1 = getValueFromSource(srcY, (y2+1)*w-2, bps, bigEndian);
-  int valY2 = getValueFromSource(srcY, (y2+1)*w-1, bps, bigEndian);
-  int valY3 = getValueFromSource(srcY, (y2+2)*w-2, bps, bigEndian);
-  int valY4 = getValueFromSource(srcY, (y2+2)*w-1, bps, bigEndian);
+  int valY1 = getValueFromSource<F>(srcY, (y2+1)*w-2);
+  int valY2 = getValueFromSource<F>(srcY, (y2+1)*w-1);
+  int valY3 = getValueFromSource<F>(srcY, (y2+2)*w-2);
+  int valY4 = getValueFromSource<F>(srcY, (y2+2)*w-1);
   if (applyMathLuma)
   {
     valY1 = transformYUV(mathY.invert, mathY.scale, mathY.offset, valY1, inMax);
@@ -2606,8 +2951,8 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
 
   // Convert to 4 RGB values and save them
   int valR1, valR2, valG1, valG2, valB1, valB2;
-  convertYUVToRGB8Bit(valY1, curU, curV, valR1, valG1, valB1, RGBConv, fullRange, bps);
-  convertYUVToRGB8Bit(valY2, curU, curV, valR2, valG2, valB2, RGBConv, fullRange, bps);
+  convertYUVToRGB8Bit<F>(valY1, curU, curV, valR1, valG1, valB1, RGBConv, bps);
+  convertYUVToRGB8Bit<F>(valY2, curU, curV, valR2, valG2, valB2, RGBConv, bps);
   const int pos1 = (y2+1)*w*4;
   dst[pos1-8] = valB1;
   dst[pos1-7] = valG1;
@@ -2617,8 +2962,8 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
   dst[pos1-3] = valG2;
   dst[pos1-2] = valR2;
   dst[pos1-1] = 255;
-  convertYUVToRGB8Bit(valY3, curU, curV, valR1, valG1, valB1, RGBConv, fullRange, bps);  // Second line
-  convertYUVToRGB8Bit(valY4, curU, curV, valR2, valG2, valB2, RGBConv, fullRange, bps);
+  convertYUVToRGB8Bit<F>(valY3, curU, curV, valR1, valG1, valB1, RGBConv, bps);  // Second line
+  convertYUVToRGB8Bit<F>(valY4, curU, curV, valR2, valG2, valB2, RGBConv, bps);
   const int pos2 = pos1 + w*4;  // Next line
   dst[pos2-8] = valB1;
   dst[pos2-7] = valG1;
@@ -2630,9 +2975,10 @@ inline void YUVPlaneToRGB_420(const int w, const int h, const yuvMathParameters
   dst[pos2-1] = 255;
 }
 
+template<class F>
 inline void YUVPlaneToRGB_410(const int w, const int h, const yuvMathParameters mathY, const yuvMathParameters mathC,
                               const unsigned char * restrict srcY, const unsigned char * restrict srcU, const unsigned char * restrict srcV,
-                              unsigned char * restrict dst, const int RGBConv[5], const bool fullRange,const int inMax, const InterpolationMode interpolation, const int bps, const bool bigEndian, const int inValSkip)
+                              unsigned char * restrict dst, const int RGBConv[5], const int inMax, const InterpolationMode interpolation, const int bps, const int inValSkip)
 {
   const bool applyMathLuma = mathY.yuvMathRequired();
   const bool applyMathChroma = mathC.yuvMathRequired();
@@ -2646,10 +2992,10 @@ inline void YUVPlaneToRGB_410(const int w, const int h, const yuvMathParameters
     // Get the current U/V samples for this y line and the next one (_NL)
     const int srcIdxUV0 = y*wq;
     const int srcIdxUV1 = (y+1)*wq;
-    int curU    = getValueFromSource(srcU, srcIdxUV0*inValSkip, bps, bigEndian);
-    int curV    = getValueFromSource(srcV, srcIdxUV0*inValSkip, bps, bigEndian);
-    int curU_NL = (y < hq-1) ? getValueFromSource(srcU, srcIdxUV1*inValSkip, bps, bigEndian) : curU;
-    int curV_NL = (y < hq-1) ? getValueFromSource(srcV, srcIdxUV1*inValSkip, bps, bigEndian) : curV;
+    int curU    = getValueFromSource<F>(srcU, srcIdxUV0*inValSkip);
+    int curV    = getValueFromSource<F>(srcV, srcIdxUV0*inValSkip);
+    int curU_NL = (y < hq-1) ? getValueFromSource<F>(srcU, srcIdxUV1*inValSkip) : curU;
+    int curV_NL = (y < hq-1) ? getValueFromSource<F>(srcV, srcIdxUV1*inValSkip) : curV;
     if (applyMathChroma)
     {
       curU    = transformYUV(mathC.invert, mathC.scale, mathC.offset, curU, inMax);
@@ -2665,10 +3011,10 @@ inline void YUVPlaneToRGB_410(const int w, const int h, const yuvMathParameters
       // Get the next U/V sample for this line and the next one
       const int srcIdxUVLine0 = srcIdxUV0 + x + 1;
       const int srcIdxUVLine1 = srcIdxUV1 + x + 1;
-      int nextU    = (x < wq-1) ? getValueFromSource(srcU, srcIdxUVLine0*inValSkip, bps, bigEndian) : curU;
-      int nextV    = (x < wq-1) ? getValueFromSource(srcV, srcIdxUVLine0*inValSkip, bps, bigEndian) : curV;
-      int nextU_NL = (x < wq-1) ? getValueFromSource(srcU, srcIdxUVLine1*inValSkip, bps, bigEndian) : curU_NL;
-      int nextV_NL = (x < wq-1) ? getValueFromSource(srcV, srcIdxUVLine1*inValSkip, bps, bigEndian) : curV_NL;
+      int nextU    = (x < wq-1) ? getValueFromSource<F>(srcU, srcIdxUVLine0*inValSkip) : curU;
+      int nextV    = (x < wq-1) ? getValueFromSource<F>(srcV, srcIdxUVLine0*inValSkip) : curV;
+      int nextU_NL = (x < wq-1) ? getValueFromSource<F>(srcU, srcIdxUVLine1*inValSkip) : curU_NL;
+      int nextV_NL = (x < wq-1) ? getValueFromSource<F>(srcV, srcIdxUVLine1*inValSkip) : curV_NL;
       if (applyMathChroma)
       {
         nextU    = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextU, inMax);
@@ -2692,14 +3038,14 @@ inline void YUVPlaneToRGB_410(const int w, const int h, const yuvMathParameters
           int U = interpolateUVSampleQ(interpolation, curU_INT, nextU_INT, xo);
           int V = interpolateUVSampleQ(interpolation, curV_INT, nextV_INT, xo);
           // Get the Y sample
-          int Y = getValueFromSource(srcY, (y*4+yo)*w+x*4+xo, bps, bigEndian);
+          int Y = getValueFromSource<F>(srcY, (y*4+yo)*w+x*4+xo);
           if (applyMathLuma)
             Y = transformYUV(mathY.invert, mathY.scale, mathY.offset, Y, inMax);
 
           // Convert to RGB and save (BGRA)
           int R, G, B;
           const int pos = ((y*4+yo)*w+x*4+xo)*4;
-          convertYUVToRGB8Bit(Y, U, V, R, G, B, RGBConv, fullRange, bps);
+          convertYUVToRGB8Bit<F>(Y, U, V, R, G, B, RGBConv, bps);
           dst[pos  ] = B;
           dst[pos+1] = G;
           dst[pos+2] = R;
@@ -2715,9 +3061,10 @@ inline void YUVPlaneToRGB_410(const int w, const int h, const yuvMathParameters
   }
 }
 
+template<class F>
 inline void YUVPlaneToRGB_411(const int w, const int h, const yuvMathParameters mathY, const yuvMathParameters mathC,
   const unsigned char * restrict srcY, const unsigned char * restrict srcU, const unsigned char * restrict srcV,
-  unsigned char * restrict dst, const int RGBConv[5], const bool fullRange,const int inMax, const InterpolationMode interpolation, const int bps, const bool bigEndian, const int inValSkip)
+  unsigned char * restrict dst, const int RGBConv[5], const int inMax, const InterpolationMode interpolation, const int bps, const int inValSkip)
 {
   // Chroma: quarter horizontal resolution
   const bool applyMathLuma = mathY.yuvMathRequired();
@@ -2727,8 +3074,8 @@ inline void YUVPlaneToRGB_411(const int w, const int h, const yuvMathParameters
   for (int y = 0; y < h; y++)
   {
     const int srcIdxUV = y*w/4;
-    int curUSample = getValueFromSource(srcU, srcIdxUV*inValSkip, bps, bigEndian);
-    int curVSample = getValueFromSource(srcV, srcIdxUV*inValSkip, bps, bigEndian);
+    int curUSample = getValueFromSource<F>(srcU, srcIdxUV*inValSkip);
+    int curVSample = getValueFromSource<F>(srcV, srcIdxUV*inValSkip);
     if (applyMathChroma)
     {
       curUSample = transformYUV(mathC.invert, mathC.scale, mathC.offset, curUSample, inMax);
@@ -2739,8 +3086,8 @@ inline void YUVPlaneToRGB_411(const int w, const int h, const yuvMathParameters
     {
       // Get the next U/V sample
       const int srcIdxUVLine = srcIdxUV + x + 1;
-      int nextUSample = getValueFromSource(srcU, srcIdxUVLine*inValSkip, bps, bigEndian);
-      int nextVSample = getValueFromSource(srcV, srcIdxUVLine*inValSkip, bps, bigEndian);
+      int nextUSample = getValueFromSource<F>(srcU, srcIdxUVLine*inValSkip);
+      int nextVSample = getValueFromSource<F>(srcV, srcIdxUVLine*inValSkip);
       if (applyMathChroma)
       {
         nextUSample = transformYUV(mathC.invert, mathC.scale, mathC.offset, nextUSample, inMax);
@@ -2756,10 +3103,10 @@ inline void YUVPlaneToRGB_411(const int w, const int h, const yuvMathParameters
       int interpolatedV3 = interpolateUVSampleQ(interpolation, curVSample, nextVSample, 3);
 
       // Get the 4 Y samples
-      int valY1 = getValueFromSource(srcY, y*w+x*4,   bps, bigEndian);
-      int valY2 = getValueFromSource(srcY, y*w+x*4+1, bps, bigEndian);
-      int valY3 = getValueFromSource(srcY, y*w+x*4+2, bps, bigEndian);
-      int valY4 = getValueFromSource(srcY, y*w+x*4+3, bps, bigEndian);
+      int valY1 = getValueFromSource<F>(srcY, y*w+x*4);
+      int valY2 = getValueFromSource<F>(srcY, y*w+x*4+1);
+      int valY3 = getValueFromSource<F>(srcY, y*w+x*4+2);
+      int valY4 = getValueFromSource<F>(srcY, y*w+x*4+3);
       if (applyMathLuma)
       {
         valY1 = transformYUV(mathY.invert, mathY.scale, mathY.offset, valY1, inMax);
@@ -2771,22 +3118,22 @@ inline void YUVPlaneToRGB_411(const int w, const int h, const yuvMathParameters
       // Convert to 4 RGB values and save them
       int valR, valG, valB;
       const int pos = (y*w+x*4)*4;
-      convertYUVToRGB8Bit(valY1, curUSample, curVSample, valR, valG, valB, RGBConv, fullRange, bps);
+      convertYUVToRGB8Bit<F>(valY1, curUSample, curVSample, valR, valG, valB, RGBConv, bps);
       dst[pos  ] = valB;
       dst[pos+1] = valG;
       dst[pos+2] = valR;
       dst[pos+3] = 255;
-      convertYUVToRGB8Bit(valY2, interpolatedU1, interpolatedV1, valR, valG, valB, RGBConv, fullRange, bps);
+      convertYUVToRGB8Bit<F>(valY2, interpolatedU1, interpolatedV1, valR, valG, valB, RGBConv, bps);
       dst[pos+4] = valB;
       dst[pos+5] = valG;
       dst[pos+6] = valR;
       dst[pos+7] = 255;
-      convertYUVToRGB8Bit(valY3, interpolatedU2, interpolatedV2, valR, valG, valB, RGBConv, fullRange, bps);
+      convertYUVToRGB8Bit<F>(valY3, interpolatedU2, interpolatedV2, valR, valG, valB, RGBConv, bps);
       dst[pos+8] = valB;
       dst[pos+9] = valG;
       dst[pos+10] = valR;
       dst[pos+11] = 255;
-      convertYUVToRGB8Bit(valY4, interpolatedU3, interpolatedV3, valR, valG, valB, RGBConv, fullRange, bps);
+      convertYUVToRGB8Bit<F>(valY4, interpolatedU3, interpolatedV3, valR, valG, valB, RGBConv, bps);
       dst[pos+12] = valB;
       dst[pos+13] = valG;
       dst[pos+14] = valR;
@@ -2800,10 +3147,10 @@ inline void YUVPlaneToRGB_411(const int w, const int h, const yuvMathParameters
     // For the last row, there is no next sample. Just reuse the current one again. No interpolation required either.
 
     // Get the 2 Y samples
-    int valY1 = getValueFromSource(srcY, (y+1)*w-4, bps, bigEndian);
-    int valY2 = getValueFromSource(srcY, (y+1)*w-3, bps, bigEndian);
-    int valY3 = getValueFromSource(srcY, (y+1)*w-2, bps, bigEndian);
-    int valY4 = getValueFromSource(srcY, (y+1)*w-1, bps, bigEndian);
+    int valY1 = getValueFromSource<F>(srcY, (y+1)*w-4);
+    int valY2 = getValueFromSource<F>(srcY, (y+1)*w-3);
+    int valY3 = getValueFromSource<F>(srcY, (y+1)*w-2);
+    int valY4 = getValueFromSource<F>(srcY, (y+1)*w-1);
     if (applyMathLuma)
     {
       valY1 = transformYUV(mathY.invert, mathY.scale, mathY.offset, valY1, inMax);
@@ -2815,22 +3162,22 @@ inline void YUVPlaneToRGB_411(const int w, const int h, const yuvMathParameters
     // Convert to 4 RGB values and save them
     int valR, valG, valB;
     const int pos = ((y+1)*w)*4;
-    convertYUVToRGB8Bit(valY1, curUSample, curVSample, valR, valG, valB, RGBConv, fullRange, bps);
+    convertYUVToRGB8Bit<F>(valY1, curUSample, curVSample, valR, valG, valB, RGBConv, bps);
     dst[pos-16] = valB;
     dst[pos-15] = valG;
     dst[pos-14] = valR;
     dst[pos-13] = 255;
-    convertYUVToRGB8Bit(valY2, curUSample, curVSample, valR, valG, valB, RGBConv, fullRange, bps);
+    convertYUVToRGB8Bit<F>(valY2, curUSample, curVSample, valR, valG, valB, RGBConv, bps);
     dst[pos-12] = valB;
     dst[pos-11] = valG;
     dst[pos-10] = valR;
     dst[pos-9] = 255;
-    convertYUVToRGB8Bit(valY3, curUSample, curVSample, valR, valG, valB, RGBConv, fullRange, bps);
+    convertYUVToRGB8Bit<F>(valY3, curUSample, curVSample, valR, valG, valB, RGBConv, bps);
     dst[pos-8] = valB;
     dst[pos-7] = valG;
     dst[pos-6] = valR;
     dst[pos-5] = 255;
-    convertYUVToRGB8Bit(valY4, curUSample, curVSample, valR, valG, valB, RGBConv, fullRange, bps);
+    convertYUVToRGB8Bit<F>(valY4, curUSample, curVSample, valR, valG, valB, RGBConv, bps);
     dst[pos-4] = valB;
     dst[pos-3] = valG;
     dst[pos-2] = valR;
@@ -2951,173 +3298,215 @@ bool videoHandlerYUV::convertYUVPackedToPlanar(const QByteArray &sourceBuffer, Q
   return true;
 }
 
-bool videoHandlerYUV::convertYUVPlanarToRGB(const QByteArray &sourceBuffer, uchar *targetBuffer, const QSize &curFrameSize, const yuvPixelFormat &sourceBufferFormat) const
+// Convert h lines of planar YUV data to RGB. The pointers point to the first line to convert in each plane.
+// The conversion of a frame may be split into stripes of lines this way (see convertYUVPlanarToRGBKernel).
+template<class F>
+bool YUVPlanarToRGBLines(const yuvPixelFormat &format, const int w, const int h, const unsigned char * restrict srcY, const unsigned char * restrict srcU,
+                         const unsigned char * restrict srcV, const int inValSkip, unsigned char * restrict dst, const ComponentDisplayMode component,
+                         const yuvMathParameters &mathY, const yuvMathParameters &mathC, const int RGBConv[5], const InterpolationMode interpolation)
+{
+  const int bps = format.bitsPerSample;
+  const int inputMax = (1<<bps)-1;
+  const int componentSizeLuma = (w * h);
+  const int componentSizeChroma = (w / format.getSubsamplingHor()) * (h / format.getSubsamplingVer());
+
+  if (component == DisplayY || format.subsampling == YUV_400)
+  {
+    // Luma only. The chroma subsampling does not matter.
+    YUVPlaneToRGBMonochrome_444<F>(componentSizeLuma, mathY, srcY, dst, inputMax, bps, 1);
+  }
+  else if (component != DisplayAll)
+  {
+    // Display only the U or V component
+    const unsigned char * restrict srcC = (component == DisplayCb) ? srcU : srcV;
+    if (format.subsampling == YUV_444)
+      YUVPlaneToRGBMonochrome_444<F>(componentSizeChroma, mathC, srcC, dst, inputMax, bps, inValSkip);
+    else if (format.subsampling == YUV_422)
+      YUVPlaneToRGBMonochrome_422<F>(componentSizeChroma, mathC, srcC, dst, inputMax, bps, inValSkip);
+    else if (format.subsampling == YUV_420)
+      YUVPlaneToRGBMonochrome_420<F>(w, h, mathC, srcC, dst, inputMax, bps, inValSkip);
+    else if (format.subsampling == YUV_440)
+      YUVPlaneToRGBMonochrome_440<F>(w, h, mathC, srcC, dst, inputMax, bps, inValSkip);
+    else if (format.subsampling == YUV_410)
+      YUVPlaneToRGBMonochrome_410<F>(w, h, mathC, srcC, dst, inputMax, bps, inValSkip);
+    else if (format.subsampling == YUV_411)
+      YUVPlaneToRGBMonochrome_411<F>(componentSizeChroma, mathC, srcC, dst, inputMax, bps, inValSkip);
+    else
+      return false;
+  }
+  else
+  {
+    // We are displaying all components, so we have to perform conversion to RGB (possibly including interpolation and YUV math)
+    if (format.subsampling == YUV_444)
+      YUVPlaneToRGB_444<F>(componentSizeLuma, mathY, mathC, srcY, srcU, srcV, dst, RGBConv, inputMax, bps, inValSkip);
+    else if (format.subsampling == YUV_422)
+      YUVPlaneToRGB_422<F>(w, h, mathY, mathC, srcY, srcU, srcV, dst, RGBConv, inputMax, interpolation, bps, inValSkip);
+    else if (format.subsampling == YUV_420)
+      YUVPlaneToRGB_420<F>(w, h, mathY, mathC, srcY, srcU, srcV, dst, RGBConv, inputMax, interpolation, bps, inValSkip);
+    else if (format.subsampling == YUV_440)
+      YUVPlaneToRGB_440<F>(w, h, mathY, mathC, srcY, srcU, srcV, dst, RGBConv, inputMax, interpolation, bps, inValSkip);
+    else if (format.subsampling == YUV_410)
+      YUVPlaneToRGB_410<F>(w, h, mathY, mathC, srcY, srcU, srcV, dst, RGBConv, inputMax, interpolation, bps, inValSkip);
+    else if (format.subsampling == YUV_411)
+      YUVPlaneToRGB_411<F>(w, h, mathY, mathC, srcY, srcU, srcV, dst, RGBConv, inputMax, interpolation, bps, inValSkip);
+    else
+      return false;
+  }
+  return true;
+}
+
+template<class F>
+bool videoHandlerYUV::convertYUVPlanarToRGBKernel(const QByteArray &sourceBuffer, uchar *targetBuffer, const QSize &curFrameSize, const yuvPixelFormat &sourceBufferFormat, bool parallelStripes) const
 {
   // These are constant for the runtime of this function. This way, the compiler can optimize the
-  // hell out of this function.
+  // hell out of this function. The sample format properties are compile time constants (see sampleFormat).
   const yuvPixelFormat format = sourceBufferFormat;
   const InterpolationMode interpolation = interpolationMode;
   const ComponentDisplayMode component = componentDisplayMode;
-  const ColorConversion conversion = yuvColorConversionType;
   const int w = curFrameSize.width();
   const int h = curFrameSize.height();
-  Q_UNUSED(conversion);
 
   // Do we have to apply YUV math?
   const yuvMathParameters mathY = mathParameters[Luma];
   const yuvMathParameters mathC = mathParameters[Chroma];
-  const bool applyMathLuma   = mathY.yuvMathRequired();
-  const bool applyMathChroma = mathC.yuvMathRequired();
-  Q_UNUSED(applyMathLuma);
-  Q_UNUSED(applyMathChroma);
 
   const int bps = format.bitsPerSample;
-  const bool fullRange = (conversion == BT709_FullRange || conversion == BT601_FullRange || conversion == BT2020_FullRange);
-  const int yOffset = 16<<(bps-8);
-  const int cZero = 128<<(bps-8);
-  const int inputMax = (1<<bps)-1;
-  Q_UNUSED(yOffset);
-  Q_UNUSED(cZero);
+  const int bytesPerSample = (bps > 8) ? 2 : 1;
 
   // The luma component has full resolution. The size of each chroma components depends on the subsampling.
   const int componentSizeLuma = (w * h);
   const int componentSizeChroma = (w / format.getSubsamplingHor()) * (h / format.getSubsamplingVer());
 
   // How many bytes are in each component?
-  const int nrBytesLumaPlane = (bps > 8) ? componentSizeLuma * 2 : componentSizeLuma;
-  const int nrBytesChromaPlane = (bps > 8) ? componentSizeChroma * 2 : componentSizeChroma;
+  const int nrBytesLumaPlane = componentSizeLuma * bytesPerSample;
+  const int nrBytesChromaPlane = componentSizeChroma * bytesPerSample;
 
   // If the U and V (and A if present) components are interlevaed, we have to skip every nth value in the input when reading U and V
-  const int inputValSkip = format.uvInterleaved ? ((format.planeOrder == Order_YUV || format.planeOrder == Order_YVU) ? 2 : 3) : 1;
+  int inputValSkip = format.uvInterleaved ? ((format.planeOrder == Order_YUV || format.planeOrder == Order_YVU) ? 2 : 3) : 1;
 
-  // A pointer to the output
-  unsigned char * restrict dst = targetBuffer;
+  // Is the U plane the first or the second?
+  const bool uPlaneFirst = (format.planeOrder == Order_YUV || format.planeOrder == Order_YUVA);
+
+  // In case the U and V (and A if present) components are interleaved, the skip to the next plane is just 1 (or 2) bytes
+  const int nrBytesToNextChromaPlane = format.uvInterleaved ? bytesPerSample : nrBytesChromaPlane;
+
+  // Get the pointers to the source planes (8 bit per sample)
+  const unsigned char * restrict srcY = (unsigned char*)sourceBuffer.data();
+  const unsigned char * restrict srcU = uPlaneFirst ? srcY + nrBytesLumaPlane : srcY + nrBytesLumaPlane + nrBytesToNextChromaPlane;
+  const unsigned char * restrict srcV = uPlaneFirst ? srcY + nrBytesLumaPlane + nrBytesToNextChromaPlane: srcY + nrBytesLumaPlane;
 
-  if (component != DisplayAll || format.subsampling == YUV_400)
+  // Get/set the parameters used for YUV -> RGB conversion
+  const int RGBConv[5] = { 
+    yuvRgbConvCoeffs[yuvColorConversionType][0],
+    yuvRgbConvCoeffs[yuvColorConversionType][1],
+    yuvRgbConvCoeffs[yuvColorConversionType][2],
+    yuvRgbConvCoeffs[yuvColorConversionType][3],
+    yuvRgbConvCoeffs[yuvColorConversionType][4]
+  };
+
+  // If there is a chroma offset, we must resample the chroma components before we convert them to RGB.
+  // If so, the resampled chroma values are saved in these arrays. This is done for the whole frame before
+  // the conversion is (possibly) split into stripes.
+  QByteArray uvPlaneChromaResampled[2];
+  if (component == DisplayAll && format.subsampling != YUV_400 && (format.chromaOffset[0] != 0 || format.chromaOffset[1] != 0))
   {
-    // We only display (or there is only) one of the color components (possibly with YUV math)
-    if (component == DisplayY || format.subsampling == YUV_400)
-    {
-      // Luma only. The chroma subsampling does not matter.
-      const unsigned char * restrict srcY = (unsigned char*)sourceBuffer.data();
-      YUVPlaneToRGBMonochrome_444(componentSizeLuma, mathY, srcY, dst, inputMax, bps, format.bigEndian, 1, fullRange);
-    }
-    else
-    {
-      // Display only the U or V component
-      bool firstComponent = (((format.planeOrder == Order_YUV || format.planeOrder == Order_YUVA) && component == DisplayCb) ||
-                             ((format.planeOrder == Order_YVU || format.planeOrder == Order_YVUA) && component == DisplayCr));
-      
-      int srcOffset = nrBytesLumaPlane;
-      if (!firstComponent)
-      {
-        if (format.uvInterleaved)
-          srcOffset += (bps > 8) ? 2 : 1;
-        else
-          srcOffset += nrBytesChromaPlane;
-      }
+    uvPlaneChromaResampled[0].resize(nrBytesChromaPlane);
+    uvPlaneChromaResampled[1].resize(nrBytesChromaPlane);
 
-      const unsigned char * restrict srcC = (unsigned char*)sourceBuffer.data() + srcOffset;
-      if (format.subsampling == YUV_444)
-        YUVPlaneToRGBMonochrome_444(componentSizeChroma, mathC, srcC, dst, inputMax, bps, format.bigEndian, inputValSkip, fullRange);
-      else if (format.subsampling == YUV_422)
-        YUVPlaneToRGBMonochrome_422(componentSizeChroma, mathC, srcC, dst, inputMax, bps, format.bigEndian, inputValSkip, fullRange);
-      else if (format.subsampling == YUV_420)
-        YUVPlaneToRGBMonochrome_420(w, h, mathC, srcC, dst, inputMax, bps, format.bigEndian, inputValSkip, fullRange);
-      else if (format.subsampling == YUV_440)
-        YUVPlaneToRGBMonochrome_440(w, h, mathC, srcC, dst, inputMax, bps, format.bigEndian, inputValSkip, fullRange);
-      else if (format.subsampling == YUV_410)
-        YUVPlaneToRGBMonochrome_410(w, h, mathC, srcC, dst, inputMax, bps, format.bigEndian, inputValSkip, fullRange);
-      else if (format.subsampling == YUV_411)
-        YUVPlaneToRGBMonochrome_411(componentSizeChroma, mathC, srcC, dst, inputMax, bps, format.bigEndian, inputValSkip, fullRange);
-      else
-        return false;
-    }
+    // We have to perform pre-filtering for the U and V positions, because there is an offset between the pixel positions of Y and U/V
+    unsigned char *restrict dstU = (unsigned char*)uvPlaneChromaResampled[0].data();
+    unsigned char *restrict dstV = (unsigned char*)uvPlaneChromaResampled[1].data();
+    UVPlaneResamplingChromaOffset<F>(format, w / format.getSubsamplingHor(), h / format.getSubsamplingVer(), srcU, srcV, inputValSkip, dstU, dstV);
+
+    srcU = dstU;
+    srcV = dstV;
+    inputValSkip = 1;
   }
-  else
-  {
-    // Is the U plane the first or the second?
-    const bool uPlaneFirst = (format.planeOrder == Order_YUV || format.planeOrder == Order_YUVA);
 
-    // In case the U and V (and A if present) components are interleaved, the skip to the next plane is just 1 (or 2) bytes
-    int nrBytesToNextChromaPlane = nrBytesChromaPlane;
-    if (format.uvInterleaved)
-      nrBytesToNextChromaPlane = (bps > 8) ? 2 : 1;
+  // The number of bytes from one luma/chroma line to the next
+  const int lumaLineBytes = w * bytesPerSample;
+  const int chromaLineBytes = (w / format.getSubsamplingHor()) * inputValSkip * bytesPerSample;
+  const int subsamplingVer = (format.subsampling == YUV_400) ? 1 : format.getSubsamplingVer();
 
-    // Get/set the parameters used for YUV -> RGB conversion
-    const int RGBConv[5] = { 
-      yuvRgbConvCoeffs[yuvColorConversionType][0],
-      yuvRgbConvCoeffs[yuvColorConversionType][1],
-      yuvRgbConvCoeffs[yuvColorConversionType][2],
-      yuvRgbConvCoeffs[yuvColorConversionType][3],
-      yuvRgbConvCoeffs[yuvColorConversionType][4]
-    };
+  const int nrStripes = parallelStripes ? clip(h / CONVERSION_STRIPE_MIN_HEIGHT, 1, QThreadPool::globalInstance()->maxThreadCount()) : 1;
+  if (nrStripes == 1)
+    return YUVPlanarToRGBLines<F>(format, w, h, srcY, srcU, srcV, inputValSkip, targetBuffer, component, mathY, mathC, RGBConv, interpolation);
+  if (format.subsampling < 0 || format.subsampling >= YUV_NUM_SUBSAMPLINGS)
+    return false;
 
-    // We are displaying all components, so we have to perform conversion to RGB (possibly including interpolation and YUV math)
-    if (format.subsampling != YUV_400 && (format.chromaOffset[0] != 0 || format.chromaOffset[1] != 0))
-    {
-      // If there is a chroma offset, we must resample the chroma components before we convert them to RGB.
-      // If so, the resampled chroma values are saved in these arrays.
-      QByteArray uvPlaneChromaResampled[2];
-      uvPlaneChromaResampled[0].resize(nrBytesChromaPlane);
-      uvPlaneChromaResampled[1].resize(nrBytesChromaPlane);
-
-      // We have to perform pre-filtering for the U and V positions, because there is an offset between the pixel positions of Y and U/V
-      unsigned char *restrict dstU = (unsigned char*)uvPlaneChromaResampled[0].data();
-      unsigned char *restrict dstV = (unsigned char*)uvPlaneChromaResampled[1].data();
-
-      unsigned char * restrict srcY = (unsigned char*)sourceBuffer.data();
-      unsigned char * restrict srcU = uPlaneFirst ? srcY + nrBytesLumaPlane : srcY + nrBytesLumaPlane + nrBytesToNextChromaPlane;
-      unsigned char * restrict srcV = uPlaneFirst ? srcY + nrBytesLumaPlane + nrBytesToNextChromaPlane: srcY + nrBytesLumaPlane;
-      UVPlaneResamplingChromaOffset(format, w / format.getSubsamplingHor(), h / format.getSubsamplingVer(), srcU, srcV, inputValSkip, dstU, dstV);
-
-      if (format.subsampling == YUV_444)
-        YUVPlaneToRGB_444(componentSizeLuma, mathY, mathC, srcY, dstU, dstV, dst, RGBConv, fullRange, inputMax, bps, format.bigEndian, 1);
-      else if (format.subsampling == YUV_422)
-        YUVPlaneToRGB_422(w, h, mathY, mathC, srcY, dstU, dstV, dst, RGBConv, fullRange, inputMax, interpolation, bps, format.bigEndian, 1);
-      else if (format.subsampling == YUV_420)
-        YUVPlaneToRGB_420(w, h, mathY, mathC, srcY, dstU, dstV, dst, RGBConv, fullRange, inputMax, interpolation, bps, format.bigEndian, 1);
-      else if (format.subsampling == YUV_440)
-        YUVPlaneToRGB_440(w, h, mathY, mathC, srcY, dstU, dstV, dst, RGBConv, fullRange, inputMax, interpolation, bps, format.bigEndian, 1);
-      else if (format.subsampling == YUV_410)
-        YUVPlaneToRGB_410(w, h, mathY, mathC, srcY, dstU, dstV, dst, RGBConv, fullRange, inputMax, interpolation, bps, format.bigEndian, 1);
-      else if (format.subsampling == YUV_411)
-        YUVPlaneToRGB_411(w, h, mathY, mathC, srcY, dstU, dstV, dst, RGBConv, fullRange, inputMax, interpolation, bps, format.bigEndian, 1);
-      else
-        return false;
+  // Split the frame into horizontal stripes which are converted in parallel using the global thread pool.
+  // Every stripe starts at a chroma line so that no chroma line is shared between two stripes.
+  // With interpolation, the last lines of a stripe are interpolated using the first chroma line of the next
+  // stripe. So these stripes are converted with one more chroma line into a temporary buffer (which is then
+  // copied without the additional lines) so that the result is identical to converting the whole frame at once.
+  const bool needNextChromaLine = (component == DisplayAll && subsamplingVer > 1 && interpolation != NearestNeighborInterpolation);
+  const int linesPerStripe = (h / nrStripes + subsamplingVer - 1) / subsamplingVer * subsamplingVer;
+  QVector<indexRange> stripes;
+  for (int y = 0; y < h; y += linesPerStripe)
+    stripes.append(indexRange(y, std::min(y + linesPerStripe, h)));
+
+  QtConcurrent::blockingMap(stripes, [&](const indexRange &stripe)
+  {
+    const int y = stripe.first;
+    const int stripeHeight = stripe.second - stripe.first;
+    const int chromaLine = y / subsamplingVer;
+    const unsigned char *stripeY = srcY + y * lumaLineBytes;
+    const unsigned char *stripeU = srcU + chromaLine * chromaLineBytes;
+    const unsigned char *stripeV = srcV + chromaLine * chromaLineBytes;
+    unsigned char *stripeDst = targetBuffer + y * w * 4;
+    if (needNextChromaLine && stripe.second < h)
+    {
+      QByteArray tmpRGB;
+      tmpRGB.resize((stripeHeight + subsamplingVer) * w * 4);
+      YUVPlanarToRGBLines<F>(format, w, stripeHeight + subsamplingVer, stripeY, stripeU, stripeV, inputValSkip, (unsigned char*)tmpRGB.data(), component, mathY, mathC, RGBConv, interpolation);
+      memcpy(stripeDst, tmpRGB.constData(), stripeHeight * w * 4);
     }
     else
+      YUVPlanarToRGBLines<F>(format, w, stripeHeight, stripeY, stripeU, stripeV, inputValSkip, stripeDst, component, mathY, mathC, RGBConv, interpolation);
+  });
+  return true;
+}
+
+bool videoHandlerYUV::convertYUVPlanarToRGB(const QByteArray &sourceBuffer, uchar *targetBuffer, const QSize &curFrameSize, const yuvPixelFormat &sourceBufferFormat, bool parallelStripes) const
+{
+  // Select the specialized conversion for the sample format. This is done once per frame.
+  const int bps = sourceBufferFormat.bitsPerSample;
+  const bool bigEndian = sourceBufferFormat.bigEndian;
+  const ColorConversion conversion = yuvColorConversionType;
+  const bool fullRange = (conversion == BT709_FullRange || conversion == BT601_FullRange || conversion == BT2020_FullRange);
+
+  if (bps <= 8)
+  {
+    if (fullRange)
+      return convertYUVPlanarToRGBKernel<sampleFormat<false, false, false, true> >(sourceBuffer, targetBuffer, curFrameSize, sourceBufferFormat, parallelStripes);
+    return convertYUVPlanarToRGBKernel<sampleFormat<false, false, false, false> >(sourceBuffer, targetBuffer, curFrameSize, sourceBufferFormat, parallelStripes);
+  }
+  if (bps <= 14)
+  {
+    if (bigEndian)
     {
-      // Get the pointers to the source planes (8 bit per sample)
-      const unsigned char * restrict srcY = (unsigned char*)sourceBuffer.data();
-      const unsigned char * restrict srcU = uPlaneFirst ? srcY + nrBytesLumaPlane : srcY + nrBytesLumaPlane + nrBytesToNextChromaPlane;
-      const unsigned char * restrict srcV = uPlaneFirst ? srcY + nrBytesLumaPlane + nrBytesToNextChromaPlane: srcY + nrBytesLumaPlane;
-
-      if (format.subsampling == YUV_444)
-        YUVPlaneToRGB_444(componentSizeLuma, mathY, mathC, srcY, srcU, srcV, dst, RGBConv, fullRange, inputMax, bps, format.bigEndian, inputValSkip);
-      else if (format.subsampling == YUV_422)
-        YUVPlaneToRGB_422(w, h, mathY, mathC, srcY, srcU, srcV, dst, RGBConv, fullRange, inputMax, interpolation, bps, format.bigEndian, inputValSkip);
-      else if (format.subsampling == YUV_420)
-        YUVPlaneToRGB_420(w, h, mathY, mathC, srcY, srcU, srcV, dst, RGBConv, fullRange, inputMax, interpolation, bps, format.bigEndian, inputValSkip);
-      else if (format.subsampling == YUV_440)
-        YUVPlaneToRGB_440(w, h, mathY, mathC, srcY, srcU, srcV, dst, RGBConv, fullRange, inputMax, interpolation, bps, format.bigEndian, inputValSkip);
-      else if (format.subsampling == YUV_410)
-        YUVPlaneToRGB_410(w, h, mathY, mathC, srcY, srcU, srcV, dst, RGBConv, fullRange, inputMax, interpolation, bps, format.bigEndian, inputValSkip);
-      else if (format.subsampling == YUV_411)
-        YUVPlaneToRGB_411(w, h, mathY, mathC, srcY, srcU, srcV, dst, RGBConv, fullRange, inputMax, interpolation, bps, format.bigEndian, inputValSkip);
-      else if (format.subsampling == YUV_400)
-        YUVPlaneToRGBMonochrome_444(componentSizeLuma, mathY, srcY, dst, fullRange, inputMax, bps, format.bigEndian, 1);
-      else
-        return false;
+      if (fullRange)
+        return convertYUVPlanarToRGBKernel<sampleFormat<true, true, false, true> >(sourceBuffer, targetBuffer, curFrameSize, sourceBufferFormat, parallelStripes);
+      return convertYUVPlanarToRGBKernel<sampleFormat<true, true, false, false> >(sourceBuffer, targetBuffer, curFrameSize, sourceBufferFormat, parallelStripes);
     }
+    if (fullRange)
+      return convertYUVPlanarToRGBKernel<sampleFormat<true, false, false, true> >(sourceBuffer, targetBuffer, curFrameSize, sourceBufferFormat, parallelStripes);
+    return convertYUVPlanarToRGBKernel<sampleFormat<true, false, false, false> >(sourceBuffer, targetBuffer, curFrameSize, sourceBufferFormat, parallelStripes);
   }
-
-  return true;
+  if (bigEndian)
+  {
+    if (fullRange)
+      return convertYUVPlanarToRGBKernel<sampleFormat<true, true, true, true> >(sourceBuffer, targetBuffer, curFrameSize, sourceBufferFormat, parallelStripes);
+    return convertYUVPlanarToRGBKernel<sampleFormat<true, true, true, false> >(sourceBuffer, targetBuffer, curFrameSize, sourceBufferFormat, parallelStripes);
+  }
+  if (fullRange)
+    return convertYUVPlanarToRGBKernel<sampleFormat<true, false, true, true> >(sourceBuffer, targetBuffer, curFrameSize, sourceBufferFormat, parallelStripes);
+  return convertYUVPlanarToRGBKernel<sampleFormat<true, false, true, false> >(sourceBuffer, targetBuffer, curFrameSize, sourceBufferFormat, parallelStripes);
 }
 
 // Convert the given raw YUV data in sourceBuffer (using srcPixelFormat) to image (RGB-888), using the
 // buffer tmpRGBBuffer for intermediate RGB values.
-void videoHandlerYUV::convertYUVToImage(const QByteArray &sourceBuffer, QImage &outputImage, const yuvPixelFormat &yuvFormat, const QSize &curFrameSize)
+void videoHandlerYUV::convertYUVToImage(const QByteArray &sourceBuffer, QImage &outputImage, const yuvPixelFormat &yuvFormat, const QSize &curFrameSize, bool parallelStripes)
 {
   if (!canConvertToRGB(yuvFormat, curFrameSize))
   {
@@ -3127,37 +3516,18 @@ void videoHandlerYUV::convertYUVToImage(const QByteArray &sourceBuffer, QImage &
 
   DEBUG_YUV("videoHandlerYUV::convertYUVToImage");
 
-  // Create the output image in the right format.
-  // In both cases, we will set the alpha channel to 255. The format of the raw buffer is: BGRA (each 8 bit).
-  // Internally, this is how QImage allocates the number of bytes per line (with depth = 32):
-  // const int bytes_per_line = ((width * depth + 31) >> 5) << 2; // bytes per scanline (must be multiple of 4)
-  if (is_Q_OS_WIN || is_Q_OS_MAC)
-    outputImage = QImage(curFrameSize, platformImageFormat());
-  else if (is_Q_OS_LINUX)
-  {
-    QImage::Format f = platformImageFormat();
-    if (f == QImage::Format_ARGB32_Premultiplied || f == QImage::Format_ARGB32)
-      outputImage = QImage(curFrameSize, f);
-    else
-      outputImage = QImage(curFrameSize, QImage::Format_RGB32);
-  }
-
-  // Check the image buffer size before we write to it
-  assert(outputImage.byteCount() >= curFrameSize.width() * curFrameSize.height() * 4);
+  createImageForConversion(outputImage, curFrameSize);
   
   // Convert the source to RGB
   bool convOK = true;
   if (yuvFormat.planar)
   {
-    if (yuvFormat.bitsPerSample == 8 && yuvFormat.subsampling == YUV_420 && interpolationMode == NearestNeighborInterpolation &&
-        yuvFormat.chromaOffset[0] == 0 && yuvFormat.chromaOffset[1] == 1 &&
-        componentDisplayMode == DisplayAll && !yuvFormat.uvInterleaved &&
-        !mathParameters[Luma].yuvMathRequired() && !mathParameters[Chroma].yuvMathRequired())
-      // 8 bit 4:2:0, nearest neighbor, chroma offset (0,1) (the default for 4:2:0), all components displayed and no yuv math.
-      // We can use a specialized function for this.
-      convOK = convertYUV420ToRGB(sourceBuffer, outputImage.bits(), curFrameSize, yuvFormat);
+    if (canUseSIMDConversion(yuvFormat))
+      // No interpolation, chroma offset or yuv math and all components are displayed.
+      // We can use the vectorized conversion for this.
+      convOK = convertYUVPlanarToRGBSIMD(sourceBuffer, outputImage.bits(), curFrameSize, yuvFormat, parallelStripes);
     else
-      convOK = convertYUVPlanarToRGB(sourceBuffer, outputImage.bits(), curFrameSize, yuvFormat);
+      convOK = convertYUVPlanarToRGB(sourceBuffer, outputImage.bits(), curFrameSize, yuvFormat, parallelStripes);
   }
   else
   {
@@ -3167,12 +3537,42 @@ void videoHandlerYUV::convertYUVToImage(const QByteArray &sourceBuffer, QImage &
     yuvPixelFormat bufferPixelFormat = yuvFormat;
     convOK &= convertYUVPackedToPlanar(sourceBuffer, tmpPlanarYUVSource, curFrameSize, bufferPixelFormat);
 
-    if (convOK)
-      convOK &= convertYUVPlanarToRGB(tmpPlanarYUVSource, outputImage.bits(), curFrameSize, bufferPixelFormat);
+    if (convOK && canUseSIMDConversion(bufferPixelFormat))
+      convOK &= convertYUVPlanarToRGBSIMD(tmpPlanarYUVSource, outputImage.bits(), curFrameSize, bufferPixelFormat, parallelStripes);
+    else if (convOK)
+      convOK &= convertYUVPlanarToRGB(tmpPlanarYUVSource, outputImage.bits(), curFrameSize, bufferPixelFormat, parallelStripes);
   }
 
   assert(convOK);
 
+  convertImageToPlatformFormat(outputImage);
+
+  DEBUG_YUV("videoHandlerYUV::convertYUVToImage Done");
+}
+
+void videoHandlerYUV::createImageForConversion(QImage &outputImage, const QSize &curFrameSize) const
+{
+  // Create the output image in the right format.
+  // In both cases, we will set the alpha channel to 255. The format of the raw buffer is: BGRA (each 8 bit).
+  // Internally, this is how QImage allocates the number of bytes per line (with depth = 32):
+  // const int bytes_per_line = ((width * depth + 31) >> 5) << 2; // bytes per scanline (must be multiple of 4)
+  if (is_Q_OS_WIN || is_Q_OS_MAC)
+    outputImage = QImage(curFrameSize, platformImageFormat());
+  else if (is_Q_OS_LINUX)
+  {
+    QImage::Format f = platformImageFormat();
+    if (f == QImage::Format_ARGB32_Premultiplied || f == QImage::Format_ARGB32)
+      outputImage = QImage(curFrameSize, f);
+    else
+      outputImage = QImage(curFrameSize, QImage::Format_RGB32);
+  }
+
+  // Check the image buffer size before we write to it
+  assert(outputImage.byteCount() >= curFrameSize.width() * curFrameSize.height() * 4);
+}
+
+void videoHandlerYUV::convertImageToPlatformFormat(QImage &outputImage) const
+{
   if (is_Q_OS_LINUX)
   {
     // On linux, we may have to convert the image to the platform image format if it is not one of the
@@ -3181,8 +3581,6 @@ void videoHandlerYUV::convertYUVToImage(const QByteArray &sourceBuffer, QImage &
     if (f != QImage::Format_ARGB32_Premultiplied && f != QImage::Format_ARGB32 && f != QImage::Format_RGB32)
       outputImage = outputImage.convertToFormat(f);
   }
-
-  DEBUG_YUV("videoHandlerYUV::convertYUVToImage Done");
 }
 
 void videoHandlerYUV::getPixelValue(const QPoint &pixelPos, unsigned int &Y, unsigned int &U, unsigned int &V)
@@ -3276,232 +3674,108 @@ void videoHandlerYUV::getPixelValue(const QPoint &pixelPos, unsigned int &Y, uns
   }
 }
 
-// This is a specialized function that can convert 8-bit YUV 4:2:0 to RGB888 using NearestNeighborInterpolation.
-// The chroma must be 0 in x direction and 1 in y direction. No yuvMath is supported.
-// TODO: Correct the chroma subsampling offset.
-#if SSE_CONVERSION
-bool videoHandlerYUV::convertYUV420ToRGB(const byteArrayAligned &sourceBuffer, byteArrayAligned &targetBuffer)
-#else
-bool videoHandlerYUV::convertYUV420ToRGB(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &size, const yuvPixelFormat format)
-#endif
+// Convert the planar YUV data to RGB using the vectorized kernels (see canUseSIMDConversion()).
+bool videoHandlerYUV::convertYUVPlanarToRGBSIMD(const QByteArray &sourceBuffer, uchar *targetBuffer, const QSize &curFrameSize, const yuvPixelFormat &sourceBufferFormat, bool parallelStripes) const
 {
-  const int frameWidth = size.width();
-  const int frameHeight = size.height();
-
-  // For 4:2:0, w and h must be dividible by 2
-  assert(frameWidth % 2 == 0 && frameHeight % 2 == 0);
-  
-  int componentLenghtY  = frameWidth * frameHeight;
-  int componentLengthUV = componentLenghtY >> 2;
-  Q_ASSERT(sourceBuffer.size() >= componentLenghtY + componentLengthUV + componentLengthUV); // YUV 420 must be (at least) 1.5*Y-area
-
-#if SSE_CONVERSION_420_ALT
-  quint8 *srcYRaw = (quint8*) sourceBuffer.data();
-  quint8 *srcURaw = srcYRaw + componentLenghtY;
-  quint8 *srcVRaw = srcURaw + componentLengthUV;
-
-  quint8 *dstBuffer = (quint8*)targetBuffer.data();
-  quint32 dstBufferStride = frameWidth*4;
-
-  yuv420_to_argb8888(srcYRaw,srcURaw,srcVRaw,frameWidth,frameWidth>>1,frameWidth,frameHeight,dstBuffer,dstBufferStride);
-  return false;
-#endif
-
-#if SSE_CONVERSION
-  // Try to use SSE. If this fails use conventional algorithm
-
-  if (frameWidth % 32 == 0 && frameHeight % 2 == 0)
-  {
-    // We can use 16byte aligned read/write operations
-
-    quint8 *srcY = (quint8*) sourceBuffer.data();
-    quint8 *srcU = srcY + componentLenghtY;
-    quint8 *srcV = srcU + componentLengthUV;
-
-    __m128i yMult  = _mm_set_epi16(75, 75, 75, 75, 75, 75, 75, 75);
-    __m128i ySub   = _mm_set_epi16(16, 16, 16, 16, 16, 16, 16, 16);
-    __m128i ugMult = _mm_set_epi16(25, 25, 25, 25, 25, 25, 25, 25);
-    //__m128i sub16  = _mm_set_epi8(16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16, 16);
-    __m128i sub128 = _mm_set_epi8(128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128, 128);
-
-    //__m128i test = _mm_set_epi8(128, 0, 1, 2, 3, 245, 254, 255, 128, 128, 128, 128, 128, 128, 128, 128);
-
-    __m128i y, u, v, uMult, vMult;
-    __m128i RGBOut0, RGBOut1, RGBOut2;
-    __m128i tmp;
-
-    for (int yh=0; yh < frameHeight / 2; yh++)
-    {
-      for (int x=0; x < frameWidth / 32; x+=32)
-      {
-        // Load 16 bytes U/V
-        u  = _mm_load_si128((__m128i *) &srcU[x / 2]);
-        v  = _mm_load_si128((__m128i *) &srcV[x / 2]);
-        // Subtract 128 from each U/V value (16 values)
-        u = _mm_sub_epi8(u, sub128);
-        v = _mm_sub_epi8(v, sub128);
-
-        // Load 16 bytes Y from this line and the next one
-        y = _mm_load_si128((__m128i *) &srcY[x]);
-
-        // Get the lower 8 (8bit signed) Y values and put them into a 16bit register
-        tmp = _mm_srai_epi16(_mm_unpacklo_epi8(y, y), 8);
-        // Subtract 16 and multiply by 75
-        tmp = _mm_sub_epi16(tmp, ySub);
-        tmp = _mm_mullo_epi16(tmp, yMult);
-
-        // Now to add them to the 16 bit RGB output values
-        RGBOut0 = _mm_shuffle_epi32(tmp, _MM_SHUFFLE(1, 0, 1, 0));
-        RGBOut0 = _mm_shufflelo_epi16(RGBOut0, _MM_SHUFFLE(1, 0, 0, 0));
-        RGBOut0 = _mm_shufflehi_epi16(RGBOut0, _MM_SHUFFLE(2, 2, 1, 1));
-
-        RGBOut1 = _mm_shuffle_epi32(tmp, _MM_SHUFFLE(2, 1, 2, 1));
-        RGBOut1 = _mm_shufflelo_epi16(RGBOut1, _MM_SHUFFLE(1, 1, 1, 0));
-        RGBOut1 = _mm_shufflehi_epi16(RGBOut1, _MM_SHUFFLE(3, 2, 2, 2));
-
-        RGBOut2 = _mm_shuffle_epi32(tmp, _MM_SHUFFLE(3, 2, 3, 2));
-        RGBOut2 = _mm_shufflelo_epi16(RGBOut2, _MM_SHUFFLE(2, 2, 1, 1));
-        RGBOut2 = _mm_shufflehi_epi16(RGBOut2, _MM_SHUFFLE(3, 3, 3, 2));
-
-        //y2 = _mm_load_si128((__m128i *) &srcY[x + 16]);
-
-        // --- Start with the left 8 values from U/V
-
-        // Get the lower 8 (8bit signed) U/V values and put them into a 16bit register
-        uMult = _mm_srai_epi16(_mm_unpacklo_epi8(u, u), 8);
-        vMult = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
-
-        // Multiply
-
-
-        /*y3 = _mm_load_si128((__m128i *) &srcY[x + frameWidth]);
-        y4 = _mm_load_si128((__m128i *) &srcY[x + frameWidth + 16]);*/
-      }
-    }
-
-    return true;
-  }
-#endif
-
-  // Perform software based 420 to RGB conversion
-  static unsigned char clp_buf[384+256+384];
-  static unsigned char *clip_buf = clp_buf+384;
-  static bool clp_buf_initialized = false;
-
-  if (!clp_buf_initialized)
-  {
-    // Initialize clipping table. Because of the static bool, this will only be called once.
-    memset(clp_buf, 0, 384);
-    int i;
-    for (i = 0; i < 256; i++)
-      clp_buf[384+i] = i;
-    memset(clp_buf+384+256, 255, 384);
-    clp_buf_initialized = true;
-  }
+  const yuvPixelFormat format = sourceBufferFormat;
+  const int w = curFrameSize.width();
+  const int h = curFrameSize.height();
+  const int bps = format.bitsPerSample;
+  const int bytesPerSample = (bps > 8) ? 2 : 1;
 
-  unsigned char * restrict dst = targetBuffer;
+  // The luma component has full resolution. The size of each chroma components depends on the subsampling.
+  const int componentSizeLuma = (w * h);
+  const int componentSizeChroma = (w / format.getSubsamplingHor()) * (h / format.getSubsamplingVer());
+  const int nrBytesLumaPlane = componentSizeLuma * bytesPerSample;
+  const int nrBytesChromaPlane = componentSizeChroma * bytesPerSample;
+
+  // In case the U and V (and A if present) components are interleaved, the skip to the next plane is just 1 (or 2) bytes
+  const int nrBytesToNextChromaPlane = format.uvInterleaved ? bytesPerSample : nrBytesChromaPlane;
+  const int chromaValSkip = format.uvInterleaved ? ((format.planeOrder == Order_YUV || format.planeOrder == Order_YVU) ? 2 : 3) : 1;
+  const bool uPlaneFirst = (format.planeOrder == Order_YUV || format.planeOrder == Order_YUVA);
+
+  // The planes in the buffer have no padding
+  yuvPlanes planes;
+  planes.plane[0] = (const unsigned char*)sourceBuffer.data();
+  planes.plane[1] = uPlaneFirst ? planes.plane[0] + nrBytesLumaPlane : planes.plane[0] + nrBytesLumaPlane + nrBytesToNextChromaPlane;
+  planes.plane[2] = uPlaneFirst ? planes.plane[0] + nrBytesLumaPlane + nrBytesToNextChromaPlane : planes.plane[0] + nrBytesLumaPlane;
+  planes.stride[0] = w * bytesPerSample;
+  planes.stride[1] = w / format.getSubsamplingHor() * chromaValSkip * bytesPerSample;
+  planes.stride[2] = planes.stride[1];
+  return convertYUVPlanarToRGBSIMD(planes, targetBuffer, curFrameSize, format, parallelStripes);
+}
 
-  // Get/set the parameters used for YUV -> RGB conversion
-  const bool fullRange = (yuvColorConversionType == BT709_FullRange || yuvColorConversionType == BT601_FullRange || yuvColorConversionType == BT2020_FullRange);
-  const int yOffset = (fullRange ? 0 : 16);
-  const int cZero = 128;
-  const int RGBConv[5] = { 
-    yuvRgbConvCoeffs[yuvColorConversionType][0],
-    yuvRgbConvCoeffs[yuvColorConversionType][1],
-    yuvRgbConvCoeffs[yuvColorConversionType][2],
-    yuvRgbConvCoeffs[yuvColorConversionType][3],
-    yuvRgbConvCoeffs[yuvColorConversionType][4]
-  };
+bool videoHandlerYUV::convertYUVPlanarToRGBSIMD(const yuvPlanes &planes, uchar *targetBuffer, const QSize &curFrameSize, const yuvPixelFormat &sourceBufferFormat, bool parallelStripes) const
+{
+  const yuvPixelFormat format = sourceBufferFormat;
+  const int w = curFrameSize.width();
+  const int h = curFrameSize.height();
+  const int bps = format.bitsPerSample;
 
-  // Get pointers to the source and the output array
-  const bool uPplaneFirst = (format.planeOrder == Order_YUV || format.planeOrder == Order_YUVA); // Is the U plane the first or the second?
-  const unsigned char * restrict srcY = (unsigned char*)sourceBuffer.data();
-  const unsigned char * restrict srcU = uPplaneFirst ? srcY + componentLenghtY : srcY + componentLenghtY + componentLengthUV;
-  const unsigned char * restrict srcV = uPplaneFirst ? srcY + componentLenghtY + componentLengthUV : srcY + componentLenghtY;
+  // The conversion uses one stride for both chroma planes
+  if (planes.stride[1] != planes.stride[2])
+    return false;
 
-  int yh;
-  for (yh=0; yh < frameHeight / 2; yh++)
+  YUV_SIMD::conversionParameters par;
+  par.srcY = planes.plane[0];
+  par.srcU = planes.plane[1];
+  par.srcV = planes.plane[2];
+  par.strideY = planes.stride[0];
+  par.strideC = planes.stride[1];
+  par.width = w;
+  par.height = h;
+  par.subsamplingHor = format.getSubsamplingHor();
+  par.subsamplingVer = format.getSubsamplingVer();
+  par.chromaValSkip = format.uvInterleaved ? ((format.planeOrder == Order_YUV || format.planeOrder == Order_YVU) ? 2 : 3) : 1;
+  // The vertical chroma offset is re-sampled like in UVPlaneResamplingChromaOffset(). Only for 8 bit 4:2:0 with
+  // the default chroma offset of (0,1), the offset has always been ignored.
+  const int possibleValsY = getMaxPossibleChromaOffsetValues(false, format.subsampling);
+  par.chromaOffsetY8 = (possibleValsY == 1) ? format.chromaOffset[1] * 4 : (possibleValsY == 3) ? format.chromaOffset[1] * 2 : format.chromaOffset[1];
+  if (bps == 8 && format.subsampling == YUV_420 && format.chromaOffset[1] == 1)
+    par.chromaOffsetY8 = 0;
+  par.bitsPerSample = bps;
+  par.bigEndian = format.bigEndian;
+  par.fullRange = (yuvColorConversionType == BT709_FullRange || yuvColorConversionType == BT601_FullRange || yuvColorConversionType == BT2020_FullRange);
+  for (int i = 0; i < 5; i++)
+    par.RGBConv[i] = yuvRgbConvCoeffs[yuvColorConversionType][i];
+
+  if (parallelStripes)
   {
-    // Process two lines at once, always 4 RGB values at a time (they have the same U/V components)
-
-    int dstAddr1 = yh * 2 * frameWidth * 4;         // The RGB output address of line yh*2
-    int dstAddr2 = (yh * 2 + 1) * frameWidth * 4;   // The RGB output address of line yh*2+1
-    int srcAddrY1 = yh * 2 * frameWidth;            // The Y source address of line yh*2
-    int srcAddrY2 = (yh * 2 + 1) * frameWidth;      // The Y source address of line yh*2+1
-    int srcAddrUV = yh * frameWidth / 2;            // The UV source address of both lines (UV are identical)
-
-    for (int xh=0, x=0; xh < frameWidth / 2; xh++, x+=2)
+    // Split the frame into horizontal stripes which are converted in parallel using the global thread pool.
+    // Every stripe starts at a chroma line so that no chroma line is shared between two stripes.
+    const int nrStripes = clip(h / CONVERSION_STRIPE_MIN_HEIGHT, 1, QThreadPool::globalInstance()->maxThreadCount());
+    if (nrStripes > 1)
     {
-      // Process four pixels (the ones for which U/V are valid
-
-      // Load UV and pre-multiply
-      const int U_tmp_G = ((int)srcU[srcAddrUV + xh] - cZero) * RGBConv[2];
-      const int U_tmp_B = ((int)srcU[srcAddrUV + xh] - cZero) * RGBConv[4];
-      const int V_tmp_R = ((int)srcV[srcAddrUV + xh] - cZero) * RGBConv[1];
-      const int V_tmp_G = ((int)srcV[srcAddrUV + xh] - cZero) * RGBConv[3];
-
-      // Pixel top left
-      {
-        const int Y_tmp = ((int)srcY[srcAddrY1 + x] - yOffset) * RGBConv[0];
-
-        const int R_tmp = (Y_tmp           + V_tmp_R) >> 16;
-        const int G_tmp = (Y_tmp + U_tmp_G + V_tmp_G) >> 16;
-        const int B_tmp = (Y_tmp + U_tmp_B          ) >> 16;
-
-        dst[dstAddr1]   = clip_buf[B_tmp];
-        dst[dstAddr1+1] = clip_buf[G_tmp];
-        dst[dstAddr1+2] = clip_buf[R_tmp];
-        dst[dstAddr1+3] = 255;
-        dstAddr1 += 4;
-      }
-      // Pixel top right
-      {
-        const int Y_tmp = ((int)srcY[srcAddrY1 + x + 1] - yOffset) * RGBConv[0];
-
-        const int R_tmp = (Y_tmp           + V_tmp_R) >> 16;
-        const int G_tmp = (Y_tmp + U_tmp_G + V_tmp_G) >> 16;
-        const int B_tmp = (Y_tmp + U_tmp_B          ) >> 16;
+      const int linesPerStripe = (h / nrStripes + par.subsamplingVer - 1) / par.subsamplingVer * par.subsamplingVer;
+      QVector<indexRange> stripes;
+      for (int y = 0; y < h; y += linesPerStripe)
+        stripes.append(indexRange(y, std::min(y + linesPerStripe, h)));
 
-        dst[dstAddr1]   = clip_buf[B_tmp];
-        dst[dstAddr1+1] = clip_buf[G_tmp];
-        dst[dstAddr1+2] = clip_buf[R_tmp];
-        dst[dstAddr1+3] = 255;
-        dstAddr1 += 4;
-      }
-      // Pixel bottom left
+      QtConcurrent::blockingMap(stripes, [&par, targetBuffer, w](const indexRange &stripe)
       {
-        const int Y_tmp = ((int)srcY[srcAddrY2 + x] - yOffset) * RGBConv[0];
-
-        const int R_tmp = (Y_tmp           + V_tmp_R) >> 16;
-        const int G_tmp = (Y_tmp + U_tmp_G + V_tmp_G) >> 16;
-        const int B_tmp = (Y_tmp + U_tmp_B          ) >> 16;
-
-        dst[dstAddr2]   = clip_buf[B_tmp];
-        dst[dstAddr2+1] = clip_buf[G_tmp];
-        dst[dstAddr2+2] = clip_buf[R_tmp];
-        dst[dstAddr2+3] = 255;
-        dstAddr2 += 4;
-      }
-      // Pixel bottom right
-      {
-        const int Y_tmp = ((int)srcY[srcAddrY2 + x + 1] - yOffset) * RGBConv[0];
-
-        const int R_tmp = (Y_tmp           + V_tmp_R) >> 16;
-        const int G_tmp = (Y_tmp + U_tmp_G + V_tmp_G) >> 16;
-        const int B_tmp = (Y_tmp + U_tmp_B          ) >> 16;
-
-        dst[dstAddr2]   = clip_buf[B_tmp];
-        dst[dstAddr2+1] = clip_buf[G_tmp];
-        dst[dstAddr2+2] = clip_buf[R_tmp];
-        dst[dstAddr2+3] = 255;
-        dstAddr2 += 4;
-      }
+        YUV_SIMD::convertYUVToRGB(par, targetBuffer, w*4, stripe.first, stripe.second);
+      });
+      return true;
     }
   }
 
+  YUV_SIMD::convertYUVToRGB(par, targetBuffer, w*4, 0, h);
   return true;
 }
 
+bool videoHandlerYUV::canUseSIMDConversion(const yuvPixelFormat &format) const
+{
+  if (!format.planar || format.subsampling == YUV_400 || componentDisplayMode != DisplayAll)
+    return false;
+  if (mathParameters[Luma].yuvMathRequired() || mathParameters[Chroma].yuvMathRequired())
+    return false;
+  // The kernels only perform nearest neighbor up-sampling of the chroma components
+  if (format.subsampling != YUV_444 && interpolationMode != NearestNeighborInterpolation)
+    return false;
+  // Only a vertical chroma offset is supported
+  return format.chromaOffset[0] == 0;
+}
+
 bool videoHandlerYUV::markDifferencesYUVPlanarToRGB(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &curFrameSize, const yuvPixelFormat &sourceBufferFormat) const
 {
   // These are constant for the runtime of this function. This way, the compiler can optimize the
@@ -3893,6 +4167,12 @@ void videoHandlerYUV::invalidateAllBuffers()
 {
   currentFrameRawYUVData_frameIdx = -1;
   rawYUVData_frameIdx = -1;
+  viewportOnlyFrameIdx = -1;
+  currentImageSetMutex.lock();
+  viewportImageCache.clear();
+  doubleBufferViewportImage.frameIdx = -1;
+  viewportConversionNeeded = false;
+  currentImageSetMutex.unlock();
   videoHandler::invalidateAllBuffers();
 }
 
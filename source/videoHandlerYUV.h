@@ -180,6 +180,15 @@ namespace YUV_Internals
     // Get the yuvPixelFormat with the given name
     yuvPixelFormat getFromName(const QString &name);
   };
+
+  // The planes of a planar YUV frame that is held somewhere else (e.g. in the picture buffer of a decoder).
+  // The planes are always given in the order Y, U, V. The lines of a plane may be padded.
+  struct yuvPlanes
+  {
+    yuvPlanes() { for (int c = 0; c < 3; c++) { plane[c] = nullptr; stride[c] = 0; } }
+    const unsigned char *plane[3];
+    int stride[3];  //< The number of bytes from one line to the next
+  };
 }
 
 /** The videoHandlerYUV can be used in any playlistItem to read/display YUV data. A playlistItem could even provide multiple YUV videos.
@@ -256,12 +265,27 @@ public:
   QByteArray rawYUVData;
   int        rawYUVData_frameIdx;
 
+  // Convert a frame directly from the given planes and put the image into the cache. This saves copying the frame
+  // into a buffer first. The planes must have the current YUV format (except for the order of the planes). Return false
+  // if this is not possible (e.g. if raw data is cached). The frame must then be cached using cacheFrame().
+  bool cacheFrameFromPlanes(int frameIdx, const YUV_Internals::yuvPlanes &planes, bool testMode);
+  // Convert a frame that was decoded in a background thread (e.g. ahead of playback) to an image. This is the
+  // same conversion that is used for caching. Return false if the frame could not be converted.
+  bool convertFrameFromPlanes(const YUV_Internals::yuvPlanes &planes, QImage &image);
+  bool convertFrameFromRawData(const QByteArray &rawData, QImage &image);
+
   // Invalidate all YUV related buffers. Then call the videoHandler::invalidateAllBuffers() function
   virtual void invalidateAllBuffers() Q_DECL_OVERRIDE;
 
   // Load the given frame and convert it to image. After this, currentFrameRawYUVData and currentFrame will
   // contain the frame with the given frame index.
   virtual void loadFrame(int frameIndex, bool loadToDoubleBuffer=false) Q_DECL_OVERRIDE;
+  virtual void setLoadedFrame(int frameIndex, const QImage &image, bool loadToDoubleBuffer=false) Q_DECL_OVERRIDE;
+
+  // If only a part of the current frame was converted and a different part is visible now, the frame must be loaded again.
+  virtual itemLoadingState needsLoading(int frameIndex, bool loadRawValues) Q_DECL_OVERRIDE;
+  // The double buffer may only contain the visible part of the frame (see viewportOnlyFrameIdx).
+  virtual void activateDoubleBuffer() Q_DECL_OVERRIDE;
 
   // If this is set, the pixel values drawn in the drawPixels function will be scaled according to the bit depth.
   // E.g: The bit depth is 8 and the pixel value is 127, then the value shown will be -1.
@@ -323,6 +347,16 @@ protected:
   // Get the YUV values for the given pixel.
   virtual void getPixelValue(const QPoint &pixelPos, unsigned int &Y, unsigned int &U, unsigned int &V);
 
+  // If the current image was not converted (only the visible part of it), the value is taken from the converted part.
+  virtual QRgb getPixelVal(int x, int y) Q_DECL_OVERRIDE;
+
+  // Raw data caching. The raw YUV frames are cached and converted when drawn.
+  virtual bool supportsRawDataCaching() const Q_DECL_OVERRIDE { return true; }
+  virtual bool loadRawDataForCaching(int frameIndex, QByteArray &rawData) Q_DECL_OVERRIDE;
+  virtual void convertRawDataFromCache(int frameIndex, const QByteArray &rawData, QImage &image) Q_DECL_OVERRIDE;
+  virtual void convertRawDataForCaching(int frameIndex, const QByteArray &rawData, QImage &image) Q_DECL_OVERRIDE;
+  virtual unsigned int getRawCachingFrameSize() const Q_DECL_OVERRIDE { return getBytesPerFrame(); }
+
   // Load the given frame and return it for caching. The current buffers (currentFrameRawYUVData and currentFrame)
   // will not be modified.
   virtual void loadFrameForCaching(int frameIndex, QImage &frameToCache) Q_DECL_OVERRIDE;
@@ -333,30 +367,62 @@ private:
   // Return false is loading failed.
   bool loadRawYUVData(int frameIndex);
 
-  // Convert from YUV (which ever format is selected) to image (RGB-888)
-  void convertYUVToImage(const QByteArray &sourceBuffer, QImage &outputImage, const YUV_Internals::yuvPixelFormat &yuvFormat, const QSize &curFrameSize);
+  // Convert from YUV (which ever format is selected) to image (RGB-888). If parallelStripes is set, the conversion
+  // of the frame may be split over multiple threads. Only use this for interactive loading (caching is already parallel).
+  void convertYUVToImage(const QByteArray &sourceBuffer, QImage &outputImage, const YUV_Internals::yuvPixelFormat &yuvFormat, const QSize &curFrameSize, bool parallelStripes=false);
 
   // Set the new pixel format thread save (lock the mutex). We should also emit that something changed (can be disabled).
   void setSrcPixelFormat(YUV_Internals::yuvPixelFormat newFormat, bool emitChangedSignal=true);
 
   bool canConvertToRGB(YUV_Internals::yuvPixelFormat format, QSize imageSize, QString *whyNot=nullptr) const;
 
-#if SSE_CONVERSION
-  bool convertYUV420ToRGB(const byteArrayAligned &sourceBuffer, byteArrayAligned &targetBuffer);
-#else
-  bool convertYUV420ToRGB(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &size, const YUV_Internals::yuvPixelFormat format);
-#endif
-
   bool convertYUVPackedToPlanar(const QByteArray &sourceBuffer, QByteArray &targetBuffer, const QSize &frameSize, YUV_Internals::yuvPixelFormat &sourceBufferFormat);
-  bool convertYUVPlanarToRGB(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &frameSize, const YUV_Internals::yuvPixelFormat &sourceBufferFormat) const;
+  // If parallelStripes is set, the frame is split into stripes of lines that are converted in parallel (like in convertYUVPlanarToRGBSIMD).
+  bool convertYUVPlanarToRGB(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &frameSize, const YUV_Internals::yuvPixelFormat &sourceBufferFormat, bool parallelStripes=false) const;
+  // The conversion for one specific sample format (bit depth, endianness, range). Selected by convertYUVPlanarToRGB.
+  template<class sampleFormat> bool convertYUVPlanarToRGBKernel(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &frameSize, const YUV_Internals::yuvPixelFormat &sourceBufferFormat, bool parallelStripes) const;
+  // The vectorized conversion only supports a subset of the formats/settings. Check this before calling convertYUVPlanarToRGBSIMD.
+  bool canUseSIMDConversion(const YUV_Internals::yuvPixelFormat &format) const;
+  bool convertYUVPlanarToRGBSIMD(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &frameSize, const YUV_Internals::yuvPixelFormat &sourceBufferFormat, bool parallelStripes) const;
+  bool convertYUVPlanarToRGBSIMD(const YUV_Internals::yuvPlanes &planes, unsigned char *targetBuffer, const QSize &frameSize, const YUV_Internals::yuvPixelFormat &sourceBufferFormat, bool parallelStripes) const;
+  // Create the output image for the conversion and (if needed) convert it to the platform image format after the conversion
+  void createImageForConversion(QImage &outputImage, const QSize &curFrameSize) const;
+  void convertImageToPlatformFormat(QImage &outputImage) const;
   bool markDifferencesYUVPlanarToRGB(const QByteArray &sourceBuffer, unsigned char *targetBuffer, const QSize &frameSize, const YUV_Internals::yuvPixelFormat &sourceBufferFormat) const;
 
-#if SSE_CONVERSION_420_ALT
-  void yuv420_to_argb8888(quint8 *yp, quint8 *up, quint8 *vp,
-                          quint32 sy, quint32 suv,
-                           int width, int height,
-                           quint8 *rgb, quint32 srgb);
-#endif
+  // --- Viewport conversion: If only a small part of a (large) frame is visible or the frame is drawn downscaled,
+  // we do not convert the full frame. Instead, only the part that was visible in the last draw call is converted (at
+  // the needed resolution) in loadFrame(). If a different part becomes visible, the frame is loaded again.
+  // A converted part of a frame. rect is in frame coordinates and step is the downscaling factor.
+  struct viewportImage
+  {
+    viewportImage() : step(1), frameIdx(-1) {}
+    QImage image;
+    QRect rect;
+    int step;
+    int frameIdx;
+  };
+  bool getViewportConversionRect(QPainter *painter, const QRect &videoRect, QRect &visibleRect, int &step) const;
+  // Convert the part of the frame in currentFrameRawYUVData that was visible in the last viewport draw call.
+  bool convertViewportImage(int frameIdx, viewportImage &newImage);
+  // Draw the converted parts of the current frame. The caller must lock the currentImageSetMutex.
+  bool drawViewportImage(QPainter *painter, int frameIdx, const QRect &videoRect, const QRect &visibleRect, int step);
+  bool cropYUVPlanar(const QByteArray &sourceBuffer, const QRect &rect, int step, QByteArray &targetBuffer) const;
+  // If this is equal to currentImageIdx, only a part of the current frame was converted (see viewportImageCache) and
+  // currentImage was not updated.
+  int viewportOnlyFrameIdx;
+  // Were there draw calls that needed the full frame/only a part of the frame since the last loadFrame()?
+  bool drawnViewportSinceLoad;
+  bool drawnFullSinceLoad;
+  // The visible part of the frame (and the step) in the last viewport draw call. Protected by the currentImageSetMutex.
+  QRect viewportRect;
+  int viewportStep;
+  // Set when drawing if the converted parts do not cover what is visible. Protected by the currentImageSetMutex.
+  bool viewportConversionNeeded;
+  // The last converted parts of the current frame
+  QList<viewportImage> viewportImageCache;
+  // If the double buffer was loaded while drawing only parts of the frame, this is the converted part of it.
+  viewportImage doubleBufferViewportImage;
 
   SafeUi<Ui::videoHandlerYUV> ui;
 
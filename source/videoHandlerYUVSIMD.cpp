@@ -0,0 +1,685 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "videoHandlerYUVSIMD.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define YUV_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#else
+#define YUV_SIMD_X86 0
+#endif
+
+// NEON is always available on 64 bit ARM. On 32 bit ARM, the kernel is only used if we are compiled for NEON.
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(_M_ARM64)
+#define YUV_SIMD_NEON 1
+#include <arm_neon.h>
+#else
+#define YUV_SIMD_NEON 0
+#endif
+
+// Activate this to check the output of every vector kernel against the scalar reference kernel.
+#define YUV_SIMD_VERIFY 0
+#if YUV_SIMD_VERIFY
+#include <cassert>
+#endif
+
+// The vector kernels are compiled for their instruction set using function attributes so that the
+// rest of YUView can still be compiled for (and run on) any CPU. MSVC does not need this.
+#if defined(_MSC_VER)
+#define YUV_SIMD_TARGET(instructionSet)
+#else
+#define YUV_SIMD_TARGET(instructionSet) __attribute__((target(instructionSet)))
+#endif
+
+namespace YUV_SIMD
+{
+  namespace
+  {
+    // The values that are derived from the conversionParameters and are identical for all kernels.
+    // This is exactly the same math as in convertYUVToRGB8Bit() of the videoHandlerYUV.
+    struct kernelConstants
+    {
+      int inputShift;     //< For more than 14 bit we drop the 2 LSBs so that the conversion fits into 32 bit
+      int yOffset;
+      int cZero;
+      int outputShift;
+    };
+
+    kernelConstants getKernelConstants(const conversionParameters &par)
+    {
+      kernelConstants k;
+      k.inputShift = (par.bitsPerSample > 14) ? 2 : 0;
+      const int bps = par.bitsPerSample - k.inputShift;
+      k.yOffset = par.fullRange ? 0 : 16 << (bps - 8);
+      k.cZero = 128 << (bps - 8);
+      k.outputShift = 16 + bps - 8;
+      return k;
+    }
+
+    inline int getValue(const unsigned char *src, const int idx, const bool twoBytes, const bool bigEndian)
+    {
+      if (twoBytes)
+        return bigEndian ? (src[idx*2] << 8 | src[idx*2+1]) : (src[idx*2] | src[idx*2+1] << 8);
+      return src[idx];
+    }
+
+    inline void setValue(unsigned char *dst, const int idx, const int val, const bool bigEndian)
+    {
+      dst[idx*2]   = (unsigned char)(bigEndian ? (val >> 8) : (val & 0xff));
+      dst[idx*2+1] = (unsigned char)(bigEndian ? (val & 0xff) : (val >> 8));
+    }
+
+    inline unsigned char clip8Bit(const int val)
+    {
+      return (unsigned char)((val < 0) ? 0 : (val > 255) ? 255 : val);
+    }
+
+    // Interpolate between a chroma sample and the one before it. This is the same as interpolateUV8Pos() in the videoHandlerYUV.
+    inline int interpolateChroma(const int prev, const int cur, const int offset8)
+    {
+      switch (offset8)
+      {
+        case 1: return (prev + cur*7 + 4) / 8;
+        case 2: return (prev + cur*3 + 2) / 4;
+        case 3: return (prev*3 + cur*5 + 4) / 8;
+        case 4: return (prev + cur + 1) / 2;
+        case 5: return (prev*5 + cur*3 + 4) / 8;
+        case 6: return (prev*3 + cur + 2) / 4;
+        case 7: return (prev*7 + cur + 4) / 8;
+        default: return cur;
+      }
+    }
+
+    // Read one line of chroma samples. The values in dstU/dstV are already reduced by cZero.
+    // With a vertical chroma offset, the line is interpolated with the line above it (the first line is not changed).
+    // This is the same re-sampling as in UVPlaneResamplingChromaOffset() of the videoHandlerYUV. It is done here
+    // so that all kernels get the re-sampled values.
+    void readChromaLine(const conversionParameters &par, const kernelConstants &k, const int chromaLine, int *dstU, int *dstV)
+    {
+      const bool twoBytes = par.bitsPerSample > 8;
+      const int chromaWidth = par.width / par.subsamplingHor;
+      const unsigned char *srcU = par.srcU + chromaLine * par.strideC;
+      const unsigned char *srcV = par.srcV + chromaLine * par.strideC;
+      const bool interpolate = (par.chromaOffsetY8 != 0 && chromaLine > 0);
+      for (int x = 0; x < chromaWidth; x++)
+      {
+        const int idx = x * par.chromaValSkip;
+        int valU = getValue(srcU, idx, twoBytes, par.bigEndian);
+        int valV = getValue(srcV, idx, twoBytes, par.bigEndian);
+        if (interpolate)
+        {
+          valU = interpolateChroma(getValue(srcU - par.strideC, idx, twoBytes, par.bigEndian), valU, par.chromaOffsetY8);
+          valV = interpolateChroma(getValue(srcV - par.strideC, idx, twoBytes, par.bigEndian), valV, par.chromaOffsetY8);
+        }
+        dstU[x] = (valU >> k.inputShift) - k.cZero;
+        dstV[x] = (valV >> k.inputShift) - k.cZero;
+      }
+    }
+
+    // Convert the pixels [xStart, width) of one line. This is the reference that all vector kernels must match.
+    void convertPixelsScalar(const conversionParameters &par, const kernelConstants &k, const unsigned char *srcY, const int *u, const int *v, unsigned char *dst, const int xStart)
+    {
+      const bool twoBytes = par.bitsPerSample > 8;
+      // If the width is not divisible by the subsampling, the last pixels reuse the last chroma value of the line.
+      const int lastChromaIdx = std::max(par.width / par.subsamplingHor - 1, 0);
+      for (int x = xStart; x < par.width; x++)
+      {
+        const int valY = getValue(srcY, x, twoBytes, par.bigEndian) >> k.inputShift;
+        const int chromaIdx = std::min(x / par.subsamplingHor, lastChromaIdx);
+        const int valU = u[chromaIdx];
+        const int valV = v[chromaIdx];
+
+        const int Y_tmp = (valY - k.yOffset) * par.RGBConv[0];
+        const int R_tmp = (Y_tmp                           + valV * par.RGBConv[1]) >> k.outputShift;
+        const int G_tmp = (Y_tmp + valU * par.RGBConv[2] + valV * par.RGBConv[3]) >> k.outputShift;
+        const int B_tmp = (Y_tmp + valU * par.RGBConv[4]                          ) >> k.outputShift;
+
+        dst[x*4  ] = clip8Bit(B_tmp);
+        dst[x*4+1] = clip8Bit(G_tmp);
+        dst[x*4+2] = clip8Bit(R_tmp);
+        dst[x*4+3] = 255;
+      }
+    }
+
+    typedef void (*convertLineFunction)(const conversionParameters &par, const kernelConstants &k, const unsigned char *srcY, const int *u, const int *v, unsigned char *dst);
+
+    void convertLineScalar(const conversionParameters &par, const kernelConstants &k, const unsigned char *srcY, const int *u, const int *v, unsigned char *dst)
+    {
+      convertPixelsScalar(par, k, srcY, u, v, dst, 0);
+    }
+
+#if YUV_SIMD_X86 || YUV_SIMD_NEON
+    // Select the template instance of the given kernel for the format
+    template<template<int, bool, bool> class kernel>
+    convertLineFunction getKernelInstance(const conversionParameters &par)
+    {
+      const bool twoBytes = par.bitsPerSample > 8;
+      if (par.subsamplingHor == 1)
+        return !twoBytes ? kernel<1, false, false>::get() : par.bigEndian ? kernel<1, true, true>::get() : kernel<1, true, false>::get();
+      if (par.subsamplingHor == 2)
+        return !twoBytes ? kernel<2, false, false>::get() : par.bigEndian ? kernel<2, true, true>::get() : kernel<2, true, false>::get();
+      return !twoBytes ? kernel<4, false, false>::get() : par.bigEndian ? kernel<4, true, true>::get() : kernel<4, true, false>::get();
+    }
+#endif
+
+#if YUV_SIMD_X86
+
+    // The SSE4.1 kernel processes 4 pixels at a time. The format properties are template parameters so
+    // that there is no branching in the inner loop.
+    template<int subsamplingHor, bool twoBytes, bool bigEndian>
+    YUV_SIMD_TARGET("sse4.1")
+    void convertLineSSE41(const conversionParameters &par, const kernelConstants &k, const unsigned char *srcY, const int *u, const int *v, unsigned char *dst)
+    {
+      const __m128i yOffset = _mm_set1_epi32(k.yOffset);
+      const __m128i c0 = _mm_set1_epi32(par.RGBConv[0]);
+      const __m128i c1 = _mm_set1_epi32(par.RGBConv[1]);
+      const __m128i c2 = _mm_set1_epi32(par.RGBConv[2]);
+      const __m128i c3 = _mm_set1_epi32(par.RGBConv[3]);
+      const __m128i c4 = _mm_set1_epi32(par.RGBConv[4]);
+      const __m128i inputShift = _mm_cvtsi32_si128(k.inputShift);
+      const __m128i outputShift = _mm_cvtsi32_si128(k.outputShift);
+      const __m128i zero = _mm_setzero_si128();
+      const __m128i max8Bit = _mm_set1_epi32(255);
+      const __m128i alpha = _mm_slli_epi32(max8Bit, 24);
+      const __m128i swapBytes = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+
+      int x = 0;
+      for (; x + 4 <= par.width; x += 4)
+      {
+        __m128i valY;
+        if (twoBytes)
+        {
+          valY = _mm_loadl_epi64((const __m128i*)(srcY + x*2));
+          if (bigEndian)
+            valY = _mm_shuffle_epi8(valY, swapBytes);
+          valY = _mm_srl_epi32(_mm_cvtepu16_epi32(valY), inputShift);
+        }
+        else
+        {
+          int fourSamples;
+          memcpy(&fourSamples, srcY + x, 4);
+          valY = _mm_cvtepu8_epi32(_mm_cvtsi32_si128(fourSamples));
+        }
+
+        __m128i valU, valV;
+        if (subsamplingHor == 1)
+        {
+          valU = _mm_loadu_si128((const __m128i*)(u + x));
+          valV = _mm_loadu_si128((const __m128i*)(v + x));
+        }
+        else if (subsamplingHor == 2)
+        {
+          valU = _mm_loadl_epi64((const __m128i*)(u + x/2));
+          valV = _mm_loadl_epi64((const __m128i*)(v + x/2));
+          valU = _mm_unpacklo_epi32(valU, valU);
+          valV = _mm_unpacklo_epi32(valV, valV);
+        }
+        else
+        {
+          valU = _mm_set1_epi32(u[x/4]);
+          valV = _mm_set1_epi32(v[x/4]);
+        }
+
+        const __m128i yTmp = _mm_mullo_epi32(_mm_sub_epi32(valY, yOffset), c0);
+        __m128i valR = _mm_sra_epi32(_mm_add_epi32(yTmp, _mm_mullo_epi32(valV, c1)), outputShift);
+        __m128i valG = _mm_sra_epi32(_mm_add_epi32(_mm_add_epi32(yTmp, _mm_mullo_epi32(valU, c2)), _mm_mullo_epi32(valV, c3)), outputShift);
+        __m128i valB = _mm_sra_epi32(_mm_add_epi32(yTmp, _mm_mullo_epi32(valU, c4)), outputShift);
+        valR = _mm_min_epi32(_mm_max_epi32(valR, zero), max8Bit);
+        valG = _mm_min_epi32(_mm_max_epi32(valG, zero), max8Bit);
+        valB = _mm_min_epi32(_mm_max_epi32(valB, zero), max8Bit);
+
+        // Combine to 4 BGRA pixels
+        const __m128i bgra = _mm_or_si128(_mm_or_si128(valB, _mm_slli_epi32(valG, 8)), _mm_or_si128(_mm_slli_epi32(valR, 16), alpha));
+        _mm_storeu_si128((__m128i*)(dst + x*4), bgra);
+      }
+
+      // The remaining pixels at the right border
+      convertPixelsScalar(par, k, srcY, u, v, dst, x);
+    }
+
+    // The AVX2 kernel processes 8 pixels at a time.
+    template<int subsamplingHor, bool twoBytes, bool bigEndian>
+    YUV_SIMD_TARGET("avx2")
+    void convertLineAVX2(const conversionParameters &par, const kernelConstants &k, const unsigned char *srcY, const int *u, const int *v, unsigned char *dst)
+    {
+      const __m256i yOffset = _mm256_set1_epi32(k.yOffset);
+      const __m256i c0 = _mm256_set1_epi32(par.RGBConv[0]);
+      const __m256i c1 = _mm256_set1_epi32(par.RGBConv[1]);
+      const __m256i c2 = _mm256_set1_epi32(par.RGBConv[2]);
+      const __m256i c3 = _mm256_set1_epi32(par.RGBConv[3]);
+      const __m256i c4 = _mm256_set1_epi32(par.RGBConv[4]);
+      const __m128i inputShift = _mm_cvtsi32_si128(k.inputShift);
+      const __m128i outputShift = _mm_cvtsi32_si128(k.outputShift);
+      const __m256i zero = _mm256_setzero_si256();
+      const __m256i max8Bit = _mm256_set1_epi32(255);
+      const __m256i alpha = _mm256_slli_epi32(max8Bit, 24);
+      const __m128i swapBytes = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+      // Which chroma value to use for each of the 8 pixels
+      const __m256i chromaIdx = (subsamplingHor == 2) ? _mm256_setr_epi32(0, 0, 1, 1, 2, 2, 3, 3) : _mm256_setr_epi32(0, 0, 0, 0, 1, 1, 1, 1);
+
+      int x = 0;
+      for (; x + 8 <= par.width; x += 8)
+      {
+        __m256i valY;
+        if (twoBytes)
+        {
+          __m128i eightSamples = _mm_loadu_si128((const __m128i*)(srcY + x*2));
+          if (bigEndian)
+            eightSamples = _mm_shuffle_epi8(eightSamples, swapBytes);
+          valY = _mm256_srl_epi32(_mm256_cvtepu16_epi32(eightSamples), inputShift);
+        }
+        else
+          valY = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)(srcY + x)));
+
+        __m256i valU, valV;
+        if (subsamplingHor == 1)
+        {
+          valU = _mm256_loadu_si256((const __m256i*)(u + x));
+          valV = _mm256_loadu_si256((const __m256i*)(v + x));
+        }
+        else if (subsamplingHor == 2)
+        {
+          valU = _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(u + x/2))), chromaIdx);
+          valV = _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)(v + x/2))), chromaIdx);
+        }
+        else
+        {
+          valU = _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadl_epi64((const __m128i*)(u + x/4))), chromaIdx);
+          valV = _mm256_permutevar8x32_epi32(_mm256_castsi128_si256(_mm_loadl_epi64((const __m128i*)(v + x/4))), chromaIdx);
+        }
+
+        const __m256i yTmp = _mm256_mullo_epi32(_mm256_sub_epi32(valY, yOffset), c0);
+        __m256i valR = _mm256_sra_epi32(_mm256_add_epi32(yTmp, _mm256_mullo_epi32(valV, c1)), outputShift);
+        __m256i valG = _mm256_sra_epi32(_mm256_add_epi32(_mm256_add_epi32(yTmp, _mm256_mullo_epi32(valU, c2)), _mm256_mullo_epi32(valV, c3)), outputShift);
+        __m256i valB = _mm256_sra_epi32(_mm256_add_epi32(yTmp, _mm256_mullo_epi32(valU, c4)), outputShift);
+        valR = _mm256_min_epi32(_mm256_max_epi32(valR, zero), max8Bit);
+        valG = _mm256_min_epi32(_mm256_max_epi32(valG, zero), max8Bit);
+        valB = _mm256_min_epi32(_mm256_max_epi32(valB, zero), max8Bit);
+
+        // Combine to 8 BGRA pixels
+        const __m256i bgra = _mm256_or_si256(_mm256_or_si256(valB, _mm256_slli_epi32(valG, 8)), _mm256_or_si256(_mm256_slli_epi32(valR, 16), alpha));
+        _mm256_storeu_si256((__m256i*)(dst + x*4), bgra);
+      }
+
+      // The remaining pixels at the right border
+      convertPixelsScalar(par, k, srcY, u, v, dst, x);
+    }
+
+    template<int subsamplingHor, bool twoBytes, bool bigEndian>
+    struct kernelSSE41
+    {
+      static convertLineFunction get() { return &convertLineSSE41<subsamplingHor, twoBytes, bigEndian>; }
+    };
+
+    template<int subsamplingHor, bool twoBytes, bool bigEndian>
+    struct kernelAVX2
+    {
+      static convertLineFunction get() { return &convertLineAVX2<subsamplingHor, twoBytes, bigEndian>; }
+    };
+
+#endif // YUV_SIMD_X86
+
+#if YUV_SIMD_NEON
+
+    // The NEON kernel processes 4 pixels at a time (like the SSE4.1 kernel).
+    template<int subsamplingHor, bool twoBytes, bool bigEndian>
+    void convertLineNEON(const conversionParameters &par, const kernelConstants &k, const unsigned char *srcY, const int *u, const int *v, unsigned char *dst)
+    {
+      const int32x4_t yOffset = vdupq_n_s32(k.yOffset);
+      const int32x4_t c0 = vdupq_n_s32(par.RGBConv[0]);
+      const int32x4_t c1 = vdupq_n_s32(par.RGBConv[1]);
+      const int32x4_t c2 = vdupq_n_s32(par.RGBConv[2]);
+      const int32x4_t c3 = vdupq_n_s32(par.RGBConv[3]);
+      const int32x4_t c4 = vdupq_n_s32(par.RGBConv[4]);
+      // A shift by a negative value is a right shift (arithmetic for signed values)
+      const int32x4_t inputShift = vdupq_n_s32(-k.inputShift);
+      const int32x4_t outputShift = vdupq_n_s32(-k.outputShift);
+      const int32x4_t zero = vdupq_n_s32(0);
+      const int32x4_t max8Bit = vdupq_n_s32(255);
+      const uint32x4_t alpha = vdupq_n_u32(0xff000000u);
+
+      int x = 0;
+      for (; x + 4 <= par.width; x += 4)
+      {
+        int32x4_t valY;
+        if (twoBytes)
+        {
+          uint64_t fourSamples;
+          memcpy(&fourSamples, srcY + x*2, 8);
+          uint16x4_t samples = vcreate_u16(fourSamples);
+          if (bigEndian)
+            samples = vreinterpret_u16_u8(vrev16_u8(vreinterpret_u8_u16(samples)));
+          valY = vshlq_s32(vreinterpretq_s32_u32(vmovl_u16(samples)), inputShift);
+        }
+        else
+        {
+          uint32_t fourSamples;
+          memcpy(&fourSamples, srcY + x, 4);
+          const uint8x8_t samples = vreinterpret_u8_u32(vdup_n_u32(fourSamples));
+          valY = vreinterpretq_s32_u32(vmovl_u16(vget_low_u16(vmovl_u8(samples))));
+        }
+
+        int32x4_t valU, valV;
+        if (subsamplingHor == 1)
+        {
+          valU = vld1q_s32(u + x);
+          valV = vld1q_s32(v + x);
+        }
+        else if (subsamplingHor == 2)
+        {
+          const int32x2_t twoU = vld1_s32(u + x/2);
+          const int32x2_t twoV = vld1_s32(v + x/2);
+          const int32x2x2_t zipU = vzip_s32(twoU, twoU);
+          const int32x2x2_t zipV = vzip_s32(twoV, twoV);
+          valU = vcombine_s32(zipU.val[0], zipU.val[1]);
+          valV = vcombine_s32(zipV.val[0], zipV.val[1]);
+        }
+        else
+        {
+          valU = vdupq_n_s32(u[x/4]);
+          valV = vdupq_n_s32(v[x/4]);
+        }
+
+        const int32x4_t yTmp = vmulq_s32(vsubq_s32(valY, yOffset), c0);
+        int32x4_t valR = vshlq_s32(vaddq_s32(yTmp, vmulq_s32(valV, c1)), outputShift);
+        int32x4_t valG = vshlq_s32(vaddq_s32(vaddq_s32(yTmp, vmulq_s32(valU, c2)), vmulq_s32(valV, c3)), outputShift);
+        int32x4_t valB = vshlq_s32(vaddq_s32(yTmp, vmulq_s32(valU, c4)), outputShift);
+        valR = vminq_s32(vmaxq_s32(valR, zero), max8Bit);
+        valG = vminq_s32(vmaxq_s32(valG, zero), max8Bit);
+        valB = vminq_s32(vmaxq_s32(valB, zero), max8Bit);
+
+        // Combine to 4 BGRA pixels
+        const uint32x4_t bg = vorrq_u32(vreinterpretq_u32_s32(valB), vshlq_n_u32(vreinterpretq_u32_s32(valG), 8));
+        const uint32x4_t ra = vorrq_u32(vshlq_n_u32(vreinterpretq_u32_s32(valR), 16), alpha);
+        vst1q_u8(dst + x*4, vreinterpretq_u8_u32(vorrq_u32(bg, ra)));
+      }
+
+      // The remaining pixels at the right border
+      convertPixelsScalar(par, k, srcY, u, v, dst, x);
+    }
+
+    template<int subsamplingHor, bool twoBytes, bool bigEndian>
+    struct kernelNEON
+    {
+      static convertLineFunction get() { return &convertLineNEON<subsamplingHor, twoBytes, bigEndian>; }
+    };
+
+#endif // YUV_SIMD_NEON
+
+    InstructionSet detectInstructionSet()
+    {
+#if YUV_SIMD_X86
+#if defined(_MSC_VER)
+      int info[4];
+      __cpuid(info, 0);
+      const int maxLeaf = info[0];
+      __cpuid(info, 1);
+      const bool sse41 = (info[2] & (1 << 19)) != 0;
+      const bool osxsave = (info[2] & (1 << 27)) != 0;
+      const bool avx = (info[2] & (1 << 28)) != 0;
+      bool avx2 = false;
+      // AVX2 also requires that the OS saves the YMM registers
+      if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6)
+      {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] & (1 << 5)) != 0;
+      }
+#else
+      __builtin_cpu_init();
+      const bool sse41 = __builtin_cpu_supports("sse4.1");
+      const bool avx2 = __builtin_cpu_supports("avx2");
+#endif
+      if (avx2)
+        return InstructionSetAVX2;
+      if (sse41)
+        return InstructionSetSSE41;
+#elif YUV_SIMD_NEON
+      return InstructionSetNEON;
+#endif
+      return InstructionSetScalar;
+    }
+
+    convertLineFunction getLineFunction(const conversionParameters &par, InstructionSet set)
+    {
+#if YUV_SIMD_X86
+      if (set == InstructionSetAVX2)
+        return getKernelInstance<kernelAVX2>(par);
+      if (set == InstructionSetSSE41)
+        return getKernelInstance<kernelSSE41>(par);
+#elif YUV_SIMD_NEON
+      if (set == InstructionSetNEON)
+        return getKernelInstance<kernelNEON>(par);
+#else
+      (void)par;
+      (void)set;
+#endif
+      return &convertLineScalar;
+    }
+
+    bool isInstructionSetSupported(InstructionSet set)
+    {
+      if (set == InstructionSetScalar)
+        return true;
+      // The x86 instruction sets are ordered (AVX2 implies SSE4.1). NEON is only supported on ARM.
+      const InstructionSet supportedSet = getSupportedInstructionSet();
+      if (set == InstructionSetNEON || supportedSet == InstructionSetNEON)
+        return set == supportedSet;
+      return set <= supportedSet;
+    }
+
+    void convertLines(const conversionParameters &par, convertLineFunction convertLine, unsigned char *dst, const int dstStride, const int lineStart, const int lineEnd)
+    {
+      const kernelConstants k = getKernelConstants(par);
+      const int chromaWidth = par.width / par.subsamplingHor;
+      const int lastChromaLine = std::max(par.height / par.subsamplingVer - 1, 0);
+
+      // One line of chroma values is read (and converted to int) once and used for all luma lines
+      // that share the chroma line.
+      std::vector<int> chromaLine(std::max(chromaWidth, 1) * 2);
+      int *u = chromaLine.data();
+      int *v = u + chromaWidth;
+      int curChromaLine = -1;
+
+      for (int y = lineStart; y < lineEnd; y++)
+      {
+        if (std::min(y / par.subsamplingVer, lastChromaLine) != curChromaLine)
+        {
+          curChromaLine = std::min(y / par.subsamplingVer, lastChromaLine);
+          readChromaLine(par, k, curChromaLine, u, v);
+        }
+        const unsigned char *srcY = par.srcY + y * par.strideY;
+        convertLine(par, k, srcY, u, v, dst + y * dstStride);
+      }
+    }
+  }
+
+  InstructionSet getSupportedInstructionSet()
+  {
+    // The detection result never changes so concurrent first calls are harmless.
+    static const InstructionSet supportedSet = detectInstructionSet();
+    return supportedSet;
+  }
+
+  const char *getInstructionSetName(InstructionSet set)
+  {
+    if (set == InstructionSetSSE41)
+      return "SSE4.1";
+    if (set == InstructionSetAVX2)
+      return "AVX2";
+    if (set == InstructionSetNEON)
+      return "NEON";
+    return "Scalar";
+  }
+
+  void convertYUVToRGB(const conversionParameters &par, unsigned char *dst, int dstStride, int lineStart, int lineEnd)
+  {
+    convertYUVToRGB(par, dst, dstStride, lineStart, lineEnd, getSupportedInstructionSet());
+  }
+
+  void convertYUVToRGB(const conversionParameters &par, unsigned char *dst, int dstStride, int lineStart, int lineEnd, InstructionSet set)
+  {
+    if (!isInstructionSetSupported(set))
+      set = InstructionSetScalar;
+
+    convertLines(par, getLineFunction(par, set), dst, dstStride, lineStart, lineEnd);
+
+#if YUV_SIMD_VERIFY
+    if (set != InstructionSetScalar)
+    {
+      // Convert again using the reference and compare the results
+      std::vector<unsigned char> reference(par.width * 4 * par.height);
+      convertLines(par, &convertLineScalar, reference.data(), par.width * 4, lineStart, lineEnd);
+      for (int y = lineStart; y < lineEnd; y++)
+        assert(memcmp(dst + y * dstStride, reference.data() + y * par.width * 4, par.width * 4) == 0);
+    }
+#endif
+  }
+
+  bool testKernels(InstructionSet &failedSet, conversionParameters &failedPar)
+  {
+    // Fixed pseudo random input so that a failure can be reproduced
+    unsigned int seed = 12345;
+    auto nextRandom = [&seed]() { seed = seed * 1103515245 + 12345; return (int)((seed >> 16) & 0x7fff); };
+
+    // BT709 (limited range) and BT601 (full range) coefficients
+    const int RGBConv[2][5] = {{76309, 117489, -13975, -34925, 138438}, {65536, 91881, -22553, -46802, 116130}};
+    const int subsamplings[6][2] = {{1, 1}, {2, 1}, {2, 2}, {1, 2}, {4, 1}, {4, 4}};
+    // Widths that are not a multiple of any vector width so that the scalar tail is always tested as well
+    const int widths[3] = {37, 64, 77};
+    // No offset, the default 4:2:0 offset (1/4 chroma line) and half a chroma line
+    const int chromaOffsets[3] = {0, 2, 4};
+    const int height = 8;
+    const int padding = 14;
+
+    // The scalar kernel itself is only tested for the chroma offset. It is compared to a conversion of chroma planes
+    // that were re-sampled beforehand.
+    for (int set = InstructionSetScalar; set < InstructionSetNum; set++)
+    {
+      if (!isInstructionSetSupported(InstructionSet(set)))
+        continue;
+
+      for (const auto &subsampling : subsamplings)
+        for (int bitsPerSample = 8; bitsPerSample <= 16; bitsPerSample++)
+          for (int endianness = 0; endianness < 2; endianness++)
+            for (int interleaved = 0; interleaved < 2; interleaved++)
+              for (int chromaOffsetY8 : chromaOffsets)
+                for (int width : widths)
+                {
+                  if (set == InstructionSetScalar && chromaOffsetY8 == 0)
+                    continue;
+
+                  conversionParameters par;
+                  par.width = width;
+                  par.height = height;
+                  par.subsamplingHor = subsampling[0];
+                  par.subsamplingVer = subsampling[1];
+                  par.chromaValSkip = interleaved ? 2 : 1;
+                  par.chromaOffsetY8 = chromaOffsetY8;
+                  par.bitsPerSample = bitsPerSample;
+                  par.bigEndian = (endianness == 1);
+                  par.fullRange = (width == 64);
+                  for (int i = 0; i < 5; i++)
+                    par.RGBConv[i] = RGBConv[par.fullRange ? 1 : 0][i];
+
+                  // Fill the planes (including the padding at the end of each line) with random values
+                  const int bytesPerSample = (bitsPerSample > 8) ? 2 : 1;
+                  const int chromaWidth = width / par.subsamplingHor;
+                  const int chromaHeight = height / par.subsamplingVer;
+                  par.strideY = width * bytesPerSample + padding;
+                  par.strideC = chromaWidth * par.chromaValSkip * bytesPerSample + padding;
+                  std::vector<unsigned char> planes(par.strideY * height + par.strideC * chromaHeight * 2);
+                  for (unsigned char &val : planes)
+                    val = (unsigned char)nextRandom();
+                  // Only use valid sample values (values that exceed the bit depth are not defined)
+                  if (bytesPerSample == 2)
+                  {
+                    const int maxVal = (1 << bitsPerSample) - 1;
+                    for (size_t i = 0; i + 1 < planes.size(); i += 2)
+                      setValue(planes.data(), int(i / 2), nextRandom() & maxVal, par.bigEndian);
+                  }
+                  par.srcY = planes.data();
+                  par.srcU = planes.data() + par.strideY * height;
+                  par.srcV = interleaved ? par.srcU + bytesPerSample : par.srcU + par.strideC * chromaHeight;
+
+                  std::vector<unsigned char> reference(width * 4 * height);
+                  std::vector<unsigned char> output(width * 4 * height);
+                  convertLines(par, &convertLineScalar, reference.data(), width * 4, 0, height);
+                  if (set == InstructionSetScalar)
+                  {
+                    // Re-sample the chroma planes (from the bottom up so that every line is interpolated with the
+                    // original line above it) and convert them without an offset.
+                    std::vector<unsigned char> resampledPlanes(planes);
+                    conversionParameters resampledPar = par;
+                    resampledPar.chromaOffsetY8 = 0;
+                    resampledPar.srcY = resampledPlanes.data();
+                    resampledPar.srcU = resampledPlanes.data() + (par.srcU - planes.data());
+                    resampledPar.srcV = resampledPlanes.data() + (par.srcV - planes.data());
+                    for (int c = 0; c < 2; c++)
+                    {
+                      unsigned char *plane = const_cast<unsigned char*>(c == 0 ? resampledPar.srcU : resampledPar.srcV);
+                      for (int y = chromaHeight - 1; y > 0; y--)
+                        for (int x = 0; x < chromaWidth; x++)
+                        {
+                          const int idx = x * par.chromaValSkip;
+                          const int prev = getValue(plane + (y - 1) * par.strideC, idx, bytesPerSample == 2, par.bigEndian);
+                          const int cur = getValue(plane + y * par.strideC, idx, bytesPerSample == 2, par.bigEndian);
+                          const int val = interpolateChroma(prev, cur, chromaOffsetY8);
+                          if (bytesPerSample == 2)
+                            setValue(plane + y * par.strideC, idx, val, par.bigEndian);
+                          else
+                            plane[y * par.strideC + idx] = (unsigned char)val;
+                        }
+                    }
+                    convertLines(resampledPar, &convertLineScalar, output.data(), width * 4, 0, height);
+                  }
+                  else
+                    convertLines(par, getLineFunction(par, InstructionSet(set)), output.data(), width * 4, 0, height);
+                  if (reference != output)
+                  {
+                    failedSet = InstructionSet(set);
+                    failedPar = par;
+                    return false;
+                  }
+                }
+    }
+    return true;
+  }
+}
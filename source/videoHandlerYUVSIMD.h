@@ -0,0 +1,96 @@
+/*  This file is part of YUView - The YUV player with advanced analytics toolset
+*   <https://github.com/IENT/YUView>
+*   Copyright (C) 2015  Institut für Nachrichtentechnik, RWTH Aachen University, GERMANY
+*
+*   This program is free software; you can redistribute it and/or modify
+*   it under the terms of the GNU General Public License as published by
+*   the Free Software Foundation; either version 3 of the License, or
+*   (at your option) any later version.
+*
+*   In addition, as a special exception, the copyright holders give
+*   permission to link the code of portions of this program with the
+*   OpenSSL library under certain conditions as described in each
+*   individual source file, and distribute linked combinations including
+*   the two.
+*   
+*   You must obey the GNU General Public License in all respects for all
+*   of the code used other than OpenSSL. If you modify file(s) with this
+*   exception, you may extend this exception to your version of the
+*   file(s), but you are not obligated to do so. If you do not wish to do
+*   so, delete this exception statement from your version. If you delete
+*   this exception statement from all source files in the program, then
+*   also delete it here.
+*
+*   This program is distributed in the hope that it will be useful,
+*   but WITHOUT ANY WARRANTY; without even the implied warranty of
+*   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+*   GNU General Public License for more details.
+*
+*   You should have received a copy of the GNU General Public License
+*   along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#ifndef VIDEOHANDLERYUVSIMD_H
+#define VIDEOHANDLERYUVSIMD_H
+
+/* Vectorized YUV -> RGB conversion kernels for the videoHandlerYUV.
+ * The kernels handle the most common conversion case: Planar (or UV interleaved) YUV with any chroma
+ * subsampling and any bit depth (8 to 16 bit, little or big endian) with nearest neighbor chroma
+ * up-sampling, no YUV math and all components displayed. A vertical chroma offset is supported. The output is BGRA (8 bit each). The input lines may
+ * have any stride.
+ * Which instruction set is used is decided at runtime depending on what the CPU supports (SSE4.1/AVX2 on x86,
+ * NEON on ARM). The scalar kernel is always available (on any CPU) and is the reference that the vector kernels
+ * must match bit exactly (see testKernels()).
+ * This file does not depend on Qt so that the kernels can be tested in isolation.
+ */
+namespace YUV_SIMD
+{
+  typedef enum
+  {
+    InstructionSetScalar,
+    InstructionSetSSE41,
+    InstructionSetAVX2,
+    InstructionSetNEON,
+    InstructionSetNum
+  } InstructionSet;
+
+  // All the parameters that are needed to convert a planar YUV frame to RGB.
+  struct conversionParameters
+  {
+    const unsigned char *srcY;
+    const unsigned char *srcU;
+    const unsigned char *srcV;
+    int strideY;            //< The number of bytes from one line to the next in the luma and chroma planes. The lines of a
+    int strideC;            //  plane do not have to be contiguous (e.g. if the planes are taken directly from a decoder picture).
+    int width;              //< The width and height of the luma plane (and the output)
+    int height;
+    int subsamplingHor;     //< The chroma subsampling factors (1, 2 or 4)
+    int subsamplingVer;
+    int chromaValSkip;      //< If U and V are interleaved, this is the number of values to skip per chroma sample (2 or 3). 1 otherwise.
+    int chromaOffsetY8;     //< The vertical chroma offset in 1/8 of a chroma line (0 to 7). Each chroma line is interpolated with the line above.
+    int bitsPerSample;
+    bool bigEndian;
+    bool fullRange;
+    int RGBConv[5];         //< [Y, cRV, cGU, cGV, cBU] with 16 bit fixed point precision
+  };
+
+  // Get the best instruction set that is supported by the CPU we are running on. The detection is only
+  // performed on the first call. This function is thread safe.
+  InstructionSet getSupportedInstructionSet();
+  // Get the name of the given instruction set (for display in the performance test info)
+  const char *getInstructionSetName(InstructionSet set);
+
+  // Convert the lines [lineStart, lineEnd) of the YUV input to BGRA. dst must point to the top left pixel of
+  // the full output image and dstStride is the number of bytes from one output line to the next. If no instruction set
+  // is given, the best supported one is used. If the requested set is not supported, the scalar kernel is used.
+  void convertYUVToRGB(const conversionParameters &par, unsigned char *dst, int dstStride, int lineStart, int lineEnd);
+  void convertYUVToRGB(const conversionParameters &par, unsigned char *dst, int dstStride, int lineStart, int lineEnd, InstructionSet set);
+
+  // Test all vector kernels that the CPU supports against the scalar reference kernel. Random input is converted
+  // for every subsampling, bit depth, endianness, vertical chroma offset and (odd) width. The chroma offset
+  // interpolation is also checked against a straightforward re-sampling of the chroma planes. Returns false if any output differs. In that case
+  // the instruction set and parameters of the first failing conversion are returned in failedSet and failedPar.
+  bool testKernels(InstructionSet &failedSet, conversionParameters &failedPar);
+}
+
+#endif // VIDEOHANDLERYUVSIMD_H